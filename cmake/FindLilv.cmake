@@ -0,0 +1,19 @@
+find_path(LILV_INCLUDE_DIR lilv/lilv.h PATH_SUFFIXES lilv-0)
+find_library(LILV_LIBRARY lilv-0)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(
+	Lilv
+	REQUIRED_VARS LILV_LIBRARY LILV_INCLUDE_DIR
+)
+
+if(Lilv_FOUND AND NOT TARGET Lilv::lilv)
+	add_library(Lilv::lilv UNKNOWN IMPORTED)
+
+	set_target_properties(
+		Lilv::lilv
+		PROPERTIES
+		IMPORTED_LOCATION "${LILV_LIBRARY}"
+		INTERFACE_INCLUDE_DIRECTORIES "${LILV_INCLUDE_DIR}"
+	)
+endif()
@@ -1,42 +1,395 @@
 #include "app.h"
 
 #include "gui/main_window.h"
+#include "effect_registry.h"
+#include "effect_chain.h"
+#include "ladspa_host.h"
+#include "lv2_host.h"
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QDir>
 #include <QMessageBox>
-#include <portaudio.h>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QThread>
+#include <stdio.h>
+#include <chrono>
+#include <algorithm>
+#include <random>
 
 App the_app;
 
 int run_app(int argc, char* argv[]) {
     QApplication app(argc, argv);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument("file", "Audio file to open.");
+    QCommandLineOption backend_option("audio-backend",
+        "Audio backend: portaudio, null, null:fast or file:<path.wav>. Defaults to $AUDIOEDITOR_BACKEND, then portaudio.",
+        "backend");
+    QCommandLineOption benchmark_option("benchmark",
+        "Play the file through the audio backend without a window, print callback statistics and exit.");
+    QCommandLineOption benchmark_effects_option("benchmark-effects",
+        "Run every effect, LADSPA and LV2 plugins included, over noise in preview sized blocks, print the cost per block and exit.");
+    parser.addOption(backend_option);
+    parser.addOption(benchmark_option);
+    parser.addOption(benchmark_effects_option);
+    parser.process(app);
+
+    QString backend = parser.isSet(backend_option) ? parser.value(backend_option) : qEnvironmentVariable("AUDIOEDITOR_BACKEND");
+    QStringList files = parser.positionalArguments();
+
     the_app.buffer.init(2, 44100);
     the_app.last_dir = QDir::currentPath();
     the_app.unsaved_changes = false;
-    the_app.interface.init();
+    the_app.main_window = nullptr;
+    load_settings();
+    the_app.interface.init(backend);
+
+    QString cache_dir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+    register_ladspa_plugins(QDir(cache_dir).filePath("AudioEditor/ladspa_plugins.txt").toStdString());
+    register_lv2_plugins(QDir(cache_dir).filePath("AudioEditor/lv2_plugins.txt").toStdString());
+    QString data_dir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+    QString recovery_dir = QDir(data_dir).filePath("AudioEditor/recovery");
+
+    if (parser.isSet(benchmark_effects_option))
+        return run_effect_benchmark();
+
+    if (parser.isSet(benchmark_option)) {
+        if (files.isEmpty()) {
+            fprintf(stderr, "--benchmark needs a file to play\n");
+            return 1;
+        }
+        return run_benchmark(files.at(0));
+    }
 
     MainWindow window;
     the_app.main_window = &window;
     window.show();
 
-    if (app.arguments().length() >= 2) {
-        window.load_from_file(app.arguments().at(1));
+    if (the_app.journal.start(recovery_dir.toStdString()))
+        the_app.journal.record_new(the_app.buffer.get_num_channels(), the_app.buffer.get_sample_rate());
+
+    if (!window.offer_recovery(recovery_dir) && !files.isEmpty()) {
+        window.load_from_file(files.at(0));
+    }
+
+    int result = app.exec();
+
+    // a clean exit, there's nothing to recover next time
+    the_app.journal.discard();
+    return result;
+}
+
+// headless playback, with the null:fast backend this measures pure callback cost
+int run_benchmark(const QString& path) {
+    if (!the_app.buffer.load_from_file(path))
+        return 1;
+
+    AudioInterface& interface = the_app.interface;
+    auto start_time = std::chrono::steady_clock::now();
+    interface.play();
+    while (interface.get_state() != AudioInterface::State::IDLE)
+        QThread::msleep(5);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+    const AudioStats& stats = interface.get_stats();
+    double duration = the_app.buffer.get_num_frames() / (double) the_app.buffer.get_sample_rate();
+
+    printf("backend:          %s\n", interface.get_backend_name());
+    printf("audio:            %.2f s, %d ch, %d Hz\n", duration, the_app.buffer.get_num_channels(), the_app.buffer.get_sample_rate());
+    printf("stream rate:      %.0f Hz%s\n", interface.get_stream_rate(), interface.is_resampling() ? " (resampling)" : "");
+    printf("wall time:        %.3f s (%.1fx realtime)\n", elapsed.count(), duration / std::max(elapsed.count(), 1e-9));
+    printf("callbacks:        %llu\n", (unsigned long long) stats.num_callbacks.load());
+    printf("max load:         %.1f%%\n", stats.max_load.load() * 100);
+    printf("deadline misses:  %llu\n", (unsigned long long) stats.deadline_misses.load());
+    printf("underflows:       %llu\n", (unsigned long long) stats.output_underflows.load());
+
+    printf("load histogram:\n");
+    for (int i = 0; i < AudioStats::num_load_bins; i++) {
+        uint64_t count = stats.load_histogram[i].load();
+        if (count == 0)
+            continue;
+        printf("  %3d%%%s %llu\n", (int) (i * AudioStats::load_bin_width * 100),
+               i == AudioStats::num_load_bins - 1 ? "+" : " ", (unsigned long long) count);
     }
 
-    return app.exec();
+    return 0;
+}
+
+// what each effect costs the audio callback, every block is fresh noise so nothing settles into
+// silence, effects that need something first (a noise profile, an impulse response) are skipped
+int run_effect_benchmark() {
+    const int num_channels = 2;
+    const int sample_rate = 48000;
+    const int block_size = EffectChain::block_size;
+    const int num_blocks = sample_rate * 10 / block_size;
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+    std::vector<float> noise[num_channels];
+    for (int c = 0; c < num_channels; c++) {
+        noise[c].resize(block_size * num_blocks);
+        for (float& x : noise[c])
+            x = distribution(random);
+    }
+
+    printf("%d ch, %d Hz, %d frame blocks, %.1f s of audio each\n\n", num_channels, sample_rate, block_size, num_blocks * block_size / (double) sample_rate);
+    printf("%-40s %12s %10s\n", "effect", "us/block", "load");
+
+    std::vector<float> planar[num_channels];
+    for (int c = 0; c < num_channels; c++)
+        planar[c].resize(block_size);
+
+    for (const EffectInfo& info : get_effect_registry()) {
+        if (info.generator)
+            continue;
+
+        std::unique_ptr<Effect> effect = info.create(sample_rate);
+        effect->prepare(num_channels, sample_rate, 0, (int64_t) num_blocks * block_size);
+        QString name = info.submenu.isEmpty() ? info.name : info.submenu + "/" + info.name;
+        if (const char* requirement = effect->get_unmet_requirement()) {
+            printf("%-40s skipped, %s\n", name.toLocal8Bit().constData(), requirement);
+            continue;
+        }
+
+        std::chrono::duration<double> elapsed(0);
+        for (int b = 0; b < num_blocks; b++) {
+            for (int c = 0; c < num_channels; c++)
+                std::copy(noise[c].begin() + b * block_size, noise[c].begin() + (b + 1) * block_size, planar[c].begin());
+
+            EffectBlock block;
+            block.channels[0] = planar[0].data();
+            block.channels[1] = planar[1].data();
+            block.num_channels = num_channels;
+            block.num_frames = block_size;
+            block.frame_pos = (int64_t) b * block_size;
+
+            auto start_time = std::chrono::steady_clock::now();
+            effect->process(block);
+            elapsed += std::chrono::steady_clock::now() - start_time;
+        }
+
+        double per_block = elapsed.count() / num_blocks;
+        printf("%-40s %12.2f %9.3f%%\n", name.toLocal8Bit().constData(), per_block * 1e6, per_block / (block_size / (double) sample_rate) * 100);
+    }
+
+    return 0;
 }
 
 void save_state() {
+    if (the_app.non_destructive) {
+        the_app.edit_history.push_back(the_app.edits);
+        return;
+    }
+
     the_app.history.push_back(the_app.buffer);
+    the_app.layout_history.push_back(the_app.layout);
+    the_app.track_history.push_back(nullptr);
 }
 
 void undo_state() {
+    if (the_app.non_destructive) {
+        if (the_app.edit_history.empty())
+            return;
+
+        the_app.journal.record_restore(the_app.edits, std::make_shared<const EditList>(the_app.edit_history.back()));
+        the_app.edits = std::move(the_app.edit_history.back());
+        the_app.edit_history.pop_back();
+        return;
+    }
+
     if (the_app.history.empty())
         return;
 
+    the_app.journal.record_restore(the_app.buffer, the_app.history.back());
     the_app.buffer = the_app.history.back();
     the_app.history.pop_back();
+    if (!the_app.layout_history.empty()) {
+        the_app.layout = std::move(the_app.layout_history.back());
+        the_app.layout_history.pop_back();
+    }
+    if (!the_app.track_history.empty()) {
+        if (the_app.track_history.back())
+            the_app.interface.get_mixer().set_state(std::move(the_app.track_history.back()));
+        the_app.track_history.pop_back();
+    }
+}
+
+// the buffer's frames become the only source of a new edit list, the buffer keeps the format
+// frames that are still in the project read from there instead
+void begin_edit_list() {
+    int num_channels = the_app.buffer.get_num_channels();
+    int sample_rate = the_app.buffer.get_sample_rate();
+
+    EditList frames(std::make_shared<const AudioBuffer>(std::move(the_app.buffer)));
+    the_app.edits = ProjectFile::fill_layout(the_app.layout, frames);
+    the_app.buffer.init(num_channels, sample_rate);
+    the_app.edit_clipboard = EditList(num_channels, sample_rate);
+    the_app.edit_history.clear();
+    the_app.history.clear();
+    the_app.layout = EditList();
+    the_app.layout_history.clear();
+    the_app.track_history.clear();
+}
+
+// renders the edit list back into the buffer, the edit history doesn't apply to it anymore
+void end_edit_list() {
+    the_app.edits.render(the_app.buffer);
+    if (the_app.project)
+        the_app.layout = the_app.project->get_layout(the_app.edits);
+    else
+        reset_layout();
+    the_app.edits = EditList();
+    the_app.edit_clipboard = EditList();
+    the_app.edit_history.clear();
+    the_app.history.clear();
+    the_app.layout_history.clear();
+    the_app.track_history.clear();
+}
+
+int64_t get_edited_frames() {
+    return the_app.non_destructive ? the_app.edits.get_num_frames() : the_app.buffer.get_num_frames();
+}
+
+double get_edited_duration() {
+    return the_app.non_destructive ? the_app.edits.get_duration() : the_app.buffer.get_duration();
+}
+
+// an edit left frames [start, new_end) new, only those go into the journal, the edit list reads
+// them on the journal's thread
+void journal_change(int64_t start, int64_t new_end) {
+    if (the_app.non_destructive)
+        the_app.journal.record_splice(std::make_shared<const EditList>(the_app.edits), start, new_end);
+    else
+        the_app.journal.record_splice(the_app.buffer, start, new_end);
+}
+
+// everything as it is now becomes the base of the journal
+void journal_snapshot() {
+    std::string document = the_app.file_path.toStdString();
+    if (the_app.non_destructive)
+        the_app.journal.record_snapshot(std::make_shared<const EditList>(the_app.edits), document);
+    else
+        the_app.journal.record_snapshot(the_app.buffer, document);
+}
+
+// every frame of the buffer is new to the project, after anything that changed all of them
+void reset_layout() {
+    const AudioBuffer& buffer = the_app.buffer;
+    the_app.layout = EditList(buffer.get_num_channels(), buffer.get_sample_rate(), {{nullptr, 0, buffer.get_num_frames()}});
+}
+
+// an edit of the buffer left frames [start, new_end) new and the rest as it was, what it took out
+// follows from the lengths before and after it, like in the journal
+void layout_change(int64_t start, int64_t new_end) {
+    if (the_app.non_destructive)
+        return;
+
+    EditList& layout = the_app.layout;
+    const AudioBuffer& buffer = the_app.buffer;
+    int64_t length = layout.get_num_frames();
+    int64_t first = std::min(start, length); // a paste past the end fills the gap with silence
+    int64_t removed = length - first - (buffer.get_num_frames() - new_end);
+    if (layout.get_num_channels() != buffer.get_num_channels() || removed < 0 || new_end < first) {
+        reset_layout();
+        return;
+    }
+
+    layout.remove(first, first + removed);
+    layout.insert(first, EditList(buffer.get_num_channels(), buffer.get_sample_rate(), {{nullptr, 0, new_end - first}}));
+}
+
+// writes the document, its undo history and what's been analysed of it, the selection is up to
+// the caller, afterwards the lists read from the saved project
+bool save_project(const std::string& path, ProjectState& state, std::string& error) {
+    if (the_app.non_destructive) {
+        state.edits = the_app.edits;
+        state.history = the_app.edit_history;
+    } else {
+        // the lists only borrow the buffers, for as long as the save takes
+        auto borrow = [](const AudioBuffer& buffer) {
+            return EditList(std::shared_ptr<const AudioBuffer>(std::shared_ptr<const AudioBuffer>(), &buffer));
+        };
+        state.edits = ProjectFile::fill_layout(the_app.layout, borrow(the_app.buffer));
+
+        // an undo step mostly has the frames of the one after it, like in the journal only what
+        // differs is read from its own buffer, the rest comes from the newer list so it's written once
+        state.history.resize(the_app.history.size());
+        const AudioBuffer* newer = &the_app.buffer;
+        const EditList* newer_list = &state.edits;
+        for (size_t i = the_app.history.size(); i-- > 0;) {
+            const AudioBuffer& buffer = the_app.history[i];
+            int64_t num_frames = buffer.get_num_frames();
+            int64_t newer_frames = newer->get_num_frames();
+            int64_t prefix, suffix;
+            buffer.find_common(*newer, prefix, suffix);
+
+            EditList frames = borrow(buffer);
+            if (prefix + suffix > 0) {
+                EditList own = frames.slice(prefix, num_frames - suffix);
+                frames = newer_list->slice(0, prefix);
+                frames.insert(prefix, own);
+                frames.insert(num_frames - suffix, newer_list->slice(newer_frames - suffix, newer_frames));
+            }
+
+            const EditList& layout = i < the_app.layout_history.size() ? the_app.layout_history[i] : EditList();
+            state.history[i] = ProjectFile::fill_layout(layout, frames);
+            newer = &buffer;
+            newer_list = &state.history[i];
+        }
+    }
+    state.beats = the_app.beat_tracker.get_grid();
+    // buckets that show silence where an effect hasn't been rendered yet aren't worth keeping
+    if (!the_app.waveform.has_unrendered())
+        state.levels = the_app.waveform.get_levels();
+
+    if (!ProjectFile::save(path, state, the_app.project, error))
+        return false;
+
+    if (the_app.non_destructive) {
+        the_app.edits = state.edits;
+        the_app.edit_history = state.history;
+    } else {
+        the_app.layout = state.edits;
+        the_app.layout_history = state.history;
+    }
+    return true;
+}
+
+// the project's lists become the document and its undo history, in destructive mode the buffers
+// get their frames copied out of the mapping, the rest of state is up to the caller
+bool open_project(const std::string& path, ProjectState& state, std::string& error) {
+    std::shared_ptr<ProjectFile> project;
+    if (!ProjectFile::open(path, state, project, error))
+        return false;
+
+    int num_channels = state.edits.get_num_channels();
+    int sample_rate = state.edits.get_sample_rate();
+    the_app.project = std::move(project);
+    the_app.buffer.init(num_channels, sample_rate);
+
+    if (the_app.non_destructive) {
+        the_app.edits = state.edits;
+        the_app.edit_history = state.history;
+        the_app.edit_clipboard = EditList(num_channels, sample_rate);
+        the_app.history.clear();
+        the_app.track_history.clear();
+        return true;
+    }
+
+    state.edits.render(the_app.buffer);
+    the_app.history.clear();
+    for (const EditList& list : state.history) {
+        AudioBuffer buffer;
+        list.render(buffer);
+        the_app.history.push_back(std::move(buffer));
+    }
+    the_app.layout = state.edits;
+    the_app.layout_history = state.history;
+    the_app.track_history.assign(the_app.history.size(), nullptr);
+    return true;
 }
 
 void show_error_box(const QString& msg) {
@@ -44,3 +397,32 @@ void show_error_box(const QString& msg) {
     QMessageBox box;
     box.critical(the_app.main_window, "Error", msg);
 }
+
+void load_settings() {
+    QSettings settings("AudioEditor", "AudioEditor");
+
+    AudioInterface::StreamConfig config = the_app.interface.get_config();
+    config.frames_per_buffer = settings.value("audio/frames_per_buffer", config.frames_per_buffer).toInt();
+    config.latency = settings.value("audio/latency", config.latency).toDouble();
+    config.resample = settings.value("audio/resample", config.resample).toBool();
+    config.resample_quality = (Resampler::Quality) settings.value("audio/resample_quality", (int) config.resample_quality).toInt();
+    config.loop_crossfade = settings.value("audio/loop_crossfade", config.loop_crossfade).toDouble();
+    the_app.interface.set_config(config);
+
+    the_app.io.limit_exports = settings.value("export/limit", the_app.io.limit_exports).toBool();
+    the_app.io.export_ceiling_dbtp = settings.value("export/ceiling_dbtp", the_app.io.export_ceiling_dbtp).toDouble();
+}
+
+void save_settings() {
+    QSettings settings("AudioEditor", "AudioEditor");
+
+    const AudioInterface::StreamConfig& config = the_app.interface.get_config();
+    settings.setValue("audio/frames_per_buffer", config.frames_per_buffer);
+    settings.setValue("audio/latency", config.latency);
+    settings.setValue("audio/resample", config.resample);
+    settings.setValue("audio/resample_quality", (int) config.resample_quality);
+    settings.setValue("audio/loop_crossfade", config.loop_crossfade);
+
+    settings.setValue("export/limit", the_app.io.limit_exports);
+    settings.setValue("export/ceiling_dbtp", the_app.io.export_ceiling_dbtp);
+}
@@ -3,7 +3,13 @@
 #include "audio_buffer.h"
 #include "audio_interface.h"
 #include "waveform_cache.h"
+#include "energy_index.h"
+#include "snap_index.h"
+#include "beat_tracker.h"
 #include "file_io.h"
+#include "edit_list.h"
+#include "journal.h"
+#include "project.h"
 #include <QString>
 
 class MainWindow;
@@ -19,11 +25,45 @@ struct App {
     bool unsaved_changes;
     AudioInterface interface;
     WaveformVisual waveform;
+    EnergyIndex energy_index; // built on demand, dropped on every edit
+    SnapIndex snap_index; // built in the background after loads, patched on every edit
+    BeatTracker beat_tracker; // runs again in the background after every edit
+
+    // non-destructive mode, edits go into the edit list and the buffer only keeps the format
+    bool non_destructive = false;
+    EditList edits;
+    EditList edit_clipboard;
+    std::vector<EditList> edit_history;
+
+    Journal journal; // crash recovery, every edit gets written out in the background
+
+    // the project the document was last opened from or saved to, null if it wasn't one
+    std::shared_ptr<ProjectFile> project;
+    // destructive mode, which frames of the buffer are still in the project, a piece without a
+    // source stands for frames that are new to it, see ProjectFile::get_layout
+    EditList layout;
+    std::vector<EditList> layout_history; // goes along with history
+    // goes along with history too, the tracks a step had where it changed them, null elsewhere
+    std::vector<std::shared_ptr<const MixerState>> track_history;
 };
 
 extern App the_app;
 
 int run_app(int argc, char* argv[]);
+int run_benchmark(const QString& path);
+int run_effect_benchmark();
 void save_state();
 void undo_state();
+void begin_edit_list();
+void end_edit_list();
+int64_t get_edited_frames();
+double get_edited_duration();
+void journal_change(int64_t start, int64_t new_end);
+void journal_snapshot();
+void reset_layout();
+void layout_change(int64_t start, int64_t new_end);
+bool save_project(const std::string& path, ProjectState& state, std::string& error);
+bool open_project(const std::string& path, ProjectState& state, std::string& error);
 void show_error_box(const QString& msg);
+void load_settings();
+void save_settings();
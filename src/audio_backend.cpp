@@ -0,0 +1,21 @@
+#include "audio_backend.h"
+
+#include "backends/portaudio_backend.h"
+#include "backends/null_backend.h"
+#include "backends/file_backend.h"
+
+std::unique_ptr<AudioBackend> create_audio_backend(const QString& spec) {
+    if (spec.isEmpty() || spec == "portaudio")
+        return std::make_unique<PortAudioBackend>();
+
+    if (spec == "null")
+        return std::make_unique<NullBackend>(true);
+
+    if (spec == "null:fast")
+        return std::make_unique<NullBackend>(false);
+
+    if (spec.startsWith("file:") && spec.length() > 5)
+        return std::make_unique<FileBackend>(spec.mid(5));
+
+    return nullptr;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QString>
+#include <memory>
+#include <portaudio.h>
+
+// whatever drives the audio callbacks, a sound card or something that just pretends to be one
+// streams keep portaudio's callback signature and status flags whichever backend runs them
+class AudioBackend {
+public:
+    struct DeviceInfo {
+        QString name;
+        int max_input_channels = 0;
+        int max_output_channels = 0;
+        double default_sample_rate = 0; // 0 if any rate is fine
+        double default_input_latency = 0;
+        double default_output_latency = 0;
+    };
+
+    struct StreamParams {
+        int device = -1;
+        bool input = false; // streams are either input or output, never both
+        int num_channels = 0;
+        double sample_rate = 0;
+        int frames_per_buffer = 0; // 0 lets the backend decide
+        double latency = 0;
+    };
+
+    virtual ~AudioBackend() {}
+
+    virtual const char* get_name() const = 0;
+    virtual bool init() = 0;
+
+    virtual int get_num_devices() const = 0;
+    virtual DeviceInfo get_device_info(int i) const = 0;
+    virtual int get_default_input_device() const = 0; // -1 if there is none
+    virtual int get_default_output_device() const = 0;
+    virtual bool is_format_supported(const StreamParams& params) const = 0;
+
+    // only one stream at a time, opening a new one closes the previous one
+    virtual bool open_stream(const StreamParams& params, PaStreamCallback* callback,
+                             PaStreamFinishedCallback* finished, void* user_data) = 0;
+    virtual bool start_stream() = 0;
+    virtual bool stop_stream() = 0;
+    virtual void close_stream() = 0;
+    virtual bool is_stream_open() const = 0;
+    virtual bool is_stream_stopped() const = 0;
+
+    // clock the callback's time info is based on
+    virtual double get_stream_time() const = 0;
+    virtual double get_stream_latency() const = 0;
+
+    const QString& get_error() const { return m_error; }
+
+protected:
+    QString m_error; // reason the last call failed
+};
+
+// "portaudio", "null", "null:fast" or "file:<path>", nullptr for anything else
+std::unique_ptr<AudioBackend> create_audio_backend(const QString& spec);
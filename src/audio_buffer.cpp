@@ -1,21 +1,37 @@
 #include "audio_buffer.h"
 
 #include "app.h"
+#include "simd.h"
 #include <QFileInfo>
 #include <QtGlobal>
 #include <qlogging.h>
 #include <stdint.h>
+#include <string.h>
 #include <algorithm>
+#include <atomic>
 
 AudioBuffer::AudioBuffer() {}
 
 void AudioBuffer::init(int num_channels, int sample_rate, std::vector<float>&& samples) {
     m_num_channels = num_channels;
     m_sample_rate = sample_rate;
-    m_samples = std::move(samples);
+    m_samples = std::make_shared<std::vector<float>>(std::move(samples));
     on_length_changed();
 }
 
+std::vector<float>& AudioBuffer::writable() {
+    if (!m_samples) {
+        m_samples = std::make_shared<std::vector<float>>();
+    } else if (m_samples.use_count() > 1) {
+        m_samples = std::make_shared<std::vector<float>>(*m_samples);
+    } else {
+        // the last other owner may have dropped its copy on another thread just now, its reads
+        // have to be done before the frames change
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *m_samples;
+}
+
 // TODO: refactor
 bool AudioBuffer::load_from_file(const QString& path) {
 	bool result = the_app.io.read(*this, path.toStdString());
@@ -32,12 +48,13 @@ void AudioBuffer::sample_amplitude(int channel, int64_t start, int64_t end, floa
     if (start == end)
         end = start + 1;
 
+    const std::vector<float>& samples = get_samples();
     float max = -2, min = 2;
     for (int64_t i = start; i < end; i++) {
         int64_t index = i * m_num_channels + channel;
-        if (index < 0 || index >= m_samples.size())
+        if (index < 0 || index >= samples.size())
             continue;
-        float sample = m_samples[index];
+        float sample = samples[index];
         if (sample > max)
             max = sample;
         if (sample < min)
@@ -58,41 +75,60 @@ bool AudioBuffer::delete_region(int64_t start, int64_t end) {
     start *= m_num_channels;
     end *= m_num_channels;
 
-    m_samples.erase(m_samples.begin() + start, m_samples.begin() + end);
+    std::vector<float>& samples = writable();
+    samples.erase(samples.begin() + start, samples.begin() + end);
     on_length_changed();
     return true;
 }
 
 void AudioBuffer::insert_silence(int64_t where, int64_t num_frames) {
-    int64_t num = num_frames * m_num_channels;
-    for (int64_t i = 0; i < num; i++) {
-        m_samples.push_back(0);
-    }
+    insert_frames(where, num_frames);
+}
+
+// opens a zeroed gap of num_frames at where and returns a pointer to it,
+// so callers can fill it in place instead of going through a temporary buffer
+float* AudioBuffer::insert_frames(int64_t where, int64_t num_frames) {
+    where = std::max((int64_t) 0, std::min(m_num_frames, where));
+
+    std::vector<float>& samples = writable();
+    samples.insert(samples.begin() + where * m_num_channels, num_frames * m_num_channels, 0.0f);
     on_length_changed();
+    return &samples[where * m_num_channels];
 }
 
-void AudioBuffer::normalize_region(int64_t start, int64_t end) {
-    start = clamp_frame(start);
-    end = clamp_frame(end);
+void AudioBuffer::normalize_region(int64_t start, int64_t end, float target_peak) {
+    start = std::max((int64_t) 0, start);
+    end = std::min(m_num_frames, end);
 
     if (start >= end)
         return;
 
-    float left_min = 0, left_max = 0;
-    sample_amplitude(0, start, end, left_min, left_max);
-    float right_min = 0, right_max = 0;
-    if (m_num_channels == 2)
-        sample_amplitude(1, start, end, right_min, right_max);
+    // one gain for all channels so the balance between them stays the same
+    float abs_max = 0;
+    for (int c = 0; c < m_num_channels; c++) {
+        float max = 0, min = 0;
+        sample_amplitude(c, start, end, max, min);
+        abs_max = std::max(abs_max, std::max(std::abs(min), std::abs(max)));
+    }
 
-    float abs_max = std::max(std::abs(left_min), std::abs(left_max));
     const float min_amp = 0.0001f;
     abs_max = std::max(min_amp, abs_max);
 
-    float amp = 1.0f / abs_max;
+    apply_gain(start, end, target_peak / abs_max);
+}
 
-    amplify_region(0, start, end, amp);
-    if (m_num_channels == 2)
-        amplify_region(1, start, end, amp);
+void AudioBuffer::apply_gain(int64_t start, int64_t end, float amp) {
+    start = std::max((int64_t) 0, start);
+    end = std::min(m_num_frames, end);
+    if (start >= end)
+        return;
+
+    // frames are interleaved, so the region is one run of samples
+    float* samples = &writable()[start * m_num_channels];
+    int64_t num_samples = (end - start) * m_num_channels;
+    const int64_t max_run = 1 << 20;
+    for (int64_t i = 0; i < num_samples; i += max_run)
+        multiply_ramp(samples + i, (int) std::min(max_run, num_samples - i), amp, 0.0f);
 }
 
 void AudioBuffer::amplify_region(int channel, int64_t start, int64_t end, float amp) {
@@ -100,14 +136,15 @@ void AudioBuffer::amplify_region(int channel, int64_t start, int64_t end, float
     start = clamp_frame(start);
     end = clamp_frame(end);
 
+    std::vector<float>& samples = writable();
     for (int64_t i = start; i < end; i++) {
         int64_t index = i * m_num_channels + channel;
 
         // TODO: remove some of this crap
-        if (index < 0 || index >= m_samples.size())
+        if (index < 0 || index >= samples.size())
             continue;
 
-        m_samples[index] *= amp;
+        samples[index] *= amp;
     }
 }
 
@@ -121,9 +158,8 @@ bool AudioBuffer::copy_region(int64_t start, int64_t end, AudioBuffer& to) const
     start *= m_num_channels;
     end *= m_num_channels;
 
-    to.init(m_num_channels, m_sample_rate);
-    to.m_samples.insert(to.m_samples.begin(), m_samples.begin() + start, m_samples.begin() + end);
-    to.on_length_changed();
+    const std::vector<float>& samples = get_samples();
+    to.init(m_num_channels, m_sample_rate, std::vector<float>(samples.begin() + start, samples.begin() + end));
     return true;
 }
 
@@ -146,12 +182,57 @@ bool AudioBuffer::paste_from(int64_t where, const AudioBuffer& from) {
 
     where *= m_num_channels;
 
-    m_samples.insert(m_samples.begin() + where, from.m_samples.begin(), from.m_samples.end());
+    // holding on to from's frames keeps them apart from the ones that change, even if they're shared
+    std::shared_ptr<const std::vector<float>> from_samples = from.m_samples;
+    const std::vector<float>& source = from.get_samples();
+    std::vector<float>& samples = writable();
+    samples.insert(samples.begin() + where, source.begin(), source.end());
     on_length_changed();
     return true;
 }
 
+// how many samples from the start are the same in both, a block at a time until one differs
+static int64_t common_prefix(const float* a, const float* b, int64_t count) {
+    const int64_t block = 4096;
+    int64_t i = 0;
+    while (i + block <= count && memcmp(a + i, b + i, block * sizeof(float)) == 0)
+        i += block;
+    while (i < count && memcmp(a + i, b + i, sizeof(float)) == 0)
+        i++;
+    return i;
+}
+
+// the same from the end backwards, a_end and b_end point past the last sample
+static int64_t common_suffix(const float* a_end, const float* b_end, int64_t count) {
+    const int64_t block = 4096;
+    int64_t i = 0;
+    while (i + block <= count && memcmp(a_end - i - block, b_end - i - block, block * sizeof(float)) == 0)
+        i += block;
+    while (i < count && memcmp(a_end - i - 1, b_end - i - 1, sizeof(float)) == 0)
+        i++;
+    return i;
+}
+
+void AudioBuffer::find_common(const AudioBuffer& other, int64_t& prefix, int64_t& suffix) const {
+    prefix = 0;
+    suffix = 0;
+    if (m_num_channels != other.m_num_channels || m_sample_rate != other.m_sample_rate)
+        return;
+
+    // copies that still share their frames are the same without looking
+    int64_t shortest = std::min(m_num_frames, other.m_num_frames);
+    if (m_samples == other.m_samples) {
+        prefix = shortest;
+        return;
+    }
+
+    const float* a = get_samples().data();
+    const float* b = other.get_samples().data();
+    prefix = common_prefix(a, b, shortest * m_num_channels) / m_num_channels;
+    suffix = common_suffix(a + m_num_frames * m_num_channels, b + other.m_num_frames * m_num_channels, (shortest - prefix) * m_num_channels) / m_num_channels;
+}
+
 void AudioBuffer::on_length_changed() {
-    m_num_frames = m_samples.size() / m_num_channels;
+    m_num_frames = get_samples().size() / m_num_channels;
     m_total_duration = m_num_frames / (double) m_sample_rate;
 }
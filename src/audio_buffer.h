@@ -1,10 +1,13 @@
 #pragma once
 
 #include "ffmpeg_wrapper.h"
+#include <memory>
 #include <vector>
 #include <stdint.h>
 #include <QString>
 
+// copies share their frames until one of them changes, so a copy that is only ever read, like
+// the ones the journal hands to its writer, costs nothing up front
 class AudioBuffer {
 public:
     AudioBuffer();
@@ -14,13 +17,19 @@ public:
     void sample_amplitude(int channel, int64_t start, int64_t end, float& out_max, float& out_min) const;
     bool delete_region(int64_t start, int64_t end);
     void insert_silence(int64_t where, int64_t num_frames);
-    void normalize_region(int64_t start, int64_t end);
+    float* insert_frames(int64_t where, int64_t num_frames);
+    void normalize_region(int64_t start, int64_t end, float target_peak = 1.0f);
+    void apply_gain(int64_t start, int64_t end, float amp);
     void amplify_region(int channel, int64_t start, int64_t end, float amp);
 
     bool copy_region(int64_t start, int64_t end, AudioBuffer& to) const;
     bool cut_region(int64_t start, int64_t end, AudioBuffer& to);
     bool paste_from(int64_t where, const AudioBuffer& from);
 
+    // frames both have in common from the start and, of the rest, from the end, none if the
+    // formats differ
+    void find_common(const AudioBuffer& other, int64_t& prefix, int64_t& suffix) const;
+
     int64_t get_num_frames() const { return m_num_frames; }
     int get_num_channels() const { return m_num_channels; }
     int get_sample_rate() const { return m_sample_rate; }
@@ -28,13 +37,20 @@ public:
     int64_t get_frame(double time) const { return (int64_t) (time * m_sample_rate); }
     double get_time(int64_t frame_pos) const { return frame_pos / (double)m_sample_rate; }
     bool is_stereo() const { return m_num_channels == 2; }
-    const std::vector<float>& get_samples() const { return m_samples; }
+    const std::vector<float>& get_samples() const {
+        static const std::vector<float> no_samples;
+        return m_samples ? *m_samples : no_samples;
+    }
 	float single_sample(int64_t frame, int channel) const {
-		return m_samples[clamp_frame(frame) * 2 + channel];
+		return get_samples()[clamp_frame(frame) * 2 + channel];
 	}
 
+    // unshares the frames, the const one doesn't and is the one for the audio thread
     float* get_raw_pointer() {
-        return m_samples.size() == 0 ? nullptr : &m_samples[0];
+        return get_samples().empty() ? nullptr : writable().data();
+    }
+    const float* get_raw_pointer() const {
+        return get_samples().empty() ? nullptr : get_samples().data();
     }
 
 	int64_t clamp_frame(int64_t frame) const {
@@ -48,8 +64,11 @@ public:
 private:
     void on_length_changed();
 
+    // the frames to change in place, copied first if another buffer still shares them
+    std::vector<float>& writable();
+
 private:
-    std::vector<float> m_samples;
+    std::shared_ptr<std::vector<float>> m_samples; // null once moved from
 	int m_sample_format = AV_SAMPLE_FMT_FLT;
     int64_t m_num_frames = 0;
     int m_sample_rate = -1;
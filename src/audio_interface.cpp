@@ -5,141 +5,290 @@
 #include <QtGlobal>
 #include <qlogging.h>
 #include <QDebug>
+#include <string.h>
+#include <chrono>
+#include <math.h>
+#include <utility>
+#include <thread>
+
+// effects in the edit list render this much of what's about to play before the stream starts,
+// the render ahead thread keeps this much rendered past the playhead after that
+static const double prefetch_seconds = 2;
+static const double render_ahead_seconds = 10;
 
 int playback_callback(const void* input_buf, void* output_buf,
                              unsigned long num_frames, const PaStreamCallbackTimeInfo* time_info,
                              PaStreamCallbackFlags status, void* user_data) {
     AudioInterface* interface = (AudioInterface*) user_data;
-
-    if (interface->m_stop_pos != -1 && interface->m_frame_pos >= interface->m_stop_pos) {
-        if (interface->m_loop)
-            interface->m_frame_pos = interface->m_start_pos;
-        else
-            return paComplete;
-    }
+    CallbackTimer timer(interface->m_stats, num_frames, interface->m_stream_rate, status);
 
     float* out = (float*) output_buf;
 
-    int64_t frames_left = interface->m_stop_pos - interface->m_frame_pos;
+    if (interface->wants_varispeed()) {
+        bool finished = interface->render_varispeed(out, num_frames, time_info->outputBufferDacTime);
+        interface->m_meter.push(out, num_frames);
+        return finished ? paComplete : paContinue;
+    }
+
+    interface->leave_varispeed();
+    interface->m_mix_seconds = 0;
 
-    int64_t num = std::min((int64_t) num_frames, frames_left);
-    if (the_app.buffer.is_stereo()) {
-        const float* in = (const float*) the_app.buffer.get_raw_pointer();
-        in += interface->m_frame_pos * 2;
-        for (int64_t i = 0; i < num; i++) {
-            *out++ = *in++;
-            *out++ = *in++;
-        }
+    // the whole buffer is always filled, looping wraps mid-buffer and the end is padded with silence
+    if (interface->m_resampling) {
+        interface->publish_playhead(interface->m_frame_pos - interface->m_resampler.get_delay(), time_info->outputBufferDacTime, 1.0);
+        interface->render_resampled(out, num_frames);
     } else {
-        const float* in = (const float*) the_app.buffer.get_raw_pointer();
-        in += interface->m_frame_pos;
-        for (int64_t i = 0; i < num; i++) {
-            *out++ = *in++;
-        }
+        interface->publish_playhead(interface->m_frame_pos, time_info->outputBufferDacTime, 1.0);
+        int64_t num = interface->read_source(out, num_frames);
+        std::fill(out + num * interface->m_num_channels, out + num_frames * interface->m_num_channels, 0.0f);
     }
 
-    // TODO: this is not thread safe!
-    the_app.main_window->m_audio_widget->update();
+    interface->m_stats.mixer_load.store(interface->m_mix_seconds * interface->m_stream_rate / num_frames, std::memory_order_relaxed);
+    interface->m_meter.push(out, num_frames);
+
+    // this buffer still gets played, the stream finishes after it
+    bool source_done = !interface->m_loop && interface->m_frame_pos >= interface->m_stop_pos;
+    if (source_done && (!interface->m_resampling || interface->m_resampler.get_delay() <= interface->m_flushed_frames))
+        return paComplete;
 
-    interface->m_frame_pos += num;
+    return paContinue;
+}
+
+int record_callback(const void* input_buf, void* output_buf,
+                    unsigned long num_frames, const PaStreamCallbackTimeInfo* time_info,
+                    PaStreamCallbackFlags status, void* user_data) {
+    AudioInterface* interface = (AudioInterface*) user_data;
+    CallbackTimer timer(interface->m_stats, num_frames, interface->m_stream_rate, status);
+
+    interface->m_recorder.push((const float*) input_buf, num_frames);
+    interface->m_meter.push((const float*) input_buf, num_frames);
     return paContinue;
 }
 
 void stream_finished(void* user_data) {
     AudioInterface* interface = (AudioInterface*) user_data;
 
+    // the gui notices this on its next playhead timer tick
     interface->m_state = AudioInterface::State::IDLE;
-    the_app.main_window->m_audio_widget->update();
 }
 
-void AudioInterface::init() {
-    PaError err;
+void AudioInterface::init(const QString& backend_spec) {
+    m_backend = create_audio_backend(backend_spec);
+    if (!m_backend) {
+        qDebug() << "unknown audio backend" << backend_spec << "- using portaudio";
+        m_backend = create_audio_backend("portaudio");
+    }
 
-    err = Pa_Initialize();
-    Q_ASSERT(err == paNoError);
+    // no sound hardware shouldn't keep the editor from starting
+    if (!m_backend->init() || m_backend->get_default_output_device() < 0) {
+        qDebug() << "could not initialize" << m_backend->get_name() << m_backend->get_error() << "- falling back to the null backend";
+        m_backend = create_audio_backend("null");
+        m_backend->init();
+    }
 
-    m_input_dev = Pa_GetDefaultInputDevice();
-    Q_ASSERT(m_input_dev != paNoDevice);
-    m_output_dev = Pa_GetDefaultOutputDevice();
-    Q_ASSERT(m_output_dev != paNoDevice);
+    m_input_dev = m_backend->get_default_input_device();
+    m_output_dev = m_backend->get_default_output_device();
+}
+
+bool AudioInterface::start_stream(const AudioBackend::StreamParams& params, PaStreamCallback* callback) {
+    if (!m_backend->open_stream(params, callback, stream_finished, this) || !m_backend->start_stream()) {
+        show_error_box("could not start the audio stream: " + m_backend->get_error());
+        m_backend->close_stream();
+        return false;
+    }
+
+    return true;
+}
+
+AudioInterface::~AudioInterface() {
+    stop_render_ahead();
 }
 
 void AudioInterface::play(int64_t start_pos, int64_t stop_pos) {
     if (m_state != State::IDLE)
         return;
 
-    m_start_pos = std::min(start_pos, the_app.buffer.get_num_frames());
-    m_stop_pos = std::min(stop_pos, the_app.buffer.get_num_frames());
+    // the one from the last time may not have noticed yet that it stopped
+    stop_render_ahead();
+
+    // edits made while it plays don't reach the audio thread, it keeps reading this copy
+    m_edits = nullptr;
+    if (the_app.non_destructive)
+        m_edits = std::make_shared<const EditList>(the_app.edits);
+
+    // tracks that run on past the end of the buffer are played to their end
+    int64_t num_frames = get_edited_frames();
+    if (m_mixer.get_state()->sample_rate == the_app.buffer.get_sample_rate())
+        num_frames = std::max(num_frames, m_mixer.get_end());
+    if (stop_pos < 0)
+        stop_pos = num_frames;
+
+    m_start_pos = std::max((int64_t) 0, std::min(start_pos, num_frames));
+    m_stop_pos = std::max(m_start_pos, std::min(stop_pos, num_frames));
     m_frame_pos = m_start_pos;
+    m_num_channels = the_app.buffer.get_num_channels();
+    m_flushed_frames = 0;
+
+    m_varispeed.init(m_num_channels, the_app.buffer.get_sample_rate());
+    m_in_varispeed = false;
+    m_current_speed = m_scrubbing ? 0.0 : m_speed.load();
+
+    // reverse playback starts from the end of the range
+    if (!m_scrubbing && m_speed < 0 && m_stop_pos > m_start_pos)
+        m_frame_pos = m_stop_pos - 1;
+
+    // can't be longer than half the loop, the part of the pre-roll before the start of the buffer
+    // is silence, so a loop from the very start fades in from it
+    m_crossfade_frames = (int64_t) (m_config.loop_crossfade * the_app.buffer.get_sample_rate());
+    m_crossfade_frames = std::min(m_crossfade_frames, (m_stop_pos - m_start_pos) / 2);
+
+    // effects in the edit list render the start of what is about to play now, the audio thread
+    // only takes what's already rendered, the rest is rendered ahead of it once it runs
+    if (m_edits) {
+        int64_t prefetch_frames = (int64_t) (prefetch_seconds * m_edits->get_sample_rate());
+        m_edits->prefetch(m_start_pos - m_crossfade_frames, std::min(m_stop_pos, m_start_pos + prefetch_frames));
+    }
 
-    PaError err;
+    publish_playhead(m_start_pos, 0, 1.0);
+    m_stats.reset();
+    m_preview_chain.reset();
+    m_mixer.prepare(m_num_channels, the_app.buffer.get_sample_rate());
 
-    PaStreamParameters params;
+    AudioBackend::StreamParams params;
     params.device = m_output_dev;
+    params.input = false;
+    params.num_channels = m_num_channels;
+    params.frames_per_buffer = m_config.frames_per_buffer;
+
+    AudioBackend::DeviceInfo device_info = m_backend->get_device_info(m_output_dev);
+    params.latency = m_config.latency >= 0 ? m_config.latency : device_info.default_output_latency;
+
+    // run the device at its native rate and convert in the callback, either because
+    // the user asked for it or because the device can't do the file's rate at all
+    double file_rate = the_app.buffer.get_sample_rate();
+    double device_rate = device_info.default_sample_rate;
+    params.sample_rate = file_rate;
+    bool file_rate_supported = m_backend->is_format_supported(params);
+
+    m_stream_rate = file_rate;
+    if ((m_config.resample || !file_rate_supported) && device_rate > 0 && device_rate != file_rate)
+        m_stream_rate = device_rate;
+
+    m_resampling = m_stream_rate != file_rate;
+    if (m_resampling) {
+        m_resampler.init(m_num_channels, file_rate, m_stream_rate, m_config.resample_quality);
+        m_source_buf.resize(m_resampler.get_input_needed(Resampler::max_block) * m_num_channels);
+    }
 
-    params.channelCount = the_app.buffer.get_num_channels();
-    params.sampleFormat = paFloat32;
-    params.suggestedLatency = Pa_GetDeviceInfo(params.device)->defaultLowOutputLatency;
-    params.hostApiSpecificStreamInfo = NULL;
-
-    err = Pa_OpenStream(
-        &m_stream,
-        NULL,
-        &params,
-        the_app.buffer.get_sample_rate(),
-        64,
-        paClipOff,
-        playback_callback,
-        this
-    );
-    Q_ASSERT(err == paNoError);
-
-    err = Pa_SetStreamFinishedCallback(m_stream, stream_finished);
-    Q_ASSERT(err == paNoError);
-
-    err = Pa_StartStream(m_stream);
-    Q_ASSERT(err == paNoError);
+    params.sample_rate = m_stream_rate;
+    m_meter.start(m_num_channels, m_stream_rate);
 
+    // set first, a short enough stream can finish before start_stream returns
     m_state = State::PLAYING;
+    if (!start_stream(params, playback_callback))
+        m_state = State::IDLE;
+    else if (m_edits)
+        start_render_ahead();
 }
 
-void AudioInterface::record() {
+void AudioInterface::start_render_ahead() {
+    std::shared_ptr<const EditList> edits = m_edits;
+    int64_t preroll_start = m_start_pos - m_crossfade_frames;
+    int64_t start_pos = m_start_pos, stop_pos = m_stop_pos;
+    int64_t ahead_frames = (int64_t) (render_ahead_seconds * edits->get_sample_rate());
+
+    m_render_ahead_stop = false;
+    m_render_ahead = std::thread([this, edits, preroll_start, start_pos, stop_pos, ahead_frames]() {
+        // going over blocks that are already rendered costs next to nothing, the ones that were
+        // dropped from the cache since, like the start of a long loop, get rendered again
+        while (!m_render_ahead_stop && m_state == State::PLAYING) {
+            int64_t pos = m_playhead_pos.load(std::memory_order_relaxed);
+            edits->prefetch(pos, std::min(stop_pos, pos + ahead_frames));
+            if (m_loop && pos + ahead_frames > stop_pos)
+                edits->prefetch(preroll_start, std::min(stop_pos, start_pos + pos + ahead_frames - stop_pos));
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    });
 }
 
-void AudioInterface::stop() {
-    if (m_state == State::IDLE)
+void AudioInterface::stop_render_ahead() {
+    m_render_ahead_stop = true;
+    if (m_render_ahead.joinable())
+        m_render_ahead.join();
+}
+
+void AudioInterface::record(int64_t insert_pos) {
+    if (m_state != State::IDLE)
         return;
 
-    if (Pa_IsStreamStopped(m_stream))
+    if (m_input_dev < 0) {
+        show_error_box("there is no input device to record from");
         return;
+    }
 
-    PaError err;
-    err = Pa_StopStream(m_stream);
-    Q_ASSERT(err == paNoError);
-    //m_state = State::IDLE;
-}
+    AudioBackend::DeviceInfo device_info = m_backend->get_device_info(m_input_dev);
+    int num_channels = the_app.buffer.get_num_channels();
+    int input_channels = std::min(num_channels, device_info.max_input_channels);
+    if (input_channels < 1) {
+        show_error_box("the selected input device has no input channels");
+        return;
+    }
+
+    if (!m_recorder.start(input_channels, num_channels, the_app.buffer.get_sample_rate())) {
+        show_error_box("could not create a scratch file for recording");
+        return;
+    }
 
-int AudioInterface::get_num_apis() const {
-    return Pa_GetHostApiCount();
+    m_record_pos = std::min(insert_pos, the_app.buffer.get_num_frames());
+    m_stream_rate = the_app.buffer.get_sample_rate();
+    m_stats.reset();
+
+    AudioBackend::StreamParams params;
+    params.device = m_input_dev;
+    params.input = true;
+    params.num_channels = input_channels;
+    params.sample_rate = m_stream_rate;
+    params.frames_per_buffer = m_config.frames_per_buffer;
+    params.latency = m_config.latency >= 0 ? m_config.latency : device_info.default_input_latency;
+
+    m_meter.start(input_channels, m_stream_rate);
+    m_state = State::RECORDING;
+    if (!start_stream(params, record_callback)) {
+        m_state = State::IDLE;
+        m_recorder.stop();
+    }
 }
 
-void AudioInterface::set_api(int i) {
-    m_api = i;
+void AudioInterface::stop() {
+    if (m_state == State::IDLE)
+        return;
+
+    bool recording = m_state == State::RECORDING;
+
+    if (!m_backend->is_stream_stopped()) {
+        bool ok = m_backend->stop_stream();
+        Q_ASSERT(ok);
+    }
+
+    // no more callbacks at this point, let the writer drain the ring
+    if (recording)
+        m_recorder.stop();
+    m_meter.stop();
+
+    // not waited for, it can be in the middle of a block that takes a while, play() joins it
+    m_render_ahead_stop = true;
 }
 
-QString AudioInterface::get_api_name(int i) {
-    return Pa_GetHostApiInfo(i)->name;
+const char* AudioInterface::get_backend_name() const {
+    return m_backend->get_name();
 }
 
 int AudioInterface::get_num_devices() const {
-    return Pa_GetDeviceCount();
+    return m_backend->get_num_devices();
 }
 
 QString AudioInterface::get_device_name(int i) {
-    const auto* device_info = Pa_GetDeviceInfo(i);
-    const auto* api_info = Pa_GetHostApiInfo(device_info->hostApi);
-
-    return QString(api_info->name) + ": " + QString(device_info->name);
+    return m_backend->get_device_info(i).name;
 }
 
 void AudioInterface::set_input_device(int i) {
@@ -149,3 +298,309 @@ void AudioInterface::set_input_device(int i) {
 void AudioInterface::set_output_device(int i) {
     m_output_dev = i;
 }
+
+// copies up to num_frames from the buffer starting at the play position, wrapping around
+// at the stop position when looping, returns how many were copied
+int64_t AudioInterface::read_source(float* out, int64_t num_frames) {
+    int64_t written = 0;
+
+    while (written < num_frames) {
+        if (m_frame_pos >= m_stop_pos) {
+            if (!m_loop || m_stop_pos <= m_start_pos)
+                break;
+            m_frame_pos = m_start_pos;
+        }
+
+        int64_t num = std::min(num_frames - written, m_stop_pos - m_frame_pos);
+        float* dest = out + written * m_num_channels;
+        copy_frames(dest, m_frame_pos, num);
+        m_preview_chain.process(dest, m_num_channels, num, m_frame_pos);
+
+        // the tracks come in after the preview, it only applies to the audio being edited
+        auto mix_start = std::chrono::steady_clock::now();
+        m_mixer.process(dest, m_num_channels, num, m_frame_pos);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - mix_start;
+        m_mix_seconds += elapsed.count();
+
+        m_frame_pos += num;
+        written += num;
+    }
+
+    return written;
+}
+
+// copies frames [pos, pos + num) into out, crossfading into the audio leading up to the
+// loop start near the end of the loop, so that wrapping around continues seamlessly
+// before the start of the buffer, and past the end, where only tracks are left, it's silence
+// the crossfade only covers the buffer, the tracks cut at the loop point
+void AudioInterface::copy_frames(float* out, int64_t pos, int64_t num) {
+    const float* samples = std::as_const(the_app.buffer).get_raw_pointer();
+    int64_t total_frames = m_edits ? m_edits->get_num_frames() : the_app.buffer.get_num_frames();
+    if (m_edits) {
+        m_edits->read(pos, num, out, false);
+    } else {
+        int64_t available = std::max((int64_t) 0, std::min(num, total_frames - pos));
+        if (available > 0)
+            memcpy(out, samples + pos * m_num_channels, available * m_num_channels * sizeof(float));
+        std::fill(out + available * m_num_channels, out + num * m_num_channels, 0.0f);
+    }
+
+    int64_t fade_start = m_stop_pos - m_crossfade_frames;
+    if (!m_loop || m_crossfade_frames == 0 || pos + num <= fade_start)
+        return;
+
+    int64_t preroll_start = m_start_pos - m_crossfade_frames;
+    for (int64_t f = std::max(pos, fade_start); f < pos + num; f++) {
+        int64_t preroll_pos = preroll_start + f - fade_start;
+        if (preroll_pos >= total_frames)
+            break;
+
+        // equal power, sums to constant energy for uncorrelated material
+        double t = (f - fade_start + 0.5) / m_crossfade_frames;
+        float out_gain = (float) cos(t * M_PI * 0.5);
+        float in_gain = (float) sin(t * M_PI * 0.5);
+
+        // the edit list reads frames before its start as silence too
+        float edited[2] = {0.0f, 0.0f};
+        const float* preroll = edited;
+        if (m_edits)
+            m_edits->read(preroll_pos, 1, edited, false);
+        else if (preroll_pos >= 0)
+            preroll = samples + preroll_pos * m_num_channels;
+        float* dest = out + (f - pos) * m_num_channels;
+        for (int c = 0; c < m_num_channels; c++)
+            dest[c] = dest[c] * out_gain + preroll[c] * in_gain;
+    }
+}
+
+// only the resampler itself is timed, reading the source runs the effects and the mixer,
+// which are accounted for on their own
+void AudioInterface::render_resampled(float* out, int64_t num_frames) {
+    std::chrono::duration<double> elapsed(0);
+    int num_channels = m_num_channels;
+    int64_t max_input = m_source_buf.size() / num_channels;
+    int64_t produced = 0;
+
+    while (produced < num_frames) {
+        int64_t needed = m_resampler.get_input_needed(std::min(num_frames - produced, (int64_t) Resampler::max_block));
+        needed = std::min(std::max(needed, (int64_t) 1), max_input);
+
+        // past the end of the source the filter is flushed with silence
+        int64_t num = read_source(m_source_buf.data(), needed);
+        std::fill(m_source_buf.begin() + num * num_channels, m_source_buf.begin() + needed * num_channels, 0.0f);
+        m_flushed_frames += needed - num;
+
+        auto start_time = std::chrono::steady_clock::now();
+        m_resampler.push(m_source_buf.data(), needed);
+        produced += m_resampler.pull(out + produced * num_channels, std::min(num_frames - produced, (int64_t) Resampler::max_block));
+        elapsed += std::chrono::steady_clock::now() - start_time;
+    }
+
+    double deadline = num_frames / m_stream_rate;
+    m_stats.resampler_load.store(elapsed.count() / deadline, std::memory_order_relaxed);
+}
+
+void AudioInterface::set_speed(double speed) {
+    m_speed = speed;
+}
+
+void AudioInterface::set_keep_pitch(bool keep_pitch) {
+    m_keep_pitch = keep_pitch;
+}
+
+// starts following the mouse, opening a stream if nothing is playing yet
+// varispeed reads the buffer directly, the edit list only plays at normal speed
+void AudioInterface::scrub_begin(int64_t pos) {
+    if (m_state == State::RECORDING || the_app.non_destructive)
+        return;
+
+    m_scrub_target = pos;
+    m_scrubbing = true;
+
+    if (m_state == State::IDLE) {
+        m_scrub_owns_stream = true;
+        play(pos, the_app.buffer.get_num_frames());
+    }
+}
+
+void AudioInterface::scrub_to(int64_t pos) {
+    m_scrub_target = pos;
+}
+
+void AudioInterface::scrub_end() {
+    if (!m_scrubbing)
+        return;
+
+    m_scrubbing = false;
+    if (m_scrub_owns_stream) {
+        m_scrub_owns_stream = false;
+        stop();
+    }
+}
+
+bool AudioInterface::wants_varispeed() const {
+    return (m_scrubbing || m_speed != 1.0 || m_in_varispeed) && !m_edits;
+}
+
+// back to plain playback once the speed has settled on 1x again
+void AudioInterface::leave_varispeed() {
+    if (!m_in_varispeed)
+        return;
+
+    m_in_varispeed = false;
+    m_frame_pos = std::max(m_start_pos, std::min(m_stop_pos, (int64_t) m_varispeed.get_pos()));
+    if (m_resampling) {
+        m_resampler.reset();
+        m_flushed_frames = 0;
+    }
+}
+
+// renders a buffer at the current speed, or following the scrub target, returns true when done
+bool AudioInterface::render_varispeed(float* out, int64_t num_frames, double dac_time) {
+    double file_rate = the_app.buffer.get_sample_rate();
+
+    if (!m_in_varispeed) {
+        double pos = m_frame_pos - (m_resampling ? m_resampler.get_delay() : 0.0);
+        m_varispeed.reset(pos, m_current_speed * file_rate / m_stream_rate);
+        m_in_varispeed = true;
+        m_varispeed_resampled = false;
+    }
+
+    bool scrubbing = m_scrubbing;
+    double target_speed = m_speed;
+    if (scrubbing) {
+        // head towards the mouse, arriving in about scrub_response seconds
+        const double scrub_response = 0.05;
+        const double max_scrub_speed = 8.0;
+        double distance = m_scrub_target - m_varispeed.get_pos();
+        target_speed = std::max(-max_scrub_speed, std::min(max_scrub_speed, distance / (scrub_response * file_rate)));
+    }
+
+    // glide to the new speed in ~30ms so changes don't click
+    double previous_speed = m_current_speed;
+    double coeff = std::min(1.0, num_frames / (0.03 * m_stream_rate));
+    m_current_speed += (target_speed - m_current_speed) * coeff;
+    if (fabs(m_current_speed - target_speed) < 1e-4)
+        m_current_speed = target_speed;
+
+    double delay = m_varispeed_resampled ? m_resampler.get_delay() * m_current_speed : 0.0;
+    publish_playhead((int64_t) (m_varispeed.get_pos() - delay), dac_time, m_current_speed);
+
+    Varispeed::Range range;
+    if (scrubbing)
+        range = {0, the_app.buffer.get_num_frames(), Varispeed::Edge::CLAMP};
+    else if (m_loop && m_stop_pos > m_start_pos)
+        range = {m_start_pos, m_stop_pos, Varispeed::Edge::WRAP};
+    else
+        range = {m_start_pos, m_stop_pos, Varispeed::Edge::STOP};
+
+    bool finished;
+    if (m_keep_pitch && m_resampling) {
+        // wsola copies its grains to the output 1:1, so it runs at the file's rate and the
+        // resampler takes it to the device's like at 1x, the step is only the speed then
+        if (!m_varispeed_resampled) {
+            m_resampler.reset();
+            m_flushed_frames = 0;
+            m_varispeed_resampled = true;
+        }
+        finished = render_varispeed_resampled(out, num_frames, m_current_speed, range);
+    } else {
+        // played like tape the step takes care of the rate difference as well
+        m_varispeed_resampled = false;
+        Varispeed::Mode mode = m_keep_pitch ? Varispeed::Mode::KEEP_PITCH : Varispeed::Mode::RESAMPLE;
+        int64_t block_pos = (int64_t) m_varispeed.get_pos();
+        double step = m_current_speed * file_rate / m_stream_rate;
+
+        int produced = m_varispeed.render(std::as_const(the_app.buffer).get_raw_pointer(), the_app.buffer.get_num_frames(),
+                                          out, (int) num_frames, step, mode, range);
+        std::fill(out + produced * m_num_channels, out + num_frames * m_num_channels, 0.0f);
+        m_preview_chain.process(out, m_num_channels, produced, block_pos);
+        finished = produced < num_frames;
+    }
+
+    // a scrub that comes to rest would otherwise hold whatever sample it stopped on
+    if (scrubbing) {
+        float gain0 = (float) std::min(1.0, fabs(previous_speed) * 4.0);
+        float gain1 = (float) std::min(1.0, fabs(m_current_speed) * 4.0);
+        for (int64_t i = 0; i < num_frames; i++) {
+            float gain = gain0 + (gain1 - gain0) * (i + 1) / num_frames;
+            for (int c = 0; c < m_num_channels; c++)
+                out[i * m_num_channels + c] *= gain;
+        }
+    }
+
+    m_frame_pos = (int64_t) m_varispeed.get_pos();
+
+    if (!scrubbing && m_speed == 1.0 && m_current_speed == 1.0)
+        leave_varispeed();
+
+    return finished;
+}
+
+// keep pitch playback on a resampled stream, returns true once the range has run out and the
+// resampler has played what was left in it
+bool AudioInterface::render_varispeed_resampled(float* out, int64_t num_frames, double step, const Varispeed::Range& range) {
+    int num_channels = m_num_channels;
+    int64_t max_input = m_source_buf.size() / num_channels;
+    int64_t produced = 0;
+
+    while (produced < num_frames) {
+        int64_t needed = m_resampler.get_input_needed(std::min(num_frames - produced, (int64_t) Resampler::max_block));
+        needed = std::min(std::max(needed, (int64_t) 1), max_input);
+
+        int64_t block_pos = (int64_t) m_varispeed.get_pos();
+        int num = m_varispeed.render(std::as_const(the_app.buffer).get_raw_pointer(), the_app.buffer.get_num_frames(),
+                                     m_source_buf.data(), (int) needed, step, Varispeed::Mode::KEEP_PITCH, range);
+        std::fill(m_source_buf.begin() + num * num_channels, m_source_buf.begin() + needed * num_channels, 0.0f);
+        m_preview_chain.process(m_source_buf.data(), num_channels, num, block_pos);
+        m_flushed_frames += needed - num;
+
+        m_resampler.push(m_source_buf.data(), needed);
+        produced += m_resampler.pull(out + produced * num_channels, std::min(num_frames - produced, (int64_t) Resampler::max_block));
+    }
+
+    return m_flushed_frames > 0 && m_resampler.get_delay() <= m_flushed_frames;
+}
+
+// actual latency of the running stream, as reported by the backend
+double AudioInterface::get_stream_latency() const {
+    if (m_state == State::IDLE || !m_backend->is_stream_open())
+        return 0;
+
+    return m_backend->get_stream_latency();
+}
+
+void AudioInterface::publish_playhead(int64_t frame_pos, double dac_time, double speed) {
+    uint32_t seq = m_playhead_seq.load(std::memory_order_relaxed);
+    m_playhead_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_playhead_pos.store(frame_pos, std::memory_order_relaxed);
+    m_playhead_dac_time.store(dac_time, std::memory_order_relaxed);
+    m_playhead_speed.store(speed, std::memory_order_relaxed);
+    m_playhead_seq.store(seq + 2, std::memory_order_release);
+}
+
+double AudioInterface::get_playhead_frame() const {
+    int64_t frame_pos;
+    double dac_time, speed;
+    uint32_t seq;
+    do {
+        seq = m_playhead_seq.load(std::memory_order_acquire);
+        frame_pos = m_playhead_pos.load(std::memory_order_relaxed);
+        dac_time = m_playhead_dac_time.load(std::memory_order_relaxed);
+        speed = m_playhead_speed.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != m_playhead_seq.load(std::memory_order_relaxed));
+
+    // some host apis don't report dac times, fall back to the buffer position
+    if (m_state == State::IDLE || !m_backend->is_stream_open() || dac_time <= 0)
+        return frame_pos;
+
+    // outputBufferDacTime is when the first frame of that buffer hits the speakers,
+    // so extrapolate from there using the stream clock
+    double elapsed = m_backend->get_stream_time() - dac_time;
+    double pos = frame_pos + elapsed * speed * the_app.buffer.get_sample_rate();
+    if (m_scrubbing)
+        return std::max(0.0, std::min((double) the_app.buffer.get_num_frames(), pos));
+    return std::max((double) m_start_pos, std::min((double) m_stop_pos, pos));
+}
@@ -1,46 +1,141 @@
 #pragma once
 
+#include "recorder.h"
+#include "audio_stats.h"
+#include "resampler.h"
+#include "effect_chain.h"
+#include "mixer.h"
+#include "edit_list.h"
+#include "varispeed.h"
+#include "audio_backend.h"
+#include "meter.h"
+#include <vector>
 #include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <portaudio.h>
 #include <QString>
 
 class AudioInterface {
 public:
+    struct StreamConfig {
+        int frames_per_buffer = 64; // 0 lets the host api decide
+        double latency = -1; // in seconds, negative uses the device's default low latency
+        bool resample = true; // open playback streams at the device's native rate
+        Resampler::Quality resample_quality = Resampler::Quality::HIGH;
+        double loop_crossfade = 0; // in seconds, 0 for a hard cut at the loop point
+    };
+
     AudioInterface() {}
+    ~AudioInterface();
 
-    void init();
+    // backend_spec picks the audio backend (see create_audio_backend), falls back
+    // to the null backend if it can't be used
+    void init(const QString& backend_spec = "");
     void play(int64_t start_pos = 0, int64_t stop_pos = -1);
-    void record();
+    void record(int64_t insert_pos);
     void stop();
 
-    int get_num_apis() const;
-    void set_api(int i);
-    QString get_api_name(int i);
+    // varispeed, negative speeds play backwards
+    void set_speed(double speed);
+    void set_keep_pitch(bool keep_pitch);
+    void scrub_begin(int64_t pos);
+    void scrub_to(int64_t pos);
+    void scrub_end();
 
+    const char* get_backend_name() const;
     int get_num_devices() const;
     QString get_device_name(int i);
 
     void set_input_device(int i);
     void set_output_device(int i);
 
+    EffectChain& get_preview_chain() { return m_preview_chain; }
+    Mixer& get_mixer() { return m_mixer; }
+    const StreamConfig& get_config() const { return m_config; }
+    void set_config(const StreamConfig& config) { m_config = config; }
+    AudioStats& get_stats() { return m_stats; }
+    Meter& get_meter() { return m_meter; }
+    double get_stream_latency() const;
+    double get_stream_rate() const { return m_stream_rate; }
+    bool is_resampling() const { return m_resampling; }
+
+    // estimated frame that is currently audible, compensated for output latency
+    double get_playhead_frame() const;
+
     enum class State {
         IDLE,
         PLAYING,
         RECORDING,
     };
 
+    State get_state() const { return m_state; }
+
 private:
-    State m_state = State::IDLE;
-    int64_t m_frame_pos = 0;
+    bool start_stream(const AudioBackend::StreamParams& params, PaStreamCallback* callback);
+    void start_render_ahead();
+    void stop_render_ahead();
+    void publish_playhead(int64_t frame_pos, double dac_time, double speed);
+    int64_t read_source(float* out, int64_t num_frames);
+    void copy_frames(float* out, int64_t pos, int64_t num);
+    bool wants_varispeed() const;
+    void leave_varispeed();
+    bool render_varispeed(float* out, int64_t num_frames, double dac_time);
+    bool render_varispeed_resampled(float* out, int64_t num_frames, double step, const Varispeed::Range& range);
+    void render_resampled(float* out, int64_t num_frames);
+
+    std::atomic<State> m_state = State::IDLE;
+    int64_t m_frame_pos = 0; // only touched by the audio thread while playing
+
+    // written by the audio thread, read by the gui (seqlock)
+    std::atomic<uint32_t> m_playhead_seq = 0;
+    std::atomic<int64_t> m_playhead_pos = 0;
+    std::atomic<double> m_playhead_dac_time = 0;
+    std::atomic<double> m_playhead_speed = 1;
+
     int64_t m_start_pos = -1, m_stop_pos = -1;
-    bool m_loop = false;
-    PaStream* m_stream = nullptr;
-    int m_api = -1;
+    int m_num_channels = 2;
+    int64_t m_crossfade_frames = 0;
+    int64_t m_flushed_frames = 0; // silence pushed into the resampler after the end
+    std::atomic<bool> m_loop = false;
+    std::unique_ptr<AudioBackend> m_backend;
     int m_input_dev = -1, m_output_dev = -1;
+    StreamConfig m_config;
+    double m_stream_rate = 0;
+    bool m_resampling = false;
+    Resampler m_resampler;
+    std::vector<float> m_source_buf; // resampler input, sized before the stream starts
+    EffectChain m_preview_chain;
+    Mixer m_mixer;
+    std::shared_ptr<const EditList> m_edits; // what plays in non-destructive mode, a copy nothing edits
+    std::thread m_render_ahead; // keeps effects in m_edits rendered ahead of the playhead
+    std::atomic<bool> m_render_ahead_stop = false;
+
+    // set from the gui
+    std::atomic<double> m_speed = 1;
+    std::atomic<bool> m_keep_pitch = false;
+    std::atomic<bool> m_scrubbing = false;
+    std::atomic<int64_t> m_scrub_target = 0;
+    bool m_scrub_owns_stream = false;
+
+    // audio thread
+    Varispeed m_varispeed;
+    bool m_in_varispeed = false;
+    bool m_varispeed_resampled = false; // wsola output is going through m_resampler
+    double m_current_speed = 1;
+    AudioStats m_stats;
+    Meter m_meter;
+    Recorder m_recorder;
+    int64_t m_record_pos = 0; // where the take gets spliced into the buffer
+    double m_mix_seconds = 0; // spent in the mixer during the current callback
 
     friend int playback_callback(const void *input_buf, void *output_buf,
         unsigned long num_frames, const PaStreamCallbackTimeInfo* time_info,
         PaStreamCallbackFlags status, void *user_data);
+    friend int record_callback(const void *input_buf, void *output_buf,
+        unsigned long num_frames, const PaStreamCallbackTimeInfo* time_info,
+        PaStreamCallbackFlags status, void *user_data);
     friend void stream_finished(void* user_data);
     friend class MainWindow;
     friend class AudioWidget;
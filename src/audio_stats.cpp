@@ -0,0 +1,44 @@
+#include "audio_stats.h"
+
+#include <algorithm>
+
+void AudioStats::reset() {
+    num_callbacks = 0;
+    output_underflows = 0;
+    output_overflows = 0;
+    input_underflows = 0;
+    input_overflows = 0;
+    deadline_misses = 0;
+    for (int i = 0; i < num_load_bins; i++)
+        load_histogram[i] = 0;
+    last_load = 0;
+    max_load = 0;
+    resampler_load = 0;
+    mixer_load = 0;
+}
+
+void AudioStats::record_status(PaStreamCallbackFlags status) {
+    if (status & paOutputUnderflow)
+        output_underflows.fetch_add(1, std::memory_order_relaxed);
+    if (status & paOutputOverflow)
+        output_overflows.fetch_add(1, std::memory_order_relaxed);
+    if (status & paInputUnderflow)
+        input_underflows.fetch_add(1, std::memory_order_relaxed);
+    if (status & paInputOverflow)
+        input_overflows.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AudioStats::record_load(double seconds, double deadline) {
+    double load = deadline > 0 ? seconds / deadline : 0;
+
+    int bin = std::min(num_load_bins - 1, (int) (load / load_bin_width));
+    load_histogram[bin].fetch_add(1, std::memory_order_relaxed);
+    num_callbacks.fetch_add(1, std::memory_order_relaxed);
+    if (load >= 1.0)
+        deadline_misses.fetch_add(1, std::memory_order_relaxed);
+
+    // only the audio thread writes these, no need for a cas loop
+    last_load.store(load, std::memory_order_relaxed);
+    if (load > max_load.load(std::memory_order_relaxed))
+        max_load.store(load, std::memory_order_relaxed);
+}
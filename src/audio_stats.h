@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <portaudio.h>
+
+// counters filled in by the audio callbacks, read by the diagnostics panel
+struct AudioStats {
+    // callback time relative to the buffer duration, 10% per bin, last bin catches everything above
+    static const int num_load_bins = 16;
+    static constexpr double load_bin_width = 0.1;
+
+    std::atomic<uint64_t> num_callbacks = 0;
+    std::atomic<uint64_t> output_underflows = 0;
+    std::atomic<uint64_t> output_overflows = 0;
+    std::atomic<uint64_t> input_underflows = 0;
+    std::atomic<uint64_t> input_overflows = 0;
+    std::atomic<uint64_t> deadline_misses = 0;
+    std::atomic<uint64_t> load_histogram[num_load_bins] = {};
+    std::atomic<double> last_load = 0;
+    std::atomic<double> max_load = 0;
+    std::atomic<double> resampler_load = 0; // fraction of the callback's deadline, all channels together
+    std::atomic<double> mixer_load = 0; // fraction of a core
+
+    void reset();
+    void record_status(PaStreamCallbackFlags status);
+    void record_load(double seconds, double deadline);
+};
+
+// measures a callback from construction to destruction
+class CallbackTimer {
+public:
+    CallbackTimer(AudioStats& stats, unsigned long num_frames, double sample_rate, PaStreamCallbackFlags status)
+        : m_stats(stats), m_deadline(num_frames / sample_rate), m_start(std::chrono::steady_clock::now()) {
+        m_stats.record_status(status);
+    }
+
+    ~CallbackTimer() {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start;
+        m_stats.record_load(elapsed.count(), m_deadline);
+    }
+
+private:
+    AudioStats& m_stats;
+    double m_deadline;
+    std::chrono::steady_clock::time_point m_start;
+};
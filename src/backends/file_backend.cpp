@@ -0,0 +1,71 @@
+#include "file_backend.h"
+
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+
+static void write_u16(FILE* file, uint16_t value) {
+    uint8_t bytes[2] = {(uint8_t) value, (uint8_t) (value >> 8)};
+    fwrite(bytes, 1, 2, file);
+}
+
+static void write_u32(FILE* file, uint32_t value) {
+    uint8_t bytes[4] = {(uint8_t) value, (uint8_t) (value >> 8), (uint8_t) (value >> 16), (uint8_t) (value >> 24)};
+    fwrite(bytes, 1, 4, file);
+}
+
+bool FileBackend::begin_output(const StreamParams& params) {
+    m_file = fopen(m_path.toLocal8Bit().constData(), "wb");
+    if (!m_file) {
+        m_error = "could not open " + m_path + ": " + strerror(errno);
+        return false;
+    }
+
+    m_num_channels = params.num_channels;
+    m_sample_rate = (int) params.sample_rate;
+    m_num_frames = 0;
+
+    // sizes get patched in once the stream ends
+    write_header();
+    return true;
+}
+
+void FileBackend::write_output(const float* samples, int num_frames) {
+    fwrite(samples, sizeof(float), (size_t) num_frames * m_num_channels, m_file);
+    m_num_frames += num_frames;
+}
+
+void FileBackend::end_output() {
+    rewind(m_file);
+    write_header();
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+// riff header for WAVE_FORMAT_IEEE_FLOAT, assumes a little endian host for the sample data
+void FileBackend::write_header() {
+    uint32_t block_align = m_num_channels * sizeof(float);
+    uint32_t data_size = (uint32_t) std::min(m_num_frames * block_align, (int64_t) UINT32_MAX - 58);
+
+    fwrite("RIFF", 1, 4, m_file);
+    write_u32(m_file, 50 + data_size);
+    fwrite("WAVE", 1, 4, m_file);
+
+    fwrite("fmt ", 1, 4, m_file);
+    write_u32(m_file, 18);
+    write_u16(m_file, 3); // ieee float
+    write_u16(m_file, m_num_channels);
+    write_u32(m_file, m_sample_rate);
+    write_u32(m_file, m_sample_rate * block_align);
+    write_u16(m_file, block_align);
+    write_u16(m_file, 32);
+    write_u16(m_file, 0);
+
+    // required for non-pcm formats
+    fwrite("fact", 1, 4, m_file);
+    write_u32(m_file, 4);
+    write_u32(m_file, data_size / block_align);
+
+    fwrite("data", 1, 4, m_file);
+    write_u32(m_file, data_size);
+}
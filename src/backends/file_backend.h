@@ -0,0 +1,33 @@
+#pragma once
+
+#include "null_backend.h"
+#include <stdio.h>
+
+// runs like the fast null backend and writes each output stream to a 32 bit float wav,
+// replacing whatever the previous stream wrote
+class FileBackend : public NullBackend {
+public:
+    FileBackend(const QString& path) : NullBackend(false), m_path(path) {}
+
+    // the clock thread calls the hooks below, so it has to be done before they go away,
+    // ~NullBackend would be too late for that and for the sizes in the header
+    ~FileBackend() override { close_stream(); }
+
+    const char* get_name() const override { return "file"; }
+
+protected:
+    bool begin_output(const StreamParams& params) override;
+    void write_output(const float* samples, int num_frames) override;
+    void end_output() override;
+
+    QString get_device_name() const override { return "File: " + m_path; }
+
+private:
+    void write_header();
+
+    QString m_path;
+    FILE* m_file = nullptr;
+    int m_num_channels = 0;
+    int m_sample_rate = 0;
+    int64_t m_num_frames = 0;
+};
@@ -0,0 +1,157 @@
+#include "null_backend.h"
+
+#include <math.h>
+
+NullBackend::~NullBackend() {
+    close_stream();
+}
+
+AudioBackend::DeviceInfo NullBackend::get_device_info(int i) const {
+    DeviceInfo info;
+    info.name = get_device_name();
+    info.max_input_channels = 2;
+    info.max_output_channels = 2;
+    return info;
+}
+
+bool NullBackend::is_format_supported(const StreamParams& params) const {
+    return params.device == 0 && params.num_channels >= 1 && params.num_channels <= 2 && params.sample_rate > 0;
+}
+
+bool NullBackend::open_stream(const StreamParams& params, PaStreamCallback* callback,
+                              PaStreamFinishedCallback* finished, void* user_data) {
+    close_stream();
+
+    if (!is_format_supported(params)) {
+        m_error = "unsupported stream format";
+        return false;
+    }
+
+    m_params = params;
+    if (m_params.frames_per_buffer <= 0)
+        m_params.frames_per_buffer = default_frames_per_buffer;
+
+    m_callback = callback;
+    m_finished = finished;
+    m_user_data = user_data;
+    m_frames_done = 0;
+    m_open = true;
+    return true;
+}
+
+bool NullBackend::start_stream() {
+    if (!m_open || m_running)
+        return false;
+
+    // a stream that finished on its own still has its thread around
+    if (m_thread.joinable())
+        m_thread.join();
+
+    if (!m_params.input && !begin_output(m_params))
+        return false;
+
+    m_frames_done = 0;
+    m_sine_phase = 0;
+    m_start_time = std::chrono::steady_clock::now();
+    m_stop_requested = false;
+    m_running = true;
+    m_thread = std::thread(&NullBackend::clock_thread, this);
+    return true;
+}
+
+bool NullBackend::stop_stream() {
+    m_stop_requested = true;
+    if (m_thread.joinable())
+        m_thread.join();
+    return true;
+}
+
+void NullBackend::close_stream() {
+    if (!m_open)
+        return;
+
+    stop_stream();
+    m_open = false;
+}
+
+double NullBackend::get_stream_time() const {
+    if (!m_realtime)
+        return m_frames_done / m_params.sample_rate;
+
+    if (!m_running)
+        return 0;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start_time;
+    return elapsed.count();
+}
+
+double NullBackend::get_stream_latency() const {
+    return m_open ? m_params.frames_per_buffer / m_params.sample_rate : 0;
+}
+
+void NullBackend::clock_thread() {
+    using clock = std::chrono::steady_clock;
+
+    int num_frames = m_params.frames_per_buffer;
+    std::vector<float> samples((size_t) num_frames * m_params.num_channels, 0.0f);
+    std::chrono::duration<double> buffer_duration(num_frames / m_params.sample_rate);
+    clock::time_point deadline = m_start_time;
+
+    while (!m_stop_requested) {
+        PaStreamCallbackFlags status = 0;
+
+        if (m_realtime) {
+            deadline += std::chrono::duration_cast<clock::duration>(buffer_duration);
+            clock::time_point now = clock::now();
+
+            // fell more than a buffer behind, a real device would have glitched here
+            if (now > deadline + buffer_duration) {
+                status = m_params.input ? paInputOverflow : paOutputUnderflow;
+                deadline = now;
+            } else {
+                std::this_thread::sleep_until(deadline);
+            }
+        }
+
+        double buffer_time = m_frames_done / m_params.sample_rate;
+        PaStreamCallbackTimeInfo time_info;
+        time_info.currentTime = get_stream_time();
+        time_info.inputBufferAdcTime = buffer_time;
+        time_info.outputBufferDacTime = buffer_time;
+
+        int result;
+        if (m_params.input) {
+            fill_input(samples.data(), num_frames);
+            result = m_callback(samples.data(), nullptr, num_frames, &time_info, status, m_user_data);
+        } else {
+            result = m_callback(nullptr, samples.data(), num_frames, &time_info, status, m_user_data);
+            write_output(samples.data(), num_frames);
+        }
+
+        m_frames_done += num_frames;
+
+        if (result != paContinue)
+            break;
+    }
+
+    if (!m_params.input)
+        end_output();
+
+    m_running = false;
+    if (m_finished)
+        m_finished(m_user_data);
+}
+
+// 440hz at -20dbfs
+void NullBackend::fill_input(float* samples, int num_frames) {
+    double step = 2 * M_PI * 440.0 / m_params.sample_rate;
+    for (int i = 0; i < num_frames; i++) {
+        float sample = (float) (0.1 * sin(m_sine_phase));
+        for (int c = 0; c < m_params.num_channels; c++)
+            samples[i * m_params.num_channels + c] = sample;
+
+        m_sine_phase += step;
+        if (m_sine_phase > 2 * M_PI)
+            m_sine_phase -= 2 * M_PI;
+    }
+}
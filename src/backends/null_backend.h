@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../audio_backend.h"
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+// no hardware, a thread calls the stream callback on its own clock
+// in realtime mode it paces the buffers like a sound card would, otherwise it runs them back
+// to back and the stream clock counts frames, which is what benchmarks and tests want
+// input streams are fed a quiet sine so recorded takes are easy to check
+class NullBackend : public AudioBackend {
+public:
+    static const int default_frames_per_buffer = 256;
+
+    NullBackend(bool realtime) : m_realtime(realtime) {}
+    ~NullBackend() override;
+
+    const char* get_name() const override { return m_realtime ? "null" : "null:fast"; }
+    bool init() override { return true; }
+
+    int get_num_devices() const override { return 1; }
+    DeviceInfo get_device_info(int i) const override;
+    int get_default_input_device() const override { return 0; }
+    int get_default_output_device() const override { return 0; }
+    bool is_format_supported(const StreamParams& params) const override;
+
+    bool open_stream(const StreamParams& params, PaStreamCallback* callback,
+                     PaStreamFinishedCallback* finished, void* user_data) override;
+    bool start_stream() override;
+    bool stop_stream() override;
+    void close_stream() override;
+    bool is_stream_open() const override { return m_open; }
+    bool is_stream_stopped() const override { return !m_running; }
+
+    double get_stream_time() const override;
+    double get_stream_latency() const override;
+
+protected:
+    // hooks for backends that do something with the output, called from the clock thread
+    // except for begin_output, which runs in start_stream and can refuse to start
+    virtual bool begin_output(const StreamParams& params) { return true; }
+    virtual void write_output(const float* samples, int num_frames) {}
+    virtual void end_output() {}
+
+    virtual QString get_device_name() const { return "Null Device"; }
+
+private:
+    void clock_thread();
+    void fill_input(float* samples, int num_frames);
+
+    bool m_realtime;
+    bool m_open = false;
+    StreamParams m_params;
+    PaStreamCallback* m_callback = nullptr;
+    PaStreamFinishedCallback* m_finished = nullptr;
+    void* m_user_data = nullptr;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running = false;
+    std::atomic<bool> m_stop_requested = false;
+    std::atomic<int64_t> m_frames_done = 0;
+    std::chrono::steady_clock::time_point m_start_time;
+    double m_sine_phase = 0;
+};
@@ -0,0 +1,138 @@
+#include "portaudio_backend.h"
+
+#include <algorithm>
+
+PortAudioBackend::~PortAudioBackend() {
+    close_stream();
+    if (m_initialized)
+        Pa_Terminate();
+}
+
+bool PortAudioBackend::check(PaError err) {
+    if (err == paNoError)
+        return true;
+
+    m_error = Pa_GetErrorText(err);
+    return false;
+}
+
+PaStreamParameters PortAudioBackend::to_pa_params(const StreamParams& params) {
+    PaStreamParameters pa_params;
+    pa_params.device = params.device;
+    pa_params.channelCount = params.num_channels;
+    pa_params.sampleFormat = paFloat32;
+    pa_params.suggestedLatency = params.latency;
+    pa_params.hostApiSpecificStreamInfo = NULL;
+    return pa_params;
+}
+
+bool PortAudioBackend::init() {
+    if (!check(Pa_Initialize()))
+        return false;
+
+    m_initialized = true;
+    return true;
+}
+
+int PortAudioBackend::get_num_devices() const {
+    return std::max(0, (int) Pa_GetDeviceCount());
+}
+
+AudioBackend::DeviceInfo PortAudioBackend::get_device_info(int i) const {
+    const PaDeviceInfo* device_info = Pa_GetDeviceInfo(i);
+    if (!device_info)
+        return {};
+
+    const PaHostApiInfo* api_info = Pa_GetHostApiInfo(device_info->hostApi);
+
+    DeviceInfo info;
+    info.name = QString(api_info->name) + ": " + QString(device_info->name);
+    info.max_input_channels = device_info->maxInputChannels;
+    info.max_output_channels = device_info->maxOutputChannels;
+    info.default_sample_rate = device_info->defaultSampleRate;
+    info.default_input_latency = device_info->defaultLowInputLatency;
+    info.default_output_latency = device_info->defaultLowOutputLatency;
+    return info;
+}
+
+int PortAudioBackend::get_default_input_device() const {
+    PaDeviceIndex device = Pa_GetDefaultInputDevice();
+    return device == paNoDevice ? -1 : device;
+}
+
+int PortAudioBackend::get_default_output_device() const {
+    PaDeviceIndex device = Pa_GetDefaultOutputDevice();
+    return device == paNoDevice ? -1 : device;
+}
+
+bool PortAudioBackend::is_format_supported(const StreamParams& params) const {
+    PaStreamParameters pa_params = to_pa_params(params);
+    PaError err = params.input ? Pa_IsFormatSupported(&pa_params, NULL, params.sample_rate)
+                               : Pa_IsFormatSupported(NULL, &pa_params, params.sample_rate);
+    return err == paFormatIsSupported;
+}
+
+bool PortAudioBackend::open_stream(const StreamParams& params, PaStreamCallback* callback,
+                                   PaStreamFinishedCallback* finished, void* user_data) {
+    close_stream();
+
+    PaStreamParameters pa_params = to_pa_params(params);
+    PaStream* stream = nullptr;
+    bool ok = check(Pa_OpenStream(
+        &stream,
+        params.input ? &pa_params : NULL,
+        params.input ? NULL : &pa_params,
+        params.sample_rate,
+        params.frames_per_buffer,
+        paClipOff,
+        callback,
+        user_data
+    ));
+    if (!ok)
+        return false;
+
+    if (!check(Pa_SetStreamFinishedCallback(stream, finished))) {
+        Pa_CloseStream(stream);
+        return false;
+    }
+
+    m_stream = stream;
+    m_input = params.input;
+    return true;
+}
+
+bool PortAudioBackend::start_stream() {
+    return m_stream && check(Pa_StartStream(m_stream));
+}
+
+bool PortAudioBackend::stop_stream() {
+    if (!m_stream || Pa_IsStreamStopped(m_stream) == 1)
+        return true;
+
+    return check(Pa_StopStream(m_stream));
+}
+
+void PortAudioBackend::close_stream() {
+    if (!m_stream)
+        return;
+
+    // closing aborts the stream if it's still running
+    Pa_CloseStream(m_stream);
+    m_stream = nullptr;
+}
+
+bool PortAudioBackend::is_stream_stopped() const {
+    return !m_stream || Pa_IsStreamStopped(m_stream) == 1;
+}
+
+double PortAudioBackend::get_stream_time() const {
+    return m_stream ? Pa_GetStreamTime(m_stream) : 0;
+}
+
+double PortAudioBackend::get_stream_latency() const {
+    const PaStreamInfo* info = m_stream ? Pa_GetStreamInfo(m_stream) : nullptr;
+    if (!info)
+        return 0;
+
+    return m_input ? info->inputLatency : info->outputLatency;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../audio_backend.h"
+
+class PortAudioBackend : public AudioBackend {
+public:
+    PortAudioBackend() {}
+    ~PortAudioBackend() override;
+
+    const char* get_name() const override { return "portaudio"; }
+    bool init() override;
+
+    int get_num_devices() const override;
+    DeviceInfo get_device_info(int i) const override;
+    int get_default_input_device() const override;
+    int get_default_output_device() const override;
+    bool is_format_supported(const StreamParams& params) const override;
+
+    bool open_stream(const StreamParams& params, PaStreamCallback* callback,
+                     PaStreamFinishedCallback* finished, void* user_data) override;
+    bool start_stream() override;
+    bool stop_stream() override;
+    void close_stream() override;
+    bool is_stream_open() const override { return m_stream != nullptr; }
+    bool is_stream_stopped() const override;
+
+    double get_stream_time() const override;
+    double get_stream_latency() const override;
+
+private:
+    bool check(PaError err);
+    static PaStreamParameters to_pa_params(const StreamParams& params);
+
+    bool m_initialized = false;
+    PaStream* m_stream = nullptr;
+    bool m_input = false;
+};
@@ -0,0 +1,359 @@
+#include "beat_tracker.h"
+
+#include "audio_buffer.h"
+#include "fft.h"
+#include "stft.h"
+#include "parallel.h"
+#include "simd.h"
+#include <algorithm>
+#include <math.h>
+
+static const double min_tempo = 40;
+static const double max_tempo = 240;
+static const double preferred_tempo = 120; // the autocorrelation is weighted towards it
+static const double tempo_spread = 1.0;    // octaves
+static const double tightness = 100;       // how hard the beats are held to the tempo
+static const double min_duration = 4;      // seconds
+static const int64_t hops_per_task = 512;
+
+int64_t BeatGrid::find_nearest(int64_t frame, int64_t max_distance) const {
+    auto it = std::lower_bound(beats.begin(), beats.end(), frame);
+
+    int64_t best = -1;
+    int64_t best_distance = max_distance;
+    if (it != beats.end() && *it - frame <= best_distance) {
+        best = *it;
+        best_distance = *it - frame;
+    }
+    if (it != beats.begin() && frame - *(it - 1) <= best_distance)
+        best = *(it - 1);
+
+    return best;
+}
+
+void BeatGrid::update(int64_t start, int64_t old_end, int64_t new_end) {
+    auto first = std::lower_bound(beats.begin(), beats.end(), start);
+    auto last = std::lower_bound(first, beats.end(), old_end);
+    first = beats.erase(first, last);
+
+    for (; first != beats.end(); first++)
+        *first += new_end - old_end;
+}
+
+// log power spectral flux of frames centered on every hop, only rises count
+static void compute_onset_strength(const float* mono, int64_t num_frames, int fft_size, int hop, std::vector<float>& onset, const std::atomic<bool>* cancel) {
+    int num_bins = fft_size / 2 + 1;
+    int64_t num_hops = (int64_t) onset.size();
+    std::vector<float> window = make_hann_window(fft_size);
+
+    // anything 80 db under a full scale sine is the same silence
+    float floor = (float) (fft_size / 4.0 * fft_size / 4.0 * 1e-8);
+
+    parallel_for((num_hops + hops_per_task - 1) / hops_per_task, [&](int64_t task) {
+        if (cancel && *cancel)
+            return;
+
+        RealFFT fft;
+        fft.init(fft_size);
+        std::vector<float> frame(fft_size);
+        std::vector<std::complex<float>> bins(num_bins);
+        std::vector<float> level(num_bins), previous(num_bins);
+
+        // every task also analyses the hop before its first, for the difference
+        int64_t first = task * hops_per_task;
+        int64_t last = std::min(num_hops, first + hops_per_task);
+        for (int64_t h = first - 1; h < last; h++) {
+            int64_t frame_start = h * hop - fft_size / 2;
+            for (int i = 0; i < fft_size; i++) {
+                int64_t pos = frame_start + i;
+                frame[i] = pos >= 0 && pos < num_frames ? mono[pos] * window[i] : 0.0f;
+            }
+            fft.forward(frame.data(), bins.data());
+
+            for (int k = 0; k < num_bins; k++)
+                level[k] = std::norm(bins[k]) + floor;
+            fast_log2(level.data(), num_bins);
+
+            if (h >= first) {
+                float flux = 0;
+                for (int k = 0; k < num_bins; k++)
+                    flux += std::max(0.0f, level[k] - previous[k]);
+                onset[h] = flux / num_bins;
+            }
+            std::swap(level, previous);
+        }
+    });
+}
+
+// beats per minute from the autocorrelation of the onset strength, as a period in hops, 0 if
+// there is none or cancel was set
+static double estimate_period(const std::vector<float>& onset, double hops_per_second, const std::atomic<bool>* cancel) {
+    int64_t num_hops = (int64_t) onset.size();
+    int min_lag = std::max(1, (int) floor(hops_per_second * 60 / max_tempo));
+    int max_lag = std::min((int) (num_hops / 2), (int) ceil(hops_per_second * 60 / min_tempo));
+    if (max_lag <= min_lag + 1)
+        return 0;
+
+    double mean = 0;
+    for (float x : onset)
+        mean += x;
+    mean /= num_hops;
+
+    // smoothed over about 20ms, so a period that falls between two lags still shows as one peak
+    int radius = std::max(1, (int) (hops_per_second * 0.01));
+    std::vector<float> centered(num_hops);
+    for (int64_t h = 0; h < num_hops; h++) {
+        if (cancel && (h & 4095) == 0 && *cancel)
+            return 0;
+
+        double sum = 0, weights = 0;
+        for (int i = -radius; i <= radius; i++) {
+            if (h + i < 0 || h + i >= num_hops)
+                continue;
+            double weight = radius + 1 - abs(i);
+            sum += weight * onset[h + i];
+            weights += weight;
+        }
+        centered[h] = (float) (sum / weights - mean);
+    }
+
+    int max_correlated = std::min((int) (num_hops - 4), max_lag * 2 + 2);
+    std::vector<double> correlation(max_correlated + 1, 0.0);
+    // every lag is a pass over the whole onset, hours of audio take a while
+    for (int lag = min_lag; lag <= max_correlated; lag++) {
+        if (cancel && *cancel)
+            return 0;
+
+        int n = (int) (num_hops - lag) & ~3;
+        correlation[lag] = dot(centered.data(), centered.data() + lag, n) / n;
+    }
+
+    // a real period repeats at twice the lag too, which tells it apart from the lags where
+    // only the offbeats line up
+    std::vector<double> weighted(max_lag + 2, 0.0);
+    for (int lag = min_lag; lag <= max_lag + 1; lag++) {
+        double octaves = log2(hops_per_second * 60 / lag / preferred_tempo) / tempo_spread;
+        double repeated = lag * 2 <= max_correlated ? correlation[lag * 2] : 0;
+        weighted[lag] = (correlation[lag] + 0.5 * repeated) * exp(-0.5 * octaves * octaves);
+    }
+
+    int best = min_lag + 1;
+    for (int lag = min_lag + 1; lag <= max_lag; lag++) {
+        if (weighted[lag] > weighted[best])
+            best = lag;
+    }
+
+    if (weighted[best] <= 0)
+        return 0;
+
+    // the peak between the lags from the parabola through it and its neighbours
+    double a = weighted[best - 1], b = weighted[best], c = weighted[best + 1];
+    double curvature = a - 2 * b + c;
+    double offset = curvature < 0 ? 0.5 * (a - c) / curvature : 0;
+    return best + std::max(-0.5, std::min(0.5, offset));
+}
+
+bool track_beats(const float* mono, int64_t num_frames, int sample_rate, BeatGrid& grid, const std::atomic<bool>* cancel) {
+    if (num_frames < min_duration * sample_rate)
+        return false;
+
+    // about 20ms frames at a quarter hop
+    int fft_size = 256;
+    while (fft_size < sample_rate * 0.02)
+        fft_size *= 2;
+    int hop = fft_size / 4;
+    double hops_per_second = sample_rate / (double) hop;
+
+    int64_t num_hops = num_frames / hop + 1;
+    std::vector<float> onset(num_hops, 0.0f);
+    compute_onset_strength(mono, num_frames, fft_size, hop, onset, cancel);
+    if (cancel && *cancel)
+        return false;
+
+    double period = estimate_period(onset, hops_per_second, cancel);
+    if (period <= 0)
+        return false;
+
+    double sum_squares = 0;
+    for (float x : onset)
+        sum_squares += (double) x * x;
+    double rms = sqrt(sum_squares / num_hops);
+    if (rms <= 0)
+        return false;
+
+    // the best chain of beats ending on each hop, a beat scores its onset strength plus the best
+    // chain half to two periods before it, less a penalty for straying from the period
+    int64_t min_gap = std::max((int64_t) 1, (int64_t) round(period / 2));
+    int64_t max_gap = (int64_t) round(period * 2);
+    std::vector<double> penalty(max_gap + 1);
+    for (int64_t gap = min_gap; gap <= max_gap; gap++)
+        penalty[gap] = tightness * pow(log(gap / period), 2);
+
+    std::vector<double> score(num_hops);
+    std::vector<int64_t> link(num_hops);
+    for (int64_t h = 0; h < num_hops; h++) {
+        if (cancel && (h & 4095) == 0 && *cancel)
+            return false;
+
+        double best = 0;
+        int64_t best_link = -1;
+        for (int64_t gap = min_gap; gap <= max_gap && gap <= h; gap++) {
+            double chained = score[h - gap] - penalty[gap];
+            if (best_link < 0 || chained > best) {
+                best = chained;
+                best_link = h - gap;
+            }
+        }
+
+        // starting over beats a chain that only costs
+        if (best < 0)
+            best_link = -1;
+        score[h] = onset[h] / rms + std::max(0.0, best);
+        link[h] = best_link;
+    }
+
+    int64_t end = num_hops - 1;
+    for (int64_t h = std::max((int64_t) 0, num_hops - (int64_t) ceil(period)); h < num_hops; h++) {
+        if (score[h] > score[end])
+            end = h;
+    }
+
+    std::vector<int64_t> beat_hops;
+    for (int64_t h = end; h >= 0; h = link[h])
+        beat_hops.push_back(h);
+    std::reverse(beat_hops.begin(), beat_hops.end());
+
+    // the chain runs on through quiet intros and endings, drop the beats where the onset strength
+    // averaged over a period is well under its usual level
+    std::vector<double> prefix(num_hops + 1, 0.0);
+    for (int64_t h = 0; h < num_hops; h++)
+        prefix[h + 1] = prefix[h] + onset[h];
+
+    int64_t half = std::max((int64_t) 1, (int64_t) period / 2);
+    std::vector<double> local(num_hops);
+    double local_squares = 0;
+    for (int64_t h = 0; h < num_hops; h++) {
+        int64_t a = std::max((int64_t) 0, h - half);
+        int64_t b = std::min(num_hops, h + half + 1);
+        local[h] = (prefix[b] - prefix[a]) / (b - a);
+        local_squares += local[h] * local[h];
+    }
+    double local_rms = sqrt(local_squares / num_hops);
+    auto is_quiet = [&](int64_t h) {
+        return local[h] < local_rms * 0.5;
+    };
+
+    size_t first = 0, last = beat_hops.size();
+    while (first < last && is_quiet(beat_hops[first]))
+        first++;
+    while (last > first && is_quiet(beat_hops[last - 1]))
+        last--;
+
+    grid.sample_rate = sample_rate;
+    grid.tempo = hops_per_second * 60 / period;
+    grid.beats.clear();
+    for (size_t i = first; i < last; i++)
+        grid.beats.push_back(std::min(num_frames - 1, beat_hops[i] * hop));
+
+    return !grid.beats.empty();
+}
+
+BeatTracker::~BeatTracker() {
+    cancel();
+    for (auto& run : m_runs)
+        run->thread.join();
+}
+
+void BeatTracker::start(const AudioBuffer& buffer, std::function<void()> on_done) {
+    cancel();
+    join_finished();
+
+    if (buffer.get_num_frames() == 0) {
+        clear();
+        return;
+    }
+
+    auto audio = std::make_shared<const AudioBuffer>(buffer);
+    m_runs.push_back(std::make_unique<Run>());
+    Run* run = m_runs.back().get();
+    run->thread = std::thread([this, run, audio = std::move(audio), on_done = std::move(on_done)]() mutable {
+        int num_channels = audio->get_num_channels();
+        int sample_rate = audio->get_sample_rate();
+        int64_t num_frames = audio->get_num_frames();
+
+        std::vector<float> mono(num_frames);
+        const float* samples = audio->get_samples().data();
+        for (int64_t i = 0; i < num_frames && !run->cancel; i++) {
+            float sum = 0;
+            for (int c = 0; c < num_channels; c++)
+                sum += samples[i * num_channels + c];
+            mono[i] = sum / num_channels;
+        }
+
+        // the next edit would have to copy the frames while they're shared
+        audio.reset();
+
+        auto grid = std::make_shared<BeatGrid>();
+        bool found = !run->cancel && track_beats(mono.data(), num_frames, sample_rate, *grid, &run->cancel);
+
+        {
+            // cancel() sets the flag under the lock, so once it returns nothing gets published and
+            // on_done isn't called anymore
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!run->cancel) {
+                m_grid = found ? std::move(grid) : nullptr;
+                if (on_done)
+                    on_done();
+            }
+        }
+        run->done = true;
+    });
+}
+
+void BeatTracker::cancel() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& run : m_runs)
+        run->cancel = true;
+}
+
+void BeatTracker::join_finished() {
+    for (size_t i = 0; i < m_runs.size();) {
+        if (m_runs[i]->done) {
+            m_runs[i]->thread.join();
+            m_runs.erase(m_runs.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+std::shared_ptr<const BeatGrid> BeatTracker::get_grid() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_grid;
+}
+
+void BeatTracker::update(int64_t start, int64_t old_end, int64_t new_end) {
+    cancel();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_grid)
+        return;
+
+    auto grid = std::make_shared<BeatGrid>(*m_grid);
+    grid->update(start, old_end, new_end);
+    m_grid = std::move(grid);
+}
+
+void BeatTracker::clear() {
+    cancel();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_grid = nullptr;
+}
+
+void BeatTracker::set_grid(std::shared_ptr<const BeatGrid> grid) {
+    cancel();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_grid = std::move(grid);
+}
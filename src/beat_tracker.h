@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+
+class AudioBuffer;
+
+// beat positions and the tempo they were tracked at
+struct BeatGrid {
+    int sample_rate = 0;
+    double tempo = 0; // beats per minute
+    std::vector<int64_t> beats; // frames, ascending
+
+    // closest beat, or -1 if there is none within max_distance frames
+    int64_t find_nearest(int64_t frame, int64_t max_distance) const;
+
+    // the edit replaced frames [start, old_end) with [start, new_end), the beats in it are dropped
+    // and the ones after it moved along
+    void update(int64_t start, int64_t old_end, int64_t new_end);
+};
+
+// onset strength from the log spectral flux, the tempo from its autocorrelation and the beats by
+// dynamic programming over both (ellis 2007)
+// returns false if the audio is too short, has no pulse or cancel was set while it ran
+bool track_beats(const float* mono, int64_t num_frames, int sample_rate, BeatGrid& grid, const std::atomic<bool>* cancel = nullptr);
+
+// runs track_beats on a thread of its own so nothing waits for it, starting again cancels
+// whatever is still running
+class BeatTracker {
+public:
+    BeatTracker() {}
+    ~BeatTracker();
+
+    // analyses a mono mix of the buffer, made on the analysis thread from a copy that shares its
+    // frames, on_done is called from there once the grid has been published, or dropped if there
+    // was no pulse, with the grid locked, so it can only hand the news on
+    void start(const AudioBuffer& buffer, std::function<void()> on_done);
+
+    // doesn't wait for the running analysis, it only makes sure it can't publish anymore
+    void cancel();
+
+    // null until an analysis finishes with a pulse
+    std::shared_ptr<const BeatGrid> get_grid() const;
+
+    // keeps the published grid in line with an edit until the next analysis replaces it,
+    // cancels the running one so it can't publish a grid of the old audio
+    void update(int64_t start, int64_t old_end, int64_t new_end);
+    void clear();
+
+    // publishes a grid that was kept from an earlier analysis, like the one in a project
+    void set_grid(std::shared_ptr<const BeatGrid> grid);
+
+private:
+    // a cancelled one runs until it notices, the next start joins it once it's done
+    struct Run {
+        std::thread thread;
+        std::atomic<bool> cancel = false;
+        std::atomic<bool> done = false;
+    };
+
+    void join_finished();
+
+    mutable std::mutex m_mutex;
+    std::shared_ptr<const BeatGrid> m_grid;
+    std::vector<std::unique_ptr<Run>> m_runs; // gui thread, only the last one can be running uncancelled
+};
@@ -0,0 +1,217 @@
+#include "biquad.h"
+
+#include <QtGlobal>
+#include <complex>
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+void Biquad::set(Type type, double sample_rate, double freq, double gain_db, double q) {
+    freq = std::max(1.0, std::min(freq, sample_rate * 0.49));
+    q = std::max(q, 0.01);
+
+    double a = pow(10.0, gain_db / 40.0);
+    double w0 = 2.0 * M_PI * freq / sample_rate;
+    double cos_w0 = cos(w0);
+    double alpha = sin(w0) / (2.0 * q);
+
+    double nb0, nb1, nb2, na0, na1, na2;
+
+    switch (type) {
+    case Type::LOW_SHELF: {
+        double sq = 2.0 * sqrt(a) * alpha;
+        nb0 = a * ((a + 1) - (a - 1) * cos_w0 + sq);
+        nb1 = 2 * a * ((a - 1) - (a + 1) * cos_w0);
+        nb2 = a * ((a + 1) - (a - 1) * cos_w0 - sq);
+        na0 = (a + 1) + (a - 1) * cos_w0 + sq;
+        na1 = -2 * ((a - 1) + (a + 1) * cos_w0);
+        na2 = (a + 1) + (a - 1) * cos_w0 - sq;
+        break;
+    }
+    case Type::HIGH_SHELF: {
+        double sq = 2.0 * sqrt(a) * alpha;
+        nb0 = a * ((a + 1) + (a - 1) * cos_w0 + sq);
+        nb1 = -2 * a * ((a - 1) + (a + 1) * cos_w0);
+        nb2 = a * ((a + 1) + (a - 1) * cos_w0 - sq);
+        na0 = (a + 1) - (a - 1) * cos_w0 + sq;
+        na1 = 2 * ((a - 1) - (a + 1) * cos_w0);
+        na2 = (a + 1) - (a - 1) * cos_w0 - sq;
+        break;
+    }
+    case Type::PEAK:
+        nb0 = 1 + alpha * a;
+        nb1 = -2 * cos_w0;
+        nb2 = 1 - alpha * a;
+        na0 = 1 + alpha / a;
+        na1 = -2 * cos_w0;
+        na2 = 1 - alpha / a;
+        break;
+    case Type::LOW_PASS:
+        nb0 = (1 - cos_w0) / 2;
+        nb1 = 1 - cos_w0;
+        nb2 = (1 - cos_w0) / 2;
+        na0 = 1 + alpha;
+        na1 = -2 * cos_w0;
+        na2 = 1 - alpha;
+        break;
+    case Type::HIGH_PASS:
+    default:
+        nb0 = (1 + cos_w0) / 2;
+        nb1 = -(1 + cos_w0);
+        nb2 = (1 + cos_w0) / 2;
+        na0 = 1 + alpha;
+        na1 = -2 * cos_w0;
+        na2 = 1 - alpha;
+        break;
+    }
+
+    b0 = (float) (nb0 / na0);
+    b1 = (float) (nb1 / na0);
+    b2 = (float) (nb2 / na0);
+    a1 = (float) (na1 / na0);
+    a2 = (float) (na2 / na0);
+}
+
+double Biquad::get_magnitude(double w) const {
+    std::complex<double> z1 = std::polar(1.0, -w);
+    std::complex<double> z2 = z1 * z1;
+    return std::abs(((double) b0 + (double) b1 * z1 + (double) b2 * z2) / (1.0 + (double) a1 * z1 + (double) a2 * z2));
+}
+
+void BiquadCascade::init(int num_stages, int num_channels) {
+    Q_ASSERT(num_stages > 0 && num_stages <= max_stages);
+    Q_ASSERT(num_channels > 0);
+
+    m_num_channels = num_channels;
+    m_biquads.assign(num_stages, Biquad());
+    m_states.assign(num_stages * num_channels, BiquadState());
+
+    m_num_lanes = (num_stages * num_channels + 3) / 4 * 4;
+    m_coeffs.assign(m_num_lanes * 5, 0.0f);
+    for (int lane = 0; lane < m_num_lanes; lane++)
+        m_coeffs[lane / 4 * 20 + lane % 4] = 1.0f; // b0, the padding passes through
+
+    reset();
+}
+
+void BiquadCascade::reset() {
+    for (BiquadState& state : m_states)
+        state.reset();
+    m_z1.assign(m_num_lanes, 0.0f);
+    m_z2.assign(m_num_lanes, 0.0f);
+}
+
+void BiquadCascade::set(int stage, const Biquad& biquad) {
+    m_biquads[stage] = biquad;
+
+    const float values[5] = {biquad.b0, biquad.b1, biquad.b2, biquad.a1, biquad.a2};
+    for (int c = 0; c < m_num_channels; c++) {
+        int lane = stage * m_num_channels + c;
+        for (int i = 0; i < 5; i++)
+            m_coeffs[lane / 4 * 20 + i * 4 + lane % 4] = values[i];
+    }
+}
+
+void BiquadCascade::process(float* const* channels, int num_frames) {
+#if defined(__SSE__)
+    if (m_num_channels <= 2 && m_num_lanes / 4 <= max_stages / 2) {
+        process_vector(channels, num_frames);
+        return;
+    }
+#endif
+    process_scalar(channels, num_frames);
+}
+
+void BiquadCascade::process_scalar(float* const* channels, int num_frames) {
+    for (int s = 0; s < get_num_stages(); s++) {
+        for (int c = 0; c < m_num_channels; c++)
+            m_states[s * m_num_channels + c].process(m_biquads[s], channels[c], num_frames);
+    }
+}
+
+void BiquadCascade::process_vector(float* const* channels, int num_frames) {
+#if defined(__SSE__)
+    const int num_vectors = m_num_lanes / 4;
+    const int num_channels = m_num_channels;
+    const int num_stages = m_num_lanes / num_channels; // including the padding
+    const int delay = num_stages - 1;
+
+    __m128 b0[max_stages / 2], b1[max_stages / 2], b2[max_stages / 2], a1[max_stages / 2], a2[max_stages / 2];
+    __m128 z1[max_stages / 2], z2[max_stages / 2], out[max_stages / 2], in[max_stages / 2];
+    __m128 lane_stage[max_stages / 2];
+    for (int v = 0; v < num_vectors; v++) {
+        const float* coeffs = &m_coeffs[v * 20];
+        b0[v] = _mm_loadu_ps(coeffs);
+        b1[v] = _mm_loadu_ps(coeffs + 4);
+        b2[v] = _mm_loadu_ps(coeffs + 8);
+        a1[v] = _mm_loadu_ps(coeffs + 12);
+        a2[v] = _mm_loadu_ps(coeffs + 16);
+        z1[v] = _mm_loadu_ps(&m_z1[v * 4]);
+        z2[v] = _mm_loadu_ps(&m_z2[v * 4]);
+        out[v] = _mm_setzero_ps();
+
+        float stages[4];
+        for (int i = 0; i < 4; i++)
+            stages[i] = (float) ((v * 4 + i) / num_channels);
+        lane_stage[v] = _mm_loadu_ps(stages);
+    }
+
+    // stage s handles frame i - s at step i, the first and last steps only move some of the stages
+    int num_steps = num_frames + delay;
+    for (int i = 0; i < num_steps; i++) {
+        float x0 = i < num_frames ? channels[0][i] : 0.0f;
+        float x1 = num_channels == 2 && i < num_frames ? channels[1][i] : 0.0f;
+
+        // every lane takes the output of the lane one stage below, stage 0 the new frame
+        __m128 prev = num_channels == 2 ? _mm_setr_ps(0, 0, x0, x1) : _mm_set1_ps(x0);
+        for (int v = 0; v < num_vectors; v++) {
+            if (num_channels == 2) {
+                in[v] = _mm_shuffle_ps(prev, out[v], _MM_SHUFFLE(1, 0, 3, 2));
+            } else {
+                __m128 t = _mm_shuffle_ps(prev, out[v], _MM_SHUFFLE(0, 0, 3, 3));
+                in[v] = _mm_shuffle_ps(t, out[v], _MM_SHUFFLE(2, 1, 2, 0));
+            }
+            prev = out[v];
+        }
+
+        // lanes whose stage has no frame at this step keep their state
+        bool partial = i < delay || i >= num_frames;
+        __m128 step = _mm_set1_ps((float) i);
+        __m128 first = _mm_set1_ps((float) (i - num_frames));
+
+        for (int v = 0; v < num_vectors; v++) {
+            __m128 x = in[v];
+            __m128 y = _mm_add_ps(_mm_mul_ps(b0[v], x), z1[v]);
+            __m128 new_z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1[v], x), _mm_mul_ps(a1[v], y)), z2[v]);
+            __m128 new_z2 = _mm_sub_ps(_mm_mul_ps(b2[v], x), _mm_mul_ps(a2[v], y));
+
+            if (partial) {
+                __m128 active = _mm_and_ps(_mm_cmple_ps(lane_stage[v], step), _mm_cmpgt_ps(lane_stage[v], first));
+                new_z1 = _mm_or_ps(_mm_and_ps(active, new_z1), _mm_andnot_ps(active, z1[v]));
+                new_z2 = _mm_or_ps(_mm_and_ps(active, new_z2), _mm_andnot_ps(active, z2[v]));
+            }
+
+            z1[v] = new_z1;
+            z2[v] = new_z2;
+            out[v] = y;
+        }
+
+        // the last stage just finished frame i - delay
+        if (i >= delay) {
+            float last[4];
+            _mm_storeu_ps(last, out[num_vectors - 1]);
+            channels[0][i - delay] = last[4 - num_channels];
+            if (num_channels == 2)
+                channels[1][i - delay] = last[3];
+        }
+    }
+
+    for (int v = 0; v < num_vectors; v++) {
+        _mm_storeu_ps(&m_z1[v * 4], z1[v]);
+        _mm_storeu_ps(&m_z2[v * 4], z2[v]);
+    }
+#endif
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+
+// second order iir section, coefficients from the rbj audio eq cookbook
+struct Biquad {
+    enum class Type {
+        LOW_SHELF,
+        PEAK,
+        HIGH_SHELF,
+        LOW_PASS,
+        HIGH_PASS,
+    };
+
+    // normalized so that a0 == 1
+    float b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+
+    void set(Type type, double sample_rate, double freq, double gain_db, double q);
+
+    // passes everything through unchanged
+    void set_identity() { b0 = 1; b1 = b2 = a1 = a2 = 0; }
+
+    // gain at w radians per sample
+    double get_magnitude(double w) const;
+};
+
+// transposed direct form ii state for one channel
+struct BiquadState {
+    float z1 = 0, z2 = 0;
+
+    void reset() { z1 = z2 = 0; }
+
+    void process(const Biquad& f, float* samples, int num_frames) {
+        float s1 = z1, s2 = z2;
+        for (int i = 0; i < num_frames; i++) {
+            float x = samples[i];
+            float y = f.b0 * x + s1;
+            s1 = f.b1 * x - f.a1 * y + s2;
+            s2 = f.b2 * x - f.a2 * y;
+            samples[i] = y;
+        }
+        z1 = s1;
+        z2 = s2;
+    }
+};
+
+// biquads in series over one or two planar channels, the sse path gives every stage and channel
+// its own lane and lets each stage work on the sample the stage before it produced one step
+// earlier, so a single step advances the whole cascade
+class BiquadCascade {
+public:
+    static const int max_stages = 16;
+
+    // allocates, not for the audio thread
+    void init(int num_stages, int num_channels);
+    void reset();
+
+    void set(int stage, const Biquad& biquad);
+    const Biquad& get(int stage) const { return m_biquads[stage]; }
+    int get_num_stages() const { return (int) m_biquads.size(); }
+
+    // in place, the output lines up with the input
+    void process(float* const* channels, int num_frames);
+
+private:
+    void process_scalar(float* const* channels, int num_frames);
+    void process_vector(float* const* channels, int num_frames);
+
+private:
+    int m_num_channels = 0;
+    std::vector<Biquad> m_biquads;
+    std::vector<BiquadState> m_states; // stage * channels + channel
+
+    // sse layout, lane = stage * channels + channel, padded to a whole register with pass-through stages
+    int m_num_lanes = 0;
+    std::vector<float> m_coeffs; // b0, b1, b2, a1, a2 for every register of lanes
+    std::vector<float> m_z1, m_z2;
+};
@@ -0,0 +1,191 @@
+#include "convolution.h"
+
+#include "simd.h"
+#include <QtGlobal>
+#include <algorithm>
+
+static int64_t next_power_of_two(int64_t n) {
+    int64_t result = 1;
+    while (result < n)
+        result *= 2;
+    return result;
+}
+
+bool ConvolutionKernel::init(const float* response, int64_t length, int block_size, int max_block_size) {
+    Q_ASSERT(length > 0 && block_size > 0 && max_block_size >= block_size);
+
+    m_block_size = block_size;
+    m_length = length;
+    m_stages.clear();
+
+    // a stage of block p has its input at the end of the block and works on it over the next p
+    // frames, one block_size at a time, so what it adds to the output can't be needed before
+    // 2 * (p - block_size) into the response
+    int64_t offset = 0;
+    int size = block_size;
+    while (offset < length) {
+        // four times longer each stage, the last step only as far as the cap
+        int next_size = std::min(size * 4, max_block_size);
+        int64_t partitions = (length - offset + size - 1) / size;
+        if (next_size > size) {
+            int64_t until_next = 2 * (next_size - block_size) - offset;
+            partitions = std::min(partitions, std::max((int64_t) 1, (until_next + size - 1) / size));
+        }
+
+        Stage stage;
+        stage.block_size = size;
+        stage.offset = offset;
+        stage.num_partitions = (int) partitions;
+        stage.spectra.resize(partitions * (size + 1));
+
+        RealFFT fft;
+        if (!fft.init(size * 2))
+            return false;
+
+        std::vector<float> padded(size * 2);
+        for (int64_t p = 0; p < partitions; p++) {
+            int64_t from = offset + p * size;
+            int64_t count = std::min((int64_t) size, length - from);
+            std::fill(padded.begin(), padded.end(), 0.0f);
+            std::copy(response + from, response + from + count, padded.begin());
+            fft.forward(padded.data(), &stage.spectra[p * (size + 1)]);
+        }
+
+        offset += partitions * size;
+        m_stages.push_back(std::move(stage));
+        size = next_size;
+    }
+
+    return true;
+}
+
+// each stage puts its transforms a step further in from the ends of its steps than the one
+// before, so the transforms of different stages land on different blocks
+static int get_step_shift(int stage, int num_steps) {
+    return std::min(std::max(stage - 1, 0), (num_steps - 1) / 2);
+}
+
+bool ConvolutionState::init(const ConvolutionKernel& kernel) {
+    int block_size = kernel.get_block_size();
+    int64_t max_block = block_size;
+    int64_t max_reach = 0;
+
+    m_stages.clear();
+    m_stages.resize(kernel.get_num_stages());
+    for (int s = 0; s < kernel.get_num_stages(); s++) {
+        const ConvolutionKernel::Stage& info = kernel.get_stage(s);
+        Stage& stage = m_stages[s];
+        stage.fft = std::make_unique<RealFFT>();
+        if (!stage.fft->init(info.block_size * 2))
+            return false;
+
+        stage.history.resize((size_t) info.num_partitions * (info.block_size + 1));
+        stage.sum.resize(info.block_size + 1);
+        stage.time.resize(info.block_size * 2);
+        max_block = std::max(max_block, (int64_t) info.block_size);
+        max_reach = std::max(max_reach, info.offset + info.block_size);
+    }
+
+    // with room for the steps a transform gets shifted by
+    int64_t max_shift = (int64_t) block_size * kernel.get_num_stages();
+    m_input.resize(next_power_of_two(max_block * 2 + max_shift));
+    m_output.resize(next_power_of_two(max_reach + block_size * 2 + max_shift));
+    m_block.resize(block_size);
+    reset();
+    return true;
+}
+
+void ConvolutionState::reset() {
+    m_pos = 0;
+    m_fill = 0;
+    std::fill(m_input.begin(), m_input.end(), 0.0f);
+    std::fill(m_output.begin(), m_output.end(), 0.0f);
+    std::fill(m_block.begin(), m_block.end(), 0.0f);
+    for (Stage& stage : m_stages) {
+        std::fill(stage.history.begin(), stage.history.end(), 0.0f);
+        std::fill(stage.sum.begin(), stage.sum.end(), 0.0f);
+        stage.history_pos = 0;
+    }
+}
+
+void ConvolutionState::process(const ConvolutionKernel& kernel, float* samples, int num_frames) {
+    int block_size = (int) m_block.size();
+    int64_t input_mask = (int64_t) m_input.size() - 1;
+
+    while (num_frames > 0) {
+        int count = std::min(num_frames, block_size - m_fill);
+
+        // swap the new frames in for the output of the last block
+        for (int i = 0; i < count; i++) {
+            m_input[(m_pos + i) & input_mask] = samples[i];
+            samples[i] = m_block[m_fill + i];
+        }
+
+        m_pos += count;
+        m_fill += count;
+        samples += count;
+        num_frames -= count;
+
+        if (m_fill == block_size) {
+            run_block(kernel);
+            m_fill = 0;
+        }
+    }
+}
+
+// a stage's block is worked on over the block_size steps of its length that follow it, the
+// forward transform first, the partitions spread evenly, the inverse last, so the work of a long
+// stage doesn't land on one audio callback
+void ConvolutionState::run_block(const ConvolutionKernel& kernel) {
+    int block_size = (int) m_block.size();
+    int64_t input_mask = (int64_t) m_input.size() - 1;
+    int64_t output_mask = (int64_t) m_output.size() - 1;
+
+    for (int s = 0; s < (int) m_stages.size(); s++) {
+        const ConvolutionKernel::Stage& info = kernel.get_stage(s);
+        Stage& stage = m_stages[s];
+        int size = info.block_size;
+        int num_bins = size + 1;
+        int num_steps = size / block_size;
+        int step = (int) ((m_pos / block_size) % num_steps);
+        int forward_step = get_step_shift(s, num_steps);
+        int inverse_step = num_steps - 1 - forward_step;
+        if (step < forward_step || step > inverse_step)
+            continue;
+
+        int64_t block_start = m_pos - (int64_t) step * block_size - size;
+        if (step == forward_step) {
+            // the stage's last two blocks of input, overlap-save keeps the second half of the result
+            for (int i = 0; i < size * 2; i++)
+                stage.time[i] = m_input[(block_start - size + i) & input_mask];
+
+            stage.history_pos = (stage.history_pos + 1) % info.num_partitions;
+            std::complex<float>* newest = &stage.history[(size_t) stage.history_pos * num_bins];
+            stage.fft->forward(stage.time.data(), newest);
+            std::fill(stage.sum.begin(), stage.sum.end(), 0.0f);
+        }
+
+        // partition p meets the input from p blocks ago
+        int64_t num_work_steps = inverse_step - forward_step + 1;
+        int64_t work_step = step - forward_step;
+        int first = (int) (info.num_partitions * work_step / num_work_steps);
+        int last = (int) (info.num_partitions * (work_step + 1) / num_work_steps);
+        for (int p = first; p < last; p++) {
+            int slot = (stage.history_pos - p + info.num_partitions) % info.num_partitions;
+            complex_multiply_add((float*) stage.sum.data(), (const float*) &stage.history[(size_t) slot * num_bins],
+                                 (const float*) &info.spectra[(size_t) p * num_bins], num_bins);
+        }
+
+        if (step == inverse_step) {
+            stage.fft->inverse(stage.sum.data(), stage.time.data());
+            for (int i = 0; i < size; i++)
+                m_output[(block_start + info.offset + i) & output_mask] += stage.time[size + i];
+        }
+    }
+
+    for (int i = 0; i < block_size; i++) {
+        float& out = m_output[(m_pos - block_size + i) & output_mask];
+        m_block[i] = out;
+        out = 0;
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "fft.h"
+#include <vector>
+#include <complex>
+#include <memory>
+#include <stdint.h>
+
+// an impulse response cut into stages of uniform partitions, the partitions four times longer
+// from one stage to the next up to max_block_size and every stage starting late enough in the
+// response that its longer block can be worked on while the next one comes in, so the work per
+// frame grows with the log of the length until the partitions are max_block_size long, past that
+// the last stage only gets more of them and the work grows linearly, if slowly
+class ConvolutionKernel {
+public:
+    struct Stage {
+        int block_size;
+        int64_t offset; // where in the response the stage begins
+        int num_partitions;
+        std::vector<std::complex<float>> spectra; // num_partitions runs of block_size + 1 bins
+    };
+
+    // allocates and transforms, block_size is both the latency and the shortest partition,
+    // max_block_size the longest and a power of two multiple of block_size
+    bool init(const float* response, int64_t length, int block_size, int max_block_size = 16384);
+
+    int get_block_size() const { return m_block_size; }
+    int64_t get_length() const { return m_length; }
+    int get_num_stages() const { return (int) m_stages.size(); }
+    const Stage& get_stage(int i) const { return m_stages[i]; }
+
+private:
+    int m_block_size = 0;
+    int64_t m_length = 0;
+    std::vector<Stage> m_stages;
+};
+
+// streaming convolution of one channel, uniformly partitioned overlap-save in every stage with
+// the work of a long stage's block spread over the kernel's blocks until its next one is complete
+class ConvolutionState {
+public:
+    bool init(const ConvolutionKernel& kernel);
+    void reset();
+
+    // in place, delayed by the kernel's block size
+    void process(const ConvolutionKernel& kernel, float* samples, int num_frames);
+
+private:
+    void run_block(const ConvolutionKernel& kernel);
+
+private:
+    struct Stage {
+        std::unique_ptr<RealFFT> fft;
+        std::vector<std::complex<float>> history; // input spectra, newest at history_pos
+        int history_pos = 0;
+        std::vector<std::complex<float>> sum;
+        std::vector<float> time;
+    };
+
+    std::vector<Stage> m_stages;
+    int64_t m_pos = 0; // frames taken in since the reset
+    int m_fill = 0;
+    std::vector<float> m_input;  // ring by position, two of the longest blocks
+    std::vector<float> m_output; // ring by position, sums of the stages not handed out yet
+    std::vector<float> m_block;  // output of the last block
+};
@@ -0,0 +1,243 @@
+#include "dynamics.h"
+
+#include "simd.h"
+#include <QtGlobal>
+#include <math.h>
+#include <algorithm>
+
+static const float db_per_octave = 6.0205999f; // 20 * log10(2), db to log2 and back
+
+static float time_to_coefficient(float ms, int sample_rate) {
+    return ms <= 0 ? 0.0f : (float) exp(-1.0 / (ms * 0.001 * sample_rate));
+}
+
+// out[i] = max over the channels of |channels[c][i]|
+static void linked_abs_max(float* const* channels, int num_channels, int num_frames, float* out) {
+    int i = 0;
+#if defined(__SSE__)
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= num_frames; i += 4) {
+        __m128 v = _mm_andnot_ps(sign_mask, _mm_loadu_ps(channels[0] + i));
+        if (num_channels == 2)
+            v = _mm_max_ps(v, _mm_andnot_ps(sign_mask, _mm_loadu_ps(channels[1] + i)));
+        _mm_storeu_ps(out + i, v);
+    }
+#endif
+    for (; i < num_frames; i++) {
+        float v = fabsf(channels[0][i]);
+        if (num_channels == 2)
+            v = fmaxf(v, fabsf(channels[1][i]));
+        out[i] = v;
+    }
+}
+
+// delays one channel through its ring in place
+static void run_delay(float* samples, int num_frames, std::vector<float>& delay, int pos) {
+    int size = (int) delay.size();
+    for (int i = 0; i < num_frames; i++) {
+        float delayed = delay[pos];
+        delay[pos] = samples[i];
+        samples[i] = delayed;
+        if (++pos == size)
+            pos = 0;
+    }
+}
+
+void Compressor::init(int num_channels, int sample_rate, int lookahead_frames) {
+    Q_ASSERT(num_channels >= 1 && num_channels <= 2);
+
+    m_num_channels = num_channels;
+    m_sample_rate = sample_rate;
+    m_lookahead = lookahead_frames;
+    for (int c = 0; c < num_channels; c++)
+        m_delay[c].resize(lookahead_frames);
+    m_level.resize(max_block);
+    m_gain.resize(max_block);
+
+    set(m_settings);
+    reset();
+}
+
+void Compressor::reset() {
+    for (int c = 0; c < m_num_channels; c++)
+        std::fill(m_delay[c].begin(), m_delay[c].end(), 0.0f);
+    m_delay_pos = 0;
+    m_reduction = 0;
+}
+
+void Compressor::set(const Settings& settings) {
+    m_settings = settings;
+    m_attack = time_to_coefficient(settings.attack_ms, m_sample_rate);
+    m_release = time_to_coefficient(settings.release_ms, m_sample_rate);
+}
+
+void Compressor::process(float* const* channels, int num_frames) {
+    for (int done = 0; done < num_frames; done += max_block) {
+        float* block[2] = {channels[0] + done, m_num_channels == 2 ? channels[1] + done : nullptr};
+        process_block(block, std::min(max_block, num_frames - done));
+    }
+}
+
+void Compressor::process_block(float* const* channels, int num_frames) {
+    float* level = m_level.data();
+    float* gain = m_gain.data();
+
+    linked_abs_max(channels, m_num_channels, num_frames, level);
+    for (int i = 0; i < num_frames; i++)
+        level[i] = std::max(level[i], 1e-6f);
+    fast_log2(level, num_frames);
+
+    // static curve, the knee is a quadratic blend between no compression and the full ratio
+    float slope = 1.0f / std::max(1.0f, m_settings.ratio) - 1.0f;
+    float knee = std::max(m_settings.knee_db, 1e-3f);
+    int i = 0;
+#if defined(__SSE__)
+    const __m128 v_slope = _mm_set1_ps(slope);
+    const __m128 v_knee = _mm_set1_ps(knee);
+    const __m128 v_half_knee = _mm_set1_ps(knee * 0.5f);
+    const __m128 v_knee_scale = _mm_set1_ps(slope / (2.0f * knee));
+    const __m128 v_threshold = _mm_set1_ps(m_settings.threshold_db);
+    const __m128 v_db = _mm_set1_ps(db_per_octave);
+    for (; i + 4 <= num_frames; i += 4) {
+        __m128 over = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(level + i), v_db), v_threshold);
+        __m128 y = _mm_min_ps(_mm_max_ps(_mm_add_ps(over, v_half_knee), _mm_setzero_ps()), v_knee);
+        __m128 in_knee = _mm_mul_ps(_mm_mul_ps(y, y), v_knee_scale);
+        __m128 above = _mm_mul_ps(over, v_slope);
+        __m128 is_above = _mm_cmpge_ps(over, v_half_knee);
+        __m128 curve = _mm_or_ps(_mm_and_ps(is_above, above), _mm_andnot_ps(is_above, in_knee));
+        _mm_storeu_ps(gain + i, _mm_sub_ps(_mm_setzero_ps(), curve));
+    }
+#endif
+    for (; i < num_frames; i++) {
+        float over = level[i] * db_per_octave - m_settings.threshold_db;
+        float y = std::min(std::max(over + knee * 0.5f, 0.0f), knee);
+        float curve = over >= knee * 0.5f ? over * slope : y * y * slope / (2.0f * knee);
+        gain[i] = -curve;
+    }
+
+    // attack while the reduction grows, release while it shrinks
+    float reduction = m_reduction;
+    float makeup = m_settings.makeup_db;
+    for (int i = 0; i < num_frames; i++) {
+        float target = gain[i];
+        float coefficient = target > reduction ? m_attack : m_release;
+        reduction = target + coefficient * (reduction - target);
+        gain[i] = (makeup - reduction) * (1.0f / db_per_octave);
+    }
+    m_reduction = reduction;
+    fast_exp2(gain, num_frames);
+
+    for (int c = 0; c < m_num_channels; c++) {
+        if (m_lookahead > 0)
+            run_delay(channels[c], num_frames, m_delay[c], m_delay_pos);
+        multiply(channels[c], gain, num_frames);
+    }
+    if (m_lookahead > 0)
+        m_delay_pos = (m_delay_pos + num_frames) % m_lookahead;
+}
+
+void TruePeakLimiter::init(int num_channels, int sample_rate, int lookahead_frames) {
+    Q_ASSERT(num_channels >= 1 && num_channels <= 2 && lookahead_frames > 0);
+
+    m_num_channels = num_channels;
+    m_sample_rate = sample_rate;
+    m_lookahead = lookahead_frames;
+
+    for (int c = 0; c < num_channels; c++) {
+        m_detectors[c].init(max_block);
+        m_peaks[c].resize(max_block);
+        m_delay[c].resize(get_latency());
+    }
+    m_gain.resize(max_block);
+    m_min_frames.resize(lookahead_frames + 2);
+    m_min_gains.resize(lookahead_frames + 2);
+    m_average.resize(lookahead_frames);
+
+    set(m_ceiling, 100);
+    reset();
+}
+
+void TruePeakLimiter::reset() {
+    for (int c = 0; c < m_num_channels; c++) {
+        m_detectors[c].reset();
+        std::fill(m_delay[c].begin(), m_delay[c].end(), 0.0f);
+    }
+    m_delay_pos = 0;
+    m_min_head = 0;
+    m_min_count = 0;
+    m_frame = 0;
+    m_envelope = 1;
+    std::fill(m_average.begin(), m_average.end(), 1.0f);
+    m_average_sum = m_lookahead;
+    m_average_pos = 0;
+    m_reduction = 0;
+}
+
+void TruePeakLimiter::set(float ceiling, float release_ms) {
+    m_ceiling = ceiling;
+    m_release = 1.0f - time_to_coefficient(release_ms, m_sample_rate);
+}
+
+void TruePeakLimiter::process(float* const* channels, int num_frames) {
+    for (int done = 0; done < num_frames; done += max_block) {
+        float* block[2] = {channels[0] + done, m_num_channels == 2 ? channels[1] + done : nullptr};
+        process_block(block, std::min(max_block, num_frames - done));
+    }
+}
+
+void TruePeakLimiter::process_block(float* const* channels, int num_frames) {
+    for (int c = 0; c < m_num_channels; c++)
+        m_detectors[c].process(channels[c], num_frames, 1, m_peaks[c].data());
+
+    // gain each interval between two samples needs to stay under the ceiling
+    float* peaks[2] = {m_peaks[0].data(), m_peaks[1].data()};
+    float* needed = m_gain.data();
+    linked_abs_max(peaks, m_num_channels, num_frames, needed);
+    int i = 0;
+#if defined(__SSE__)
+    const __m128 v_ceiling = _mm_set1_ps(m_ceiling);
+    const __m128 v_one = _mm_set1_ps(1.0f);
+    const __m128 v_tiny = _mm_set1_ps(1e-9f);
+    for (; i + 4 <= num_frames; i += 4)
+        _mm_storeu_ps(needed + i, _mm_min_ps(v_one, _mm_div_ps(v_ceiling, _mm_max_ps(_mm_loadu_ps(needed + i), v_tiny))));
+#endif
+    for (; i < num_frames; i++)
+        needed[i] = std::min(1.0f, m_ceiling / std::max(needed[i], 1e-9f));
+
+    // the hold spans two more frames than the average, so both intervals either side of the
+    // sample the averaged gain lands on are covered by every value that goes into it
+    int capacity = (int) m_min_gains.size();
+    float min_gain = 1;
+    for (int i = 0; i < num_frames; i++, m_frame++) {
+        float gain = needed[i];
+        while (m_min_count > 0 && m_min_gains[(m_min_head + m_min_count - 1) % capacity] >= gain)
+            m_min_count--;
+        int back = (m_min_head + m_min_count) % capacity;
+        m_min_frames[back] = m_frame;
+        m_min_gains[back] = gain;
+        m_min_count++;
+        while (m_min_frames[m_min_head] < m_frame - m_lookahead - 1) {
+            m_min_head = (m_min_head + 1) % capacity;
+            m_min_count--;
+        }
+
+        m_envelope = std::min(m_min_gains[m_min_head], m_envelope + (1.0f - m_envelope) * m_release);
+
+        m_average_sum += m_envelope - m_average[m_average_pos];
+        m_average[m_average_pos] = m_envelope;
+        if (++m_average_pos == m_lookahead)
+            m_average_pos = 0;
+
+        needed[i] = std::min(1.0f, (float) (m_average_sum / m_lookahead));
+        min_gain = std::min(min_gain, needed[i]);
+    }
+    m_reduction = -20.0f * log10f(min_gain);
+
+    int latency = get_latency();
+    for (int c = 0; c < m_num_channels; c++) {
+        run_delay(channels[c], num_frames, m_delay[c], m_delay_pos);
+        multiply(channels[c], needed, num_frames);
+        clamp_abs(channels[c], num_frames, m_ceiling);
+    }
+    m_delay_pos = (m_delay_pos + num_frames) % latency;
+}
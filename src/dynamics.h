@@ -0,0 +1,100 @@
+#pragma once
+
+#include "loudness.h"
+#include <vector>
+
+// gain stages that work a block at a time with buffers sized in init, so the audio thread never
+// allocates, the level detection and gain curves run vectorized and only the smoothing, which
+// depends on the previous frame, is left scalar
+
+// feed-forward compressor with a soft knee, linked across channels and smoothed in the log domain
+// the audio runs through a short delay so the gain is already down when a transient arrives
+class Compressor {
+public:
+    struct Settings {
+        float threshold_db = -18;
+        float ratio = 4;
+        float knee_db = 6;
+        float attack_ms = 10;
+        float release_ms = 150;
+        float makeup_db = 0;
+    };
+
+    void init(int num_channels, int sample_rate, int lookahead_frames);
+    void reset();
+    void set(const Settings& settings);
+
+    // in place, delayed by the lookahead
+    void process(float* const* channels, int num_frames);
+
+    int get_latency() const { return m_lookahead; }
+
+    // db of gain reduction at the end of the last block
+    float get_gain_reduction() const { return m_reduction; }
+
+private:
+    void process_block(float* const* channels, int num_frames);
+
+private:
+    static const int max_block = 256;
+
+    int m_num_channels = 0;
+    int m_sample_rate = 0;
+    int m_lookahead = 0;
+    Settings m_settings;
+    float m_attack = 0, m_release = 0; // smoothing coefficients per frame
+
+    float m_reduction = 0;
+    std::vector<float> m_delay[2];
+    int m_delay_pos = 0;
+    std::vector<float> m_level;
+    std::vector<float> m_gain;
+};
+
+// brickwall limiter on the true peak, linked across channels
+// the gain is the minimum of what every peak in the lookahead needs, averaged over the lookahead
+// so it ramps down smoothly and still never exceeds any of those, then clamped to the ceiling
+// sample by sample so nothing gets past it even where the ramp rounds
+class TruePeakLimiter {
+public:
+    void init(int num_channels, int sample_rate, int lookahead_frames);
+    void reset();
+    void set(float ceiling, float release_ms);
+
+    // in place, delayed by get_latency()
+    void process(float* const* channels, int num_frames);
+
+    int get_latency() const { return m_lookahead + TruePeakDetector::frame_delay; }
+    float get_gain_reduction() const { return m_reduction; }
+
+private:
+    void process_block(float* const* channels, int num_frames);
+
+private:
+    static const int max_block = 256;
+
+    int m_num_channels = 0;
+    int m_sample_rate = 0;
+    int m_lookahead = 0;
+    float m_ceiling = 1;
+    float m_release = 0;
+
+    TruePeakDetector m_detectors[2];
+    std::vector<float> m_peaks[2];
+    std::vector<float> m_gain;
+
+    // sliding minimum over the lookahead, a ring of (frame, gain) kept increasing in gain
+    std::vector<int64_t> m_min_frames;
+    std::vector<float> m_min_gains;
+    int m_min_head = 0, m_min_count = 0;
+    int64_t m_frame = 0;
+
+    float m_envelope = 1;
+    std::vector<float> m_average; // ring of the last lookahead envelope values
+    double m_average_sum = 0;
+    int m_average_pos = 0;
+
+    std::vector<float> m_delay[2];
+    int m_delay_pos = 0;
+    float m_reduction = 0;
+};
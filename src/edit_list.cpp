@@ -0,0 +1,410 @@
+#include "edit_list.h"
+
+#include "audio_buffer.h"
+#include "effect_render.h"
+#include "parallel.h"
+#include <QtGlobal>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
+static const int64_t render_chunk_frames = 1 << 16;
+
+class BufferSource : public EditSource {
+public:
+    BufferSource(std::shared_ptr<const AudioBuffer> buffer) : m_buffer(std::move(buffer)) {}
+
+    int64_t get_num_frames() const override { return m_buffer->get_num_frames(); }
+
+    bool read(int64_t start, int64_t num_frames, float* out, bool render) const override {
+        int num_channels = m_buffer->get_num_channels();
+        int64_t available = std::max((int64_t) 0, std::min(num_frames, m_buffer->get_num_frames() - start));
+        if (available > 0)
+            memcpy(out, m_buffer->get_samples().data() + start * num_channels, available * num_channels * sizeof(float));
+        std::fill(out + available * num_channels, out + num_frames * num_channels, 0.0f);
+        return true;
+    }
+
+private:
+    std::shared_ptr<const AudioBuffer> m_buffer;
+};
+
+// the effect applied to everything its input list plays, rendered a block at a time
+// blocks are independent like the chunks of a parallel render, each one warms the effect up on
+// the audio before it first, past max_cached_blocks the least recently used ones are dropped and
+// rendered again when something, like the render-ahead, asks for them
+class EffectSource : public EditSource {
+public:
+    EffectSource(EditList input, const Effect& effect) : m_input(std::move(input)) {
+        int64_t num_frames = m_input.get_num_frames();
+        m_effect = effect.clone();
+        m_effect->prepare(m_input.get_num_channels(), m_input.get_sample_rate(), 0, num_frames);
+
+        // an effect that needs one pass over everything gets it in a single block
+        m_block_frames = m_effect->allows_parallel() ? block_frames : std::max((int64_t) 1, num_frames);
+        m_num_blocks = (num_frames + m_block_frames - 1) / m_block_frames;
+        m_blocks = std::make_unique<Block[]>(m_num_blocks);
+    }
+
+    int64_t get_num_frames() const override { return m_input.get_num_frames(); }
+
+    bool read(int64_t start, int64_t num_frames, float* out, bool render) const override {
+        int num_channels = m_input.get_num_channels();
+        int64_t end = std::min(start + num_frames, get_num_frames());
+        bool complete = true;
+
+        for (int64_t pos = start; pos < end;) {
+            int64_t i = pos / m_block_frames;
+            int64_t offset = pos - i * m_block_frames;
+            int64_t count = std::min(end - pos, get_block_length(i) - offset);
+            float* dest = out + (pos - start) * num_channels;
+
+            if (!copy_block(i, offset, count, dest, render)) {
+                std::fill(dest, dest + count * num_channels, 0.0f);
+                complete = false;
+            }
+            pos += count;
+        }
+
+        std::fill(out + std::max((int64_t) 0, end - start) * num_channels, out + num_frames * num_channels, 0.0f);
+        return complete;
+    }
+
+    void prefetch(int64_t start, int64_t end) const override {
+        start = std::max((int64_t) 0, start);
+        end = std::min(get_num_frames(), end);
+        if (start >= end)
+            return;
+
+        int64_t first = start / m_block_frames;
+        int64_t last = (end - 1) / m_block_frames + 1;
+        parallel_for(last - first, [&](int64_t i) {
+            ensure_block(first + i);
+        });
+        drop_old_blocks();
+    }
+
+private:
+    static constexpr int64_t block_frames = 1 << 16;
+    static constexpr int64_t max_cached_blocks = 64; // 32 MB of stereo, several times the render-ahead
+
+    struct Block {
+        std::shared_mutex mutex; // shared while copying out, exclusive while rendering or dropping
+        std::atomic<bool> ready = false;
+        std::unique_ptr<float[]> samples;
+        std::atomic<uint64_t> last_used = 0;
+    };
+
+    int64_t get_block_length(int64_t i) const {
+        return std::min(m_block_frames, get_num_frames() - i * m_block_frames);
+    }
+
+    // false if it isn't rendered and render is false, the audio thread never waits for the lock
+    bool copy_block(int64_t i, int64_t offset, int64_t count, float* out, bool render) const {
+        Block& block = m_blocks[i];
+        block.last_used.store(++m_use_clock, std::memory_order_relaxed);
+        int num_channels = m_input.get_num_channels();
+        auto copy = [&]() {
+            memcpy(out, block.samples.get() + offset * num_channels, count * num_channels * sizeof(float));
+        };
+
+        {
+            std::shared_lock<std::shared_mutex> lock(block.mutex, std::try_to_lock);
+            if (lock.owns_lock() && block.ready.load(std::memory_order_relaxed)) {
+                copy();
+                return true;
+            }
+        }
+        if (!render)
+            return false;
+
+        // another thread could drop it again before it's copied
+        for (;;) {
+            ensure_block(i);
+            drop_old_blocks();
+
+            std::shared_lock<std::shared_mutex> lock(block.mutex);
+            if (block.ready.load(std::memory_order_relaxed)) {
+                copy();
+                return true;
+            }
+        }
+    }
+
+    // a block is only rendered once while it's cached
+    void ensure_block(int64_t i) const {
+        Block& block = m_blocks[i];
+        block.last_used.store(++m_use_clock, std::memory_order_relaxed);
+        {
+            std::shared_lock<std::shared_mutex> lock(block.mutex);
+            if (block.ready.load(std::memory_order_relaxed))
+                return;
+        }
+
+        std::unique_lock<std::shared_mutex> lock(block.mutex);
+        if (block.ready.load(std::memory_order_relaxed))
+            return;
+        block.samples = std::make_unique<float[]>(get_block_length(i) * m_input.get_num_channels());
+        render_block(i, block.samples.get());
+        block.ready.store(true, std::memory_order_relaxed);
+        m_num_ready++;
+    }
+
+    // blocks that are being read stay, a later call drops them once they're the oldest and free
+    void drop_old_blocks() const {
+        std::lock_guard<std::mutex> drop_lock(m_drop_mutex);
+        while (m_num_ready > max_cached_blocks) {
+            int64_t oldest = -1;
+            for (int64_t i = 0; i < m_num_blocks; i++) {
+                if (m_blocks[i].ready.load(std::memory_order_relaxed) &&
+                    (oldest < 0 || m_blocks[i].last_used.load(std::memory_order_relaxed) < m_blocks[oldest].last_used.load(std::memory_order_relaxed)))
+                    oldest = i;
+            }
+            if (oldest < 0)
+                return;
+
+            Block& block = m_blocks[oldest];
+            std::unique_lock<std::shared_mutex> lock(block.mutex, std::try_to_lock);
+            if (!lock.owns_lock())
+                return;
+            if (block.ready.load(std::memory_order_relaxed)) {
+                block.samples.reset();
+                block.ready.store(false, std::memory_order_relaxed);
+                m_num_ready--;
+            }
+        }
+    }
+
+    void render_block(int64_t i, float* out) const {
+        int num_channels = m_input.get_num_channels();
+        int64_t num_frames = get_num_frames();
+        int64_t start = i * m_block_frames;
+        int64_t end = start + get_block_length(i);
+
+        // the first block starts cold, like a single pass over the input would
+        int64_t feed_start = i > 0 ? std::max((int64_t) 0, start - m_effect->get_warmup_frames()) : 0;
+        int64_t feed_end = std::min(num_frames, end + m_effect->get_latency_frames());
+
+        std::vector<float> samples((feed_end - feed_start) * num_channels);
+        m_input.read(feed_start, feed_end - feed_start, samples.data());
+
+        AudioBuffer temp;
+        temp.init(num_channels, m_input.get_sample_rate(), std::move(samples));
+
+        // the region stays where it is relative to the frames handed to the effect
+        std::unique_ptr<Effect> effect = m_effect->clone();
+        effect->prepare(num_channels, m_input.get_sample_rate(), -feed_start, num_frames - feed_start);
+        render_effect(temp, 0, end - feed_start, *effect);
+
+        const float* rendered = temp.get_samples().data() + (start - feed_start) * num_channels;
+        std::copy(rendered, rendered + (end - start) * num_channels, out);
+    }
+
+    EditList m_input;
+    std::unique_ptr<Effect> m_effect; // prepared for the whole input, only cloned from
+    int64_t m_block_frames;
+    int64_t m_num_blocks;
+    std::unique_ptr<Block[]> m_blocks;
+    mutable std::atomic<uint64_t> m_use_clock = 0;
+    mutable std::atomic<int64_t> m_num_ready = 0;
+    mutable std::mutex m_drop_mutex; // one thread looks for the oldest blocks at a time
+};
+
+EditList::EditList(int num_channels, int sample_rate)
+    : m_num_channels(num_channels), m_sample_rate(sample_rate) {}
+
+EditList::EditList(std::shared_ptr<const AudioBuffer> buffer)
+    : m_num_channels(buffer->get_num_channels()), m_sample_rate(buffer->get_sample_rate()) {
+    int64_t num_frames = buffer->get_num_frames();
+    if (num_frames > 0)
+        m_pieces.push_back({std::make_shared<BufferSource>(std::move(buffer)), 0, num_frames});
+    on_pieces_changed();
+}
+
+EditList::EditList(int num_channels, int sample_rate, std::vector<Piece> pieces)
+    : m_pieces(std::move(pieces)), m_num_channels(num_channels), m_sample_rate(sample_rate) {
+    on_pieces_changed();
+}
+
+size_t EditList::find_piece(int64_t pos) const {
+    if (pos >= m_num_frames)
+        return m_pieces.size();
+
+    auto it = std::upper_bound(m_starts.begin(), m_starts.end(), std::max((int64_t) 0, pos));
+    return (size_t) (it - m_starts.begin()) - 1;
+}
+
+size_t EditList::split(int64_t pos) {
+    size_t i = find_piece(pos);
+    if (i == m_pieces.size() || m_starts[i] == pos)
+        return i;
+
+    Piece second = m_pieces[i];
+    int64_t offset = pos - m_starts[i];
+    second.source_start += offset;
+    second.length -= offset;
+    m_pieces[i].length = offset;
+    m_pieces.insert(m_pieces.begin() + i + 1, std::move(second));
+    m_starts.insert(m_starts.begin() + i + 1, pos);
+    return i + 1;
+}
+
+// pieces that continue each other in the same source are joined again, so a cut that gets
+// pasted back where it was doesn't leave the list any longer
+void EditList::on_pieces_changed() {
+    std::vector<Piece> pieces;
+    pieces.reserve(m_pieces.size());
+    for (Piece& piece : m_pieces) {
+        if (piece.length <= 0)
+            continue;
+
+        if (!pieces.empty()) {
+            Piece& last = pieces.back();
+            if (last.source == piece.source && last.source_start + last.length == piece.source_start) {
+                last.length += piece.length;
+                continue;
+            }
+        }
+        pieces.push_back(std::move(piece));
+    }
+    m_pieces = std::move(pieces);
+
+    m_starts.resize(m_pieces.size());
+    m_num_frames = 0;
+    for (size_t i = 0; i < m_pieces.size(); i++) {
+        m_starts[i] = m_num_frames;
+        m_num_frames += m_pieces[i].length;
+    }
+}
+
+EditList EditList::slice(int64_t start, int64_t end) const {
+    EditList result(m_num_channels, m_sample_rate);
+    start = std::max((int64_t) 0, start);
+    end = std::min(m_num_frames, end);
+
+    for (size_t i = find_piece(start); i < m_pieces.size() && m_starts[i] < end; i++) {
+        Piece piece = m_pieces[i];
+        int64_t piece_start = std::max(start, m_starts[i]);
+        int64_t piece_end = std::min(end, m_starts[i] + piece.length);
+        piece.source_start += piece_start - m_starts[i];
+        piece.length = piece_end - piece_start;
+        result.m_pieces.push_back(std::move(piece));
+    }
+
+    result.on_pieces_changed();
+    return result;
+}
+
+void EditList::remove(int64_t start, int64_t end) {
+    start = std::max((int64_t) 0, start);
+    end = std::min(m_num_frames, end);
+    if (start >= end)
+        return;
+
+    size_t first = split(start);
+    size_t last = split(end);
+    m_pieces.erase(m_pieces.begin() + first, m_pieces.begin() + last);
+    on_pieces_changed();
+}
+
+void EditList::insert(int64_t where, const EditList& other) {
+    Q_ASSERT(other.m_num_channels == m_num_channels);
+
+    size_t i = split(std::max((int64_t) 0, std::min(m_num_frames, where)));
+    m_pieces.insert(m_pieces.begin() + i, other.m_pieces.begin(), other.m_pieces.end());
+    on_pieces_changed();
+}
+
+void EditList::apply_effect(int64_t start, int64_t end, const Effect& effect) {
+    start = std::max((int64_t) 0, start);
+    end = std::min(m_num_frames, end);
+    if (start >= end)
+        return;
+
+    EditList applied(m_num_channels, m_sample_rate);
+    applied.m_pieces.push_back({std::make_shared<EffectSource>(slice(start, end), effect), 0, end - start});
+    applied.on_pieces_changed();
+
+    remove(start, end);
+    insert(start, applied);
+}
+
+bool EditList::read(int64_t start, int64_t num_frames, float* out, bool render) const {
+    int64_t end = start + num_frames;
+    int64_t pos = std::max(start, (int64_t) 0);
+    std::fill(out, out + std::min(pos - start, num_frames) * m_num_channels, 0.0f);
+
+    bool complete = true;
+    for (size_t i = find_piece(pos); i < m_pieces.size() && pos < end; i++) {
+        const Piece& piece = m_pieces[i];
+        int64_t offset = pos - m_starts[i];
+        int64_t count = std::min(end - pos, piece.length - offset);
+        complete = piece.source->read(piece.source_start + offset, count, out + (pos - start) * m_num_channels, render) && complete;
+        pos += count;
+    }
+
+    if (pos < end)
+        std::fill(out + (pos - start) * m_num_channels, out + num_frames * m_num_channels, 0.0f);
+    return complete;
+}
+
+void EditList::prefetch(int64_t start, int64_t end) const {
+    start = std::max((int64_t) 0, start);
+    end = std::min(m_num_frames, end);
+
+    for (size_t i = find_piece(start); i < m_pieces.size() && m_starts[i] < end; i++) {
+        const Piece& piece = m_pieces[i];
+        int64_t offset = std::max(start, m_starts[i]) - m_starts[i];
+        int64_t piece_end = std::min(end, m_starts[i] + piece.length) - m_starts[i];
+        piece.source->prefetch(piece.source_start + offset, piece.source_start + piece_end);
+    }
+}
+
+bool EditList::sample_amplitude(int channel, int64_t start, int64_t end, float& out_max, float& out_min, bool render) const {
+    Q_ASSERT(end >= start);
+
+    if (start == end)
+        end = start + 1;
+    start = std::max((int64_t) 0, start);
+    end = std::min(m_num_frames, end);
+
+    const int64_t max_frames = 1024;
+    float frames[max_frames * 2];
+
+    float max = -2, min = 2;
+    bool complete = true;
+    for (int64_t pos = start; pos < end; pos += max_frames) {
+        int64_t count = std::min(max_frames, end - pos);
+        complete = read(pos, count, frames, render) && complete;
+        for (int64_t i = 0; i < count; i++) {
+            float sample = frames[i * m_num_channels + channel];
+            max = std::max(max, sample);
+            min = std::min(min, sample);
+        }
+    }
+
+    out_max = max;
+    out_min = min;
+    return complete;
+}
+
+float EditList::single_sample(int64_t frame, int channel, bool render) const {
+    float samples[2];
+    read(std::max((int64_t) 0, std::min(m_num_frames - 1, frame)), 1, samples, render);
+    return samples[channel];
+}
+
+void EditList::render(AudioBuffer& out) const {
+    std::vector<float> samples(m_num_frames * m_num_channels);
+    float* dest = samples.data();
+
+    parallel_for((m_num_frames + render_chunk_frames - 1) / render_chunk_frames, [&](int64_t i) {
+        int64_t start = i * render_chunk_frames;
+        int64_t count = std::min(render_chunk_frames, m_num_frames - start);
+        read(start, count, dest + start * m_num_channels);
+    });
+
+    out.init(m_num_channels, m_sample_rate, std::move(samples));
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "effect.h"
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+class AudioBuffer;
+
+// audio an edit list refers to, it never changes once made, so lists, the clipboard and the undo
+// history can all share it
+class EditSource {
+public:
+    virtual ~EditSource() {}
+
+    virtual int64_t get_num_frames() const = 0;
+
+    // copies frames [start, start + num_frames) into out, interleaved
+    // with render false nothing gets rendered, only what's cached is used and false is returned
+    // (with silence in its place) if something wasn't there yet, that's how the audio thread reads
+    virtual bool read(int64_t start, int64_t num_frames, float* out, bool render) const = 0;
+
+    // renders whatever reading [start, end) would, so the audio thread finds it cached
+    virtual void prefetch(int64_t start, int64_t end) const {}
+};
+
+// the edited audio as a list of ranges of sources, edits only move ranges around, so cutting
+// and pasting costs the same no matter how long the audio is, effects become sources that render
+// what they are applied to block by block the first time something reads it
+// copies are cheap and share the sources, the undo history is a stack of them
+class EditList {
+public:
+    struct Piece {
+        std::shared_ptr<const EditSource> source;
+        int64_t source_start;
+        int64_t length;
+    };
+
+    EditList() {}
+    EditList(int num_channels, int sample_rate);
+
+    // the whole buffer as a single piece
+    explicit EditList(std::shared_ptr<const AudioBuffer> buffer);
+
+    // pieces that were kept somewhere else, like a project file, a piece without a source only
+    // means something to whoever made it and must not be read
+    EditList(int num_channels, int sample_rate, std::vector<Piece> pieces);
+
+    int64_t get_num_frames() const { return m_num_frames; }
+    int get_num_channels() const { return m_num_channels; }
+    int get_sample_rate() const { return m_sample_rate; }
+    double get_duration() const { return m_num_frames / (double) m_sample_rate; }
+    const std::vector<Piece>& get_pieces() const { return m_pieces; }
+
+    EditList slice(int64_t start, int64_t end) const;
+    void remove(int64_t start, int64_t end);
+
+    // where is clamped to the end, the other list has to have the same format
+    void insert(int64_t where, const EditList& other);
+
+    // replaces [start, end) with the effect applied to it, rendered when first read
+    void apply_effect(int64_t start, int64_t end, const Effect& effect);
+
+    // frames past either end read as silence, see EditSource::read for render
+    bool read(int64_t start, int64_t num_frames, float* out, bool render = true) const;
+    void prefetch(int64_t start, int64_t end) const;
+
+    // same as the ones in AudioBuffer, for the waveform, with render off sample_amplitude returns
+    // false if it came across frames an effect hadn't rendered yet, those read as silence
+    bool sample_amplitude(int channel, int64_t start, int64_t end, float& out_max, float& out_min, bool render = true) const;
+    float single_sample(int64_t frame, int channel, bool render = true) const;
+
+    // everything into one buffer, for saving, across cores
+    void render(AudioBuffer& out) const;
+
+private:
+    // index of the piece holding frame pos, the number of pieces at or past the end
+    size_t find_piece(int64_t pos) const;
+
+    // makes a piece start at pos and returns its index
+    size_t split(int64_t pos);
+
+    void on_pieces_changed();
+
+    std::vector<Piece> m_pieces;
+    std::vector<int64_t> m_starts; // where each piece starts in the list
+    int64_t m_num_frames = 0;
+    int m_num_channels = 2;
+    int m_sample_rate = 44100;
+};
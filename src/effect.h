@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+// a block of planar audio handed to an effect
+struct EffectBlock {
+    float* channels[2];
+    int num_channels;
+    int num_frames;
+    int64_t frame_pos; // position of the first frame in the buffer
+};
+
+// a user facing parameter, safe to change from the gui while the audio thread reads it
+struct EffectParam {
+    EffectParam(const char* name, const char* unit, float min, float max, float default_value)
+        : name(name), unit(unit), min(min), max(max), default_value(default_value), value(default_value) {}
+
+    const char* name;
+    const char* unit;
+    float min, max;
+    float default_value;
+    std::atomic<float> value;
+
+    float get() const { return value.load(std::memory_order_relaxed); }
+    void set(float v) { value.store(v, std::memory_order_relaxed); }
+};
+
+// processes audio in blocks, used both by the preview chain and for rendering into the buffer
+class Effect {
+public:
+    virtual ~Effect() {}
+
+    virtual const char* get_name() const = 0;
+    virtual std::unique_ptr<Effect> clone() const = 0;
+    virtual void process(EffectBlock& block) = 0;
+
+    // clears internal state (filter memory etc.), never called from the audio thread
+    virtual void reset() {}
+
+    // gui thread, after a parameter was set, for work too slow to pick the new value up in process()
+    virtual void params_changed() {}
+
+    // frames of preceding audio needed to settle internal state when a chunk is rendered on its own
+    virtual int get_warmup_frames() const { return 0; }
+
+    // frames the output lags the input by, rendering into the buffer makes up for it while the
+    // preview just plays late
+    virtual int get_latency_frames() const { return 0; }
+
+    // false if chunks can't be rendered independently even with warm-up, the region is then
+    // processed in one go on a single thread
+    virtual bool allows_parallel() const { return true; }
+
+    // generators make new audio instead of processing the region, which is inserted at the
+    // region start and is get_generated_frames() long, their input blocks are silence
+    virtual bool is_generator() const { return false; }
+    virtual int64_t get_generated_frames() const { return 0; }
+
+    // reason the effect can't be applied right now, shown instead of its dialog
+    virtual const char* get_unmet_requirement() const { return nullptr; }
+
+    // region the effect is applied to, some effects (fades) depend on it
+    void prepare(int num_channels, int sample_rate, int64_t region_start, int64_t region_end) {
+        m_num_channels = num_channels;
+        m_sample_rate = sample_rate;
+        m_region_start = region_start;
+        m_region_end = region_end;
+        reset();
+    }
+
+    int get_num_params() const { return (int) m_params.size(); }
+    EffectParam& get_param(int i) { return *m_params[i]; }
+    const EffectParam& get_param(int i) const { return *m_params[i]; }
+
+protected:
+    void add_param(EffectParam* param) { m_params.push_back(param); }
+
+    // for clone()
+    template <typename T>
+    std::unique_ptr<Effect> clone_as() const {
+        auto effect = std::make_unique<T>();
+        for (int i = 0; i < get_num_params(); i++)
+            effect->get_param(i).set(get_param(i).get());
+        effect->prepare(m_num_channels, m_sample_rate, m_region_start, m_region_end);
+        return effect;
+    }
+
+protected:
+    int m_num_channels = 2;
+    int m_sample_rate = 44100;
+    int64_t m_region_start = 0;
+    int64_t m_region_end = 0;
+
+private:
+    std::vector<EffectParam*> m_params;
+};
@@ -0,0 +1,81 @@
+#include "effect_chain.h"
+
+#include <QtGlobal>
+#include <thread>
+#include <algorithm>
+
+EffectChain::EffectChain() {
+    for (int i = 0; i < max_effects; i++)
+        m_slots[i] = nullptr;
+}
+
+bool EffectChain::add(Effect* effect) {
+    for (int i = 0; i < max_effects; i++) {
+        if (m_slots[i] == nullptr) {
+            m_slots[i] = effect;
+            return true;
+        }
+    }
+    return false;
+}
+
+// once this returns the audio thread no longer touches the effect, so it can be deleted
+void EffectChain::remove(Effect* effect) {
+    for (int i = 0; i < max_effects; i++) {
+        if (m_slots[i] == effect)
+            m_slots[i] = nullptr;
+    }
+
+    // both sides use seq_cst, so a callback starting after this point sees the empty slot
+    while (m_processing)
+        std::this_thread::yield();
+}
+
+// only call this while no stream is running
+void EffectChain::reset() {
+    for (int i = 0; i < max_effects; i++) {
+        Effect* effect = m_slots[i];
+        if (effect)
+            effect->reset();
+    }
+}
+
+void EffectChain::process(float* samples, int num_channels, int64_t num_frames, int64_t frame_pos) {
+    Q_ASSERT(num_channels <= 2);
+    m_processing = true;
+
+    Effect* effects[max_effects];
+    int num_effects = 0;
+    for (int i = 0; i < max_effects; i++) {
+        Effect* effect = m_slots[i];
+        if (effect)
+            effects[num_effects++] = effect;
+    }
+
+    for (int64_t offset = 0; num_effects > 0 && offset < num_frames; offset += block_size) {
+        int count = (int) std::min((int64_t) block_size, num_frames - offset);
+        float* interleaved = samples + offset * num_channels;
+
+        for (int c = 0; c < num_channels; c++) {
+            for (int i = 0; i < count; i++)
+                m_planar[c][i] = interleaved[i * num_channels + c];
+        }
+
+        EffectBlock block;
+        block.channels[0] = m_planar[0];
+        block.channels[1] = m_planar[1];
+        block.num_channels = num_channels;
+        block.num_frames = count;
+        block.frame_pos = frame_pos + offset;
+
+        for (int e = 0; e < num_effects; e++)
+            effects[e]->process(block);
+
+        for (int c = 0; c < num_channels; c++) {
+            for (int i = 0; i < count; i++)
+                interleaved[i * num_channels + c] = m_planar[c][i];
+        }
+    }
+
+    m_processing = false;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "effect.h"
+#include <atomic>
+#include <stdint.h>
+
+// effects applied to playback in real time, without touching the buffer
+// the gui inserts and removes effects, the audio thread only ever reads the slots
+class EffectChain {
+public:
+    static const int max_effects = 8;
+    static const int block_size = 256;
+
+    EffectChain();
+
+    bool add(Effect* effect);
+    void remove(Effect* effect);
+    void reset();
+
+    // audio thread, interleaved in place
+    void process(float* samples, int num_channels, int64_t num_frames, int64_t frame_pos);
+
+private:
+    std::atomic<Effect*> m_slots[max_effects];
+    std::atomic<bool> m_processing = false;
+    float m_planar[2][block_size];
+};
@@ -0,0 +1,52 @@
+#include "effect_registry.h"
+
+#include "effects/gain.h"
+#include "effects/fade.h"
+#include "effects/equalizer.h"
+#include "effects/parametric_eq.h"
+#include "effects/noise_reduction.h"
+#include "effects/convolution_reverb.h"
+#include "effects/dynamics.h"
+#include "effects/silence.h"
+
+static std::vector<EffectInfo>& registry() {
+    static std::vector<EffectInfo> effects;
+    return effects;
+}
+
+template <typename T, typename... Args>
+static void register_builtin(Args... args) {
+    std::unique_ptr<Effect> prototype = std::make_unique<T>(args...);
+    register_effect({prototype->get_name(), prototype->is_generator(), [args...](int) -> std::unique_ptr<Effect> {
+        return std::make_unique<T>(args...);
+    }});
+}
+
+static void register_builtins() {
+    register_builtin<GainEffect>();
+    register_builtin<FadeEffect>(true);
+    register_builtin<FadeEffect>(false);
+    register_builtin<EqualizerEffect>();
+    register_builtin<ParametricEqEffect>();
+    register_builtin<LinearPhaseEqEffect>();
+    register_builtin<NoiseReductionEffect>();
+    register_builtin<SpectralGateEffect>();
+    register_builtin<ConvolutionEffect>();
+    register_builtin<CompressorEffect>();
+    register_builtin<LimiterEffect>();
+    register_builtin<SilenceEffect>();
+}
+
+const std::vector<EffectInfo>& get_effect_registry() {
+    static bool initialized = false;
+    if (!initialized) {
+        initialized = true;
+        register_builtins();
+    }
+    return registry();
+}
+
+void register_effect(const EffectInfo& info) {
+    get_effect_registry();
+    registry().push_back(info);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "effect.h"
+#include <QString>
+#include <functional>
+#include <vector>
+
+// everything that shows up in the effects and generate menus
+struct EffectInfo {
+    QString name;
+    bool generator;
+    std::function<std::unique_ptr<Effect>(int sample_rate)> create; // the rate of the audio it will run on
+    QString submenu; // for plugins, so they don't crowd the built-in effects
+};
+
+// built-in effects are registered on first use, plugins by their host at startup
+const std::vector<EffectInfo>& get_effect_registry();
+void register_effect(const EffectInfo& info);
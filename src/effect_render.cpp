@@ -0,0 +1,148 @@
+#include "effect_render.h"
+
+#include "audio_buffer.h"
+#include "parallel.h"
+#include <QtGlobal>
+#include <vector>
+#include <algorithm>
+
+static const int block_size = 1024;
+static const int64_t min_chunk_frames = 1 << 16;
+
+using EffectInstances = std::vector<std::unique_ptr<Effect>>;
+
+// what a chunk reads besides its own frames, copied up front since the neighbouring chunks
+// overwrite those concurrently
+struct ChunkInput {
+    int64_t start, end;        // frames of the buffer the chunk writes
+    std::vector<float> before; // warm-up frames leading up to start
+    std::vector<float> after;  // latency frames from end on, zeros past the buffer
+};
+
+// runs the chunk's frames through the effects in blocks, along with the warm-up before it and as
+// much audio after it as the output lags behind
+static void process_chunk(EffectInstances& effects, float* samples, int num_channels, const ChunkInput& input, int64_t latency) {
+    int64_t feed_start = input.start - (int64_t) input.before.size() / num_channels;
+    int64_t feed_end = input.end + latency;
+
+    auto get_frame = [&](int64_t pos) -> const float* {
+        if (pos < input.start)
+            return &input.before[(pos - feed_start) * num_channels];
+        if (pos >= input.end)
+            return &input.after[(pos - input.end) * num_channels];
+        return samples + pos * num_channels;
+    };
+
+    std::vector<float> planar[2];
+    for (int c = 0; c < num_channels; c++)
+        planar[c].resize(block_size);
+
+    for (int64_t pos = feed_start; pos < feed_end; pos += block_size) {
+        int count = (int) std::min((int64_t) block_size, feed_end - pos);
+
+        for (int i = 0; i < count; i++) {
+            const float* frame = get_frame(pos + i);
+            for (int c = 0; c < num_channels; c++)
+                planar[c][i] = frame[c];
+        }
+
+        EffectBlock block;
+        block.channels[0] = planar[0].data();
+        block.channels[1] = num_channels == 2 ? planar[1].data() : nullptr;
+        block.num_channels = num_channels;
+        block.num_frames = count;
+        block.frame_pos = pos;
+        for (auto& effect : effects)
+            effect->process(block);
+
+        // already read, the frames written trail the ones being read by the latency
+        for (int i = 0; i < count; i++) {
+            int64_t out = pos + i - latency;
+            if (out < input.start || out >= input.end)
+                continue;
+            for (int c = 0; c < num_channels; c++)
+                samples[out * num_channels + c] = planar[c][i];
+        }
+    }
+}
+
+void render_effects(AudioBuffer& buffer, int64_t start, int64_t end, const std::vector<const Effect*>& effects) {
+    start = std::max((int64_t) 0, start);
+    end = std::min(buffer.get_num_frames(), end);
+    if (start >= end || effects.empty())
+        return;
+
+    int num_channels = buffer.get_num_channels();
+    float* samples = buffer.get_raw_pointer();
+    int64_t buffer_frames = buffer.get_num_frames();
+
+    // every stage has to settle and every stage delays, so a chain needs all of both together
+    int64_t warmup = 0;
+    int64_t latency = 0;
+    bool parallel = true;
+    for (const Effect* effect : effects) {
+        warmup += effect->get_warmup_frames();
+        latency += effect->get_latency_frames();
+        parallel = parallel && effect->allows_parallel();
+    }
+
+    int64_t num_frames = end - start;
+    int64_t num_chunks = 1;
+    if (parallel)
+        num_chunks = std::max((int64_t) 1, std::min((int64_t) get_num_worker_threads() * 4, num_frames / min_chunk_frames));
+    int64_t chunk_frames = (num_frames + num_chunks - 1) / num_chunks;
+
+    // stateful effects get to run over the audio leading up to their chunk first, and delayed
+    // output needs the audio after it, the first chunk starts cold like a single pass would
+    std::vector<ChunkInput> inputs(num_chunks);
+    for (int64_t i = 0; i < num_chunks; i++) {
+        ChunkInput& input = inputs[i];
+        input.start = start + i * chunk_frames;
+        input.end = std::min(end, input.start + chunk_frames);
+        if (input.start >= input.end)
+            continue;
+
+        if (i > 0 && warmup > 0) {
+            int64_t warmup_start = std::max((int64_t) 0, input.start - warmup);
+            input.before.assign(samples + warmup_start * num_channels, samples + input.start * num_channels);
+        }
+
+        input.after.assign(latency * num_channels, 0.0f);
+        int64_t after_end = std::min(buffer_frames, input.end + latency);
+        if (input.end < after_end)
+            std::copy(samples + input.end * num_channels, samples + after_end * num_channels, input.after.begin());
+    }
+
+    parallel_for(num_chunks, [&](int64_t i) {
+        const ChunkInput& input = inputs[i];
+        if (input.start >= input.end)
+            return;
+
+        EffectInstances instances;
+        for (const Effect* effect : effects)
+            instances.push_back(effect->clone());
+
+        process_chunk(instances, samples, num_channels, input, latency);
+    });
+}
+
+void render_effect(AudioBuffer& buffer, int64_t start, int64_t end, const Effect& effect) {
+    render_effects(buffer, start, end, {&effect});
+}
+
+int64_t render_generator(AudioBuffer& buffer, int64_t where, const Effect& generator) {
+    Q_ASSERT(generator.is_generator());
+
+    int64_t num_frames = generator.get_generated_frames();
+    if (num_frames <= 0)
+        return 0;
+
+    where = std::max((int64_t) 0, std::min(buffer.get_num_frames(), where));
+    buffer.insert_frames(where, num_frames);
+
+    // the region only exists now that the gap is there
+    std::unique_ptr<Effect> instance = generator.clone();
+    instance->prepare(buffer.get_num_channels(), buffer.get_sample_rate(), where, where + num_frames);
+    render_effect(buffer, where, where + num_frames, *instance);
+    return num_frames;
+}
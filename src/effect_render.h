@@ -0,0 +1,15 @@
+#pragma once
+
+#include "effect.h"
+#include <vector>
+#include <stdint.h>
+
+class AudioBuffer;
+
+// runs [start, end) of the buffer through the effects in order, in place and in a single pass,
+// split into chunks across cores unless one of the effects doesn't allow it
+void render_effects(AudioBuffer& buffer, int64_t start, int64_t end, const std::vector<const Effect*>& effects);
+void render_effect(AudioBuffer& buffer, int64_t start, int64_t end, const Effect& effect);
+
+// inserts the generator's output at where, returns the number of frames inserted
+int64_t render_generator(AudioBuffer& buffer, int64_t where, const Effect& generator);
@@ -0,0 +1,129 @@
+#include "convolution_reverb.h"
+
+#include "../rate_convert.h"
+#include <math.h>
+#include <algorithm>
+
+static std::shared_ptr<const ImpulseResponse> current_response;
+
+void set_impulse_response(std::shared_ptr<const ImpulseResponse> response) {
+    current_response = std::move(response);
+}
+
+std::shared_ptr<const ImpulseResponse> get_impulse_response() {
+    return current_response;
+}
+
+ConvolutionEffect::ConvolutionEffect() {
+    add_param(&m_wet);
+    add_param(&m_dry);
+
+    m_response = get_impulse_response();
+}
+
+std::unique_ptr<Effect> ConvolutionEffect::clone() const {
+    // the kernels have to be in place before prepare, or every clone would rebuild them
+    auto effect = std::make_unique<ConvolutionEffect>();
+    effect->m_response = m_response;
+    effect->m_kernels = m_kernels;
+    for (int i = 0; i < get_num_params(); i++)
+        effect->get_param(i).set(get_param(i).get());
+    effect->prepare(m_num_channels, m_sample_rate, m_region_start, m_region_end);
+    return effect;
+}
+
+const char* ConvolutionEffect::get_unmet_requirement() const {
+    if (!m_response || m_response->buffer.get_num_frames() == 0)
+        return "no impulse response loaded, use Load Impulse Response first";
+    return nullptr;
+}
+
+void ConvolutionEffect::build_kernels() {
+    auto kernels = std::make_shared<Kernels>();
+    kernels->sample_rate = m_sample_rate;
+    kernels->num_channels = 0;
+    kernels->length = 0;
+
+    AudioBuffer response = m_response->buffer;
+    if (response.get_sample_rate() != m_sample_rate)
+        convert_sample_rate(response, m_sample_rate, RateConverter::SINC, Resampler::Quality::HIGH);
+
+    int num_channels = std::min(response.get_num_channels(), 2);
+    int64_t length = response.get_num_frames();
+    const float* samples = response.get_samples().data();
+
+    // one scale for both sides so a stereo response keeps its balance
+    double energy = 0;
+    for (int c = 0; c < num_channels; c++) {
+        double sum = 0;
+        for (int64_t i = 0; i < length; i++)
+            sum += (double) samples[i * response.get_num_channels() + c] * samples[i * response.get_num_channels() + c];
+        energy = std::max(energy, sum);
+    }
+    float scale = energy > 0 ? (float) (1.0 / sqrt(energy)) : 0.0f;
+
+    std::vector<float> planar(length);
+    for (int c = 0; c < num_channels; c++) {
+        for (int64_t i = 0; i < length; i++)
+            planar[i] = samples[i * response.get_num_channels() + c] * scale;
+        if (!kernels->channels[c].init(planar.data(), length, block_size))
+            return;
+    }
+
+    kernels->num_channels = num_channels;
+    kernels->length = length;
+    m_kernels = std::move(kernels);
+}
+
+void ConvolutionEffect::reset() {
+    if (get_unmet_requirement())
+        return;
+
+    if (!m_kernels || m_kernels->sample_rate != m_sample_rate)
+        build_kernels();
+    if (!m_kernels || m_kernels->num_channels == 0)
+        return;
+
+    for (int c = 0; c < m_num_channels; c++) {
+        m_state[c].init(m_kernels->channels[std::min(c, m_kernels->num_channels - 1)]);
+        m_dry_delay[c].assign(block_size, 0.0f);
+    }
+    m_dry_pos = 0;
+    m_scratch.resize(4096);
+}
+
+// the response rings out for its whole length, so that much audio settles a chunk exactly
+int ConvolutionEffect::get_warmup_frames() const {
+    return m_kernels ? (int) std::min((int64_t) INT32_MAX, m_kernels->length + block_size) : 0;
+}
+
+void ConvolutionEffect::process(EffectBlock& block) {
+    if (!m_kernels || m_kernels->num_channels == 0)
+        return;
+
+    float wet = m_wet.get() <= m_wet.min ? 0.0f : (float) pow(10.0, m_wet.get() / 20.0);
+    float dry = m_dry.get() <= m_dry.min ? 0.0f : (float) pow(10.0, m_dry.get() / 20.0);
+    int scratch_size = (int) m_scratch.size();
+
+    int dry_pos = m_dry_pos;
+    for (int c = 0; c < block.num_channels; c++) {
+        const ConvolutionKernel& kernel = m_kernels->channels[std::min(c, m_kernels->num_channels - 1)];
+        float* samples = block.channels[c];
+        float* delay = m_dry_delay[c].data();
+        dry_pos = m_dry_pos;
+
+        for (int done = 0; done < block.num_frames; done += scratch_size) {
+            int count = std::min(scratch_size, block.num_frames - done);
+            std::copy(samples + done, samples + done + count, m_scratch.begin());
+            m_state[c].process(kernel, m_scratch.data(), count);
+
+            for (int i = 0; i < count; i++) {
+                float delayed = delay[dry_pos];
+                delay[dry_pos] = samples[done + i];
+                dry_pos = (dry_pos + 1) % block_size;
+                samples[done + i] = m_scratch[i] * wet + delayed * dry;
+            }
+        }
+    }
+    m_dry_pos = dry_pos;
+}
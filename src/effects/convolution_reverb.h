@@ -0,0 +1,57 @@
+#pragma once
+
+#include "../effect.h"
+#include "../convolution.h"
+#include "../audio_buffer.h"
+#include <string>
+
+// a reverb or speaker/room response loaded from a file, what the convolution effect applies
+struct ImpulseResponse {
+    std::string name;
+    AudioBuffer buffer;
+};
+
+// the response new effects pick up, gui thread only
+void set_impulse_response(std::shared_ptr<const ImpulseResponse> response);
+std::shared_ptr<const ImpulseResponse> get_impulse_response();
+
+// convolves with the loaded impulse response, resampled to the buffer's rate and scaled to unit
+// energy, a stereo response convolves each channel with its own side
+// the kernel is built once and shared by the clones the offline render makes for its chunks
+class ConvolutionEffect : public Effect {
+public:
+    static const int block_size = 512;
+
+    ConvolutionEffect();
+
+    const char* get_name() const override { return "Convolution Reverb"; }
+    std::unique_ptr<Effect> clone() const override;
+    void process(EffectBlock& block) override;
+    void reset() override;
+    int get_warmup_frames() const override;
+    int get_latency_frames() const override { return block_size; }
+    const char* get_unmet_requirement() const override;
+
+private:
+    struct Kernels {
+        int sample_rate;
+        int num_channels;
+        int64_t length;
+        ConvolutionKernel channels[2];
+    };
+
+    void build_kernels();
+
+private:
+    EffectParam m_wet{"Wet", "dB", -48, 12, 0};
+    EffectParam m_dry{"Dry", "dB", -48, 12, -48}; // off at the minimum
+
+    std::shared_ptr<const ImpulseResponse> m_response;
+    std::shared_ptr<const Kernels> m_kernels;
+    ConvolutionState m_state[2];
+
+    // the dry signal is held back by the block size to line up with the wet one
+    std::vector<float> m_dry_delay[2];
+    int m_dry_pos = 0;
+    std::vector<float> m_scratch;
+};
@@ -0,0 +1,76 @@
+#include "dynamics.h"
+
+#include "../audio_buffer.h"
+#include "../effect_render.h"
+#include "../simd.h"
+#include <math.h>
+#include <algorithm>
+
+static const double lookahead_seconds = 0.005;
+
+// the detector and envelope forget exponentially, after this many time constants what came
+// before the warm-up is far below anything audible
+static const double settle_time_constants = 8;
+
+CompressorEffect::CompressorEffect() {
+    add_param(&m_threshold);
+    add_param(&m_ratio);
+    add_param(&m_knee);
+    add_param(&m_attack);
+    add_param(&m_release);
+    add_param(&m_makeup);
+}
+
+void CompressorEffect::reset() {
+    m_compressor.init(m_num_channels, m_sample_rate, (int) (lookahead_seconds * m_sample_rate));
+}
+
+int CompressorEffect::get_warmup_frames() const {
+    double slowest = std::max(m_attack.get(), m_release.get()) * 0.001;
+    return m_compressor.get_latency() + (int) (slowest * settle_time_constants * m_sample_rate);
+}
+
+void CompressorEffect::process(EffectBlock& block) {
+    Compressor::Settings settings;
+    settings.threshold_db = m_threshold.get();
+    settings.ratio = m_ratio.get();
+    settings.knee_db = m_knee.get();
+    settings.attack_ms = m_attack.get();
+    settings.release_ms = m_release.get();
+    settings.makeup_db = m_makeup.get();
+    m_compressor.set(settings);
+
+    m_compressor.process(block.channels, block.num_frames);
+}
+
+LimiterEffect::LimiterEffect() {
+    add_param(&m_input_gain);
+    add_param(&m_ceiling);
+    add_param(&m_release);
+}
+
+void LimiterEffect::reset() {
+    m_limiter.init(m_num_channels, m_sample_rate, std::max(1, (int) (lookahead_seconds * m_sample_rate)));
+}
+
+int LimiterEffect::get_warmup_frames() const {
+    return m_limiter.get_latency() + (int) (m_release.get() * 0.001 * settle_time_constants * m_sample_rate);
+}
+
+void LimiterEffect::process(EffectBlock& block) {
+    float input_gain = powf(10.0f, m_input_gain.get() / 20.0f);
+    if (input_gain != 1.0f) {
+        for (int c = 0; c < block.num_channels; c++)
+            multiply_ramp(block.channels[c], block.num_frames, input_gain, 0);
+    }
+
+    m_limiter.set(powf(10.0f, m_ceiling.get() / 20.0f), m_release.get());
+    m_limiter.process(block.channels, block.num_frames);
+}
+
+void limit_to_ceiling(AudioBuffer& buffer, double ceiling_dbtp) {
+    LimiterEffect limiter;
+    limiter.set_ceiling((float) ceiling_dbtp);
+    limiter.prepare(buffer.get_num_channels(), buffer.get_sample_rate(), 0, buffer.get_num_frames());
+    render_effect(buffer, 0, buffer.get_num_frames(), limiter);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../effect.h"
+#include "../dynamics.h"
+
+class AudioBuffer;
+
+// the lookahead is fixed rather than a parameter, changing it would change the latency and
+// reallocate the delay lines while the preview runs
+class CompressorEffect : public Effect {
+public:
+    CompressorEffect();
+
+    const char* get_name() const override { return "Compressor"; }
+    std::unique_ptr<Effect> clone() const override { return clone_as<CompressorEffect>(); }
+    void process(EffectBlock& block) override;
+    void reset() override;
+    int get_warmup_frames() const override;
+    int get_latency_frames() const override { return m_compressor.get_latency(); }
+
+private:
+    EffectParam m_threshold{"Threshold", "dB", -60, 0, -18};
+    EffectParam m_ratio{"Ratio", ":1", 1, 20, 4};
+    EffectParam m_knee{"Knee", "dB", 0, 24, 6};
+    EffectParam m_attack{"Attack", "ms", 0.1f, 100, 10};
+    EffectParam m_release{"Release", "ms", 10, 2000, 150};
+    EffectParam m_makeup{"Makeup", "dB", 0, 24, 0};
+
+    Compressor m_compressor;
+};
+
+class LimiterEffect : public Effect {
+public:
+    LimiterEffect();
+
+    const char* get_name() const override { return "Limiter"; }
+    std::unique_ptr<Effect> clone() const override { return clone_as<LimiterEffect>(); }
+    void process(EffectBlock& block) override;
+    void reset() override;
+    int get_warmup_frames() const override;
+    int get_latency_frames() const override { return m_limiter.get_latency(); }
+
+    void set_ceiling(float ceiling_dbtp) { m_ceiling.set(ceiling_dbtp); }
+
+private:
+    EffectParam m_input_gain{"Input Gain", "dB", 0, 24, 0};
+    EffectParam m_ceiling{"Ceiling", "dBTP", -12, 0, -1};
+    EffectParam m_release{"Release", "ms", 10, 1000, 100};
+
+    TruePeakLimiter m_limiter;
+};
+
+// limits the whole buffer to the ceiling in parallel chunks, afterwards no sample goes over it
+// and neither does the true peak as a bs.1770 meter reads it
+void limit_to_ceiling(AudioBuffer& buffer, double ceiling_dbtp);
@@ -0,0 +1,46 @@
+#include "equalizer.h"
+
+#include <string.h>
+
+EqualizerEffect::EqualizerEffect() {
+    add_param(&m_low_gain);
+    add_param(&m_low_freq);
+    add_param(&m_mid_gain);
+    add_param(&m_mid_freq);
+    add_param(&m_mid_q);
+    add_param(&m_high_gain);
+    add_param(&m_high_freq);
+}
+
+void EqualizerEffect::reset() {
+    m_cascade.init(num_bands, m_num_channels);
+
+    // force a coefficient update on the next block
+    for (float& value : m_cached_values)
+        value = -1e9f;
+}
+
+// parameters can change at any time from the gui, coefficients are only recomputed when they do
+void EqualizerEffect::update_coefficients() {
+    float values[7];
+    for (int i = 0; i < 7; i++)
+        values[i] = get_param(i).get();
+
+    if (memcmp(values, m_cached_values, sizeof(values)) == 0)
+        return;
+
+    memcpy(m_cached_values, values, sizeof(values));
+
+    Biquad filters[num_bands];
+    filters[0].set(Biquad::Type::LOW_SHELF, m_sample_rate, values[1], values[0], 0.707);
+    filters[1].set(Biquad::Type::PEAK, m_sample_rate, values[3], values[2], values[4]);
+    filters[2].set(Biquad::Type::HIGH_SHELF, m_sample_rate, values[6], values[5], 0.707);
+    for (int b = 0; b < num_bands; b++)
+        m_cascade.set(b, filters[b]);
+}
+
+void EqualizerEffect::process(EffectBlock& block) {
+    update_coefficients();
+
+    m_cascade.process(block.channels, block.num_frames);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "../effect.h"
+#include "../biquad.h"
+
+// low shelf, mid peak and high shelf
+class EqualizerEffect : public Effect {
+public:
+    EqualizerEffect();
+
+    const char* get_name() const override { return "Equalizer"; }
+    std::unique_ptr<Effect> clone() const override { return clone_as<EqualizerEffect>(); }
+    void process(EffectBlock& block) override;
+    void reset() override;
+    int get_warmup_frames() const override { return m_sample_rate / 2; }
+
+private:
+    void update_coefficients();
+
+private:
+    static const int num_bands = 3;
+
+    EffectParam m_low_gain{"Low Gain", "dB", -18, 18, 0};
+    EffectParam m_low_freq{"Low Freq", "Hz", 20, 1000, 120};
+    EffectParam m_mid_gain{"Mid Gain", "dB", -18, 18, 0};
+    EffectParam m_mid_freq{"Mid Freq", "Hz", 100, 10000, 1000};
+    EffectParam m_mid_q{"Mid Q", "", 0.1f, 10, 1};
+    EffectParam m_high_gain{"High Gain", "dB", -18, 18, 0};
+    EffectParam m_high_freq{"High Freq", "Hz", 1000, 20000, 8000};
+
+    BiquadCascade m_cascade;
+    float m_cached_values[7] = {};
+};
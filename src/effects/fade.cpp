@@ -0,0 +1,35 @@
+#include "fade.h"
+
+#include "../simd.h"
+#include <math.h>
+#include <algorithm>
+
+FadeEffect::FadeEffect(bool fade_in) : m_fade_in(fade_in) {
+    add_param(&m_curve);
+
+    // enough for any block size in use, so the preview never allocates on the audio thread
+    m_gains.reserve(4096);
+}
+
+std::unique_ptr<Effect> FadeEffect::clone() const {
+    auto effect = std::make_unique<FadeEffect>(m_fade_in);
+    effect->m_curve.set(m_curve.get());
+    effect->prepare(m_num_channels, m_sample_rate, m_region_start, m_region_end);
+    return effect;
+}
+
+void FadeEffect::process(EffectBlock& block) {
+    double length = std::max((int64_t) 1, m_region_end - m_region_start);
+    float curve = m_curve.get();
+
+    // the curve is evaluated once per frame, then applied to every channel
+    m_gains.resize(block.num_frames);
+    for (int i = 0; i < block.num_frames; i++) {
+        double t = (block.frame_pos + i - m_region_start) / length;
+        t = std::max(0.0, std::min(1.0, t));
+        m_gains[i] = powf((float) (m_fade_in ? t : 1.0 - t), curve);
+    }
+
+    for (int c = 0; c < block.num_channels; c++)
+        multiply(block.channels[c], m_gains.data(), block.num_frames);
+}
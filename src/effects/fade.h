@@ -0,0 +1,18 @@
+#pragma once
+
+#include "../effect.h"
+
+// fades across the whole region the effect is applied to
+class FadeEffect : public Effect {
+public:
+    FadeEffect(bool fade_in = true);
+
+    const char* get_name() const override { return m_fade_in ? "Fade In" : "Fade Out"; }
+    std::unique_ptr<Effect> clone() const override;
+    void process(EffectBlock& block) override;
+
+private:
+    bool m_fade_in;
+    EffectParam m_curve{"Curve", "", 0.25f, 4, 1}; // 1 is linear
+    std::vector<float> m_gains;
+};
@@ -0,0 +1,25 @@
+#include "gain.h"
+
+#include "../simd.h"
+#include <math.h>
+
+GainEffect::GainEffect() {
+    add_param(&m_gain);
+}
+
+void GainEffect::reset() {
+    m_current = -1;
+}
+
+void GainEffect::process(EffectBlock& block) {
+    float target = powf(10.0f, m_gain.get() / 20.0f);
+    if (m_current < 0)
+        m_current = target;
+
+    // ramp over the block so that moving the slider doesn't click
+    float step = (target - m_current) / block.num_frames;
+    for (int c = 0; c < block.num_channels; c++)
+        multiply_ramp(block.channels[c], block.num_frames, m_current, step);
+
+    m_current = target;
+}
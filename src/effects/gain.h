@@ -0,0 +1,17 @@
+#pragma once
+
+#include "../effect.h"
+
+class GainEffect : public Effect {
+public:
+    GainEffect();
+
+    const char* get_name() const override { return "Amplify"; }
+    std::unique_ptr<Effect> clone() const override { return clone_as<GainEffect>(); }
+    void process(EffectBlock& block) override;
+    void reset() override;
+
+private:
+    EffectParam m_gain{"Gain", "dB", -24, 24, 0};
+    float m_current = -1; // linear gain the last block ended on
+};
@@ -0,0 +1,152 @@
+#include "ladspa_effect.h"
+
+#include <dlfcn.h>
+#include <math.h>
+
+// the bounds and the defaults that follow them are fractions of the rate for sample rate ports
+static PluginControl make_control(unsigned long port, const char* name, const LADSPA_PortRangeHint& hint) {
+    LADSPA_PortRangeHintDescriptor hints = hint.HintDescriptor;
+
+    PluginControl control;
+    control.port = (uint32_t) port;
+    control.name = name ? name : "";
+    control.per_rate = LADSPA_IS_HINT_SAMPLE_RATE(hints);
+    control.toggled = LADSPA_IS_HINT_TOGGLED(hints);
+    control.integer = LADSPA_IS_HINT_INTEGER(hints);
+    if (LADSPA_IS_HINT_BOUNDED_BELOW(hints))
+        control.min = hint.LowerBound;
+    if (LADSPA_IS_HINT_BOUNDED_ABOVE(hints))
+        control.max = hint.UpperBound;
+
+    float min = isnan(control.min) ? 0.0f : control.min;
+    float max = isnan(control.max) ? min + 1.0f : control.max;
+    bool logarithmic = LADSPA_IS_HINT_LOGARITHMIC(hints) && min > 0 && max > min;
+    auto between = [&](float t) {
+        if (logarithmic)
+            return expf(logf(min) * (1 - t) + logf(max) * t);
+        return min * (1 - t) + max * t;
+    };
+
+    control.default_per_rate = control.per_rate;
+    if (LADSPA_IS_HINT_DEFAULT_MINIMUM(hints))
+        control.default_value = min;
+    else if (LADSPA_IS_HINT_DEFAULT_LOW(hints))
+        control.default_value = between(0.25f);
+    else if (LADSPA_IS_HINT_DEFAULT_MIDDLE(hints))
+        control.default_value = between(0.5f);
+    else if (LADSPA_IS_HINT_DEFAULT_HIGH(hints))
+        control.default_value = between(0.75f);
+    else if (LADSPA_IS_HINT_DEFAULT_MAXIMUM(hints))
+        control.default_value = max;
+    else
+        control.default_per_rate = false;
+
+    if (LADSPA_IS_HINT_DEFAULT_1(hints))
+        control.default_value = 1;
+    else if (LADSPA_IS_HINT_DEFAULT_100(hints))
+        control.default_value = 100;
+    else if (LADSPA_IS_HINT_DEFAULT_440(hints))
+        control.default_value = 440;
+    else if (isnan(control.default_value))
+        control.default_value = 0;
+    return control;
+}
+
+LadspaPlugin::~LadspaPlugin() {
+    if (m_library)
+        dlclose(m_library);
+}
+
+bool LadspaPlugin::is_usable(const LADSPA_Descriptor* descriptor) {
+    int num_inputs = 0, num_outputs = 0;
+    for (unsigned long i = 0; i < descriptor->PortCount; i++) {
+        LADSPA_PortDescriptor port = descriptor->PortDescriptors[i];
+        if (!LADSPA_IS_PORT_AUDIO(port))
+            continue;
+        if (LADSPA_IS_PORT_INPUT(port))
+            num_inputs++;
+        else
+            num_outputs++;
+    }
+
+    return (num_inputs == 1 || num_inputs == 2) && num_inputs == num_outputs && descriptor->instantiate && descriptor->run;
+}
+
+std::shared_ptr<LadspaPlugin> LadspaPlugin::load(const std::string& path, unsigned long index) {
+    void* library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!library)
+        return nullptr;
+
+    auto get_descriptor = (LADSPA_Descriptor_Function) dlsym(library, "ladspa_descriptor");
+    const LADSPA_Descriptor* descriptor = get_descriptor ? get_descriptor(index) : nullptr;
+    if (!descriptor || !is_usable(descriptor)) {
+        dlclose(library);
+        return nullptr;
+    }
+
+    std::shared_ptr<LadspaPlugin> plugin(new LadspaPlugin());
+    plugin->m_library = library;
+    plugin->m_descriptor = descriptor;
+    plugin->m_name = descriptor->Name ? descriptor->Name : descriptor->Label;
+    plugin->m_num_ports = (uint32_t) descriptor->PortCount;
+
+    for (unsigned long i = 0; i < descriptor->PortCount; i++) {
+        LADSPA_PortDescriptor port = descriptor->PortDescriptors[i];
+        if (LADSPA_IS_PORT_AUDIO(port))
+            (LADSPA_IS_PORT_INPUT(port) ? plugin->m_inputs : plugin->m_outputs).push_back((uint32_t) i);
+        else if (LADSPA_IS_PORT_INPUT(port))
+            plugin->m_controls.push_back(make_control(i, descriptor->PortNames[i], descriptor->PortRangeHints[i]));
+        else
+            plugin->m_control_outputs.push_back((uint32_t) i);
+    }
+
+    return plugin;
+}
+
+LadspaEffect::LadspaEffect(std::shared_ptr<LadspaPlugin> plugin, const std::string& name, int sample_rate)
+    : PluginEffect(plugin.get(), name, sample_rate), m_plugin(std::move(plugin)) {}
+
+LadspaEffect::~LadspaEffect() {
+    release();
+}
+
+std::unique_ptr<Effect> LadspaEffect::clone() const {
+    auto effect = std::make_unique<LadspaEffect>(m_plugin, m_name, m_param_rate);
+    copy_state_to(*effect);
+    return effect;
+}
+
+void LadspaEffect::release() {
+    if (!m_plugin)
+        return;
+
+    const LADSPA_Descriptor* descriptor = m_plugin->get_descriptor();
+    for (LADSPA_Handle instance : m_instances) {
+        if (descriptor->deactivate)
+            descriptor->deactivate(instance);
+        if (descriptor->cleanup)
+            descriptor->cleanup(instance);
+    }
+    m_instances.clear();
+}
+
+bool LadspaEffect::add_instance(int i) {
+    const LADSPA_Descriptor* descriptor = m_plugin->get_descriptor();
+    LADSPA_Handle instance = descriptor->instantiate(descriptor, (unsigned long) m_sample_rate);
+    if (!instance)
+        return false;
+    m_instances.push_back(instance);
+
+    connect_ports(i, [&](uint32_t port, float* data) {
+        descriptor->connect_port(instance, port, data);
+    });
+    if (descriptor->activate)
+        descriptor->activate(instance);
+    return true;
+}
+
+const char* LadspaEffect::get_unmet_requirement() const {
+    if (!m_plugin)
+        return "the plugin library could not be loaded";
+    return PluginEffect::get_unmet_requirement();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "plugin_effect.h"
+#include <ladspa.h>
+#include <string>
+
+// a library loaded with dlopen and one of the plugins in it, shared by every instance of it
+class LadspaPlugin : public PluginPorts {
+public:
+    ~LadspaPlugin();
+
+    // null if the library or the plugin in it can't be loaded, or it isn't usable as an effect
+    static std::shared_ptr<LadspaPlugin> load(const std::string& path, unsigned long index);
+
+    // one or two audio inputs and as many outputs, anything else doesn't fit a channel of the buffer
+    static bool is_usable(const LADSPA_Descriptor* descriptor);
+
+    const LADSPA_Descriptor* get_descriptor() const { return m_descriptor; }
+    const std::string& get_name() const { return m_name; }
+
+private:
+    LadspaPlugin() {}
+
+    void* m_library = nullptr;
+    const LADSPA_Descriptor* m_descriptor = nullptr;
+    std::string m_name;
+};
+
+// runs a ladspa plugin as an effect
+class LadspaEffect : public PluginEffect {
+public:
+    // a null plugin makes an effect that only reports it couldn't be loaded
+    LadspaEffect(std::shared_ptr<LadspaPlugin> plugin, const std::string& name, int sample_rate);
+    ~LadspaEffect() override;
+
+    std::unique_ptr<Effect> clone() const override;
+    const char* get_unmet_requirement() const override;
+
+protected:
+    bool add_instance(int i) override;
+    int get_num_instances() const override { return (int) m_instances.size(); }
+    void run_instance(int i, int num_frames) override { m_plugin->get_descriptor()->run(m_instances[i], num_frames); }
+    void release() override;
+
+private:
+    std::shared_ptr<LadspaPlugin> m_plugin;
+    std::vector<LADSPA_Handle> m_instances;
+};
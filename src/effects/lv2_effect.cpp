@@ -0,0 +1,207 @@
+#include "lv2_effect.h"
+
+#include <lv2/core/lv2.h>
+#include <string.h>
+
+// what ports are told apart by, the nodes belong to one world
+struct PortClasses {
+    explicit PortClasses(LilvWorld* world)
+        : audio(lilv_new_uri(world, LV2_CORE__AudioPort)),
+          control(lilv_new_uri(world, LV2_CORE__ControlPort)),
+          input(lilv_new_uri(world, LV2_CORE__InputPort)),
+          optional(lilv_new_uri(world, LV2_CORE__connectionOptional)),
+          toggled(lilv_new_uri(world, LV2_CORE__toggled)),
+          integer(lilv_new_uri(world, LV2_CORE__integer)),
+          sample_rate(lilv_new_uri(world, LV2_CORE__sampleRate)) {}
+
+    ~PortClasses() {
+        for (LilvNode* node : {audio, control, input, optional, toggled, integer, sample_rate})
+            lilv_node_free(node);
+    }
+
+    LilvNode* audio;
+    LilvNode* control;
+    LilvNode* input;
+    LilvNode* optional;
+    LilvNode* toggled;
+    LilvNode* integer;
+    LilvNode* sample_rate;
+};
+
+// bounds and a default the plugin leaves out come back as nan, which is how PluginControl keeps them
+static PluginControl make_control(const LilvPlugin* plugin, uint32_t index, float min, float max, float default_value, const PortClasses& classes) {
+    const LilvPort* port = lilv_plugin_get_port_by_index(plugin, index);
+
+    PluginControl control;
+    control.port = index;
+    LilvNode* name = lilv_port_get_name(plugin, port);
+    control.name = name ? lilv_node_as_string(name) : lilv_node_as_string(lilv_port_get_symbol(plugin, port));
+    lilv_node_free(name);
+    control.min = min;
+    control.max = max;
+    control.default_value = default_value;
+    control.per_rate = lilv_port_has_property(plugin, port, classes.sample_rate);
+    control.default_per_rate = control.per_rate;
+    control.toggled = lilv_port_has_property(plugin, port, classes.toggled);
+    control.integer = lilv_port_has_property(plugin, port, classes.integer);
+    return control;
+}
+
+Lv2World& Lv2World::get() {
+    static Lv2World* world = new Lv2World();
+    return *world;
+}
+
+Lv2World::Lv2World() {
+    m_world = lilv_world_new();
+    lilv_world_load_all(m_world);
+}
+
+LilvWorld* Lv2World::load_bundle(const std::string& bundle_dir) {
+    LilvWorld* world = lilv_world_new();
+
+    // bundle uris end in a slash
+    std::string dir = bundle_dir;
+    if (dir.empty() || dir.back() != '/')
+        dir += '/';
+    LilvNode* uri = lilv_new_file_uri(world, nullptr, dir.c_str());
+    lilv_world_load_bundle(world, uri);
+    lilv_node_free(uri);
+    return world;
+}
+
+bool Lv2World::is_usable(LilvWorld* world, const LilvPlugin* plugin) {
+    PortClasses classes(world);
+    int num_inputs = 0, num_outputs = 0;
+    for (uint32_t i = 0; i < lilv_plugin_get_num_ports(plugin); i++) {
+        const LilvPort* port = lilv_plugin_get_port_by_index(plugin, i);
+        if (lilv_port_is_a(plugin, port, classes.audio)) {
+            if (lilv_port_is_a(plugin, port, classes.input))
+                num_inputs++;
+            else
+                num_outputs++;
+        } else if (!lilv_port_is_a(plugin, port, classes.control) && !lilv_port_has_property(plugin, port, classes.optional)) {
+            // atom and cv ports would need buffers of their own
+            return false;
+        }
+    }
+    if ((num_inputs != 1 && num_inputs != 2) || num_inputs != num_outputs)
+        return false;
+
+    bool supported = true;
+    LilvNodes* required = lilv_plugin_get_required_features(plugin);
+    LILV_FOREACH(nodes, it, required) {
+        const char* feature = lilv_node_as_uri(lilv_nodes_get(required, it));
+        supported = supported && (strcmp(feature, LV2_URID__map) == 0 || strcmp(feature, LV2_URID__unmap) == 0);
+    }
+    lilv_nodes_free(required);
+    return supported;
+}
+
+LV2_URID Lv2World::map_uri(LV2_URID_Map_Handle handle, const char* uri) {
+    Lv2World* world = (Lv2World*) handle;
+    std::lock_guard<std::mutex> lock(world->m_urid_mutex);
+    auto it = world->m_urids.find(uri);
+    if (it != world->m_urids.end())
+        return it->second;
+
+    world->m_uris.push_back(std::make_unique<std::string>(uri));
+    LV2_URID urid = (LV2_URID) world->m_uris.size();
+    world->m_urids[uri] = urid;
+    return urid;
+}
+
+const char* Lv2World::unmap_uri(LV2_URID_Unmap_Handle handle, LV2_URID urid) {
+    Lv2World* world = (Lv2World*) handle;
+    std::lock_guard<std::mutex> lock(world->m_urid_mutex);
+    if (urid == 0 || urid > world->m_uris.size())
+        return nullptr;
+    return world->m_uris[urid - 1]->c_str();
+}
+
+std::shared_ptr<Lv2Plugin> Lv2Plugin::load(const std::string& uri) {
+    Lv2World& lv2 = Lv2World::get();
+    std::lock_guard<std::mutex> lock(lv2.get_mutex());
+    LilvWorld* world = lv2.get_world();
+
+    LilvNode* node = lilv_new_uri(world, uri.c_str());
+    const LilvPlugin* lilv_plugin = lilv_plugins_get_by_uri(lilv_world_get_all_plugins(world), node);
+    lilv_node_free(node);
+    if (!lilv_plugin || !Lv2World::is_usable(world, lilv_plugin))
+        return nullptr;
+
+    std::shared_ptr<Lv2Plugin> plugin(new Lv2Plugin());
+    plugin->m_plugin = lilv_plugin;
+    plugin->m_num_ports = lilv_plugin_get_num_ports(lilv_plugin);
+
+    uint32_t num_ports = plugin->m_num_ports;
+    std::vector<float> mins(num_ports), maxes(num_ports), defaults(num_ports);
+    lilv_plugin_get_port_ranges_float(lilv_plugin, mins.data(), maxes.data(), defaults.data());
+
+    PortClasses classes(world);
+    for (uint32_t i = 0; i < num_ports; i++) {
+        const LilvPort* port = lilv_plugin_get_port_by_index(lilv_plugin, i);
+        bool input = lilv_port_is_a(lilv_plugin, port, classes.input);
+        if (lilv_port_is_a(lilv_plugin, port, classes.audio))
+            (input ? plugin->m_inputs : plugin->m_outputs).push_back(i);
+        else if (lilv_port_is_a(lilv_plugin, port, classes.control) && input)
+            plugin->m_controls.push_back(make_control(lilv_plugin, i, mins[i], maxes[i], defaults[i], classes));
+        else if (lilv_port_is_a(lilv_plugin, port, classes.control))
+            plugin->m_control_outputs.push_back(i);
+    }
+
+    return plugin;
+}
+
+Lv2Effect::Lv2Effect(std::shared_ptr<Lv2Plugin> plugin, const std::string& name, int sample_rate)
+    : PluginEffect(plugin.get(), name, sample_rate), m_plugin(std::move(plugin)) {}
+
+Lv2Effect::~Lv2Effect() {
+    release();
+}
+
+std::unique_ptr<Effect> Lv2Effect::clone() const {
+    auto effect = std::make_unique<Lv2Effect>(m_plugin, m_name, m_param_rate);
+    copy_state_to(*effect);
+    return effect;
+}
+
+// freeing an instance can close its library, which the world keeps track of
+void Lv2Effect::release() {
+    if (m_instances.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(Lv2World::get().get_mutex());
+    for (LilvInstance* instance : m_instances) {
+        lilv_instance_deactivate(instance);
+        lilv_instance_free(instance);
+    }
+    m_instances.clear();
+}
+
+bool Lv2Effect::add_instance(int i) {
+    Lv2World& lv2 = Lv2World::get();
+    LilvInstance* instance;
+    {
+        std::lock_guard<std::mutex> lock(lv2.get_mutex());
+        instance = lilv_plugin_instantiate(m_plugin->get_plugin(), m_sample_rate, lv2.get_features());
+    }
+    if (!instance)
+        return false;
+    m_instances.push_back(instance);
+
+    // optional ports stay unconnected
+    for (uint32_t port = 0; port < m_plugin->get_num_ports(); port++)
+        lilv_instance_connect_port(instance, port, nullptr);
+    connect_ports(i, [&](uint32_t port, float* data) {
+        lilv_instance_connect_port(instance, port, data);
+    });
+    lilv_instance_activate(instance);
+    return true;
+}
+
+const char* Lv2Effect::get_unmet_requirement() const {
+    if (!m_plugin)
+        return "the plugin is not installed anymore";
+    return PluginEffect::get_unmet_requirement();
+}
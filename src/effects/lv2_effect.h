@@ -0,0 +1,84 @@
+#pragma once
+
+#include "plugin_effect.h"
+#include <lilv/lilv.h>
+#include <lv2/urid/urid.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// the lilv world plugins are instantiated from, loaded the first time an lv2 effect is made so
+// startup only reads the discovery cache, lilv isn't thread safe so every call into it that
+// isn't about a running instance holds the lock
+// hosts urid:map and urid:unmap, plugins that need anything else aren't offered
+class Lv2World {
+public:
+    // never freed, effects in the undo history can outlive any static
+    static Lv2World& get();
+
+    // a throwaway world with only the bundle loaded, for looking at what's new in it
+    static LilvWorld* load_bundle(const std::string& bundle_dir);
+
+    // usable as an effect, see LadspaPlugin::is_usable, and needs no features that aren't hosted
+    static bool is_usable(LilvWorld* world, const LilvPlugin* plugin);
+
+    LilvWorld* get_world() const { return m_world; }
+    std::mutex& get_mutex() { return m_mutex; }
+    const LV2_Feature* const* get_features() const { return m_features; }
+
+private:
+    Lv2World();
+
+    static LV2_URID map_uri(LV2_URID_Map_Handle handle, const char* uri);
+    static const char* unmap_uri(LV2_URID_Unmap_Handle handle, LV2_URID urid);
+
+    LilvWorld* m_world = nullptr;
+    std::mutex m_mutex;
+
+    // plugins map from any thread, unmapped strings stay where they are for the plugins to keep
+    std::mutex m_urid_mutex;
+    std::map<std::string, LV2_URID> m_urids;
+    std::vector<std::unique_ptr<std::string>> m_uris; // by urid - 1
+    LV2_URID_Map m_map = {this, map_uri};
+    LV2_URID_Unmap m_unmap = {this, unmap_uri};
+    LV2_Feature m_map_feature = {LV2_URID__map, &m_map};
+    LV2_Feature m_unmap_feature = {LV2_URID__unmap, &m_unmap};
+    const LV2_Feature* m_features[3] = {&m_map_feature, &m_unmap_feature, nullptr};
+};
+
+// an lv2 plugin and its ports, shared by every instance of it
+class Lv2Plugin : public PluginPorts {
+public:
+    // null if the plugin isn't installed anymore or isn't usable as an effect
+    static std::shared_ptr<Lv2Plugin> load(const std::string& uri);
+
+    const LilvPlugin* get_plugin() const { return m_plugin; }
+
+private:
+    Lv2Plugin() {}
+
+    const LilvPlugin* m_plugin = nullptr; // owned by the world
+};
+
+// runs an lv2 plugin as an effect
+class Lv2Effect : public PluginEffect {
+public:
+    // a null plugin makes an effect that only reports it couldn't be loaded
+    Lv2Effect(std::shared_ptr<Lv2Plugin> plugin, const std::string& name, int sample_rate);
+    ~Lv2Effect() override;
+
+    std::unique_ptr<Effect> clone() const override;
+    const char* get_unmet_requirement() const override;
+
+protected:
+    bool add_instance(int i) override;
+    int get_num_instances() const override { return (int) m_instances.size(); }
+    void run_instance(int i, int num_frames) override { lilv_instance_run(m_instances[i], num_frames); }
+    void release() override;
+
+private:
+    std::shared_ptr<Lv2Plugin> m_plugin;
+    std::vector<LilvInstance*> m_instances;
+};
@@ -0,0 +1,164 @@
+#include "noise_reduction.h"
+
+#include "../audio_buffer.h"
+#include "../parallel.h"
+#include <math.h>
+#include <algorithm>
+
+static std::shared_ptr<const NoiseProfile> current_profile;
+
+void set_noise_profile(std::shared_ptr<const NoiseProfile> profile) {
+    current_profile = std::move(profile);
+}
+
+std::shared_ptr<const NoiseProfile> get_noise_profile() {
+    return current_profile;
+}
+
+int get_noise_fft_size(int sample_rate) {
+    int size = 256;
+    while (size < sample_rate / 22)
+        size *= 2;
+    return size;
+}
+
+std::shared_ptr<const NoiseProfile> NoiseProfile::capture(const AudioBuffer& buffer, int64_t start, int64_t end) {
+    int fft_size = get_noise_fft_size(buffer.get_sample_rate());
+    int hop = fft_size / 4;
+    int num_channels = buffer.get_num_channels();
+    int num_bins = fft_size / 2 + 1;
+
+    end = std::min(end, buffer.get_num_frames());
+    if (end - start < fft_size)
+        return nullptr;
+
+    int64_t num_frames = (end - start - fft_size) / hop + 1;
+    int64_t num_tasks = std::min(num_frames, (int64_t) get_num_worker_threads() * 4);
+    int64_t frames_per_task = (num_frames + num_tasks - 1) / num_tasks;
+
+    std::vector<float> window = make_hann_window(fft_size);
+    const float* samples = buffer.get_samples().data();
+
+    // summed per task in double, so long captures don't lose the quiet bins
+    std::vector<std::vector<double>> sums(num_tasks, std::vector<double>(num_channels * num_bins, 0.0));
+    parallel_for(num_tasks, [&](int64_t task) {
+        RealFFT fft;
+        fft.init(fft_size);
+        std::vector<float> frame(fft_size);
+        std::vector<std::complex<float>> bins(num_bins);
+        double* sum = sums[task].data();
+
+        int64_t last = std::min(num_frames, (task + 1) * frames_per_task);
+        for (int64_t f = task * frames_per_task; f < last; f++) {
+            const float* in = samples + (start + f * hop) * num_channels;
+            for (int c = 0; c < num_channels; c++) {
+                for (int i = 0; i < fft_size; i++)
+                    frame[i] = in[i * num_channels + c] * window[i];
+                fft.forward(frame.data(), bins.data());
+                for (int k = 0; k < num_bins; k++)
+                    sum[c * num_bins + k] += std::norm(bins[k]);
+            }
+        }
+    });
+
+    auto profile = std::make_shared<NoiseProfile>();
+    profile->fft_size = fft_size;
+    profile->sample_rate = buffer.get_sample_rate();
+    profile->num_channels = num_channels;
+    for (int c = 0; c < num_channels; c++) {
+        profile->power[c].resize(num_bins);
+        for (int k = 0; k < num_bins; k++) {
+            double total = 0;
+            for (const std::vector<double>& sum : sums)
+                total += sum[c * num_bins + k];
+            profile->power[c][k] = (float) (total / num_frames);
+        }
+    }
+    return profile;
+}
+
+NoiseReductionEffect::NoiseReductionEffect() {
+    add_param(&m_reduction);
+    add_param(&m_threshold);
+    add_param(&m_release);
+    add_param(&m_smoothing);
+
+    m_profile = get_noise_profile();
+}
+
+const char* NoiseReductionEffect::get_unmet_requirement() const {
+    if (!m_profile)
+        return "no noise profile yet, select some background noise and use Capture Noise Profile first";
+    if (m_profile->sample_rate != m_sample_rate)
+        return "the noise profile was captured at a different sample rate, capture it again";
+    return nullptr;
+}
+
+void NoiseReductionEffect::reset() {
+    int fft_size = get_noise_fft_size(m_sample_rate);
+    for (int c = 0; c < m_num_channels; c++) {
+        m_stft[c].init(fft_size, fft_size / 4);
+        m_gain[c].assign(m_stft[c].get_num_bins(), 1.0f);
+    }
+    m_raw_gain.resize(fft_size / 2 + 1);
+}
+
+// the held gain decays by a constant factor a frame and never drops below the floor, so the
+// influence of anything before the warm-up is gone completely once the decay reaches the floor
+int NoiseReductionEffect::get_warmup_frames() const {
+    double floor = pow(10.0, -m_reduction.get() / 20.0);
+    double decay_frames = -log(floor) * m_release.get() * 0.001 * m_sample_rate;
+    return m_stft[0].get_fft_size() + (int) ceil(decay_frames) + m_stft[0].get_hop();
+}
+
+float NoiseReductionEffect::get_bin_gain(float power, float noise, float floor) const {
+    if (power <= noise)
+        return floor;
+    return std::max(floor, 1.0f - noise / power);
+}
+
+float SpectralGateEffect::get_bin_gain(float power, float noise, float floor) const {
+    return power > noise ? 1.0f : floor;
+}
+
+void NoiseReductionEffect::process_frame(int channel, std::complex<float>* bins) {
+    const std::vector<float>& noise = m_profile->power[std::min(channel, m_profile->num_channels - 1)];
+    int num_bins = (int) noise.size();
+
+    float floor = (float) pow(10.0, -m_reduction.get() / 20.0);
+    float threshold = (float) pow(10.0, m_threshold.get() / 10.0);
+    float decay = (float) exp(-m_stft[channel].get_hop() / (m_release.get() * 0.001 * m_sample_rate));
+    int radius = (int) (m_smoothing.get() + 0.5f);
+
+    for (int k = 0; k < num_bins; k++)
+        m_raw_gain[k] = get_bin_gain(std::norm(bins[k]), noise[k] * threshold, floor);
+
+    // averaging over neighbouring bins and holding the gain over frames keeps isolated bins
+    // from flickering in and out, the warbly "musical noise" of plain subtraction
+    std::vector<float>& held = m_gain[channel];
+    float sum = 0;
+    for (int k = 0; k < std::min(radius, num_bins); k++)
+        sum += m_raw_gain[k];
+    for (int k = 0; k < num_bins; k++) {
+        if (k + radius < num_bins)
+            sum += m_raw_gain[k + radius];
+        if (k - radius - 1 >= 0)
+            sum -= m_raw_gain[k - radius - 1];
+        int count = std::min(num_bins - 1, k + radius) - std::max(0, k - radius) + 1;
+
+        float gain = std::max(sum / count, held[k] * decay);
+        held[k] = gain;
+        bins[k] *= gain;
+    }
+}
+
+void NoiseReductionEffect::process(EffectBlock& block) {
+    if (!m_profile)
+        return;
+
+    for (int c = 0; c < block.num_channels; c++) {
+        m_stft[c].process(block.channels[c], block.num_frames, block.frame_pos, [this, c](std::complex<float>* bins) {
+            process_frame(c, bins);
+        });
+    }
+}
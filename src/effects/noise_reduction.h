@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../effect.h"
+#include "../stft.h"
+
+class AudioBuffer;
+
+// average power per fft bin of a stretch of background noise, what the noise reduction takes out
+struct NoiseProfile {
+    int fft_size = 0;
+    int sample_rate = 0;
+    int num_channels = 0;
+    std::vector<float> power[2];
+
+    // parallel over the frames, null if the region is shorter than one frame
+    static std::shared_ptr<const NoiseProfile> capture(const AudioBuffer& buffer, int64_t start, int64_t end);
+};
+
+// about 46ms at any sample rate, the same for capturing and reducing
+int get_noise_fft_size(int sample_rate);
+
+// the profile new effects pick up, gui thread only
+void set_noise_profile(std::shared_ptr<const NoiseProfile> profile);
+std::shared_ptr<const NoiseProfile> get_noise_profile();
+
+// wiener style subtraction of the captured noise profile, overlap-add stft with a quarter
+// frame hop, chunks rendered on their own agree with a single pass after the warm-up
+class NoiseReductionEffect : public Effect {
+public:
+    NoiseReductionEffect();
+
+    const char* get_name() const override { return "Noise Reduction"; }
+    std::unique_ptr<Effect> clone() const override { return clone_with_profile<NoiseReductionEffect>(); }
+    void process(EffectBlock& block) override;
+    void reset() override;
+    int get_warmup_frames() const override;
+    int get_latency_frames() const override { return m_stft[0].get_latency(); }
+    const char* get_unmet_requirement() const override;
+
+protected:
+    // gain of one bin before smoothing, noise is already scaled by the threshold
+    virtual float get_bin_gain(float power, float noise, float floor) const;
+
+    template <typename T>
+    std::unique_ptr<Effect> clone_with_profile() const {
+        // the profile has to be in place before prepare sizes the transforms
+        auto effect = std::make_unique<T>();
+        effect->m_profile = m_profile;
+        for (int i = 0; i < get_num_params(); i++)
+            effect->get_param(i).set(get_param(i).get());
+        effect->prepare(m_num_channels, m_sample_rate, m_region_start, m_region_end);
+        return effect;
+    }
+
+private:
+    void process_frame(int channel, std::complex<float>* bins);
+
+private:
+    EffectParam m_reduction{"Reduction", "dB", 0, 48, 12};
+    EffectParam m_threshold{"Threshold", "dB", -6, 18, 6};
+    EffectParam m_release{"Release", "ms", 10, 500, 100};
+    EffectParam m_smoothing{"Smoothing", "bins", 0, 8, 2};
+
+    std::shared_ptr<const NoiseProfile> m_profile;
+    StftProcessor m_stft[2];
+    std::vector<float> m_gain[2]; // per bin, held over from the previous frame
+    std::vector<float> m_raw_gain;
+};
+
+// the same with bins either passed or dropped to the floor, harsher but keeps more of the signal
+class SpectralGateEffect : public NoiseReductionEffect {
+public:
+    const char* get_name() const override { return "Spectral Gate"; }
+    std::unique_ptr<Effect> clone() const override { return clone_with_profile<SpectralGateEffect>(); }
+
+protected:
+    float get_bin_gain(float power, float noise, float floor) const override;
+};
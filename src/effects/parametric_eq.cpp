@@ -0,0 +1,138 @@
+#include "parametric_eq.h"
+
+#include <math.h>
+#include <thread>
+
+ParametricEqEffect::ParametricEqEffect() {
+    add_param(&m_high_pass);
+    add_param(&m_low_shelf_freq);
+    add_param(&m_low_shelf_gain);
+    for (int i = 0; i < num_peaks; i++) {
+        add_param(&m_peak_freq[i]);
+        add_param(&m_peak_gain[i]);
+        add_param(&m_peak_q[i]);
+    }
+    add_param(&m_high_shelf_freq);
+    add_param(&m_high_shelf_gain);
+    add_param(&m_low_pass);
+}
+
+void ParametricEqEffect::reset() {
+    m_cascade.init(num_bands, m_num_channels);
+
+    // force a coefficient update on the next block
+    m_cached_values.assign(get_num_params(), -1e9f);
+}
+
+bool ParametricEqEffect::update_bands() {
+    bool changed = false;
+    for (int i = 0; i < get_num_params(); i++) {
+        float value = get_param(i).get();
+        changed = changed || value != m_cached_values[i];
+        m_cached_values[i] = value;
+    }
+
+    if (!changed)
+        return false;
+
+    const double butterworth_q = 0.7071;
+    double nyquist = m_sample_rate * 0.5;
+
+    if (m_high_pass.get() <= m_high_pass.min)
+        m_bands[0].set_identity();
+    else
+        m_bands[0].set(Biquad::Type::HIGH_PASS, m_sample_rate, m_high_pass.get(), 0, butterworth_q);
+
+    m_bands[1].set(Biquad::Type::LOW_SHELF, m_sample_rate, m_low_shelf_freq.get(), m_low_shelf_gain.get(), butterworth_q);
+    for (int i = 0; i < num_peaks; i++)
+        m_bands[2 + i].set(Biquad::Type::PEAK, m_sample_rate, m_peak_freq[i].get(), m_peak_gain[i].get(), m_peak_q[i].get());
+    m_bands[6].set(Biquad::Type::HIGH_SHELF, m_sample_rate, m_high_shelf_freq.get(), m_high_shelf_gain.get(), butterworth_q);
+
+    if (m_low_pass.get() >= m_low_pass.max || m_low_pass.get() >= nyquist * 0.9)
+        m_bands[7].set_identity();
+    else
+        m_bands[7].set(Biquad::Type::LOW_PASS, m_sample_rate, m_low_pass.get(), 0, butterworth_q);
+
+    return true;
+}
+
+void ParametricEqEffect::process(EffectBlock& block) {
+    if (update_bands()) {
+        for (int b = 0; b < num_bands; b++)
+            m_cascade.set(b, m_bands[b]);
+    }
+
+    m_cascade.process(block.channels, block.num_frames);
+}
+
+void LinearPhaseEqEffect::reset() {
+    ParametricEqEffect::reset();
+
+    // at least 1/12s of taps either side, enough to resolve the low shelf
+    int half = 1024;
+    while (half < m_sample_rate / 12)
+        half *= 2;
+
+    for (FirKernel& kernel : m_kernels)
+        kernel.init(2 * half - 1);
+    for (int c = 0; c < m_num_channels; c++)
+        m_state[c].init(m_kernels[0]);
+
+    m_design_fft.init(m_kernels[0].get_fft_size());
+    m_response.resize(m_kernels[0].get_fft_size() / 2 + 1);
+    m_impulse.resize(m_kernels[0].get_fft_size());
+    m_taps.resize(m_kernels[0].get_max_taps());
+
+    // not on the audio thread either, so renders start out with the kernel for their parameters
+    update_bands();
+    design_kernel(m_kernels[0]);
+    m_kernel = &m_kernels[0];
+}
+
+void LinearPhaseEqEffect::params_changed() {
+    if (!update_bands())
+        return;
+
+    FirKernel* spare = m_kernel == &m_kernels[0] ? &m_kernels[1] : &m_kernels[0];
+    design_kernel(*spare);
+    m_kernel = spare;
+
+    // a block that started before the swap may still read the old kernel, the next design
+    // goes into it
+    while (m_processing)
+        std::this_thread::yield();
+}
+
+// samples the cascade's magnitude response, takes it back to a zero phase impulse and windows
+// that down to the kernel length, centered so the delay is exactly half the kernel
+void LinearPhaseEqEffect::design_kernel(FirKernel& kernel) {
+    int fft_size = m_design_fft.get_size();
+    for (int k = 0; k <= fft_size / 2; k++) {
+        double w = 2.0 * M_PI * k / fft_size;
+        double magnitude = 1.0;
+        for (int b = 0; b < num_bands; b++)
+            magnitude *= m_bands[b].get_magnitude(w);
+        m_response[k] = (float) magnitude;
+    }
+    m_design_fft.inverse(m_response.data(), m_impulse.data());
+
+    int half = kernel.get_max_taps() / 2;
+    for (int i = -half; i <= half; i++) {
+        double x = i / (double) (half + 1);
+        double window = 0.42 + 0.5 * cos(M_PI * x) + 0.08 * cos(2 * M_PI * x);
+        m_taps[half + i] = (float) (m_impulse[(i + fft_size) % fft_size] * window);
+    }
+
+    kernel.set(m_taps.data(), (int) m_taps.size());
+}
+
+void LinearPhaseEqEffect::process(EffectBlock& block) {
+    m_processing = true;
+
+    // both kernels are the same size, the filter state works with either
+    FirKernel* kernel = m_kernel;
+    for (int c = 0; c < block.num_channels; c++)
+        m_state[c].process(*kernel, block.channels[c], block.num_frames);
+
+    m_processing = false;
+}
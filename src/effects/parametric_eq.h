@@ -0,0 +1,86 @@
+#pragma once
+
+#include "../effect.h"
+#include "../biquad.h"
+#include "../fir_filter.h"
+
+// high pass, low shelf, four peaks, high shelf and low pass, run as one vectorized cascade
+class ParametricEqEffect : public Effect {
+public:
+    static const int num_bands = 8;
+
+    ParametricEqEffect();
+
+    const char* get_name() const override { return "Parametric EQ"; }
+    std::unique_ptr<Effect> clone() const override { return clone_as<ParametricEqEffect>(); }
+    void process(EffectBlock& block) override;
+    void reset() override;
+    int get_warmup_frames() const override { return m_sample_rate / 2; }
+
+protected:
+    // recomputes m_bands from the parameters, false if they haven't changed since the last call
+    bool update_bands();
+
+protected:
+    Biquad m_bands[num_bands];
+
+private:
+    static const int num_peaks = 4;
+
+    // the pass filters are off at the far end of their range
+    EffectParam m_high_pass{"High Pass", "Hz", 10, 1000, 10};
+    EffectParam m_low_shelf_freq{"Low Shelf", "Hz", 20, 1000, 100};
+    EffectParam m_low_shelf_gain{"Low Shelf Gain", "dB", -18, 18, 0};
+    EffectParam m_peak_freq[num_peaks] = {
+        {"Peak 1", "Hz", 20, 20000, 200},
+        {"Peak 2", "Hz", 20, 20000, 800},
+        {"Peak 3", "Hz", 20, 20000, 2500},
+        {"Peak 4", "Hz", 20, 20000, 6000},
+    };
+    EffectParam m_peak_gain[num_peaks] = {
+        {"Peak 1 Gain", "dB", -18, 18, 0},
+        {"Peak 2 Gain", "dB", -18, 18, 0},
+        {"Peak 3 Gain", "dB", -18, 18, 0},
+        {"Peak 4 Gain", "dB", -18, 18, 0},
+    };
+    EffectParam m_peak_q[num_peaks] = {
+        {"Peak 1 Q", "", 0.1f, 10, 1},
+        {"Peak 2 Q", "", 0.1f, 10, 1},
+        {"Peak 3 Q", "", 0.1f, 10, 1},
+        {"Peak 4 Q", "", 0.1f, 10, 1},
+    };
+    EffectParam m_high_shelf_freq{"High Shelf", "Hz", 1000, 20000, 8000};
+    EffectParam m_high_shelf_gain{"High Shelf Gain", "dB", -18, 18, 0};
+    EffectParam m_low_pass{"Low Pass", "Hz", 1000, 20000, 20000};
+
+    BiquadCascade m_cascade;
+    std::vector<float> m_cached_values;
+};
+
+// the same bands with the cascade's magnitude response but no phase shift, for mastering,
+// a long fir filter so the preview plays around a quarter of a second late
+// the kernel takes a couple of transforms to design, so that's done on the gui thread into the
+// kernel the audio thread isn't using, which is then published the way EffectChain slots are
+class LinearPhaseEqEffect : public ParametricEqEffect {
+public:
+    const char* get_name() const override { return "Linear Phase EQ"; }
+    std::unique_ptr<Effect> clone() const override { return clone_as<LinearPhaseEqEffect>(); }
+    void process(EffectBlock& block) override;
+    void reset() override;
+    void params_changed() override;
+    int get_warmup_frames() const override { return m_kernels[0].get_max_taps() + m_kernels[0].get_hop(); }
+    int get_latency_frames() const override { return m_kernels[0].get_hop() + m_kernels[0].get_max_taps() / 2; }
+
+private:
+    void design_kernel(FirKernel& kernel);
+
+private:
+    FirKernel m_kernels[2];
+    std::atomic<FirKernel*> m_kernel = nullptr; // the one process() uses
+    std::atomic<bool> m_processing = false;
+    FirFilterState m_state[2];
+    RealFFT m_design_fft;
+    std::vector<std::complex<float>> m_response;
+    std::vector<float> m_impulse;
+    std::vector<float> m_taps;
+};
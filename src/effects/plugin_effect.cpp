@@ -0,0 +1,107 @@
+#include "plugin_effect.h"
+
+#include <algorithm>
+
+static std::unique_ptr<EffectParam> make_param(const PluginControl& control, int sample_rate) {
+    float scale = control.per_rate ? (float) sample_rate : 1.0f;
+    float min = isnan(control.min) ? 0.0f : control.min * scale;
+    float max = isnan(control.max) ? min + 1.0f : control.max * scale;
+    if (control.toggled) {
+        min = 0;
+        max = 1;
+    }
+    if (max <= min)
+        max = min + 1.0f;
+
+    float value = isnan(control.default_value) ? min : control.default_value * (control.default_per_rate ? scale : 1.0f);
+    if (control.toggled || control.integer)
+        value = roundf(value);
+    value = std::max(min, std::min(max, value));
+
+    // the names live in the plugin, which outlives every effect made from it
+    return std::make_unique<EffectParam>(control.name.c_str(), control.per_rate ? "Hz" : "", min, max, value);
+}
+
+PluginEffect::PluginEffect(const PluginPorts* ports, const std::string& name, int sample_rate)
+    : m_name(name), m_param_rate(sample_rate), m_ports(ports) {
+    if (!m_ports)
+        return;
+
+    for (const PluginControl& control : m_ports->get_controls()) {
+        m_param_storage.push_back(make_param(control, sample_rate));
+        add_param(m_param_storage.back().get());
+    }
+
+    m_port_values.assign(m_ports->get_num_ports(), 0.0f);
+    for (int c = 0; c < 2; c++) {
+        m_inputs[c].assign(max_block, 0.0f);
+        m_outputs[c].assign(max_block, 0.0f);
+    }
+}
+
+void PluginEffect::copy_state_to(PluginEffect& effect) const {
+    for (int i = 0; i < get_num_params(); i++)
+        effect.get_param(i).set(get_param(i).get());
+    effect.prepare(m_num_channels, m_sample_rate, m_region_start, m_region_end);
+}
+
+// instantiates the plugin again at the prepared rate, there is no other way to clear its state
+void PluginEffect::reset() {
+    release();
+    if (!m_ports)
+        return;
+
+    int num_instances = m_ports->get_inputs().size() == 1 ? m_num_channels : 1;
+    for (int i = 0; i < num_instances; i++) {
+        if (!add_instance(i)) {
+            release();
+            return;
+        }
+    }
+}
+
+const char* PluginEffect::get_unmet_requirement() const {
+    if (get_num_instances() == 0)
+        return "the plugin could not be instantiated";
+    return nullptr;
+}
+
+void PluginEffect::process(EffectBlock& block) {
+    int num_instances = get_num_instances();
+    if (num_instances == 0)
+        return;
+
+    const std::vector<PluginControl>& controls = m_ports->get_controls();
+    for (size_t i = 0; i < controls.size(); i++)
+        m_port_values[controls[i].port] = m_param_storage[i]->get();
+
+    bool stereo_plugin = m_ports->get_inputs().size() == 2;
+    for (int offset = 0; offset < block.num_frames; offset += max_block) {
+        int count = std::min(max_block, block.num_frames - offset);
+
+        if (!stereo_plugin) {
+            for (int c = 0; c < block.num_channels && c < num_instances; c++) {
+                float* channel = block.channels[c] + offset;
+                std::copy(channel, channel + count, m_inputs[c].begin());
+                run_instance(c, count);
+                std::copy(m_outputs[c].begin(), m_outputs[c].begin() + count, channel);
+            }
+            continue;
+        }
+
+        // a mono buffer goes into both inputs and comes back as the average of both outputs
+        for (int c = 0; c < 2; c++) {
+            const float* channel = block.channels[std::min(c, block.num_channels - 1)] + offset;
+            std::copy(channel, channel + count, m_inputs[c].begin());
+        }
+        run_instance(0, count);
+
+        if (block.num_channels == 2) {
+            for (int c = 0; c < 2; c++)
+                std::copy(m_outputs[c].begin(), m_outputs[c].begin() + count, block.channels[c] + offset);
+        } else {
+            for (int i = 0; i < count; i++)
+                block.channels[0][offset + i] = (m_outputs[0][i] + m_outputs[1][i]) * 0.5f;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "../effect.h"
+#include <math.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// a control input of a plugin as it describes it, what's left out is nan
+struct PluginControl {
+    uint32_t port;
+    std::string name;
+    float min = NAN, max = NAN, default_value = NAN;
+    bool per_rate = false; // the bounds are fractions of the sample rate, shown in hz
+    bool default_per_rate = false; // the default is one as well
+    bool toggled = false;
+    bool integer = false;
+};
+
+// the ports of a plugin that effects connect, shared by every instance of it
+class PluginPorts {
+public:
+    uint32_t get_num_ports() const { return m_num_ports; }
+    const std::vector<PluginControl>& get_controls() const { return m_controls; }
+    const std::vector<uint32_t>& get_control_outputs() const { return m_control_outputs; }
+    const std::vector<uint32_t>& get_inputs() const { return m_inputs; }
+    const std::vector<uint32_t>& get_outputs() const { return m_outputs; }
+
+protected:
+    uint32_t m_num_ports = 0;
+    std::vector<PluginControl> m_controls;
+    std::vector<uint32_t> m_control_outputs;
+    std::vector<uint32_t> m_inputs, m_outputs;
+};
+
+// runs a ladspa or lv2 plugin as an effect, mono plugins get an instance per channel, a stereo
+// plugin one for both, the formats only differ in how instances are made, connected and run
+// every clone instantiates the plugin again, so each chunk of a parallel render has its own
+class PluginEffect : public Effect {
+public:
+    const char* get_name() const override { return m_name.c_str(); }
+    void process(EffectBlock& block) override;
+    void reset() override;
+    const char* get_unmet_requirement() const override;
+
+    // plugins don't say how far back their state reaches, this settles filters and short delays
+    int get_warmup_frames() const override { return m_sample_rate / 2; }
+
+protected:
+    static constexpr int max_block = 1024;
+
+    // null ports make an effect that only reports the plugin couldn't be loaded, per rate
+    // parameters are shown in hz at sample_rate, the one of the document the effect is made for
+    PluginEffect(const PluginPorts* ports, const std::string& name, int sample_rate);
+
+    // instance i of the ones reset() makes, connected with connect_ports() and activated
+    virtual bool add_instance(int i) = 0;
+    virtual int get_num_instances() const = 0;
+    virtual void run_instance(int i, int num_frames) = 0;
+    // every instance, derived effects call it from their destructor as well
+    virtual void release() = 0;
+
+    // control outputs get written too, nothing reads them
+    template <typename Connect>
+    void connect_ports(int instance, Connect connect) {
+        for (const PluginControl& control : m_ports->get_controls())
+            connect(control.port, &m_port_values[control.port]);
+        for (uint32_t port : m_ports->get_control_outputs())
+            connect(port, &m_port_values[port]);
+
+        // mono plugins get a channel per instance, stereo ones both
+        const std::vector<uint32_t>& inputs = m_ports->get_inputs();
+        const std::vector<uint32_t>& outputs = m_ports->get_outputs();
+        for (size_t k = 0; k < inputs.size(); k++) {
+            connect(inputs[k], m_inputs[instance + k].data());
+            connect(outputs[k], m_outputs[instance + k].data());
+        }
+    }
+
+    // the parameter values and the preparation, for clone()
+    void copy_state_to(PluginEffect& effect) const;
+
+    std::string m_name;
+    int m_param_rate; // what the parameters were made for, clones get the same ones
+
+private:
+    const PluginPorts* m_ports;
+    std::vector<std::unique_ptr<EffectParam>> m_param_storage;
+    std::vector<float> m_port_values; // control ports of every instance, indexed by port
+    std::vector<float> m_inputs[2], m_outputs[2];
+};
@@ -0,0 +1,17 @@
+#include "silence.h"
+
+#include <string.h>
+#include <math.h>
+
+SilenceEffect::SilenceEffect() {
+    add_param(&m_duration);
+}
+
+int64_t SilenceEffect::get_generated_frames() const {
+    return (int64_t) llround(m_duration.get() * (double) m_sample_rate);
+}
+
+void SilenceEffect::process(EffectBlock& block) {
+    for (int c = 0; c < block.num_channels; c++)
+        memset(block.channels[c], 0, block.num_frames * sizeof(float));
+}
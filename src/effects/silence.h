@@ -0,0 +1,19 @@
+#pragma once
+
+#include "../effect.h"
+
+// generator, inserts the given amount of silence
+class SilenceEffect : public Effect {
+public:
+    SilenceEffect();
+
+    const char* get_name() const override { return "Insert Silence"; }
+    std::unique_ptr<Effect> clone() const override { return clone_as<SilenceEffect>(); }
+    void process(EffectBlock& block) override;
+
+    bool is_generator() const override { return true; }
+    int64_t get_generated_frames() const override;
+
+private:
+    EffectParam m_duration{"Duration", "s", 0.01f, 60, 1};
+};
@@ -0,0 +1,44 @@
+#include "energy_index.h"
+
+#include "audio_buffer.h"
+#include "parallel.h"
+#include "simd.h"
+#include <algorithm>
+
+static const int64_t hops_per_task = 4096;
+
+void EnergyIndex::build(const AudioBuffer& buffer) {
+    int num_channels = buffer.get_num_channels();
+    m_num_frames = buffer.get_num_frames();
+    m_sample_rate = buffer.get_sample_rate();
+
+    int64_t num_hops = (m_num_frames + hop_frames - 1) / hop_frames;
+    m_mean_square.resize(num_hops);
+    const float* samples = buffer.get_samples().data();
+
+    // frames are interleaved, so a hop of all channels is one run of samples
+    parallel_for((num_hops + hops_per_task - 1) / hops_per_task, [&](int64_t task) {
+        int64_t first = task * hops_per_task;
+        int64_t last = std::min(num_hops, first + hops_per_task);
+        for (int64_t hop = first; hop < last; hop++) {
+            int64_t start = hop * hop_frames;
+            int count = (int) (std::min(m_num_frames, start + hop_frames) - start);
+            m_mean_square[hop] = (float) (sum_squares(samples + start * num_channels, count * num_channels) / (count * num_channels));
+        }
+    });
+
+    m_prefix.resize(num_hops + 1);
+    m_prefix[0] = 0;
+    for (int64_t hop = 0; hop < num_hops; hop++)
+        m_prefix[hop + 1] = m_prefix[hop] + m_mean_square[hop];
+
+    m_valid = true;
+}
+
+double EnergyIndex::get_mean_square(int64_t start, int64_t end) const {
+    start = std::max((int64_t) 0, start);
+    end = std::min(get_num_hops(), end);
+    if (start >= end)
+        return 0;
+    return (m_prefix[end] - m_prefix[start]) / (end - start);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+class AudioBuffer;
+
+// mean square of the buffer over short hops, averaged over the channels, kept with its running
+// sum so analyses over long recordings never have to go back to the samples
+class EnergyIndex {
+public:
+    static const int hop_frames = 256;
+
+    // parallel, about a fifth of a second for an hour of stereo per core
+    void build(const AudioBuffer& buffer);
+    void invalidate() { m_valid = false; }
+    bool is_valid() const { return m_valid; }
+
+    int64_t get_num_hops() const { return (int64_t) m_mean_square.size(); }
+    int64_t get_num_frames() const { return m_num_frames; }
+    int get_sample_rate() const { return m_sample_rate; }
+    float get_hop(int64_t hop) const { return m_mean_square[hop]; }
+
+    // mean square over hops [start, end), clamped to the index
+    double get_mean_square(int64_t start, int64_t end) const;
+
+    int64_t get_hop_frame(int64_t hop) const { return hop * hop_frames; }
+    int64_t seconds_to_hops(double seconds) const { return (int64_t) (seconds * m_sample_rate / hop_frames + 0.5); }
+
+private:
+    bool m_valid = false;
+    int64_t m_num_frames = 0;
+    int m_sample_rate = 0;
+    std::vector<float> m_mean_square;
+    std::vector<double> m_prefix; // sum of the hops before each one
+};
@@ -0,0 +1,61 @@
+#include "fft.h"
+
+#include <QtGlobal>
+#include <string.h>
+
+extern "C" {
+#include <libavutil/tx.h>
+#include <libavutil/mem.h>
+}
+
+RealFFT::~RealFFT() {
+    free();
+}
+
+void RealFFT::free() {
+    av_tx_uninit(&m_forward);
+    av_tx_uninit(&m_inverse);
+    av_freep(&m_real);
+    av_freep(&m_complex);
+    m_size = 0;
+}
+
+bool RealFFT::init(int size) {
+    Q_ASSERT(size >= 4 && (size & (size - 1)) == 0);
+
+    free();
+
+    float forward_scale = 1.0f;
+    float inverse_scale = 1.0f / size;
+    if (av_tx_init(&m_forward, &m_forward_fn, AV_TX_FLOAT_RDFT, 0, size, &forward_scale, 0) < 0 ||
+        av_tx_init(&m_inverse, &m_inverse_fn, AV_TX_FLOAT_RDFT, 1, size, &inverse_scale, 0) < 0) {
+        free();
+        return false;
+    }
+
+    m_real = (float*) av_malloc(size * sizeof(float));
+    m_complex = (std::complex<float>*) av_malloc((size / 2 + 1) * sizeof(std::complex<float>));
+    if (!m_real || !m_complex) {
+        free();
+        return false;
+    }
+
+    m_size = size;
+    return true;
+}
+
+void RealFFT::forward(const float* in, std::complex<float>* out) {
+    Q_ASSERT(m_size > 0);
+    memcpy(m_real, in, m_size * sizeof(float));
+    m_forward_fn(m_forward, m_complex, m_real, sizeof(float));
+    memcpy(out, m_complex, (m_size / 2 + 1) * sizeof(std::complex<float>));
+}
+
+void RealFFT::inverse(const std::complex<float>* in, float* out) {
+    Q_ASSERT(m_size > 0);
+
+    // the inverse transform overwrites its input
+    memcpy(m_complex, in, (m_size / 2 + 1) * sizeof(std::complex<float>));
+    m_inverse_fn(m_inverse, m_real, m_complex, sizeof(std::complex<float>));
+    memcpy(out, m_real, m_size * sizeof(float));
+}
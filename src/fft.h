@@ -0,0 +1,38 @@
+#pragma once
+
+#include <complex>
+#include <stddef.h>
+
+struct AVTXContext;
+
+// real fft of a fixed power of two size, backed by libavutil's tx
+// owns aligned buffers, so the caller's arrays don't need any particular alignment
+class RealFFT {
+public:
+    RealFFT() {}
+    ~RealFFT();
+    RealFFT(const RealFFT&) = delete;
+    RealFFT& operator=(const RealFFT&) = delete;
+
+    // allocates, returns false if the transform can't be set up
+    bool init(int size);
+    int get_size() const { return m_size; }
+
+    // size real samples to size / 2 + 1 bins
+    void forward(const float* in, std::complex<float>* out);
+
+    // size / 2 + 1 bins back to size real samples, scaled so that forward then inverse is the identity
+    void inverse(const std::complex<float>* in, float* out);
+
+private:
+    void free();
+
+private:
+    int m_size = 0;
+    AVTXContext* m_forward = nullptr;
+    AVTXContext* m_inverse = nullptr;
+    void (*m_forward_fn)(AVTXContext*, void*, void*, ptrdiff_t) = nullptr;
+    void (*m_inverse_fn)(AVTXContext*, void*, void*, ptrdiff_t) = nullptr;
+    float* m_real = nullptr;
+    std::complex<float>* m_complex = nullptr;
+};
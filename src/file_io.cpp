@@ -1,11 +1,17 @@
 #include "file_io.h"
 
 #include "app.h"
+#include "effects/dynamics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <iostream>
 #include <algorithm>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 // TODO: refactor error checking and reporting
 static void print_error_msg(int err) {
@@ -178,7 +184,30 @@ static void print_swr_current_values(SwrContext *swr) {
 }
 
 // TODO: refactor error checking and reporting
+int FileIO::get_format_for_path(const std::string& path) {
+	size_t dot = path.find_last_of('.');
+	std::string suffix = dot == std::string::npos ? "" : path.substr(dot + 1);
+	std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::tolower);
+
+	if (suffix == "wav")
+		return AV_CODEC_ID_PCM_S16LE;
+	if (suffix == "mp3")
+		return AV_CODEC_ID_MP3;
+	if (suffix == "ogg")
+		return AV_CODEC_ID_VORBIS;
+	return -1;
+}
+
 bool FileIO::write(const AudioBuffer& buffer, const std::string& path, int format) {
+	if (!limit_exports)
+		return write_samples(buffer, path, format);
+
+	AudioBuffer limited = buffer;
+	limit_to_ceiling(limited, export_ceiling_dbtp);
+	return write_samples(limited, path, format);
+}
+
+bool FileIO::write_samples(const AudioBuffer& buffer, const std::string& path, int format) {
 	int ret;
 
 	AVFormatContext* format_ctx = nullptr;
@@ -322,3 +351,13 @@ bool FileIO::write(const AudioBuffer& buffer, const std::string& path, int forma
 
 	return true;
 }
+
+bool sync_file(FILE* file) {
+	if (fflush(file) != 0)
+		return false;
+#if defined(_WIN32)
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
@@ -3,9 +3,23 @@
 #include "audio_buffer.h"
 
 #include <string>
+#include <stdio.h>
 
 class FileIO {
 public:
 	bool read(AudioBuffer& buffer, const std::string& path);
+	// runs the audio through the true peak limiter first when limit_exports is set
 	bool write(const AudioBuffer& buffer, const std::string& path, int format);
+
+	// codec id for the path's extension, -1 if it isn't one we can write
+	static int get_format_for_path(const std::string& path);
+
+	bool limit_exports = false;
+	double export_ceiling_dbtp = -1.0;
+
+private:
+	bool write_samples(const AudioBuffer& buffer, const std::string& path, int format);
 };
+
+// fflush only hands the data to the os, this waits until it's on the disk
+bool sync_file(FILE* file);
@@ -0,0 +1,98 @@
+#include "fir_filter.h"
+
+#include <QtGlobal>
+#include <algorithm>
+
+static int next_power_of_two(int n) {
+    int result = 1;
+    while (result < n)
+        result *= 2;
+    return result;
+}
+
+bool FirKernel::init(int max_taps) {
+    Q_ASSERT(max_taps > 0);
+
+    // at least as many new frames per transform as there are taps
+    int fft_size = next_power_of_two(std::max(2 * max_taps, 4));
+    if (!m_fft.init(fft_size))
+        return false;
+
+    m_max_taps = max_taps;
+    m_hop = fft_size - max_taps + 1;
+    m_spectrum.assign(fft_size / 2 + 1, 0.0f);
+    m_padded.assign(fft_size, 0.0f);
+    return true;
+}
+
+void FirKernel::set(const float* taps, int num_taps) {
+    Q_ASSERT(num_taps <= m_max_taps);
+
+    std::fill(m_padded.begin(), m_padded.end(), 0.0f);
+    std::copy(taps, taps + num_taps, m_padded.begin());
+    m_fft.forward(m_padded.data(), m_spectrum.data());
+}
+
+bool FirFilterState::init(const FirKernel& kernel) {
+    int fft_size = kernel.get_fft_size();
+    if (!m_fft.init(fft_size))
+        return false;
+
+    int hop = kernel.get_hop();
+    m_input.resize(hop);
+    m_output.resize(hop);
+    m_overlap.resize(fft_size - hop);
+    m_time.resize(fft_size);
+    m_bins.resize(fft_size / 2 + 1);
+    reset();
+    return true;
+}
+
+void FirFilterState::reset() {
+    m_fill = 0;
+    std::fill(m_input.begin(), m_input.end(), 0.0f);
+    std::fill(m_output.begin(), m_output.end(), 0.0f);
+    std::fill(m_overlap.begin(), m_overlap.end(), 0.0f);
+}
+
+void FirFilterState::process(const FirKernel& kernel, float* samples, int num_frames) {
+    int hop = (int) m_input.size();
+    while (num_frames > 0) {
+        int count = std::min(num_frames, hop - m_fill);
+
+        // swap the new frames in for the output of the last transform
+        for (int i = 0; i < count; i++) {
+            m_input[m_fill + i] = samples[i];
+            samples[i] = m_output[m_fill + i];
+        }
+
+        m_fill += count;
+        samples += count;
+        num_frames -= count;
+
+        if (m_fill == hop) {
+            run_transform(kernel);
+            m_fill = 0;
+        }
+    }
+}
+
+void FirFilterState::run_transform(const FirKernel& kernel) {
+    int fft_size = (int) m_time.size();
+    int hop = (int) m_input.size();
+    int tail = fft_size - hop;
+
+    std::copy(m_input.begin(), m_input.end(), m_time.begin());
+    std::fill(m_time.begin() + hop, m_time.end(), 0.0f);
+    m_fft.forward(m_time.data(), m_bins.data());
+
+    const std::complex<float>* spectrum = kernel.get_spectrum();
+    for (size_t i = 0; i < m_bins.size(); i++)
+        m_bins[i] *= spectrum[i];
+    m_fft.inverse(m_bins.data(), m_time.data());
+
+    // the first hop frames are done, the rest (never longer than a hop) overlaps the next transform
+    for (int i = 0; i < hop; i++)
+        m_output[i] = m_time[i] + (i < tail ? m_overlap[i] : 0.0f);
+    std::copy(m_time.begin() + hop, m_time.end(), m_overlap.begin());
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "fft.h"
+#include <vector>
+#include <complex>
+
+// a long fir filter applied by fft overlap-add, kept as its spectrum
+class FirKernel {
+public:
+    // allocates for kernels of up to max_taps, not for the audio thread
+    bool init(int max_taps);
+
+    // no allocation, num_taps can't be more than the max
+    void set(const float* taps, int num_taps);
+
+    int get_max_taps() const { return m_max_taps; }
+    int get_fft_size() const { return m_fft.get_size(); }
+
+    // frames that go into one transform, the filter output lags its input by this much
+    int get_hop() const { return m_hop; }
+
+    const std::complex<float>* get_spectrum() const { return m_spectrum.data(); }
+
+private:
+    RealFFT m_fft;
+    int m_max_taps = 0;
+    int m_hop = 0;
+    std::vector<std::complex<float>> m_spectrum;
+    std::vector<float> m_padded;
+};
+
+// overlap-add state for one channel
+class FirFilterState {
+public:
+    bool init(const FirKernel& kernel);
+    void reset();
+
+    // in place, delayed by the kernel's hop
+    void process(const FirKernel& kernel, float* samples, int num_frames);
+
+private:
+    void run_transform(const FirKernel& kernel);
+
+private:
+    RealFFT m_fft;
+    int m_fill = 0;
+    std::vector<float> m_input;   // hop frames being collected
+    std::vector<float> m_output;  // hop frames being handed out
+    std::vector<float> m_overlap; // tail of the previous transforms
+    std::vector<float> m_time;
+    std::vector<std::complex<float>> m_bins;
+};
@@ -5,15 +5,35 @@
 #include <QPainter>
 #include <QEvent>
 #include <QMouseEvent>
+#include <QGuiApplication>
+#include <QScreen>
 #include <algorithm>
 
 // how many pixels wide does a sample have to be to switch to graph mode?
 const double graph_pixel_threshold = 0.5;
 
+// how close in pixels the mouse has to get for a selection edge to snap
+const double snap_distance = 8;
+
+static double clamp_time(double time) {
+    return std::max(0.0, std::min(get_edited_duration(), time));
+}
+
 AudioWidget::AudioWidget(QWidget* parent) : QWidget{parent} {
     setMouseTracking(true);
     setAutoFillBackground(true);
     m_pixels_per_second = pow(1.5, m_zoom);
+
+    // the audio thread only publishes the play position, we poll it once per display frame
+    double refresh_rate = 60;
+    if (QGuiApplication::primaryScreen())
+        refresh_rate = QGuiApplication::primaryScreen()->refreshRate();
+
+    m_playhead_timer = new QTimer(this);
+    m_playhead_timer->setTimerType(Qt::PreciseTimer);
+    m_playhead_timer->setInterval((int) (1000.0 / std::max(refresh_rate, 1.0)));
+    connect(m_playhead_timer, &QTimer::timeout, this, &AudioWidget::on_playhead_timer);
+    m_playhead_timer->start();
 }
 
 void AudioWidget::select(double start, double end) {
@@ -47,6 +67,8 @@ void AudioWidget::paintEvent(QPaintEvent* event) {
 	painter.setRenderHint(QPainter::Antialiasing, false);
 	//painter.translate(0.5, 0.5);
 
+    m_unrendered_start = m_unrendered_end = 0;
+
     switch (m_view) {
     case ViewMode::OVERLAPPED:
         draw_single_view(painter);
@@ -57,6 +79,31 @@ void AudioWidget::paintEvent(QPaintEvent* event) {
     default:
         Q_ASSERT(false);
     }
+
+    // drawn as silence for now, on_playhead_timer draws them again once they're rendered
+    the_app.waveform.render_missing(m_unrendered_start, m_unrendered_end);
+}
+
+// at zoom levels finer than the waveform cache the samples are read directly, effects in the edit
+// list aren't rendered for it
+void AudioWidget::sample_amplitude(int channel, int64_t start, int64_t end, float& out_max, float& out_min) {
+    if (!the_app.non_destructive)
+        the_app.buffer.sample_amplitude(channel, start, end, out_max, out_min);
+    else if (!the_app.edits.sample_amplitude(channel, start, end, out_max, out_min, false))
+        add_unrendered(start, end);
+}
+
+float AudioWidget::single_sample(int64_t frame, int channel) {
+    return the_app.non_destructive ? the_app.edits.single_sample(frame, channel, false) : the_app.buffer.single_sample(frame, channel);
+}
+
+void AudioWidget::add_unrendered(int64_t start, int64_t end) {
+    if (m_unrendered_start < m_unrendered_end) {
+        start = std::min(start, m_unrendered_start);
+        end = std::max(end, m_unrendered_end);
+    }
+    m_unrendered_start = start;
+    m_unrendered_end = end;
 }
 
 void AudioWidget::draw_waveform_stereo(QPainter& painter, int x0, int x1, int y0, int y1) {
@@ -84,7 +131,7 @@ void AudioWidget::draw_waveform_stereo(QPainter& painter, int x0, int x1, int y0
 
     for (int x = x0; x < x1; x++) {
         double time = x / m_pixels_per_second + m_scroll_pos;
-        if (time < 0 || time >= the_app.buffer.get_duration())
+        if (time < 0 || time >= get_edited_duration())
             continue;
 
         int64_t start_frame = the_app.buffer.get_frame(time);
@@ -97,8 +144,8 @@ void AudioWidget::draw_waveform_stereo(QPainter& painter, int x0, int x1, int y0
 			waveform.sample(start_frame, end_frame, level_i, 0, left_min, left_max);
 			waveform.sample(start_frame, end_frame, level_i, 1, right_min, right_max);
 		} else {
-			the_app.buffer.sample_amplitude(0, start_frame, end_frame, left_max, left_min);
-			the_app.buffer.sample_amplitude(1, start_frame, end_frame, right_max, right_min);
+			sample_amplitude(0, start_frame, end_frame, left_max, left_min);
+			sample_amplitude(1, start_frame, end_frame, right_max, right_min);
 		}
 
 		int left_y0 = project_y(left_max, y0, y1);
@@ -140,7 +187,7 @@ void AudioWidget::draw_waveform_mono(int channel, QPainter& painter, int x0, int
 
     for (int x = x0; x < x1; x++) {
         double time = x / m_pixels_per_second + m_scroll_pos;
-        if (time < 0 || time >= the_app.buffer.get_duration())
+        if (time < 0 || time >= get_edited_duration())
             continue;
 
         int64_t start_frame = the_app.buffer.get_frame(time);
@@ -150,7 +197,7 @@ void AudioWidget::draw_waveform_mono(int channel, QPainter& painter, int x0, int
         if (level_i >= 0)
             waveform.sample(start_frame, end_frame, level_i, channel, min, max);
         else
-            the_app.buffer.sample_amplitude(channel, start_frame, end_frame, max, min);
+            sample_amplitude(channel, start_frame, end_frame, max, min);
 
         painter.setPen(color);
         painter.drawLine(x, project_y(max, y0, y1), x, project_y(min, y0, y1));
@@ -161,18 +208,25 @@ void AudioWidget::draw_waveform_graph(int channel, QPainter& painter, int x0, in
 	const AudioBuffer& buffer = the_app.buffer;
     double pixels_per_frame = m_pixels_per_second / buffer.get_sample_rate();
 
-	int64_t x0_frame = buffer.clamp_frame(buffer.get_frame(m_scroll_pos));
+	int64_t last_frame = get_edited_frames() - 1;
+	int64_t x0_frame = std::max((int64_t) 0, std::min(last_frame, buffer.get_frame(m_scroll_pos)));
 	double x1_time = (x1 - x0) / m_pixels_per_second + m_scroll_pos;
-	int64_t x1_frame = buffer.clamp_frame(buffer.get_frame(x1_time) + 2);
+	int64_t x1_frame = std::max((int64_t) 0, std::min(last_frame, buffer.get_frame(x1_time) + 2));
 
 	const int grabber_size = 10;
 
+	// single samples don't say if they were rendered, one read over all of them does
+	if (the_app.non_destructive) {
+		float max, min;
+		sample_amplitude(channel, x0_frame, x1_frame, max, min);
+	}
+
 	painter.setPen(color);
 	int prev_x = -1, prev_y = -1;
 	for (int64_t f = x0_frame; f < x1_frame; f++) {
 		double time = buffer.get_time(f);
         int x = (time - m_scroll_pos) * m_pixels_per_second;
-		int y = project_y(buffer.single_sample(f, channel), y0, y1);
+		int y = project_y(single_sample(f, channel), y0, y1);
 		
 		if (prev_y != -1)
 			painter.drawLine(prev_x, prev_y, x, y);
@@ -195,7 +249,7 @@ void AudioWidget::draw_single_view(QPainter& painter) {
     // draw start/end lines
     {
         int start_x = view_rect.left() + project_x(0);
-        int end_x   = view_rect.left() + project_x(the_app.buffer.get_duration());
+        int end_x   = view_rect.left() + project_x(get_edited_duration());
         painter.setPen(Qt::darkGray);
         painter.drawLine(start_x, view_rect.top(), start_x, view_rect.bottom());
         painter.drawLine(end_x, view_rect.top(), end_x, view_rect.bottom());
@@ -209,13 +263,7 @@ void AudioWidget::draw_single_view(QPainter& painter) {
     }
 
 
-    // draw playback line
-    if (the_app.interface.m_state != AudioInterface::State::IDLE) {
-        uint64_t pos = the_app.interface.m_frame_pos;
-        int x = (int) ((the_app.buffer.get_time(pos) - m_scroll_pos) * m_pixels_per_second);
-        painter.setPen(Qt::yellow);
-        painter.drawLine(view_rect.left() + x, view_rect.top(), view_rect.left() + x, view_rect.bottom());
-    }
+    draw_playhead(painter, view_rect);
 
     const AudioBuffer& buffer = the_app.buffer;
 	bool stereo = buffer.get_num_channels() == 2;
@@ -230,6 +278,8 @@ void AudioWidget::draw_single_view(QPainter& painter) {
 		draw_waveform_mono(0, painter, view_rect.left(), view_rect.right(), view_rect.top(), view_rect.bottom(), Qt::red);
 	}
 
+    draw_recording(0, painter, view_rect.top(), view_rect.bottom());
+
     // center line
     {
         painter.setPen(QColor(0, 0, 0, 30));
@@ -269,7 +319,7 @@ void AudioWidget::draw_split_view(QPainter& painter) {
     // draw start/end lines
     {
         int start_x = view_rect.left() + project_x(0);
-        int end_x   = view_rect.left() + project_x(the_app.buffer.get_duration());
+        int end_x   = view_rect.left() + project_x(get_edited_duration());
         painter.setPen(Qt::darkGray);
         painter.drawLine(start_x, view_rect.top(), start_x, view_rect.bottom());
         painter.drawLine(end_x, view_rect.top(), end_x, view_rect.bottom());
@@ -290,19 +340,17 @@ void AudioWidget::draw_split_view(QPainter& painter) {
 
     int channel_height = view_rect.height() / 2;
 
-    // draw playback line
-    if (the_app.interface.m_state != AudioInterface::State::IDLE) {
-        uint64_t pos = the_app.interface.m_frame_pos;
-        int x = (int) ((the_app.buffer.get_time(pos) - m_scroll_pos) * m_pixels_per_second);
-        painter.setPen(Qt::yellow);
-        painter.drawLine(view_rect.left() + x, view_rect.top(), view_rect.left() + x, view_rect.bottom());
-    }
+    draw_playhead(painter, view_rect);
 
     draw_waveform_mono(0, painter, view_rect.left(), view_rect.right(), view_rect.top(), view_rect.center().y(), Qt::red);
 
     if (the_app.buffer.get_num_channels() == 2)
         draw_waveform_mono(1, painter, view_rect.left(), view_rect.right(), view_rect.center().y(), view_rect.bottom(), Qt::green);
 
+    draw_recording(0, painter, view_rect.top(), view_rect.center().y());
+    if (the_app.buffer.get_num_channels() == 2)
+        draw_recording(1, painter, view_rect.center().y(), view_rect.bottom());
+
 	painter.setPen(Qt::white);
 	painter.drawText(5, 38, "Left");
 	painter.drawText(5, view_rect.center().y() + 16, "Right");
@@ -317,16 +365,75 @@ void AudioWidget::draw_split_view(QPainter& painter) {
     draw_timeline(painter, 0, m_timeline_height);
 }
 
-void AudioWidget::draw_timeline(QPainter& painter, int y0, int y1) {
-    painter.fillRect(0, y0, rect().width(), y1 - y0, Qt::darkBlue);
+void AudioWidget::draw_playhead(QPainter& painter, const QRect& view_rect) {
+    if (the_app.interface.m_state == AudioInterface::State::IDLE)
+        return;
 
-    const int max_tick_width = 30;
+    double pos = the_app.interface.get_playhead_frame();
+    int x = (int) ((pos / the_app.buffer.get_sample_rate() - m_scroll_pos) * m_pixels_per_second);
+    painter.setPen(Qt::yellow);
+    painter.drawLine(view_rect.left() + x, view_rect.top(), view_rect.left() + x, view_rect.bottom());
+}
 
-    int subdivision_count = (int) std::log2(max_tick_width / (float) m_pixels_per_second);
+// draws the take that is currently being recorded at its insert position
+void AudioWidget::draw_recording(int channel, QPainter& painter, int y0, int y1) {
+    if (the_app.interface.m_state != AudioInterface::State::RECORDING)
+        return;
+
+    const Recorder& recorder = the_app.interface.m_recorder;
+    const AudioBuffer& buffer = the_app.buffer;
+    double start_time = buffer.get_time(the_app.interface.m_record_pos);
+    double end_time = start_time + buffer.get_time(recorder.get_num_frames());
+
+    int x0 = std::max(0, (int) project_x(start_time));
+    int x1 = std::min(width(), (int) project_x(end_time));
+    int64_t frames_per_pixel = std::max((int64_t) 1, buffer.get_frame(1.0 / m_pixels_per_second));
+
+    painter.fillRect(x0, y0, x1 - x0, y1 - y0, QColor(255, 0, 0, 40));
+    painter.setPen(QColor(255, 120, 120));
+
+    for (int x = x0; x < x1; x++) {
+        double time = x / m_pixels_per_second + m_scroll_pos - start_time;
+        int64_t start_frame = buffer.get_frame(time);
+
+        float min, max;
+        if (!recorder.sample_peaks(channel, start_frame, start_frame + frames_per_pixel, min, max))
+            continue;
+
+        painter.drawLine(x, project_y(max, y0, y1), x, project_y(min, y0, y1));
+    }
+
+    painter.setPen(Qt::red);
+    painter.drawLine(x1, y0, x1, y1);
+}
+
+void AudioWidget::on_playhead_timer() {
+    bool playing = the_app.interface.m_state != AudioInterface::State::IDLE;
+
+    // repaint once more after playback stops to clear the playhead, or when the waveform has
+    // frames that were rendered since
+    bool rendered = the_app.waveform.poll_rendered();
+    if (playing || m_was_playing || rendered)
+        update();
+    the_app.snap_index.poll_built();
+
+    m_was_playing = playing;
+}
+
+void AudioWidget::draw_timeline(QPainter& painter, int y0, int y1) {
+    painter.fillRect(0, y0, rect().width(), y1 - y0, Qt::darkBlue);
 
     painter.setPen(Qt::white);
 
-    float mul = std::pow(2.0f, (float)subdivision_count);
+    if (m_show_beats) {
+        auto grid = the_app.beat_tracker.get_grid();
+        if (grid && grid->sample_rate == the_app.buffer.get_sample_rate()) {
+            draw_beat_timeline(painter, *grid, y0, y1);
+            return;
+        }
+    }
+
+    float mul = get_tick_interval();
     float tick_width = m_pixels_per_second * mul;
 
     int tick0 = m_scroll_pos * m_pixels_per_second / tick_width;
@@ -346,25 +453,64 @@ void AudioWidget::draw_timeline(QPainter& painter, int y0, int y1) {
     }
 }
 
+// bars of four counted from the first tracked beat, nothing knows where the downbeat really is
+void AudioWidget::draw_beat_timeline(QPainter& painter, const BeatGrid& grid, int y0, int y1) {
+    const int beats_per_bar = 4;
+    const int min_label_width = 30;
+    const int min_tick_width = 4;
+
+    const AudioBuffer& buffer = the_app.buffer;
+    double beat_width = 60.0 / grid.tempo * m_pixels_per_second;
+
+    // every beat gets a label when they're far enough apart, otherwise every power of two bars
+    int64_t label_step = beat_width >= min_label_width ? 1 : beats_per_bar;
+    while (label_step * beat_width < min_label_width)
+        label_step *= 2;
+
+    int64_t first_frame = buffer.get_frame(m_scroll_pos);
+    int64_t last_frame = buffer.get_frame(m_scroll_pos + width() / m_pixels_per_second);
+    auto it = std::lower_bound(grid.beats.begin(), grid.beats.end(), first_frame);
+    if (it != grid.beats.begin())
+        it--;
+
+    for (; it != grid.beats.end() && *it <= last_frame; it++) {
+        int64_t beat = it - grid.beats.begin();
+        bool labelled = beat % label_step == 0;
+        if (!labelled && beat_width < min_tick_width)
+            continue;
+
+        double x = project_x(buffer.get_time(*it));
+        bool bar = beat % beats_per_bar == 0;
+        painter.drawLine(x, bar ? y0 + (y1 - y0) / 2 : y1 - 3, x, y1 - 1);
+
+        if (labelled) {
+            QString label = label_step == 1 && !bar ? tr("%1.%2").arg(beat / beats_per_bar + 1).arg(beat % beats_per_bar + 1) : tr("%1").arg(beat / beats_per_bar + 1);
+            painter.drawText(QRectF(x + 3, y0, label_step * beat_width, y1 - y0), Qt::AlignLeft | Qt::AlignVCenter, label);
+        }
+    }
+}
+
 bool AudioWidget::event(QEvent* event) {
     if (event->type() == QEvent::MouseMove) {
         QMouseEvent* mouse = (QMouseEvent*) event;
 
         m_mouse_x = mouse->pos().x() - rect().left();
         m_mouse_pos = m_scroll_pos + m_mouse_x / m_pixels_per_second;
-		double clamped_mouse_pos = the_app.buffer.clamp_time(m_mouse_pos);
+		double clamped_mouse_pos = clamp_time(m_mouse_pos);
 
         if (m_state == State::SCROLLING) {
             m_scroll_pos = m_drag_start_scroll_pos - (m_mouse_x - m_drag_start_mouse_x) / m_pixels_per_second;
             update();
+        } else if (m_state == State::SCRUBBING) {
+            the_app.interface.scrub_to(the_app.buffer.get_frame(clamped_mouse_pos));
         } else if (m_state == State::SELECTING) {
-            m_selection_pos_b = clamped_mouse_pos;
+            m_selection_pos_b = snap_time(clamped_mouse_pos);
             update();
         } else if (m_state == State::RESIZE_REGION) {
             if (m_resizing_a)
-                m_selection_pos_a = clamped_mouse_pos;
+                m_selection_pos_a = snap_time(clamped_mouse_pos);
             else
-                m_selection_pos_b = clamped_mouse_pos;
+                m_selection_pos_b = snap_time(clamped_mouse_pos);
             update();
         } else {
             if (m_selection_state == SelectionState::REGION) {
@@ -393,7 +539,7 @@ bool AudioWidget::event(QEvent* event) {
     if (event->type() == QEvent::MouseButtonPress || event->type() == QEvent::MouseButtonRelease) {
         bool pressed = event->type() == QEvent::MouseButtonPress;
         QMouseEvent* mouse = (QMouseEvent*) event;
-		double clamped_mouse_pos = the_app.buffer.clamp_time(m_mouse_pos);
+		double clamped_mouse_pos = clamp_time(m_mouse_pos);
 
         if (mouse->button() == Qt::RightButton && pressed && m_state == State::IDLE) {
             m_state = State::SCROLLING;
@@ -401,11 +547,18 @@ bool AudioWidget::event(QEvent* event) {
             m_drag_start_mouse_x = mouse->pos().x() - rect().left();
         } else if (mouse->button() == Qt::RightButton && !pressed && m_state == State::SCROLLING) {
             m_state = State::IDLE;
+        } else if (mouse->button() == Qt::MiddleButton && pressed && m_state == State::IDLE) {
+            // drag with the middle button to scrub
+            m_state = State::SCRUBBING;
+            the_app.interface.scrub_begin(the_app.buffer.get_frame(clamped_mouse_pos));
+        } else if (mouse->button() == Qt::MiddleButton && !pressed && m_state == State::SCRUBBING) {
+            m_state = State::IDLE;
+            the_app.interface.scrub_end();
         } else if (mouse->button() == Qt::LeftButton && pressed && m_state == State::IDLE) {
             m_state = State::SELECTING;
             m_selection_state = SelectionState::REGION;
-            m_selection_pos_a = clamped_mouse_pos;
-            m_selection_pos_b = clamped_mouse_pos;
+            m_selection_pos_a = snap_time(clamped_mouse_pos);
+            m_selection_pos_b = m_selection_pos_a;
         } else if (mouse->button() == Qt::LeftButton && !pressed && m_state == State::SELECTING) {
             m_state = State::IDLE;
 
@@ -469,6 +622,67 @@ double AudioWidget::project_y(double amplitude, int y0, int y1) const {
     return y0 + (-amplitude + 1.0) / 2.0 * (double)(y1 - y0);
 }
 
+// seconds between timeline ticks, a power of two that keeps them apart at any zoom
+double AudioWidget::get_tick_interval() const {
+    const int max_tick_width = 30;
+
+    int subdivision_count = (int) std::log2(max_tick_width / (float) m_pixels_per_second);
+    return std::pow(2.0f, (float) subdivision_count);
+}
+
+// pulls a time onto the closest beat, transient or grid tick within reach, then onto the closest zero
+// crossing so a cut there doesn't click, holding shift places it freely
+double AudioWidget::snap_time(double time) {
+    const AudioBuffer& buffer = the_app.buffer;
+    if (get_edited_frames() == 0 || (QGuiApplication::keyboardModifiers() & Qt::ShiftModifier))
+        return time;
+
+    // the index needs the frames in one piece, the edit list doesn't have them that way, until
+    // its build in the background is done only the grid and the beats are snapped to
+    bool use_index = !the_app.non_destructive && the_app.snap_index.is_valid();
+    if (!the_app.non_destructive && !use_index && (m_snap.transients || m_snap.zero_crossings))
+        the_app.snap_index.start_build(buffer);
+
+    double reach = snap_distance / m_pixels_per_second;
+    int64_t reach_frames = buffer.get_frame(reach);
+    double best = time;
+    double best_distance = reach;
+
+    if (m_snap.grid) {
+        double interval = get_tick_interval();
+        double tick = clamp_time(round(time / interval) * interval);
+        if (fabs(tick - time) <= best_distance) {
+            best = tick;
+            best_distance = fabs(tick - time);
+        }
+    }
+
+    if (m_snap.beats) {
+        auto grid = the_app.beat_tracker.get_grid();
+        int64_t beat = grid && grid->sample_rate == buffer.get_sample_rate() ? grid->find_nearest(buffer.get_frame(time), reach_frames) : -1;
+        if (beat >= 0 && fabs(buffer.get_time(beat) - time) <= best_distance) {
+            best = buffer.get_time(beat);
+            best_distance = fabs(best - time);
+        }
+    }
+
+    if (m_snap.transients && use_index) {
+        int64_t transient = the_app.snap_index.find_nearest(SnapIndex::Kind::TRANSIENT, buffer.get_frame(time), reach_frames);
+        if (transient >= 0 && fabs(buffer.get_time(transient) - time) <= best_distance) {
+            best = buffer.get_time(transient);
+            best_distance = fabs(best - time);
+        }
+    }
+
+    if (m_snap.zero_crossings && use_index) {
+        int64_t crossing = the_app.snap_index.find_nearest(SnapIndex::Kind::ZERO_CROSSING, buffer.get_frame(best), reach_frames);
+        if (crossing >= 0)
+            best = buffer.get_time(crossing);
+    }
+
+    return best;
+}
+
 void AudioWidget::set_zoom(double zoom) {
 	zoom = fmin(50, zoom);
 	zoom = fmax(0.001, zoom);
@@ -481,9 +695,9 @@ void AudioWidget::reset_view() {
 	const int margin = 50;
 
 	double zoom = 12;
-	if (the_app.buffer.get_num_frames() > 0) {
+	if (get_edited_frames() > 0) {
 		int pixel_width = rect().width() - margin * 2;
-		double duration = the_app.buffer.get_duration();
+		double duration = get_edited_duration();
 		zoom = log(pixel_width / duration) / log(1.5);
 	}
 	set_zoom(zoom);
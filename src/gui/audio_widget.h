@@ -1,6 +1,9 @@
 #pragma once
 
 #include <QWidget>
+#include <QTimer>
+
+struct BeatGrid;
 
 class AudioWidget : public QWidget {
     Q_OBJECT
@@ -11,6 +14,14 @@ public:
         SPECTRUM,
     };
 
+    // what selection edges are pulled onto while dragging
+    struct SnapOptions {
+        bool zero_crossings = false;
+        bool transients = false;
+        bool grid = false;
+        bool beats = false;
+    };
+
     explicit AudioWidget(QWidget *parent = nullptr);
 
     double get_mouse_pos() const { return m_mouse_pos; }
@@ -28,6 +39,7 @@ private:
         SELECTING,
         RESIZE_REGION,
         RESIZE_REGION_HOVER,
+        SCRUBBING,
     };
 
     enum class SelectionState {
@@ -40,12 +52,21 @@ private:
     void draw_waveform_stereo(QPainter& painter, int x0, int x1, int y0, int y1);
     void draw_waveform_mono(int channel, QPainter& painter, int x0, int x1, int y0, int y1, const QColor& color);
 	void draw_waveform_graph(int channel, QPainter& painter, int x0, int x1, int y0, int y1, const QColor& color);
+    void sample_amplitude(int channel, int64_t start, int64_t end, float& out_max, float& out_min);
+    float single_sample(int64_t frame, int channel);
+    void add_unrendered(int64_t start, int64_t end);
     void draw_single_view(QPainter& painter);
     void draw_split_view(QPainter& painter);
     void draw_timeline(QPainter& painter, int y0, int y1);
+    void draw_beat_timeline(QPainter& painter, const BeatGrid& grid, int y0, int y1);
+    void draw_playhead(QPainter& painter, const QRect& view_rect);
+    void draw_recording(int channel, QPainter& painter, int y0, int y1);
+    void on_playhead_timer();
     bool event(QEvent *event);
     double project_x(double time) const;
     double project_y(double amplitude, int y0, int y1) const;
+    double get_tick_interval() const;
+    double snap_time(double time);
 	void set_zoom(double zoom);
 	void reset_view();
 
@@ -64,6 +85,11 @@ private:
     ViewMode m_view = ViewMode::OVERLAPPED;
     int m_timeline_height = 20;
     double m_zoom = 12;
+    QTimer* m_playhead_timer;
+    bool m_was_playing = false;
+    SnapOptions m_snap;
+    bool m_show_beats = false; // the timeline counts bars and beats instead of seconds
+    int64_t m_unrendered_start = 0, m_unrendered_end = 0; // frames drawn as silence by this paint
 
     friend class MainWindow;
 };
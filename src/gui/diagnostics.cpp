@@ -0,0 +1,82 @@
+#include "diagnostics.h"
+
+#include "../app.h"
+#include <QVBoxLayout>
+#include <QPushButton>
+#include <QFontDatabase>
+#include <algorithm>
+
+Diagnostics::Diagnostics(QWidget* parent) : QDialog(parent) {
+    setWindowTitle(tr("Audio Diagnostics"));
+
+    m_text = new QLabel();
+    m_text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    m_text->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
+    QPushButton* reset_button = new QPushButton(tr("Reset"));
+    connect(reset_button, &QPushButton::clicked, this, [this]() {
+        the_app.interface.get_stats().reset();
+        refresh();
+    });
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addWidget(m_text);
+    layout->addWidget(reset_button);
+
+    m_timer = new QTimer(this);
+    connect(m_timer, &QTimer::timeout, this, &Diagnostics::refresh);
+    m_timer->start(250);
+
+    refresh();
+}
+
+void Diagnostics::refresh() {
+    const AudioStats& stats = the_app.interface.get_stats();
+    const AudioInterface::StreamConfig& config = the_app.interface.get_config();
+
+    QString text;
+    text += QString("audio backend:      %1\n").arg(the_app.interface.get_backend_name());
+    text += QString("frames per buffer:  %1\n").arg(config.frames_per_buffer == 0 ? QString("auto") : QString::number(config.frames_per_buffer));
+    text += QString("latency target:     %1\n").arg(config.latency < 0 ? QString("device default") : QString("%1 ms").arg(config.latency * 1000.0, 0, 'f', 1));
+    text += QString("stream latency:     %1 ms\n").arg(the_app.interface.get_stream_latency() * 1000.0, 0, 'f', 1);
+    text += QString("stream rate:        %1 Hz\n").arg(the_app.interface.get_stream_rate());
+    if (the_app.interface.is_resampling()) {
+        text += QString("resampler load:     %1% (%2 -> %3 Hz)\n")
+            .arg(stats.resampler_load.load() * 100.0, 0, 'f', 2)
+            .arg(the_app.buffer.get_sample_rate())
+            .arg(the_app.interface.get_stream_rate());
+    }
+    if (!the_app.interface.get_mixer().get_state()->tracks.empty()) {
+        text += QString("mixer load:         %1% (%2 tracks)\n")
+            .arg(stats.mixer_load.load() * 100.0, 0, 'f', 2)
+            .arg(the_app.interface.get_mixer().get_state()->tracks.size());
+    }
+    text += "\n";
+    text += QString("callbacks:          %1\n").arg(stats.num_callbacks.load());
+    text += QString("output underflows:  %1\n").arg(stats.output_underflows.load());
+    text += QString("output overflows:   %1\n").arg(stats.output_overflows.load());
+    text += QString("input underflows:   %1\n").arg(stats.input_underflows.load());
+    text += QString("input overflows:    %1\n").arg(stats.input_overflows.load());
+    text += QString("deadline misses:    %1\n").arg(stats.deadline_misses.load());
+    text += QString("meter drops:        %1\n").arg(the_app.interface.get_meter().get_num_dropped());
+    text += QString("callback load:      %1% (max %2%)\n")
+        .arg(stats.last_load.load() * 100.0, 0, 'f', 1)
+        .arg(stats.max_load.load() * 100.0, 0, 'f', 1);
+    text += "\n";
+
+    // histogram of callback time relative to the buffer duration
+    uint64_t peak = 1;
+    for (int i = 0; i < AudioStats::num_load_bins; i++)
+        peak = std::max(peak, stats.load_histogram[i].load());
+
+    const int bar_width = 40;
+    for (int i = 0; i < AudioStats::num_load_bins; i++) {
+        uint64_t count = stats.load_histogram[i].load();
+        int lo = (int) (i * AudioStats::load_bin_width * 100);
+        QString label = i == AudioStats::num_load_bins - 1 ? QString(">=%1%").arg(lo) : QString("%1-%2%").arg(lo).arg(lo + (int) (AudioStats::load_bin_width * 100));
+        int bar = (int) (count * bar_width / peak);
+        text += QString("%1 %2 %3\n").arg(label, 9).arg(QString(bar, QChar('#')), -bar_width).arg(count);
+    }
+
+    m_text->setText(text);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <QDialog>
+#include <QLabel>
+#include <QTimer>
+
+// live view of the audio callback counters, meant for tuning buffer size and latency
+class Diagnostics : public QDialog {
+    Q_OBJECT
+public:
+    explicit Diagnostics(QWidget* parent = nullptr);
+
+private:
+    void refresh();
+
+private:
+    QLabel* m_text;
+    QTimer* m_timer;
+};
@@ -0,0 +1,96 @@
+#include "effect_dialog.h"
+
+#include "../app.h"
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QDialogButtonBox>
+#include <math.h>
+
+static const int slider_steps = 1000;
+
+// frequencies feel more natural on a log scale
+static bool is_logarithmic(const EffectParam& param) {
+    return QString(param.unit) == "Hz" && param.min > 0;
+}
+
+static int param_to_slider(const EffectParam& param, float value) {
+    double t;
+    if (is_logarithmic(param))
+        t = log(value / param.min) / log(param.max / param.min);
+    else
+        t = (value - param.min) / (param.max - param.min);
+    return (int) round(t * slider_steps);
+}
+
+static float slider_to_param(const EffectParam& param, int pos) {
+    double t = pos / (double) slider_steps;
+    if (is_logarithmic(param))
+        return (float) (param.min * pow(param.max / param.min, t));
+    return (float) (param.min + t * (param.max - param.min));
+}
+
+EffectDialog::EffectDialog(Effect* effect, int64_t start, int64_t end, QWidget* parent)
+    : QDialog(parent), m_effect(effect), m_start(start), m_end(end) {
+    setWindowTitle(effect->get_name());
+
+    QFormLayout* form = new QFormLayout();
+    for (int i = 0; i < effect->get_num_params(); i++) {
+        EffectParam& param = effect->get_param(i);
+
+        QSlider* slider = new QSlider(Qt::Horizontal);
+        slider->setRange(0, slider_steps);
+        slider->setValue(param_to_slider(param, param.get()));
+        slider->setMinimumWidth(250);
+
+        QLabel* value_label = new QLabel();
+        value_label->setMinimumWidth(80);
+        m_value_labels.push_back(value_label);
+        update_value_label(i);
+
+        // the audio thread picks the new value up on its next block
+        connect(slider, &QSlider::valueChanged, this, [this, i](int pos) {
+            EffectParam& param = m_effect->get_param(i);
+            param.set(slider_to_param(param, pos));
+            m_effect->params_changed();
+            update_value_label(i);
+        });
+
+        QHBoxLayout* row = new QHBoxLayout();
+        row->addWidget(slider);
+        row->addWidget(value_label);
+        form->addRow(param.name, row);
+    }
+
+    QDialogButtonBox* buttons = new QDialogButtonBox();
+    m_preview_button = buttons->addButton(tr("Preview"), QDialogButtonBox::ActionRole);
+    buttons->addButton(tr("Apply"), QDialogButtonBox::AcceptRole);
+    buttons->addButton(QDialogButtonBox::Cancel);
+    connect(m_preview_button, &QPushButton::clicked, this, &EffectDialog::toggle_preview);
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addLayout(form);
+    layout->addWidget(buttons);
+
+    // generated audio doesn't exist until it's applied, so there's nothing to preview
+    if (effect->is_generator() || !the_app.interface.get_preview_chain().add(m_effect))
+        m_preview_button->setEnabled(false);
+}
+
+EffectDialog::~EffectDialog() {
+    the_app.interface.get_preview_chain().remove(m_effect);
+}
+
+void EffectDialog::toggle_preview() {
+    if (the_app.interface.get_state() == AudioInterface::State::IDLE)
+        the_app.interface.play(m_start, m_end);
+    else
+        the_app.interface.stop();
+}
+
+void EffectDialog::update_value_label(int param_i) {
+    const EffectParam& param = m_effect->get_param(param_i);
+    m_value_labels[param_i]->setText(QString("%1 %2").arg(param.get(), 0, 'f', 2).arg(param.unit));
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "../effect.h"
+#include <QDialog>
+#include <QPushButton>
+#include <QSlider>
+#include <QLabel>
+
+// edits the parameters of an effect while it runs in the playback preview chain,
+// accepting the dialog means the effect should be applied to the buffer
+class EffectDialog : public QDialog {
+    Q_OBJECT
+public:
+    EffectDialog(Effect* effect, int64_t start, int64_t end, QWidget* parent = nullptr);
+    ~EffectDialog();
+
+private:
+    void toggle_preview();
+    void update_value_label(int param_i);
+
+private:
+    Effect* m_effect;
+    int64_t m_start, m_end;
+    QPushButton* m_preview_button;
+    std::vector<QLabel*> m_value_labels;
+};
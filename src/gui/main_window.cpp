@@ -1,16 +1,38 @@
 #include "main_window.h"
 #include "ui_main_window.h"
 #include "audio_widget.h"
+#include "settings.h"
+#include "effect_dialog.h"
+#include "meter_widget.h"
+#include "normalize_dialog.h"
+#include "region_dialog.h"
+#include "stretch_dialog.h"
 #include "../app.h"
+#include "../effect_render.h"
+#include "../effect_registry.h"
+#include "../loudness.h"
+#include "../rate_convert.h"
+#include "../mixer.h"
+#include "../effects/noise_reduction.h"
+#include "../effects/convolution_reverb.h"
 
 #include <QFileDialog>
 #include <QComboBox>
+#include <QDoubleSpinBox>
+#include <QCheckBox>
 #include <QEvent>
 #include <QMimeData>
 #include <QDragEnterEvent>
 #include <QDropEvent>
 #include <QActionGroup>
 #include <QShortcut>
+#include <QDockWidget>
+#include <QInputDialog>
+#include <QApplication>
+#include <QSettings>
+#include <QMap>
+#include <QMessageBox>
+#include <QDateTime>
 
 MainWindow::MainWindow(QWidget* parent) :
     QMainWindow(parent), ui(new Ui::MainWindow) {
@@ -24,6 +46,21 @@ MainWindow::MainWindow(QWidget* parent) :
     m_mouse_info = new QLabel();
     ui->statusbar->addPermanentWidget(m_mouse_info);
     ui->statusbar->addPermanentWidget(m_file_info);
+
+    QDockWidget* meter_dock = new QDockWidget(tr("Meters"), this);
+    meter_dock->setObjectName("meterDock");
+    meter_dock->setWidget(new MeterWidget());
+    addDockWidget(Qt::RightDockWidgetArea, meter_dock);
+    ui->menuView->addAction(meter_dock->toggleViewAction());
+
+    // out of the way until there are tracks to mix
+    m_mixer_widget = new MixerWidget();
+    m_mixer_dock = new QDockWidget(tr("Mixer"), this);
+    m_mixer_dock->setObjectName("mixerDock");
+    m_mixer_dock->setWidget(m_mixer_widget);
+    addDockWidget(Qt::BottomDockWidgetArea, m_mixer_dock);
+    m_mixer_dock->hide();
+    ui->menuView->addAction(m_mixer_dock->toggleViewAction());
     ui->toolBar->addSeparator();
 
     {
@@ -48,6 +85,28 @@ MainWindow::MainWindow(QWidget* parent) :
         ui->toolBar->addWidget(output_device_box);
     }
 
+    ui->toolBar->addSeparator();
+
+    {
+        // playback speed, can be changed while playing
+        QDoubleSpinBox* speed_box = new QDoubleSpinBox();
+        speed_box->setRange(-4.0, 4.0);
+        speed_box->setSingleStep(0.05);
+        speed_box->setValue(1.0);
+        speed_box->setSuffix("x");
+        speed_box->setToolTip(tr("Playback speed, negative plays backwards"));
+        connect(speed_box, &QDoubleSpinBox::valueChanged, this, [](double speed) {
+            the_app.interface.set_speed(speed);
+        });
+        ui->toolBar->addWidget(speed_box);
+
+        QCheckBox* keep_pitch_box = new QCheckBox(tr("Keep Pitch"));
+        connect(keep_pitch_box, &QCheckBox::toggled, this, [](bool checked) {
+            the_app.interface.set_keep_pitch(checked);
+        });
+        ui->toolBar->addWidget(keep_pitch_box);
+    }
+
     QActionGroup* group = new QActionGroup(this);
     group->addAction(ui->actionViewSingle);
     group->addAction(ui->actionViewSplit);
@@ -56,6 +115,19 @@ MainWindow::MainWindow(QWidget* parent) :
 
     ui->actionViewSpectrogram->setEnabled(false);
 
+    build_effect_menus();
+
+    {
+        // toggling the actions hands the choice on to the audio widget
+        QSettings settings("AudioEditor", "AudioEditor");
+        ui->actionSnap_Zero_Crossings->setChecked(settings.value("snap/zero_crossings", false).toBool());
+        ui->actionSnap_Transients->setChecked(settings.value("snap/transients", false).toBool());
+        ui->actionSnap_Grid->setChecked(settings.value("snap/grid", false).toBool());
+        ui->actionSnap_Beats->setChecked(settings.value("snap/beats", false).toBool());
+        ui->actionShow_Beats->setChecked(settings.value("view/show_beats", false).toBool());
+        ui->actionNon_Destructive->setChecked(settings.value("edit/non_destructive", false).toBool());
+    }
+
 	QShortcut* switchViewShortcut = new QShortcut(QKeySequence("Tab"), this);
 	connect(switchViewShortcut, &QShortcut::activated, this, [this]() {
 		// TODO: refactor
@@ -73,22 +145,29 @@ MainWindow::MainWindow(QWidget* parent) :
 }
 
 MainWindow::~MainWindow() {
+    // its callback refers to this window
+    the_app.beat_tracker.cancel();
     delete ui;
 }
 
 void MainWindow::update_status_bar() {
-	double total_duration = the_app.buffer.get_duration();
+	double total_duration = get_edited_duration();
 	double mouse_time = m_audio_widget->get_mouse_pos();
-	int64_t total_frames = the_app.buffer.get_num_frames();
+	int64_t total_frames = get_edited_frames();
 	int64_t mouse_frame = mouse_time / total_duration * total_frames;
 	int sample_rate = the_app.buffer.get_sample_rate();
 	QString bit_depth_str = "32-bit float"; // TODO
 
+	QString tempo_str;
+	if (auto grid = the_app.beat_tracker.get_grid())
+		tempo_str = QString(" %1 BPM").arg(QString::number(grid->tempo, 'f', 1));
+
 	m_file_info->setText(
-        QString("%1s %2Hz %3")
+        QString("%1s %2Hz %3%4")
 		.arg(QString::number(total_duration, 'f', 2))
         .arg(sample_rate)
         .arg(bit_depth_str)
+        .arg(tempo_str)
 	);
 
     m_mouse_info->setText(QString("Time %1s")
@@ -98,15 +177,25 @@ void MainWindow::update_status_bar() {
 
 void MainWindow::on_actionNew_triggered() {
     the_app.buffer.init(2, 44100);
+    the_app.journal.record_new(2, 44100);
+    the_app.project = nullptr;
+    reset_layout();
+    if (the_app.non_destructive)
+        begin_edit_list();
     the_app.file_path = "";
     the_app.unsaved_changes = false;
+    the_app.snap_index.invalidate();
+    start_snap_index();
+    the_app.beat_tracker.clear();
+    the_app.interface.get_mixer().set_state(std::make_shared<MixerState>());
+    m_mixer_widget->rebuild();
     update_status_bar();
     update_title();
     m_audio_widget->update();
 }
 
 void MainWindow::on_actionOpen_triggered() {
-    QString path = QFileDialog::getOpenFileName(this, tr("Open"), the_app.last_dir, tr("Audio Files (*.wav *.mp3 *.ogg)"));
+    QString path = QFileDialog::getOpenFileName(this, tr("Open"), the_app.last_dir, tr("Audio Files (*.wav *.mp3 *.ogg);;AudioEditor Projects (*.aeproj)"));
     if (path == nullptr)
         return;
 
@@ -124,7 +213,7 @@ void MainWindow::on_actionSave_triggered() {
 }
 
 void MainWindow::on_actionSave_as_triggered() {
-    QString path = QFileDialog::getSaveFileName(this, tr("Save as"), the_app.last_dir, tr("Audio Files (*.wav *.mp3 *.ogg)"));
+    QString path = QFileDialog::getSaveFileName(this, tr("Save as"), the_app.last_dir, tr("Audio Files (*.wav *.mp3 *.ogg);;AudioEditor Projects (*.aeproj)"));
     if (path == nullptr)
         return;
 
@@ -153,8 +242,12 @@ void MainWindow::on_actionCut_triggered() {
 }
 
 void MainWindow::on_actionUndo_triggered() {
+    std::shared_ptr<const MixerState> tracks = the_app.interface.get_mixer().get_state();
     undo_state();
 
+    // undoing a sample rate change brings back the tracks it converted
+    if (the_app.interface.get_mixer().get_state() != tracks)
+        m_mixer_widget->rebuild();
     on_change();
 }
 
@@ -172,7 +265,7 @@ void MainWindow::on_actionDeselect_triggered() {
 }
 
 void MainWindow::on_actionSelect_All_triggered() {
-    m_audio_widget->select(0, the_app.buffer.get_duration());
+    m_audio_widget->select(0, get_edited_duration());
     m_audio_widget->update();
 }
 
@@ -191,20 +284,38 @@ void MainWindow::on_actionPlay_triggered() {
     if (m_audio_widget->m_selection_state != AudioWidget::SelectionState::DESELECTED)
         start_pos = the_app.buffer.get_frame(m_audio_widget->get_selection_start_time());
 
+    // without a region it plays to the end of whatever runs longer, the buffer or the tracks
     if (m_audio_widget->m_selection_state == AudioWidget::SelectionState::REGION)
         stop_pos = the_app.buffer.get_frame(m_audio_widget->get_selection_end_time());
-    else
-        stop_pos = the_app.buffer.get_num_frames();
 
     the_app.interface.play(start_pos, stop_pos);
 }
 
 void MainWindow::on_actionStop_triggered() {
+    bool recording = the_app.interface.m_state == AudioInterface::State::RECORDING;
+
     the_app.interface.stop();
+    if (recording)
+        finish_recording();
+
     m_audio_widget->update();
 }
 
 void MainWindow::on_actionRecord_triggered() {
+    if (the_app.interface.m_state == AudioInterface::State::RECORDING) {
+        on_actionStop_triggered();
+        return;
+    }
+
+    if (the_app.interface.m_state != AudioInterface::State::IDLE)
+        return;
+
+    // record at the marker, or append when nothing is selected
+    int64_t insert_pos = the_app.buffer.get_num_frames();
+    if (m_audio_widget->m_selection_state != AudioWidget::SelectionState::DESELECTED)
+        insert_pos = the_app.buffer.get_frame(m_audio_widget->get_selection_start_time());
+
+    the_app.interface.record(insert_pos);
 }
 
 void MainWindow::on_actionViewSingle_triggered() {
@@ -223,31 +334,471 @@ void MainWindow::on_actionViewSpectrogram_triggered() {
 }
 
 void MainWindow::on_actionNormalize_triggered() {
-    perform_action(Action::NORMALIZE);
+    normalize();
+}
+
+void MainWindow::on_actionDetect_Regions_triggered() {
+    if (the_app.buffer.get_num_frames() == 0)
+        return;
+
+    RegionDialog dialog(this);
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+
+    DetectedRegion region = dialog.get_selected_region();
+    if (region.end > region.start) {
+        m_audio_widget->select(the_app.buffer.get_time(region.start), the_app.buffer.get_time(region.end));
+        m_audio_widget->update();
+    }
+}
+
+// the selection, or everything, gets a new length and/or pitch and stays selected
+void MainWindow::on_actionTime_Stretch_triggered() {
+    if (the_app.buffer.get_num_frames() == 0)
+        return;
+
+    StretchDialog dialog(this);
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+    StretchOptions options = dialog.get_options();
+
+    int64_t start = 0;
+    int64_t end = the_app.buffer.get_num_frames();
+    if (m_audio_widget->m_selection_state == AudioWidget::SelectionState::REGION) {
+        start = the_app.buffer.get_frame(m_audio_widget->get_selection_start_time());
+        end = the_app.buffer.get_frame(m_audio_widget->get_selection_end_time());
+    }
+
+    the_app.interface.stop();
+
+    AudioBuffer result;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool ok = time_stretch(the_app.buffer, start, end, options, result);
+    QApplication::restoreOverrideCursor();
+
+    if (!ok) {
+        show_error_box("could not stretch the selection");
+        return;
+    }
+
+    save_state();
+    int64_t new_end = end + result.get_num_frames() - the_app.buffer.get_num_frames();
+    the_app.buffer = std::move(result);
+
+    if (m_audio_widget->m_selection_state == AudioWidget::SelectionState::REGION)
+        m_audio_widget->select(the_app.buffer.get_time(start), the_app.buffer.get_time(new_end));
+
+    the_app.unsaved_changes = true;
+    update_status_bar();
+    on_change(start, end, new_end);
+}
+
+void MainWindow::on_actionCapture_Noise_Profile_triggered() {
+    if (m_audio_widget->m_selection_state != AudioWidget::SelectionState::REGION) {
+        show_error_box("select a stretch of background noise to capture the profile from");
+        return;
+    }
+
+    int64_t start = the_app.buffer.get_frame(m_audio_widget->get_selection_start_time());
+    int64_t end = the_app.buffer.get_frame(m_audio_widget->get_selection_end_time());
+
+    std::shared_ptr<const NoiseProfile> profile;
+    if (the_app.non_destructive) {
+        AudioBuffer selection;
+        the_app.edits.slice(start, end).render(selection);
+        profile = NoiseProfile::capture(selection, 0, selection.get_num_frames());
+    } else {
+        profile = NoiseProfile::capture(the_app.buffer, start, end);
+    }
+    if (!profile) {
+        show_error_box("the selection is too short to capture a noise profile from");
+        return;
+    }
+
+    set_noise_profile(std::move(profile));
+    ui->statusbar->showMessage(QString("Captured a noise profile from %1 s of audio").arg(the_app.buffer.get_time(end - start), 0, 'f', 2), 5000);
+}
+
+void MainWindow::on_actionLoad_Impulse_Response_triggered() {
+    QString path = QFileDialog::getOpenFileName(this, tr("Load Impulse Response"), the_app.last_dir, tr("Audio Files (*.wav *.flac *.mp3 *.ogg)"));
+    if (path == nullptr)
+        return;
+
+    auto response = std::make_shared<ImpulseResponse>();
+    if (!the_app.io.read(response->buffer, path.toStdString()))
+        return;
+
+    QFileInfo info(path);
+    response->name = info.fileName().toStdString();
+    ui->statusbar->showMessage(QString("Loaded %1, %2 s").arg(info.fileName()).arg(response->buffer.get_duration(), 0, 'f', 2), 5000);
+    set_impulse_response(std::move(response));
 }
 
 void MainWindow::on_actionLoop_toggled(bool checked) {
     the_app.interface.m_loop = checked;
 }
 
+void MainWindow::on_actionSnap_Zero_Crossings_toggled(bool checked) {
+    m_audio_widget->m_snap.zero_crossings = checked;
+    QSettings("AudioEditor", "AudioEditor").setValue("snap/zero_crossings", checked);
+}
+
+void MainWindow::on_actionSnap_Transients_toggled(bool checked) {
+    m_audio_widget->m_snap.transients = checked;
+    QSettings("AudioEditor", "AudioEditor").setValue("snap/transients", checked);
+}
+
+void MainWindow::on_actionSnap_Beats_toggled(bool checked) {
+    m_audio_widget->m_snap.beats = checked;
+    QSettings("AudioEditor", "AudioEditor").setValue("snap/beats", checked);
+}
+
+void MainWindow::on_actionShow_Beats_toggled(bool checked) {
+    m_audio_widget->m_show_beats = checked;
+    m_audio_widget->update();
+    QSettings("AudioEditor", "AudioEditor").setValue("view/show_beats", checked);
+}
+
+void MainWindow::on_actionSnap_Grid_toggled(bool checked) {
+    m_audio_widget->m_snap.grid = checked;
+    QSettings("AudioEditor", "AudioEditor").setValue("snap/grid", checked);
+}
+
+// switching renders the edit list back into the buffer or moves the buffer into a new one,
+// either way the undo history is left behind
+void MainWindow::on_actionNon_Destructive_toggled(bool checked) {
+    QSettings("AudioEditor", "AudioEditor").setValue("edit/non_destructive", checked);
+    if (checked == the_app.non_destructive)
+        return;
+
+    the_app.interface.stop();
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    if (checked)
+        begin_edit_list();
+    else
+        end_edit_list();
+    the_app.non_destructive = checked;
+    QApplication::restoreOverrideCursor();
+
+    update_edit_actions();
+    update_status_bar();
+    on_change();
+}
+
+// the tools that need all the frames in one buffer aren't there for the edit list
+void MainWindow::update_edit_actions() {
+    bool destructive = !the_app.non_destructive;
+    ui->actionNormalize->setEnabled(destructive);
+    ui->actionTime_Stretch->setEnabled(destructive);
+    ui->actionDetect_Regions->setEnabled(destructive);
+    ui->actionRecord->setEnabled(destructive);
+    ui->actionSnap_Zero_Crossings->setEnabled(destructive);
+    ui->actionSnap_Transients->setEnabled(destructive);
+    ui->actionSnap_Beats->setEnabled(destructive);
+    ui->menuSample_Rate->setEnabled(destructive);
+}
+
 void MainWindow::on_actionResetView_triggered() {
 	m_audio_widget->reset_view();
 }
 
-void MainWindow::load_from_file(const QString& path) {
-    if (!the_app.buffer.load_from_file(path)) {
+void MainWindow::on_actionSettings_triggered() {
+    Settings settings(this);
+    settings.exec();
+}
+
+void MainWindow::on_actionDiagnostics_triggered() {
+    if (!m_diagnostics)
+        m_diagnostics = new Diagnostics(this);
+
+    m_diagnostics->show();
+    m_diagnostics->raise();
+}
+
+void MainWindow::on_action8_kHz_triggered() {
+    change_sample_rate(8000);
+}
+
+void MainWindow::on_action16_kHz_triggered() {
+    change_sample_rate(16000);
+}
+
+void MainWindow::on_action22_05_kHz_triggered() {
+    change_sample_rate(22050);
+}
+
+void MainWindow::on_action44_1_kHz_triggered() {
+    change_sample_rate(44100);
+}
+
+void MainWindow::on_action48_kHz_triggered() {
+    change_sample_rate(48000);
+}
+
+void MainWindow::on_actionCustom_2_triggered() {
+    bool ok;
+    int sample_rate = QInputDialog::getInt(this, tr("Sample Rate"), tr("New sample rate (Hz):"),
+                                           the_app.buffer.get_sample_rate(), 1000, 768000, 1, &ok);
+    if (ok)
+        change_sample_rate(sample_rate);
+}
+
+// converts the whole buffer, the duration and selection stay the same
+void MainWindow::change_sample_rate(int sample_rate) {
+    if (sample_rate == the_app.buffer.get_sample_rate())
+        return;
+
+    struct Choice {
+        const char* name;
+        RateConverter converter;
+        Resampler::Quality quality;
+    };
+
+    static const Choice choices[] = {
+        {"Sinc, low (fastest)", RateConverter::SINC, Resampler::Quality::LOW},
+        {"Sinc, medium", RateConverter::SINC, Resampler::Quality::MEDIUM},
+        {"Sinc, high", RateConverter::SINC, Resampler::Quality::HIGH},
+        {"Sinc, best", RateConverter::SINC, Resampler::Quality::BEST},
+        {"SoX, high", RateConverter::SOXR, Resampler::Quality::HIGH},
+        {"SoX, very high", RateConverter::SOXR, Resampler::Quality::BEST},
+    };
+    const int num_choices = sizeof(choices) / sizeof(choices[0]);
+
+    QStringList items;
+    for (const Choice& choice : choices)
+        items << choice.name;
+
+    QSettings settings("AudioEditor", "AudioEditor");
+    int last = std::max(0, std::min(num_choices - 1, settings.value("convert/rate_quality", 2).toInt()));
+
+    bool ok;
+    QString item = QInputDialog::getItem(this, tr("Sample Rate"),
+                                         tr("Convert from %1 Hz to %2 Hz using:").arg(the_app.buffer.get_sample_rate()).arg(sample_rate),
+                                         items, last, false, &ok);
+    if (!ok)
+        return;
+
+    int index = items.indexOf(item);
+    const Choice& choice = choices[index];
+    settings.setValue("convert/rate_quality", index);
+
+    the_app.interface.stop();
+    Mixer& mixer = the_app.interface.get_mixer();
+    std::shared_ptr<const MixerState> tracks = mixer.get_state();
+
+    // the tracks go first, they are put back if the buffer then fails, so either both are
+    // converted or neither is
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool tracks_ok = convert_tracks(sample_rate, choice.converter, choice.quality);
+    ok = tracks_ok;
+    if (ok) {
+        save_state();
+        ok = convert_sample_rate(the_app.buffer, sample_rate, choice.converter, choice.quality);
+        if (ok && mixer.get_state() != tracks)
+            the_app.track_history.back() = tracks;
+    }
+    QApplication::restoreOverrideCursor();
+
+    // convert_tracks has said what went wrong with the tracks
+    if (!tracks_ok)
+        return;
+    if (!ok) {
+        mixer.set_state(tracks);
+        the_app.history.pop_back();
+        the_app.layout_history.pop_back();
+        the_app.track_history.pop_back();
+        if (choice.converter == RateConverter::SOXR)
+            show_error_box("sample rate conversion failed, swresample may have been built without the sox resampler");
+        else
+            show_error_box("sample rate conversion failed");
+        return;
+    }
+
+    the_app.journal.record_resample(sample_rate, choice.converter, choice.quality);
+    reset_layout();
+    the_app.unsaved_changes = true;
+    update_status_bar();
+    on_change();
+}
+
+// the tracks only play along while they are at the buffer's sample rate
+bool MainWindow::convert_tracks(int sample_rate, RateConverter converter, Resampler::Quality quality) {
+    Mixer& mixer = the_app.interface.get_mixer();
+    if (mixer.get_state()->tracks.empty() || mixer.get_state()->sample_rate == sample_rate)
+        return true;
+
+    auto state = std::make_shared<MixerState>(*mixer.get_state());
+    if (!convert_track_rates(*state, sample_rate, converter, quality)) {
+        show_error_box("could not convert the tracks to the new sample rate");
+        return false;
+    }
+
+    mixer.set_state(std::move(state));
+    return true;
+}
+
+// the file goes on a track of its own, starting at the marker
+void MainWindow::on_actionAdd_Track_triggered() {
+    Mixer& mixer = the_app.interface.get_mixer();
+    if ((int) mixer.get_state()->tracks.size() >= Mixer::max_tracks) {
+        show_error_box(QString("the mixer has room for %1 tracks").arg(Mixer::max_tracks));
+        return;
+    }
+
+    QString path = QFileDialog::getOpenFileName(this, tr("Add Track"), the_app.last_dir, tr("Audio Files (*.wav *.flac *.mp3 *.ogg)"));
+    if (path == nullptr)
+        return;
+
+    auto source = std::make_shared<AudioBuffer>();
+    if (!the_app.io.read(*source, path.toStdString()))
+        return;
+
+    if (source->get_num_channels() > 2) {
+        show_error_box("only mono and stereo files can be added as tracks");
+        return;
+    }
+
+    int sample_rate = the_app.buffer.get_sample_rate();
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool ok = convert_sample_rate(*source, sample_rate, RateConverter::SINC, Resampler::Quality::HIGH);
+    QApplication::restoreOverrideCursor();
+    if (!ok) {
+        show_error_box("could not convert the track to the sample rate of the buffer");
+        return;
+    }
+
+    int64_t position = 0;
+    if (m_audio_widget->m_selection_state != AudioWidget::SelectionState::DESELECTED)
+        position = the_app.buffer.get_frame(m_audio_widget->get_selection_start_time());
+
+    QFileInfo info(path);
+    auto state = std::make_shared<MixerState>(*mixer.get_state());
+    state->sample_rate = sample_rate;
+
+    Clip clip;
+    clip.source = source;
+    clip.length = source->get_num_frames();
+    clip.position = position;
+
+    Track track;
+    track.id = state->next_id++;
+    track.name = info.fileName().toStdString();
+    track.clips.push_back(std::move(clip));
+    state->tracks.push_back(std::move(track));
+    mixer.set_state(std::move(state));
+
+    m_mixer_widget->rebuild();
+    m_mixer_dock->show();
+    ui->statusbar->showMessage(QString("Added %1 as a track, %2 s").arg(info.fileName()).arg(source->get_duration(), 0, 'f', 2), 5000);
+}
+
+// writes the buffer and the tracks through their strips into one file
+void MainWindow::on_actionBounce_Mix_triggered() {
+    QString path = QFileDialog::getSaveFileName(this, tr("Bounce Mix"), the_app.last_dir, tr("Audio Files (*.wav *.mp3 *.ogg)"));
+    if (path == nullptr)
+        return;
+
+    int codec = FileIO::get_format_for_path(path.toStdString());
+    if (codec < 0) {
+        show_error_box("could not determine codec from filename");
         return;
     }
 
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    AudioBuffer edited;
+    if (the_app.non_destructive)
+        the_app.edits.render(edited);
+
+    AudioBuffer mix;
+    bounce_mix(the_app.non_destructive ? edited : the_app.buffer, *the_app.interface.get_mixer().get_state(), mix);
+    bool ok = the_app.io.write(mix, path.toStdString(), codec);
+    QApplication::restoreOverrideCursor();
+
+    if (!ok) {
+        show_error_box("error when writing the mix to file");
+        return;
+    }
+
+    ui->statusbar->showMessage(QString("Bounced %1 s to %2").arg(mix.get_duration(), 0, 'f', 2).arg(QFileInfo(path).fileName()), 5000);
+}
+
+void MainWindow::on_actionRemove_All_Tracks_triggered() {
+    Mixer& mixer = the_app.interface.get_mixer();
+    auto state = std::make_shared<MixerState>(*mixer.get_state());
+    state->tracks.clear();
+    mixer.set_state(std::move(state));
+    m_mixer_widget->rebuild();
+}
+
+void MainWindow::build_effect_menus() {
+    QMap<QString, QMenu*> submenus;
+    for (const EffectInfo& info : get_effect_registry()) {
+        QMenu* menu = info.generator ? ui->menuGenerate : ui->menuEffects;
+        if (!info.submenu.isEmpty()) {
+            QMenu*& submenu = submenus[info.submenu];
+            if (!submenu)
+                submenu = menu->addMenu(info.submenu);
+            menu = submenu;
+        }
+
+        QAction* action = menu->addAction(info.name + "...");
+        connect(action, &QAction::triggered, this, [this, create = info.create]() {
+            open_effect(create(the_app.buffer.get_sample_rate()));
+        });
+    }
+}
+
+// a project brings back its undo history and selection, its waveform and beats aren't analysed again
+void MainWindow::load_from_file(const QString& path) {
+    bool project = ProjectFile::is_project_path(path.toStdString());
+    ProjectState state;
+    if (project) {
+        std::string error;
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        bool ok = open_project(path.toStdString(), state, error);
+        QApplication::restoreOverrideCursor();
+        if (!ok) {
+            show_error_box(QString("could not open the project, %1").arg(QString::fromStdString(error)));
+            return;
+        }
+    } else {
+        if (!the_app.buffer.load_from_file(path)) {
+            return;
+        }
+
+        the_app.project = nullptr;
+        reset_layout();
+        if (the_app.non_destructive)
+            begin_edit_list();
+    }
+
+    the_app.journal.record_load(path.toStdString());
+
     QFileInfo info(path);
     the_app.file_path = path;
     the_app.last_dir = info.dir().path();
     the_app.unsaved_changes = false;
-    the_app.waveform.render(4);
+    if (!project || !the_app.waveform.set_levels(std::move(state.levels)))
+        the_app.waveform.render();
+    the_app.energy_index.invalidate();
+    the_app.snap_index.invalidate();
+    start_snap_index();
+    the_app.beat_tracker.clear();
+    if (project && state.beats)
+        the_app.beat_tracker.set_grid(state.beats);
+    else if (!the_app.non_destructive)
+        start_beat_tracking();
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    convert_tracks(the_app.buffer.get_sample_rate(), RateConverter::SINC, Resampler::Quality::HIGH);
+    QApplication::restoreOverrideCursor();
 
     update_status_bar();
     update_title();
-    m_audio_widget->deselect();
+    if (project && state.selection_state != (int) AudioWidget::SelectionState::DESELECTED)
+        m_audio_widget->select(state.selection_start, state.selection_end);
+    else
+        m_audio_widget->deselect();
 	m_audio_widget->reset_view();
     m_audio_widget->update();
 }
@@ -264,6 +815,49 @@ void MainWindow::update_title() {
     setWindowTitle(QString("%1%2 - AudioEditor").arg(the_app.unsaved_changes ? "*" : "", file_name));
 }
 
+// peak normalization, or gain to a loudness target that the true peak ceiling may hold back
+void MainWindow::normalize() {
+    NormalizeDialog dialog(this);
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+    NormalizeOptions options = dialog.get_options();
+
+    int64_t start = 0;
+    int64_t end = the_app.buffer.get_num_frames();
+    if (m_audio_widget->m_selection_state == AudioWidget::SelectionState::REGION) {
+        start = the_app.buffer.get_frame(m_audio_widget->get_selection_start_time());
+        end = the_app.buffer.get_frame(m_audio_widget->get_selection_end_time());
+    }
+
+    if (options.mode == NormalizeOptions::Mode::PEAK) {
+        save_state();
+        the_app.buffer.normalize_region(start, end, (float) pow(10.0, options.peak_db / 20.0));
+    } else {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        LoudnessStats stats = analyze_loudness(the_app.buffer, start, end);
+        QApplication::restoreOverrideCursor();
+
+        if (!std::isfinite(stats.integrated)) {
+            show_error_box("the audio is too short or too quiet to measure its loudness");
+            return;
+        }
+
+        double gain = get_loudness_gain(stats, options.target_lufs, options.ceiling_dbtp);
+        save_state();
+        the_app.buffer.apply_gain(start, end, (float) pow(10.0, gain / 20.0));
+
+        double reached = stats.integrated + gain;
+        QString message = tr("Normalized from %1 LUFS to %2 LUFS").arg(stats.integrated, 0, 'f', 1).arg(reached, 0, 'f', 1);
+        if (reached < options.target_lufs - 0.05)
+            message += tr(", held back by the %1 dBTP ceiling").arg(options.ceiling_dbtp, 0, 'f', 1);
+        ui->statusbar->showMessage(message, 5000);
+    }
+
+    m_audio_widget->deselect();
+    the_app.unsaved_changes = true;
+    on_change(start, end, end);
+}
+
 void MainWindow::perform_action(Action action) {
     double select_start = m_audio_widget->get_selection_start_time();
     double select_end = m_audio_widget->get_selection_end_time();
@@ -271,31 +865,58 @@ void MainWindow::perform_action(Action action) {
     int64_t start = the_app.buffer.get_frame(select_start);
     int64_t end = the_app.buffer.get_frame(select_end);
 
+    // what the action replaced [start, old_end) with, nothing by default
+    int64_t old_end = start;
+    int64_t new_end = start;
+
+    // in non-destructive mode the same actions only rearrange the edit list
+    bool list = the_app.non_destructive;
+    EditList& edits = the_app.edits;
+    int64_t clipboard_frames = list ? the_app.edit_clipboard.get_num_frames() : the_app.clipboard.get_num_frames();
+
     switch (action) {
     case Action::DELETE:
         if (m_audio_widget->m_selection_state != AudioWidget::SelectionState::REGION)
             break;
         save_state();
-        the_app.buffer.delete_region(start, end);
+        if (list)
+            edits.remove(start, end);
+        else
+            the_app.buffer.delete_region(start, end);
         m_audio_widget->deselect();
         the_app.unsaved_changes = true;
+        old_end = end;
         break;
     case Action::COPY:
         if (m_audio_widget->m_selection_state != AudioWidget::SelectionState::REGION)
             break;
-        the_app.buffer.copy_region(start, end, the_app.clipboard);
+        if (list)
+            the_app.edit_clipboard = edits.slice(start, end);
+        else
+            the_app.buffer.copy_region(start, end, the_app.clipboard);
         break;
     case Action::PASTE:
         if (m_audio_widget->m_selection_state == AudioWidget::SelectionState::MARKER) {
             save_state();
-            the_app.buffer.paste_from(start, the_app.clipboard);
+            if (list)
+                edits.insert(start, the_app.edit_clipboard);
+            else
+                the_app.buffer.paste_from(start, the_app.clipboard);
             the_app.unsaved_changes = true;
+            new_end = start + clipboard_frames;
         } else if (m_audio_widget->m_selection_state == AudioWidget::SelectionState::REGION) {
             save_state();
-            the_app.buffer.delete_region(start, end);
-            the_app.buffer.paste_from(start, the_app.clipboard);
+            if (list) {
+                edits.remove(start, end);
+                edits.insert(start, the_app.edit_clipboard);
+            } else {
+                the_app.buffer.delete_region(start, end);
+                the_app.buffer.paste_from(start, the_app.clipboard);
+            }
             the_app.unsaved_changes = true;
             m_audio_widget->deselect();
+            old_end = end;
+            new_end = start + clipboard_frames;
         }
         break;
     case Action::CUT:
@@ -303,44 +924,183 @@ void MainWindow::perform_action(Action action) {
             break;
         m_audio_widget->deselect();
         save_state();
-        the_app.buffer.cut_region(start, end, the_app.clipboard);
+        if (list) {
+            the_app.edit_clipboard = edits.slice(start, end);
+            edits.remove(start, end);
+        } else {
+            the_app.buffer.cut_region(start, end, the_app.clipboard);
+        }
         the_app.unsaved_changes = true;
+        old_end = end;
         break;
     case Action::TRIM: {
         if (m_audio_widget->m_selection_state != AudioWidget::SelectionState::REGION)
             break;
         m_audio_widget->deselect();
         save_state();
-        AudioBuffer temp;
-        the_app.buffer.copy_region(start, end, temp);
-        the_app.buffer = std::move(temp);
-        the_app.unsaved_changes = true;
-		m_audio_widget->reset_view();
-        break;
-    }
-    case Action::NORMALIZE:
-        save_state();
-        if (m_audio_widget->m_selection_state == AudioWidget::SelectionState::REGION) {
-            the_app.buffer.normalize_region(start, end);
+        int64_t num_frames = get_edited_frames();
+        if (list) {
+            edits = edits.slice(start, end);
         } else {
-            the_app.buffer.normalize_region(0, the_app.buffer.get_num_frames());
+            AudioBuffer temp;
+            the_app.buffer.copy_region(start, end, temp);
+            the_app.buffer = std::move(temp);
         }
-        m_audio_widget->deselect();
+        int64_t trim_start = std::max((int64_t) 0, std::min(num_frames, start));
+        the_app.journal.record_trim(trim_start, get_edited_frames());
+        if (!list)
+            the_app.layout = the_app.layout.slice(trim_start, trim_start + get_edited_frames());
         the_app.unsaved_changes = true;
+		m_audio_widget->reset_view();
+        old_end = -1;
         break;
+    }
     default:
         Q_ASSERT(false);
     }
 
-    on_change();
+    on_change(start, old_end, new_end);
 }
 
-void MainWindow::on_change() {
+// the edit replaced frames [start, old_end) with [start, new_end), an old_end of -1 means the
+// whole buffer may have changed, those edits tell the journal themselves
+void MainWindow::on_change(int64_t start, int64_t old_end, int64_t new_end) {
+    bool empty = old_end == start && new_end == start;
+
     update_title();
-    the_app.waveform.render(); // TODO: only redraw changed portions
+    if (old_end >= 0 && !empty) {
+        journal_change(start, new_end);
+        layout_change(start, new_end);
+    }
+    if (old_end < 0) {
+        the_app.waveform.render();
+        the_app.snap_index.invalidate();
+        the_app.beat_tracker.clear();
+    } else {
+        the_app.waveform.update(start, old_end, new_end);
+        the_app.snap_index.update(the_app.buffer, start, old_end, new_end);
+        the_app.beat_tracker.update(start, old_end, new_end);
+    }
+    the_app.energy_index.invalidate();
+    start_snap_index();
+
+    // an empty edit, like a copy, leaves the beats alone, the edit list doesn't get tracked at all
+    if (!empty && !the_app.non_destructive)
+        start_beat_tracking();
     m_audio_widget->update();
 }
 
+// snapping leaves the index out until it's built, edits it could patch leave it valid and this
+// does nothing, the edit list doesn't have the frames in one piece for it
+void MainWindow::start_snap_index() {
+    if (!the_app.non_destructive)
+        the_app.snap_index.start_build(the_app.buffer);
+}
+
+// the grid shows up on the timeline and in the status bar whenever the analysis gets done
+void MainWindow::start_beat_tracking() {
+    the_app.beat_tracker.start(the_app.buffer, [this]() {
+        QMetaObject::invokeMethod(this, [this]() {
+            update_status_bar();
+            m_audio_widget->update();
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::finish_recording() {
+    const Recorder& recorder = the_app.interface.m_recorder;
+    if (recorder.has_write_failed())
+        show_error_box(QString("could not write the recording to disk, the take was cut off after %1 s")
+                       .arg(recorder.get_num_frames() / (double) the_app.buffer.get_sample_rate(), 0, 'f', 1));
+    if (recorder.get_num_frames() == 0)
+        return;
+
+    if (recorder.get_num_overflows() > 0)
+        qDebug() << "recording dropped" << recorder.get_num_overflows() << "blocks";
+
+    save_state();
+    int64_t where = the_app.interface.m_record_pos;
+    int64_t num_frames = the_app.buffer.get_num_frames();
+    bool ok = the_app.interface.m_recorder.splice_into(the_app.buffer, where);
+    if (!ok) {
+        show_error_box("failed to read back the recorded audio");
+        // whatever made it in stays, so the journal needs it too
+        if (the_app.buffer.get_num_frames() > num_frames) {
+            journal_change(where, where + the_app.buffer.get_num_frames() - num_frames);
+            layout_change(where, where + the_app.buffer.get_num_frames() - num_frames);
+        }
+    }
+
+    m_audio_widget->deselect();
+    the_app.unsaved_changes = true;
+    update_status_bar();
+    if (ok)
+        on_change(where, where, where + recorder.get_num_frames());
+    else
+        on_change();
+}
+
+// lets the user tweak the effect while hearing it, the buffer is only touched on apply
+// generators insert at the start of the selection instead of processing it
+void MainWindow::open_effect(std::unique_ptr<Effect> effect) {
+    bool generator = effect->is_generator();
+    AudioWidget::SelectionState selection = m_audio_widget->m_selection_state;
+
+    int64_t start = 0;
+    int64_t end = get_edited_frames();
+    if (selection == AudioWidget::SelectionState::REGION || (generator && selection == AudioWidget::SelectionState::MARKER)) {
+        start = the_app.buffer.get_frame(m_audio_widget->get_selection_start_time());
+        end = the_app.buffer.get_frame(m_audio_widget->get_selection_end_time());
+    }
+
+    if (generator)
+        end = start;
+    else if (start >= end)
+        return;
+
+    effect->prepare(the_app.buffer.get_num_channels(), the_app.buffer.get_sample_rate(), start, end);
+
+    if (const char* requirement = effect->get_unmet_requirement()) {
+        show_error_box(requirement);
+        return;
+    }
+
+    bool apply;
+    {
+        EffectDialog dialog(effect.get(), start, end, this);
+        apply = dialog.exec() == QDialog::Accepted;
+    }
+
+    if (!apply)
+        return;
+
+    the_app.interface.stop();
+    save_state();
+    if (generator) {
+        int64_t num_frames;
+        if (the_app.non_destructive) {
+            // the generated audio becomes a source of its own
+            auto generated = std::make_shared<AudioBuffer>();
+            generated->init(the_app.buffer.get_num_channels(), the_app.buffer.get_sample_rate());
+            num_frames = render_generator(*generated, 0, *effect);
+            the_app.edits.insert(start, EditList(std::move(generated)));
+        } else {
+            num_frames = render_generator(the_app.buffer, start, *effect);
+        }
+        m_audio_widget->select(the_app.buffer.get_time(start), the_app.buffer.get_time(start + num_frames));
+        update_status_bar();
+        end = start + num_frames;
+    } else if (the_app.non_destructive) {
+        // nothing is rendered here, the waveform and playback have it rendered in the background
+        // as they get to it, saving and exporting render whatever is left
+        the_app.edits.apply_effect(start, end, *effect);
+    } else {
+        render_effect(the_app.buffer, start, end, *effect);
+    }
+    the_app.unsaved_changes = true;
+    on_change(start, generator ? start : end, end);
+}
+
 void MainWindow::dragEnterEvent(QDragEnterEvent* event) {
     if (event->mimeData()->hasUrls()) {
         event->acceptProposedAction();
@@ -356,27 +1116,122 @@ void MainWindow::dropEvent(QDropEvent* event) {
 }
 
 void MainWindow::save() {
-	int codec = -1;
-
 	const QString& path = the_app.file_path;
 
+    // a project keeps the edits as they are, nothing gets rendered or encoded
+    if (ProjectFile::is_project_path(path.toStdString())) {
+        ProjectState state;
+        state.selection_state = (int) m_audio_widget->m_selection_state;
+        state.selection_start = m_audio_widget->get_selection_start_time();
+        state.selection_end = m_audio_widget->get_selection_end_time();
+
+        std::string error;
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        bool ok = save_project(path.toStdString(), state, error);
+        QApplication::restoreOverrideCursor();
+        if (!ok) {
+            show_error_box(QString("error when saving the project, %1").arg(QString::fromStdString(error)));
+            return;
+        }
+
+        // the journal goes on from the project as it was saved
+        the_app.unsaved_changes = false;
+        the_app.journal.record_load(path.toStdString());
+        return;
+    }
+
 	// TODO: let user choose this if they want to
-    QFileInfo file_info(path);
-    QString suffix = file_info.completeSuffix();
-    if (suffix == "wav") {
-		codec = AV_CODEC_ID_PCM_S16LE;
-    } else if (suffix == "mp3") {
-		codec = AV_CODEC_ID_MP3;
-    } else if (suffix == "ogg") {
-		codec = AV_CODEC_ID_VORBIS;
-    } else {
+	int codec = FileIO::get_format_for_path(path.toStdString());
+	if (codec < 0) {
 		show_error_box("could not determine codec from filename");
 		return;
 	}
 
-    if (the_app.io.write(the_app.buffer, path.toStdString(), codec)) {
+    // the journal starts from the file that is about to be overwritten, so it needs a base of its own,
+    // the same file can come back from the dialog through a link or another spelling of its path
+    QString base_path = QFileInfo(QString::fromStdString(the_app.journal.get_base_path())).canonicalFilePath();
+    if (!base_path.isEmpty() && QFileInfo(path).canonicalFilePath() == base_path)
+        journal_snapshot();
+
+    // the edit list only gets rendered in full to be written out
+    AudioBuffer edited;
+    if (the_app.non_destructive) {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        the_app.edits.render(edited);
+        QApplication::restoreOverrideCursor();
+    }
+
+    if (the_app.io.write(the_app.non_destructive ? edited : the_app.buffer, path.toStdString(), codec)) {
 		the_app.unsaved_changes = false;
+		the_app.journal.record_saved(path.toStdString());
 	} else {
 		show_error_box("error when saving to file: [error message]");
 	}
 }
+
+// offers to replay the newest session an instance that crashed left behind, the ones without
+// unsaved edits are cleaned up on the way
+bool MainWindow::offer_recovery(const QString& recovery_dir) {
+    for (Journal::Session& session : Journal::find_sessions(recovery_dir.toStdString())) {
+        if (!session.dirty) {
+            Journal::remove_session(session.dir);
+            continue;
+        }
+
+        QString document = session.document.empty() ? tr("an untitled document") : QFileInfo(QString::fromStdString(session.document)).fileName();
+        QString time = QDateTime::fromSecsSinceEpoch(session.modified).toString("yyyy-MM-dd hh:mm");
+        QMessageBox box(QMessageBox::Question, tr("Recover"),
+                        tr("AudioEditor didn't shut down properly, there are unsaved edits to %1 from %2.\nRecover them?").arg(document, time),
+                        QMessageBox::Yes | QMessageBox::Discard | QMessageBox::Ignore, this);
+        int choice = box.exec();
+        if (choice == QMessageBox::Discard) {
+            Journal::remove_session(session.dir);
+            continue;
+        }
+
+        // ignoring it asks again on the next start
+        if (choice != QMessageBox::Yes)
+            return false;
+
+        AudioBuffer recovered;
+        std::string error;
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        bool ok = Journal::replay(session.dir, recovered, error);
+        QApplication::restoreOverrideCursor();
+        if (!ok) {
+            show_error_box(QString("could not recover the edits, %1").arg(QString::fromStdString(error)));
+            return false;
+        }
+
+        the_app.buffer = std::move(recovered);
+        the_app.project = nullptr;
+        reset_layout();
+        if (the_app.non_destructive)
+            begin_edit_list();
+        the_app.file_path = QString::fromStdString(session.document);
+        if (!session.document.empty())
+            the_app.last_dir = QFileInfo(the_app.file_path).dir().path();
+        the_app.unsaved_changes = true;
+
+        // the recovered audio is what this session's journal starts from
+        journal_snapshot();
+        Journal::remove_session(session.dir);
+
+        the_app.waveform.render();
+        the_app.energy_index.invalidate();
+        the_app.snap_index.invalidate();
+        start_snap_index();
+        the_app.beat_tracker.clear();
+        if (!the_app.non_destructive)
+            start_beat_tracking();
+
+        update_status_bar();
+        update_title();
+        m_audio_widget->deselect();
+        m_audio_widget->reset_view();
+        m_audio_widget->update();
+        return true;
+    }
+
+    return false;
+}
@@ -1,9 +1,14 @@
 #pragma once
 
 #include "audio_widget.h"
+#include "diagnostics.h"
+#include "mixer_widget.h"
+#include "../rate_convert.h"
+#include "../effect.h"
 
 #include <QMainWindow>
 #include <QLabel>
+#include <QDockWidget>
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -20,6 +25,9 @@ public:
     void update_status_bar();
     void load_from_file(const QString& path);
 
+    // true if the edits of a session that didn't exit cleanly were recovered
+    bool offer_recovery(const QString& recovery_dir);
+
 private slots:
     void on_actionNew_triggered();
     void on_actionOpen_triggered();
@@ -41,8 +49,29 @@ private slots:
     void on_actionViewSplit_triggered();
     void on_actionViewSpectrogram_triggered();
     void on_actionNormalize_triggered();
+    void on_actionDetect_Regions_triggered();
+    void on_actionTime_Stretch_triggered();
+    void on_actionCapture_Noise_Profile_triggered();
+    void on_actionLoad_Impulse_Response_triggered();
     void on_actionLoop_toggled(bool checked);
+    void on_actionSnap_Zero_Crossings_toggled(bool checked);
+    void on_actionSnap_Transients_toggled(bool checked);
+    void on_actionSnap_Grid_toggled(bool checked);
+    void on_actionSnap_Beats_toggled(bool checked);
+    void on_actionShow_Beats_toggled(bool checked);
+    void on_actionNon_Destructive_toggled(bool checked);
     void on_actionResetView_triggered();
+    void on_actionSettings_triggered();
+    void on_actionDiagnostics_triggered();
+    void on_action8_kHz_triggered();
+    void on_action16_kHz_triggered();
+    void on_action22_05_kHz_triggered();
+    void on_action44_1_kHz_triggered();
+    void on_action48_kHz_triggered();
+    void on_actionCustom_2_triggered();
+    void on_actionAdd_Track_triggered();
+    void on_actionBounce_Mix_triggered();
+    void on_actionRemove_All_Tracks_triggered();
 
 private:
     enum class Action {
@@ -51,12 +80,20 @@ private:
         CUT,
         PASTE,
         TRIM,
-        NORMALIZE,
     };
 
     void update_title();
     void perform_action(Action action);
-    void on_change();
+    void on_change(int64_t start = 0, int64_t old_end = -1, int64_t new_end = -1);
+    void finish_recording();
+    void build_effect_menus();
+    void update_edit_actions();
+    void start_beat_tracking();
+    void start_snap_index();
+    void change_sample_rate(int sample_rate);
+    bool convert_tracks(int sample_rate, RateConverter converter, Resampler::Quality quality);
+    void normalize();
+    void open_effect(std::unique_ptr<Effect> effect);
     void dragEnterEvent(QDragEnterEvent *e);
     void dropEvent(QDropEvent *e);
 	void save();
@@ -66,4 +103,7 @@ public:
     QLabel* m_file_info;
     QLabel* m_mouse_info;
     AudioWidget* m_audio_widget;
+    Diagnostics* m_diagnostics = nullptr;
+    MixerWidget* m_mixer_widget;
+    QDockWidget* m_mixer_dock;
 };
@@ -0,0 +1,149 @@
+#include "meter_widget.h"
+
+#include "../app.h"
+#include <QPainter>
+#include <QMouseEvent>
+#include <QGuiApplication>
+#include <QScreen>
+#include <algorithm>
+#include <math.h>
+
+const double min_db = -60;
+const double max_db = 0;
+const double peak_fall_rate = 20.0 / 1.7; // db per second, iec 60268-18
+const double peak_hold_duration = 2.0;
+
+MeterWidget::MeterWidget(QWidget* parent) : QWidget{parent} {
+    setAutoFillBackground(true);
+    setToolTip(tr("Click to reset the maximum true peak and loudness"));
+    reset();
+
+    double refresh_rate = 60;
+    if (QGuiApplication::primaryScreen())
+        refresh_rate = QGuiApplication::primaryScreen()->refreshRate();
+
+    m_timer = new QTimer(this);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    m_timer->setInterval((int) (1000.0 / std::max(refresh_rate, 1.0)));
+    connect(m_timer, &QTimer::timeout, this, &MeterWidget::on_timer);
+    m_timer->start();
+}
+
+void MeterWidget::reset() {
+    for (int c = 0; c < 2; c++) {
+        m_peak[c] = -INFINITY;
+        m_peak_hold[c] = -INFINITY;
+        m_peak_hold_time[c] = 0;
+        m_rms[c] = -INFINITY;
+    }
+    m_max_true_peak = -INFINITY;
+    m_max_momentary = -INFINITY;
+    m_momentary = -INFINITY;
+    m_short_term = -INFINITY;
+}
+
+void MeterWidget::on_timer() {
+    Meter& meter = the_app.interface.get_meter();
+    bool active = the_app.interface.get_state() != AudioInterface::State::IDLE;
+    double dt = m_timer->interval() / 1000.0;
+
+    if (active)
+        m_num_channels = meter.get_num_channels();
+
+    for (int c = 0; c < m_num_channels; c++) {
+        // read even when idle so stale maxima don't show up when playback starts
+        double peak = linear_to_db(meter.take_peak(c));
+        double true_peak = linear_to_db(meter.take_true_peak(c));
+        double rms = linear_to_db(meter.get_rms(c));
+        if (!active)
+            peak = true_peak = rms = -INFINITY;
+
+        // instant attack, steady fall
+        m_peak[c] = std::max(peak, m_peak[c] - peak_fall_rate * dt);
+        m_rms[c] = rms;
+        m_max_true_peak = std::max(m_max_true_peak, true_peak);
+
+        if (peak >= m_peak_hold[c]) {
+            m_peak_hold[c] = peak;
+            m_peak_hold_time[c] = peak_hold_duration;
+        } else if ((m_peak_hold_time[c] -= dt) <= 0) {
+            m_peak_hold[c] = m_peak[c];
+        }
+    }
+
+    m_momentary = active ? meter.get_momentary() : -INFINITY;
+    m_short_term = active ? meter.get_short_term() : -INFINITY;
+    m_max_momentary = std::max(m_max_momentary, m_momentary);
+
+    update();
+}
+
+void MeterWidget::mousePressEvent(QMouseEvent* event) {
+    m_max_true_peak = -INFINITY;
+    m_max_momentary = -INFINITY;
+    update();
+}
+
+static QString format_db(double db) {
+    return std::isfinite(db) ? QString::number(db, 'f', 1) : QString("-inf");
+}
+
+void MeterWidget::paintEvent(QPaintEvent* event) {
+    QPainter painter(this);
+    QFontMetrics metrics = painter.fontMetrics();
+    int line_height = metrics.height();
+
+    const int scale_width = metrics.horizontalAdvance("-60") + 6;
+    QRect bars_rect = rect().adjusted(scale_width, 4, -4, -(line_height * 3 + 8));
+    if (bars_rect.height() < 10)
+        return;
+
+    auto db_to_y = [&](double db) {
+        double t = (std::max(min_db, std::min(max_db, db)) - min_db) / (max_db - min_db);
+        return bars_rect.bottom() - (int) (t * bars_rect.height());
+    };
+
+    // scale
+    painter.setPen(palette().color(QPalette::WindowText));
+    for (int db : {0, -6, -12, -18, -24, -36, -48, -60}) {
+        int y = db_to_y(db);
+        painter.drawLine(scale_width - 4, y, scale_width - 1, y);
+        painter.drawText(QRect(0, y - line_height / 2, scale_width - 5, line_height), Qt::AlignRight | Qt::AlignVCenter, QString::number(db));
+    }
+
+    QLinearGradient gradient(0, db_to_y(min_db), 0, db_to_y(max_db));
+    gradient.setColorAt(0.0, QColor(40, 170, 60));
+    gradient.setColorAt(1.0 - 18.0 / (max_db - min_db), QColor(200, 200, 40));
+    gradient.setColorAt(1.0 - 6.0 / (max_db - min_db), QColor(230, 120, 30));
+    gradient.setColorAt(1.0, QColor(220, 40, 40));
+
+    int bar_gap = 3;
+    int bar_width = (bars_rect.width() - bar_gap * (m_num_channels - 1)) / m_num_channels;
+    for (int c = 0; c < m_num_channels; c++) {
+        QRect bar(bars_rect.left() + c * (bar_width + bar_gap), bars_rect.top(), bar_width, bars_rect.height());
+        painter.fillRect(bar, QColor(30, 30, 30));
+
+        // peak bar, rms drawn on top of it
+        int peak_y = db_to_y(m_peak[c]);
+        painter.fillRect(QRect(bar.left(), peak_y, bar.width(), bar.bottom() - peak_y + 1), gradient);
+
+        int rms_y = db_to_y(m_rms[c]);
+        painter.fillRect(QRect(bar.left() + bar.width() / 4, rms_y, bar.width() / 2, bar.bottom() - rms_y + 1), QColor(255, 255, 255, 90));
+
+        if (std::isfinite(m_peak_hold[c]) && m_peak_hold[c] > min_db) {
+            int hold_y = db_to_y(m_peak_hold[c]);
+            painter.fillRect(QRect(bar.left(), hold_y, bar.width(), 2), m_peak_hold[c] >= 0 ? QColor(255, 60, 60) : QColor(230, 230, 230));
+        }
+    }
+
+    // readouts
+    QRect text_rect(4, bars_rect.bottom() + 6, width() - 8, line_height);
+    painter.setPen(palette().color(QPalette::WindowText));
+    painter.drawText(text_rect, Qt::AlignLeft, "M " + format_db(m_momentary) + " (" + format_db(m_max_momentary) + ")");
+    text_rect.translate(0, line_height);
+    painter.drawText(text_rect, Qt::AlignLeft, "S " + format_db(m_short_term) + " LUFS");
+    text_rect.translate(0, line_height);
+    if (m_max_true_peak > -1.0)
+        painter.setPen(QColor(220, 40, 40));
+    painter.drawText(text_rect, Qt::AlignLeft, "TP " + format_db(m_max_true_peak) + " dBTP");
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QWidget>
+#include <QTimer>
+
+// peak/rms bars per channel plus true peak and loudness readouts, fed by the audio interface's meter
+class MeterWidget : public QWidget {
+    Q_OBJECT
+public:
+    explicit MeterWidget(QWidget* parent = nullptr);
+
+    QSize sizeHint() const override { return QSize(110, 300); }
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+
+private:
+    void on_timer();
+    void reset();
+
+private:
+    QTimer* m_timer;
+    int m_num_channels = 2;
+
+    // in dbfs, with ballistics applied
+    double m_peak[2];
+    double m_peak_hold[2];
+    double m_peak_hold_time[2]; // seconds left
+    double m_rms[2];
+
+    // held until clicked
+    double m_max_true_peak;
+    double m_max_momentary;
+
+    double m_momentary;
+    double m_short_term;
+};
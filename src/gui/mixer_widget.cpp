@@ -0,0 +1,169 @@
+#include "mixer_widget.h"
+
+#include "../app.h"
+#include <QLabel>
+#include <QSlider>
+#include <QPushButton>
+#include <QApplication>
+#include <algorithm>
+#include <math.h>
+
+// tenths of a db, the bottom of the slider is silence
+static const int min_gain_step = -600;
+static const int max_gain_step = 120;
+
+static int gain_to_slider(float gain) {
+    if (gain <= 0)
+        return min_gain_step;
+    return std::max(min_gain_step, std::min(max_gain_step, (int) round(200 * log10(gain))));
+}
+
+static float slider_to_gain(int pos) {
+    if (pos <= min_gain_step)
+        return 0;
+    return (float) pow(10.0, pos / 200.0);
+}
+
+static QString format_gain(int pos) {
+    if (pos <= min_gain_step)
+        return "-inf dB";
+    return QString("%1 dB").arg(pos / 10.0, 0, 'f', 1);
+}
+
+MixerWidget::MixerWidget(QWidget* parent) : QWidget(parent) {
+    m_layout = new QGridLayout(this);
+    m_layout->setColumnStretch(1, 1);
+    rebuild();
+}
+
+void MixerWidget::rebuild() {
+    // deleted later, this can run from a click on one of the buttons
+    while (QLayoutItem* item = m_layout->takeAt(0)) {
+        if (item->widget())
+            item->widget()->deleteLater();
+        delete item;
+    }
+
+    for (int row = 0; row < m_layout->rowCount(); row++)
+        m_layout->setRowStretch(row, 0);
+
+    std::shared_ptr<const MixerState> state = the_app.interface.get_mixer().get_state();
+    add_strip(0, state->main, true);
+    for (size_t i = 0; i < state->tracks.size(); i++)
+        add_strip((int) i + 1, state->tracks[i], false);
+    m_layout->setRowStretch((int) state->tracks.size() + 1, 1);
+}
+
+void MixerWidget::add_strip(int row, const Track& track, bool is_main) {
+    uint32_t id = track.id;
+
+    QLabel* name = new QLabel(is_main ? tr("Buffer") : QString::fromStdString(track.name));
+    name->setMaximumWidth(160);
+    if (!is_main) {
+        double duration = (track.get_end() - track.get_start()) / (double) the_app.buffer.get_sample_rate();
+        name->setToolTip(QString("%1, %2 clips, %3 s").arg(QString::fromStdString(track.name)).arg(track.clips.size()).arg(duration, 0, 'f', 2));
+    }
+
+    QSlider* gain = new QSlider(Qt::Horizontal);
+    gain->setRange(min_gain_step, max_gain_step);
+    gain->setValue(gain_to_slider(track.gain));
+    gain->setMinimumWidth(150);
+
+    QLabel* gain_label = new QLabel(format_gain(gain->value()));
+    gain_label->setMinimumWidth(60);
+
+    connect(gain, &QSlider::valueChanged, this, [this, id, gain_label](int pos) {
+        gain_label->setText(format_gain(pos));
+        edit_track(id, [pos](Track& track) {
+            track.gain = slider_to_gain(pos);
+        });
+    });
+
+    QSlider* pan = new QSlider(Qt::Horizontal);
+    pan->setRange(-100, 100);
+    pan->setValue((int) round(track.pan * 100));
+    pan->setMaximumWidth(80);
+    pan->setToolTip(tr("Pan"));
+    connect(pan, &QSlider::valueChanged, this, [this, id](int pos) {
+        edit_track(id, [pos](Track& track) {
+            track.pan = pos / 100.0f;
+        });
+    });
+
+    QPushButton* mute = new QPushButton(tr("M"));
+    mute->setCheckable(true);
+    mute->setChecked(track.mute);
+    mute->setMaximumWidth(30);
+    connect(mute, &QPushButton::toggled, this, [this, id](bool checked) {
+        edit_track(id, [checked](Track& track) {
+            track.mute = checked;
+        });
+    });
+
+    QPushButton* solo = new QPushButton(tr("S"));
+    solo->setCheckable(true);
+    solo->setChecked(track.solo);
+    solo->setMaximumWidth(30);
+    connect(solo, &QPushButton::toggled, this, [this, id](bool checked) {
+        edit_track(id, [checked](Track& track) {
+            track.solo = checked;
+        });
+    });
+
+    m_layout->addWidget(name, row, 0);
+    m_layout->addWidget(gain, row, 1);
+    m_layout->addWidget(gain_label, row, 2);
+    m_layout->addWidget(pan, row, 3);
+    m_layout->addWidget(mute, row, 4);
+    m_layout->addWidget(solo, row, 5);
+
+    if (is_main)
+        return;
+
+    // playing a frozen track reads one buffer instead of every clip
+    QPushButton* freeze = new QPushButton(tr("Freeze"));
+    freeze->setCheckable(true);
+    freeze->setChecked(track.frozen != nullptr);
+    connect(freeze, &QPushButton::toggled, this, [this, id](bool checked) {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        edit_track(id, [checked](Track& track) {
+            track.frozen = checked ? freeze_track(track, track.frozen_start) : nullptr;
+        });
+        QApplication::restoreOverrideCursor();
+    });
+
+    QPushButton* remove = new QPushButton(tr("Remove"));
+    connect(remove, &QPushButton::clicked, this, [this, id]() {
+        remove_track(id);
+    });
+
+    m_layout->addWidget(freeze, row, 6);
+    m_layout->addWidget(remove, row, 7);
+}
+
+void MixerWidget::edit_track(uint32_t id, const std::function<void(Track&)>& edit) {
+    Mixer& mixer = the_app.interface.get_mixer();
+    auto state = std::make_shared<MixerState>(*mixer.get_state());
+
+    if (state->main.id == id)
+        edit(state->main);
+    for (Track& track : state->tracks) {
+        if (track.id == id)
+            edit(track);
+    }
+
+    mixer.set_state(std::move(state));
+}
+
+void MixerWidget::remove_track(uint32_t id) {
+    Mixer& mixer = the_app.interface.get_mixer();
+    auto state = std::make_shared<MixerState>(*mixer.get_state());
+
+    auto it = std::remove_if(state->tracks.begin(), state->tracks.end(), [id](const Track& track) {
+        return track.id == id;
+    });
+    state->tracks.erase(it, state->tracks.end());
+
+    mixer.set_state(std::move(state));
+    rebuild();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QWidget>
+#include <QGridLayout>
+#include <functional>
+#include <stdint.h>
+
+struct Track;
+
+// a strip with gain, pan, mute and solo for the edited buffer and for every track, tracks can
+// also be frozen and removed, every change hands a new state to the mixer
+class MixerWidget : public QWidget {
+    Q_OBJECT
+public:
+    explicit MixerWidget(QWidget* parent = nullptr);
+
+    // call after tracks were added or removed
+    void rebuild();
+
+private:
+    void add_strip(int row, const Track& track, bool is_main);
+    void edit_track(uint32_t id, const std::function<void(Track&)>& edit);
+    void remove_track(uint32_t id);
+
+private:
+    QGridLayout* m_layout;
+};
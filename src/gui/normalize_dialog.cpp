@@ -0,0 +1,118 @@
+#include "normalize_dialog.h"
+
+#include <QFormLayout>
+#include <QVBoxLayout>
+#include <QDialogButtonBox>
+#include <QSettings>
+#include <math.h>
+
+struct LoudnessPreset {
+    const char* name;
+    double target_lufs;
+};
+
+static const LoudnessPreset presets[] = {
+    {"EBU R128 (-23 LUFS)", -23},
+    {"ATSC A/85 (-24 LUFS)", -24},
+    {"Streaming (-16 LUFS)", -16},
+    {"Streaming (-14 LUFS)", -14},
+};
+
+static QDoubleSpinBox* create_spin_box(double min, double max, double value, const QString& suffix) {
+    QDoubleSpinBox* spin_box = new QDoubleSpinBox();
+    spin_box->setRange(min, max);
+    spin_box->setDecimals(1);
+    spin_box->setSingleStep(0.5);
+    spin_box->setValue(value);
+    spin_box->setSuffix(suffix);
+    return spin_box;
+}
+
+NormalizeDialog::NormalizeDialog(QWidget* parent) : QDialog(parent) {
+    setWindowTitle(tr("Normalize"));
+
+    QSettings settings("AudioEditor", "AudioEditor");
+    NormalizeOptions defaults;
+
+    m_peak_mode = new QRadioButton(tr("Peak"));
+    m_loudness_mode = new QRadioButton(tr("Loudness"));
+    if (settings.value("normalize/mode", 0).toInt() == (int) NormalizeOptions::Mode::LOUDNESS)
+        m_loudness_mode->setChecked(true);
+    else
+        m_peak_mode->setChecked(true);
+
+    m_peak_db = create_spin_box(-60, 0, settings.value("normalize/peak_db", defaults.peak_db).toDouble(), " dBFS");
+    m_target_lufs = create_spin_box(-60, 0, settings.value("normalize/target_lufs", defaults.target_lufs).toDouble(), " LUFS");
+    m_ceiling_dbtp = create_spin_box(-20, 0, settings.value("normalize/ceiling_dbtp", defaults.ceiling_dbtp).toDouble(), " dBTP");
+
+    m_preset = new QComboBox();
+    for (const LoudnessPreset& preset : presets)
+        m_preset->addItem(preset.name);
+    m_preset->addItem(tr("Custom"));
+
+    auto select_preset = [this]() {
+        int index = m_preset->count() - 1;
+        for (int i = 0; i < (int) (sizeof(presets) / sizeof(presets[0])); i++) {
+            if (fabs(presets[i].target_lufs - m_target_lufs->value()) < 0.05)
+                index = i;
+        }
+        m_preset->blockSignals(true);
+        m_preset->setCurrentIndex(index);
+        m_preset->blockSignals(false);
+    };
+    select_preset();
+
+    connect(m_preset, &QComboBox::currentIndexChanged, this, [this](int index) {
+        if (index < (int) (sizeof(presets) / sizeof(presets[0])))
+            m_target_lufs->setValue(presets[index].target_lufs);
+    });
+    connect(m_target_lufs, &QDoubleSpinBox::valueChanged, this, select_preset);
+    connect(m_peak_mode, &QRadioButton::toggled, this, &NormalizeDialog::update_enabled);
+
+    QFormLayout* form = new QFormLayout();
+    form->addRow(m_peak_mode);
+    form->addRow(tr("Peak level"), m_peak_db);
+    form->addRow(m_loudness_mode);
+    form->addRow(tr("Preset"), m_preset);
+    form->addRow(tr("Integrated loudness"), m_target_lufs);
+    form->addRow(tr("True peak ceiling"), m_ceiling_dbtp);
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addLayout(form);
+    layout->addWidget(buttons);
+
+    update_enabled();
+}
+
+void NormalizeDialog::update_enabled() {
+    bool peak = m_peak_mode->isChecked();
+    m_peak_db->setEnabled(peak);
+    m_preset->setEnabled(!peak);
+    m_target_lufs->setEnabled(!peak);
+    m_ceiling_dbtp->setEnabled(!peak);
+}
+
+NormalizeOptions NormalizeDialog::get_options() const {
+    NormalizeOptions options;
+    options.mode = m_peak_mode->isChecked() ? NormalizeOptions::Mode::PEAK : NormalizeOptions::Mode::LOUDNESS;
+    options.peak_db = m_peak_db->value();
+    options.target_lufs = m_target_lufs->value();
+    options.ceiling_dbtp = m_ceiling_dbtp->value();
+    return options;
+}
+
+void NormalizeDialog::accept() {
+    NormalizeOptions options = get_options();
+
+    QSettings settings("AudioEditor", "AudioEditor");
+    settings.setValue("normalize/mode", (int) options.mode);
+    settings.setValue("normalize/peak_db", options.peak_db);
+    settings.setValue("normalize/target_lufs", options.target_lufs);
+    settings.setValue("normalize/ceiling_dbtp", options.ceiling_dbtp);
+
+    QDialog::accept();
+}
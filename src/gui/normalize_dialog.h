@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QDialog>
+#include <QRadioButton>
+#include <QComboBox>
+#include <QDoubleSpinBox>
+
+struct NormalizeOptions {
+    enum class Mode {
+        PEAK,
+        LOUDNESS,
+    };
+
+    Mode mode = Mode::PEAK;
+    double peak_db = 0;        // dbfs the largest sample ends up at
+    double target_lufs = -23;  // integrated loudness
+    double ceiling_dbtp = -1;  // true peak limit for the loudness mode
+};
+
+// asks whether to normalize by peak or to a loudness target, remembering the last choice
+class NormalizeDialog : public QDialog {
+    Q_OBJECT
+public:
+    explicit NormalizeDialog(QWidget* parent = nullptr);
+
+    NormalizeOptions get_options() const;
+
+    void accept() override;
+
+private:
+    void update_enabled();
+
+private:
+    QRadioButton* m_peak_mode;
+    QRadioButton* m_loudness_mode;
+    QDoubleSpinBox* m_peak_db;
+    QComboBox* m_preset;
+    QDoubleSpinBox* m_target_lufs;
+    QDoubleSpinBox* m_ceiling_dbtp;
+};
@@ -0,0 +1,219 @@
+#include "region_dialog.h"
+
+#include "../app.h"
+#include "../energy_index.h"
+#include "../parallel.h"
+#include <QFormLayout>
+#include <QVBoxLayout>
+#include <QDialogButtonBox>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QSettings>
+#include <atomic>
+
+enum Mode {
+    MODE_SILENCE,
+    MODE_ONSETS,
+};
+
+static QDoubleSpinBox* create_spin_box(double min, double max, double step, double value, const QString& suffix) {
+    QDoubleSpinBox* spin_box = new QDoubleSpinBox();
+    spin_box->setRange(min, max);
+    spin_box->setDecimals(2);
+    spin_box->setSingleStep(step);
+    spin_box->setValue(value);
+    spin_box->setSuffix(suffix);
+    return spin_box;
+}
+
+static QString format_time(double seconds) {
+    int minutes = (int) (seconds / 60);
+    return QString("%1:%2").arg(minutes).arg(seconds - minutes * 60, 6, 'f', 3, '0');
+}
+
+RegionDialog::RegionDialog(QWidget* parent) : QDialog(parent) {
+    setWindowTitle(tr("Detect Regions"));
+
+    // the index survives until the next edit, so going back and forth with the settings is instant
+    if (!the_app.energy_index.is_valid()) {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        the_app.energy_index.build(the_app.buffer);
+        QApplication::restoreOverrideCursor();
+    }
+
+    QSettings settings("AudioEditor", "AudioEditor");
+    SilenceParams silence;
+    OnsetParams onsets;
+
+    m_mode = new QComboBox();
+    m_mode->addItem(tr("Split at silence"));
+    m_mode->addItem(tr("Split at onsets"));
+    m_mode->setCurrentIndex(settings.value("regions/mode", MODE_SILENCE).toInt() == MODE_ONSETS ? MODE_ONSETS : MODE_SILENCE);
+
+    m_threshold = create_spin_box(-90, -10, 1, settings.value("regions/threshold_db", silence.threshold_db).toDouble(), " dB");
+    m_min_silence = create_spin_box(0.05, 30, 0.1, settings.value("regions/min_silence", silence.min_silence).toDouble(), " s");
+    m_min_region = create_spin_box(0, 600, 0.5, settings.value("regions/min_region", silence.min_region).toDouble(), " s");
+    m_padding = create_spin_box(0, 5, 0.05, settings.value("regions/padding", silence.padding).toDouble(), " s");
+    m_sensitivity = create_spin_box(1, 40, 1, settings.value("regions/sensitivity_db", onsets.sensitivity_db).toDouble(), " dB");
+    m_min_spacing = create_spin_box(0.05, 60, 0.1, settings.value("regions/min_spacing", onsets.min_spacing).toDouble(), " s");
+
+    QFormLayout* form = new QFormLayout();
+    form->addRow(tr("Mode"), m_mode);
+    form->addRow(tr("Threshold"), m_threshold);
+    form->addRow(tr("Minimum silence"), m_min_silence);
+    form->addRow(tr("Minimum region"), m_min_region);
+    form->addRow(tr("Padding"), m_padding);
+    form->addRow(tr("Onset rise"), m_sensitivity);
+    form->addRow(tr("Onset spacing"), m_min_spacing);
+
+    m_list = new QListWidget();
+    m_list->setMinimumHeight(200);
+    m_summary = new QLabel();
+
+    QDialogButtonBox* buttons = new QDialogButtonBox();
+    m_preview_button = buttons->addButton(tr("Preview"), QDialogButtonBox::ActionRole);
+    m_export_button = buttons->addButton(tr("Export All..."), QDialogButtonBox::ActionRole);
+    m_select_button = buttons->addButton(tr("Select"), QDialogButtonBox::AcceptRole);
+    buttons->addButton(QDialogButtonBox::Close);
+    connect(m_preview_button, &QPushButton::clicked, this, &RegionDialog::preview);
+    connect(m_export_button, &QPushButton::clicked, this, &RegionDialog::export_all);
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    connect(m_list, &QListWidget::itemDoubleClicked, this, &RegionDialog::preview);
+    connect(m_list, &QListWidget::currentRowChanged, this, &RegionDialog::update_enabled);
+
+    connect(m_mode, &QComboBox::currentIndexChanged, this, &RegionDialog::detect);
+    for (QDoubleSpinBox* spin_box : {m_threshold, m_min_silence, m_min_region, m_padding, m_sensitivity, m_min_spacing})
+        connect(spin_box, &QDoubleSpinBox::valueChanged, this, &RegionDialog::detect);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addLayout(form);
+    layout->addWidget(m_list);
+    layout->addWidget(m_summary);
+    layout->addWidget(buttons);
+
+    detect();
+}
+
+RegionDialog::~RegionDialog() {
+    save_settings();
+
+    if (the_app.interface.get_state() == AudioInterface::State::PLAYING)
+        the_app.interface.stop();
+}
+
+void RegionDialog::save_settings() const {
+    QSettings settings("AudioEditor", "AudioEditor");
+    settings.setValue("regions/mode", m_mode->currentIndex());
+    settings.setValue("regions/threshold_db", m_threshold->value());
+    settings.setValue("regions/min_silence", m_min_silence->value());
+    settings.setValue("regions/min_region", m_min_region->value());
+    settings.setValue("regions/padding", m_padding->value());
+    settings.setValue("regions/sensitivity_db", m_sensitivity->value());
+    settings.setValue("regions/min_spacing", m_min_spacing->value());
+}
+
+void RegionDialog::detect() {
+    const EnergyIndex& index = the_app.energy_index;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (m_mode->currentIndex() == MODE_SILENCE) {
+        SilenceParams params;
+        params.threshold_db = m_threshold->value();
+        params.min_silence = m_min_silence->value();
+        params.min_region = m_min_region->value();
+        params.padding = m_padding->value();
+        m_regions = find_sound_regions(index, params);
+    } else {
+        OnsetParams params;
+        params.threshold_db = m_threshold->value();
+        params.sensitivity_db = m_sensitivity->value();
+        params.min_spacing = m_min_spacing->value();
+        m_regions = split_at_onsets(find_onsets(index, params), index.get_num_frames());
+    }
+
+    double elapsed = timer.nsecsElapsed() / 1e6;
+
+    m_list->clear();
+    for (size_t i = 0; i < m_regions.size(); i++) {
+        double start = the_app.buffer.get_time(m_regions[i].start);
+        double end = the_app.buffer.get_time(m_regions[i].end);
+        m_list->addItem(QString("%1.  %2 - %3  (%4 s)").arg(i + 1).arg(format_time(start), format_time(end)).arg(end - start, 0, 'f', 2));
+    }
+    if (!m_regions.empty())
+        m_list->setCurrentRow(0);
+
+    m_summary->setText(tr("%1 regions, found in %2 ms").arg(m_regions.size()).arg(elapsed, 0, 'f', 1));
+    update_enabled();
+}
+
+void RegionDialog::update_enabled() {
+    bool silence = m_mode->currentIndex() == MODE_SILENCE;
+    m_min_silence->setEnabled(silence);
+    m_min_region->setEnabled(silence);
+    m_padding->setEnabled(silence);
+    m_sensitivity->setEnabled(!silence);
+    m_min_spacing->setEnabled(!silence);
+
+    bool has_selection = m_list->currentRow() >= 0;
+    m_preview_button->setEnabled(has_selection);
+    m_select_button->setEnabled(has_selection);
+    m_export_button->setEnabled(!m_regions.empty());
+}
+
+DetectedRegion RegionDialog::get_selected_region() const {
+    int row = m_list->currentRow();
+    if (row < 0 || row >= (int) m_regions.size())
+        return {0, 0};
+    return m_regions[row];
+}
+
+void RegionDialog::preview() {
+    DetectedRegion region = get_selected_region();
+    if (region.end <= region.start)
+        return;
+
+    if (the_app.interface.get_state() != AudioInterface::State::IDLE)
+        the_app.interface.stop();
+    the_app.interface.play(region.start, region.end);
+}
+
+// every region goes to its own file, numbered after the name picked, written in parallel
+void RegionDialog::export_all() {
+    QString path = QFileDialog::getSaveFileName(this, tr("Export Regions"), the_app.last_dir + "/track.wav",
+                                                tr("Audio Files (*.wav *.mp3 *.ogg)"));
+    if (path.isEmpty())
+        return;
+
+    int format = FileIO::get_format_for_path(path.toStdString());
+    if (format < 0) {
+        show_error_box("could not determine codec from filename");
+        return;
+    }
+
+    QFileInfo info(path);
+    int digits = QString::number(m_regions.size()).length();
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < m_regions.size(); i++) {
+        QString name = QString("%1_%2.%3").arg(info.completeBaseName()).arg(i + 1, std::max(digits, 2), 10, QChar('0')).arg(info.suffix());
+        paths.push_back(info.dir().filePath(name).toStdString());
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    std::atomic<int> num_failed = 0;
+    parallel_for((int64_t) m_regions.size(), [&](int64_t i) {
+        AudioBuffer region;
+        if (!the_app.buffer.copy_region(m_regions[i].start, m_regions[i].end, region) || !the_app.io.write(region, paths[i], format))
+            num_failed++;
+    });
+    QApplication::restoreOverrideCursor();
+
+    if (num_failed > 0)
+        show_error_box(QString("%1 of %2 regions could not be written").arg(num_failed.load()).arg(m_regions.size()));
+    else
+        m_summary->setText(tr("Exported %1 files to %2").arg(m_regions.size()).arg(info.dir().path()));
+}
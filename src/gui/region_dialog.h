@@ -0,0 +1,44 @@
+#pragma once
+
+#include "../region_detect.h"
+#include <QDialog>
+#include <QComboBox>
+#include <QDoubleSpinBox>
+#include <QListWidget>
+#include <QLabel>
+#include <QPushButton>
+
+// finds the sounding parts of the recording, or the stretches between onsets, and lets them be
+// previewed, selected or exported as separate files
+class RegionDialog : public QDialog {
+    Q_OBJECT
+public:
+    explicit RegionDialog(QWidget* parent = nullptr);
+    ~RegionDialog();
+
+    // the region to select once the dialog is accepted
+    DetectedRegion get_selected_region() const;
+
+private:
+    void detect();
+    void preview();
+    void export_all();
+    void update_enabled();
+    void save_settings() const;
+
+private:
+    QComboBox* m_mode;
+    QDoubleSpinBox* m_threshold;
+    QDoubleSpinBox* m_min_silence;
+    QDoubleSpinBox* m_min_region;
+    QDoubleSpinBox* m_padding;
+    QDoubleSpinBox* m_sensitivity;
+    QDoubleSpinBox* m_min_spacing;
+    QListWidget* m_list;
+    QLabel* m_summary;
+    QPushButton* m_preview_button;
+    QPushButton* m_select_button;
+    QPushButton* m_export_button;
+
+    std::vector<DetectedRegion> m_regions;
+};
@@ -1,14 +1,56 @@
 #include "settings.h"
 #include "ui_settings.h"
+#include "../app.h"
+
+static const int buffer_sizes[] = {
+    0, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096,
+};
 
 Settings::Settings(QWidget *parent)
     : QDialog(parent)
     , ui(new Ui::Settings)
 {
     ui->setupUi(this);
+
+    const AudioInterface::StreamConfig& config = the_app.interface.get_config();
+
+    for (int size : buffer_sizes) {
+        ui->bufferSizeBox->addItem(size == 0 ? tr("Automatic") : QString::number(size), size);
+        if (size == config.frames_per_buffer)
+            ui->bufferSizeBox->setCurrentIndex(ui->bufferSizeBox->count() - 1);
+    }
+
+    // 0 shows up as "Device default"
+    ui->latencyBox->setValue(config.latency < 0 ? 0 : config.latency * 1000.0);
+
+    ui->resampleBox->setChecked(config.resample);
+    ui->resampleQualityBox->setCurrentIndex((int) config.resample_quality);
+    ui->loopCrossfadeBox->setValue(config.loop_crossfade * 1000.0);
+
+    ui->limitExportBox->setChecked(the_app.io.limit_exports);
+    ui->exportCeilingBox->setValue(the_app.io.export_ceiling_dbtp);
 }
 
 Settings::~Settings()
 {
     delete ui;
 }
+
+void Settings::accept()
+{
+    AudioInterface::StreamConfig config = the_app.interface.get_config();
+    config.frames_per_buffer = ui->bufferSizeBox->currentData().toInt();
+    config.latency = ui->latencyBox->value() <= 0 ? -1 : ui->latencyBox->value() / 1000.0;
+    config.resample = ui->resampleBox->isChecked();
+    config.resample_quality = (Resampler::Quality) ui->resampleQualityBox->currentIndex();
+    config.loop_crossfade = ui->loopCrossfadeBox->value() / 1000.0;
+
+    // takes effect the next time a stream is opened
+    the_app.interface.set_config(config);
+
+    the_app.io.limit_exports = ui->limitExportBox->isChecked();
+    the_app.io.export_ceiling_dbtp = ui->exportCeilingBox->value();
+    save_settings();
+
+    QDialog::accept();
+}
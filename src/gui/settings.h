@@ -14,6 +14,8 @@ public:
     explicit Settings(QWidget *parent = nullptr);
     ~Settings();
 
+    void accept() override;
+
 private:
     Ui::Settings *ui;
 };
@@ -0,0 +1,64 @@
+#include "stretch_dialog.h"
+
+#include <QFormLayout>
+#include <QVBoxLayout>
+#include <QDialogButtonBox>
+#include <QSettings>
+
+StretchDialog::StretchDialog(QWidget* parent) : QDialog(parent) {
+    setWindowTitle(tr("Time Stretch"));
+
+    QSettings settings("AudioEditor", "AudioEditor");
+    StretchOptions defaults;
+
+    m_mode = new QComboBox();
+    m_mode->addItem(tr("Phase vocoder (music)"));
+    m_mode->addItem(tr("WSOLA (speech)"));
+    m_mode->setCurrentIndex(settings.value("stretch/mode", (int) defaults.mode).toInt() == (int) StretchMode::WSOLA ? 1 : 0);
+
+    m_speed = new QDoubleSpinBox();
+    m_speed->setRange(0.25, 4);
+    m_speed->setDecimals(3);
+    m_speed->setSingleStep(0.05);
+    m_speed->setSuffix("x");
+    m_speed->setValue(settings.value("stretch/speed", defaults.speed).toDouble());
+
+    m_pitch = new QDoubleSpinBox();
+    m_pitch->setRange(-24, 24);
+    m_pitch->setDecimals(2);
+    m_pitch->setSingleStep(1);
+    m_pitch->setSuffix(tr(" semitones"));
+    m_pitch->setValue(settings.value("stretch/pitch", defaults.pitch_semitones).toDouble());
+
+    QFormLayout* form = new QFormLayout();
+    form->addRow(tr("Algorithm"), m_mode);
+    form->addRow(tr("Speed"), m_speed);
+    form->addRow(tr("Pitch"), m_pitch);
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addLayout(form);
+    layout->addWidget(buttons);
+}
+
+StretchOptions StretchDialog::get_options() const {
+    StretchOptions options;
+    options.mode = m_mode->currentIndex() == 1 ? StretchMode::WSOLA : StretchMode::PHASE_VOCODER;
+    options.speed = m_speed->value();
+    options.pitch_semitones = m_pitch->value();
+    return options;
+}
+
+void StretchDialog::accept() {
+    StretchOptions options = get_options();
+
+    QSettings settings("AudioEditor", "AudioEditor");
+    settings.setValue("stretch/mode", (int) options.mode);
+    settings.setValue("stretch/speed", options.speed);
+    settings.setValue("stretch/pitch", options.pitch_semitones);
+
+    QDialog::accept();
+}
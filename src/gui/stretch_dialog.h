@@ -0,0 +1,22 @@
+#pragma once
+
+#include "../time_stretch.h"
+#include <QDialog>
+#include <QComboBox>
+#include <QDoubleSpinBox>
+
+// asks for the speed, pitch shift and algorithm of a time stretch, remembering the last choice
+class StretchDialog : public QDialog {
+    Q_OBJECT
+public:
+    explicit StretchDialog(QWidget* parent = nullptr);
+
+    StretchOptions get_options() const;
+
+    void accept() override;
+
+private:
+    QComboBox* m_mode;
+    QDoubleSpinBox* m_speed;
+    QDoubleSpinBox* m_pitch;
+};
@@ -0,0 +1,678 @@
+#include "journal.h"
+
+#include "audio_buffer.h"
+#include "edit_list.h"
+#include "file_io.h"
+#include "project.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <time.h>
+
+static const uint32_t record_magic = 0x4c4e524a; // "JRNL"
+static const int64_t block_frames = 1 << 16;
+
+// edits that come in within this long of each other share a sync
+static const std::chrono::milliseconds sync_interval(500);
+
+// a splice shares the buffer with the writer, an edit made before the writer got to it copies all
+// of it, so the changed frames of one shorter than this are copied right away instead
+static const int64_t copy_splice_frames = 1 << 20;
+
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t type;
+    uint64_t size;
+    uint64_t checksum; // of what follows
+};
+
+// fnv-1a, continued from hash
+static uint64_t checksum(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = (const unsigned char*) data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::string generation_path(const std::string& dir, const char* name, int generation) {
+    return (std::filesystem::path(dir) / (std::string(name) + "." + std::to_string(generation))).string();
+}
+
+// the generations there are journals of, newest first
+static std::vector<int> get_generations(const std::string& dir) {
+    std::vector<int> generations;
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(dir, error), end; !error && it != end; it.increment(error)) {
+        std::string name = it->path().filename().string();
+        if (name.rfind("journal.", 0) == 0)
+            generations.push_back(atoi(name.c_str() + 8));
+    }
+    std::sort(generations.rbegin(), generations.rend());
+    return generations;
+}
+
+static bool get_file_identity(const std::string& path, int64_t& size, int64_t& modified) {
+    std::error_code size_error, time_error;
+    size = (int64_t) std::filesystem::file_size(path, size_error);
+    modified = (int64_t) std::filesystem::last_write_time(path, time_error).time_since_epoch().count();
+    return !size_error && !time_error;
+}
+
+Journal::~Journal() {
+    stop();
+}
+
+bool Journal::start(const std::string& recovery_dir) {
+    Q_ASSERT(m_dir.empty());
+
+    std::string name = std::to_string((long long) time(nullptr)) + "-" + std::to_string(QCoreApplication::applicationPid());
+    std::filesystem::path dir = std::filesystem::path(recovery_dir) / name;
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+    if (error)
+        return false;
+
+    // only a lock whose instance is gone counts as stale, no matter how old it is
+    m_lock = std::make_unique<QLockFile>(QString::fromStdString((dir / "lock").string()));
+    m_lock->setStaleLockTime(0);
+    if (!m_lock->tryLock(0)) {
+        m_lock.reset();
+        return false;
+    }
+
+    m_dir = dir.string();
+    m_stop = false;
+    m_thread = std::thread(&Journal::writer_thread, this);
+    return true;
+}
+
+// whatever was queued still gets written
+void Journal::stop() {
+    if (!m_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+
+    if (m_log)
+        fclose(m_log);
+    if (m_frames)
+        fclose(m_frames);
+    m_log = nullptr;
+    m_frames = nullptr;
+}
+
+void Journal::discard() {
+    if (m_dir.empty())
+        return;
+
+    // nothing that is still queued is needed anymore
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.clear();
+    }
+
+    stop();
+    m_lock.reset();
+    remove_session(m_dir);
+    m_dir.clear();
+}
+
+void Journal::record_load(const std::string& path) {
+    m_base_path = path;
+    m_document = path;
+    if (m_dir.empty())
+        return;
+
+    Task task;
+    task.type = Type::LOAD;
+    task.path = path;
+    get_file_identity(path, task.body.file_size, task.body.file_modified);
+    push(std::move(task));
+}
+
+void Journal::record_new(int num_channels, int sample_rate) {
+    m_base_path.clear();
+    m_document.clear();
+    if (m_dir.empty())
+        return;
+
+    Task task;
+    task.type = Type::NEW;
+    task.body.num_channels = num_channels;
+    task.body.sample_rate = sample_rate;
+    push(std::move(task));
+}
+
+void Journal::record_snapshot(const AudioBuffer& buffer, const std::string& document) {
+    m_base_path.clear();
+    m_document = document;
+    if (m_dir.empty())
+        return;
+
+    Task task;
+    task.type = Type::SNAPSHOT;
+    task.path = document;
+    task.body.new_end = buffer.get_num_frames();
+    task.body.num_frames = buffer.get_num_frames();
+    task.body.num_channels = buffer.get_num_channels();
+    task.body.sample_rate = buffer.get_sample_rate();
+    task.buffer = std::make_shared<const AudioBuffer>(buffer);
+    push(std::move(task));
+}
+
+void Journal::record_snapshot(std::shared_ptr<const EditList> edits, const std::string& document) {
+    m_base_path.clear();
+    m_document = document;
+    if (m_dir.empty())
+        return;
+
+    Task task;
+    task.type = Type::SNAPSHOT;
+    task.path = document;
+    task.body.new_end = edits->get_num_frames();
+    task.body.num_frames = edits->get_num_frames();
+    task.body.num_channels = edits->get_num_channels();
+    task.body.sample_rate = edits->get_sample_rate();
+    task.edits = std::move(edits);
+    push(std::move(task));
+}
+
+void Journal::record_splice(const AudioBuffer& buffer, int64_t start, int64_t new_end) {
+    if (m_dir.empty())
+        return;
+
+    int64_t num_frames = buffer.get_num_frames();
+    start = std::max((int64_t) 0, std::min(num_frames, start));
+    new_end = std::max(start, std::min(num_frames, new_end));
+
+    Task task;
+    task.type = Type::SPLICE;
+    task.body.start = start;
+    task.body.new_end = new_end;
+    task.body.num_frames = num_frames;
+    task.body.num_channels = buffer.get_num_channels();
+    task.body.sample_rate = buffer.get_sample_rate();
+    if (new_end - start < copy_splice_frames) {
+        const float* samples = buffer.get_samples().data();
+        task.frames.assign(samples + start * task.body.num_channels, samples + new_end * task.body.num_channels);
+    } else {
+        task.buffer = std::make_shared<const AudioBuffer>(buffer);
+    }
+    push(std::move(task));
+}
+
+void Journal::record_splice(std::shared_ptr<const EditList> edits, int64_t start, int64_t new_end) {
+    if (m_dir.empty())
+        return;
+
+    int64_t num_frames = edits->get_num_frames();
+    start = std::max((int64_t) 0, std::min(num_frames, start));
+    new_end = std::max(start, std::min(num_frames, new_end));
+
+    Task task;
+    task.type = Type::SPLICE;
+    task.body.start = start;
+    task.body.new_end = new_end;
+    task.body.num_frames = num_frames;
+    task.body.num_channels = edits->get_num_channels();
+    task.body.sample_rate = edits->get_sample_rate();
+    task.edits = std::move(edits);
+    push(std::move(task));
+}
+
+void Journal::record_restore(const AudioBuffer& before, const AudioBuffer& after) {
+    if (m_dir.empty())
+        return;
+
+    // an undo of a sample rate change, none of the frames are the same
+    if (before.get_num_channels() != after.get_num_channels() || before.get_sample_rate() != after.get_sample_rate()) {
+        record_snapshot(after, m_document);
+        return;
+    }
+
+    int64_t prefix, suffix;
+    before.find_common(after, prefix, suffix);
+    record_splice(after, prefix, after.get_num_frames() - suffix);
+}
+
+// the lists share their untouched pieces, comparing those from both ends finds what the undo changed
+void Journal::record_restore(const EditList& before, std::shared_ptr<const EditList> after) {
+    if (m_dir.empty())
+        return;
+
+    auto same = [](const EditList::Piece& a, const EditList::Piece& b) {
+        return a.source == b.source && a.source_start == b.source_start && a.length == b.length;
+    };
+
+    const std::vector<EditList::Piece>& a = before.get_pieces();
+    const std::vector<EditList::Piece>& b = after->get_pieces();
+
+    size_t front = 0;
+    int64_t prefix = 0;
+    while (front < a.size() && front < b.size() && same(a[front], b[front]))
+        prefix += a[front++].length;
+
+    size_t back = 0;
+    int64_t suffix = 0;
+    while (back < a.size() - front && back < b.size() - front && same(a[a.size() - 1 - back], b[b.size() - 1 - back]))
+        suffix += a[a.size() - 1 - back++].length;
+
+    int64_t new_end = after->get_num_frames() - suffix;
+    record_splice(std::move(after), prefix, new_end);
+}
+
+void Journal::record_trim(int64_t start, int64_t num_frames) {
+    if (m_dir.empty())
+        return;
+
+    Task task;
+    task.type = Type::TRIM;
+    task.body.start = start;
+    task.body.num_frames = num_frames;
+    push(std::move(task));
+}
+
+void Journal::record_resample(int sample_rate, RateConverter converter, Resampler::Quality quality) {
+    if (m_dir.empty())
+        return;
+
+    Task task;
+    task.type = Type::RESAMPLE;
+    task.body.sample_rate = sample_rate;
+    task.body.converter = (int32_t) converter;
+    task.body.quality = (int32_t) quality;
+    push(std::move(task));
+}
+
+void Journal::record_saved(const std::string& path) {
+    m_document = path;
+    if (m_dir.empty())
+        return;
+
+    Task task;
+    task.type = Type::SAVED;
+    task.path = path;
+    push(std::move(task));
+}
+
+void Journal::push(Task&& task) {
+    task.body.time = (int64_t) time(nullptr);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back(std::move(task));
+    m_cond.notify_one();
+}
+
+void Journal::writer_thread() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cond.wait(lock, [this] { return !m_tasks.empty() || m_stop; });
+        if (m_tasks.empty())
+            break;
+
+        // a burst of edits goes out with a single sync
+        if (!m_stop)
+            m_cond.wait_for(lock, sync_interval, [this] { return m_stop; });
+
+        std::deque<Task> tasks;
+        tasks.swap(m_tasks);
+        lock.unlock();
+        write_tasks(tasks);
+        lock.lock();
+    }
+}
+
+void Journal::write_tasks(std::deque<Task>& tasks) {
+    // anything queued before the last base is replaced by it
+    size_t first = 0;
+    for (size_t i = 0; i < tasks.size(); i++) {
+        if (is_base(tasks[i].type))
+            first = i;
+    }
+
+    std::string records;
+    for (size_t i = first; i < tasks.size(); i++) {
+        Task& task = tasks[i];
+        bool base = is_base(task.type);
+        if (base) {
+            // what's still pending belongs to the generation this one replaces
+            sync(records);
+            begin_generation();
+        }
+
+        // a generation that lost a record can't be replayed past it, so nothing more goes into it
+        if (m_failed)
+            continue;
+        if ((task.type == Type::SNAPSHOT || task.type == Type::SPLICE) && !write_frames(task))
+            continue;
+
+        RecordHeader header;
+        header.magic = record_magic;
+        header.type = (uint32_t) task.type;
+        header.size = sizeof(Body) + task.path.size();
+        std::string payload((const char*) &task.body, sizeof(Body));
+        payload += task.path;
+        header.checksum = checksum(payload.data(), payload.size());
+        records.append((const char*) &header, sizeof(header));
+        records += payload;
+
+        if (base) {
+            sync(records);
+            if (!m_failed) {
+                for (int generation : get_generations(m_dir)) {
+                    if (generation >= m_generation)
+                        continue;
+                    std::error_code error;
+                    std::filesystem::remove(generation_path(m_dir, "journal", generation), error);
+                    std::filesystem::remove(generation_path(m_dir, "frames", generation), error);
+                }
+            }
+        }
+    }
+
+    sync(records);
+}
+
+// appends frames [start, new_end) of the task to the frames file and notes where they went
+bool Journal::write_frames(Task& task) {
+    Body& body = task.body;
+    body.frames_offset = m_frames_size;
+    body.frames_checksum = checksum(nullptr, 0);
+    m_frames_dirty = true;
+
+    auto write = [&](const float* samples, size_t count) {
+        if (count == 0)
+            return true;
+        if (fwrite(samples, sizeof(float), count, m_frames) != count)
+            return false;
+        body.frames_checksum = checksum(samples, count * sizeof(float), body.frames_checksum);
+        m_frames_size += count * sizeof(float);
+        return true;
+    };
+
+    bool ok = true;
+    if (task.edits) {
+        // the edit list renders what hasn't been yet, here rather than on the gui thread
+        std::vector<float> block((size_t) block_frames * body.num_channels);
+        for (int64_t pos = body.start; pos < body.new_end && ok; pos += block_frames) {
+            int64_t num_frames = std::min(block_frames, body.new_end - pos);
+            task.edits->read(pos, num_frames, block.data());
+            ok = write(block.data(), (size_t) num_frames * body.num_channels);
+        }
+    } else if (task.buffer) {
+        const float* samples = task.buffer->get_samples().data();
+        ok = write(samples + body.start * body.num_channels, (size_t) (body.new_end - body.start) * body.num_channels);
+    } else {
+        ok = write(task.frames.data(), task.frames.size());
+    }
+
+    // the queue holds on to the tasks until the whole batch is done, the buffer gets its frames
+    // to itself again as soon as they're written
+    task.edits.reset();
+    task.buffer.reset();
+    std::vector<float>().swap(task.frames);
+
+    if (!ok)
+        fail("could not write the frames of an edit");
+    return ok;
+}
+
+void Journal::sync(std::string& records) {
+    if (records.empty() || m_failed) {
+        records.clear();
+        return;
+    }
+
+    // the frames have to be on the disk before any record that refers to them
+    if (m_frames_dirty && !sync_file(m_frames)) {
+        fail("could not sync the frames file");
+        records.clear();
+        return;
+    }
+    m_frames_dirty = false;
+
+    if (fwrite(records.data(), 1, records.size(), m_log) != records.size() || !sync_file(m_log))
+        fail("could not write the journal");
+    records.clear();
+}
+
+void Journal::begin_generation() {
+    if (m_log)
+        fclose(m_log);
+    if (m_frames)
+        fclose(m_frames);
+
+    m_generation++;
+    m_log = fopen(generation_path(m_dir, "journal", m_generation).c_str(), "wb");
+    m_frames = fopen(generation_path(m_dir, "frames", m_generation).c_str(), "wb");
+    m_frames_size = 0;
+    m_frames_dirty = false;
+    m_failed = false;
+
+    if (!m_log || !m_frames)
+        fail("could not create the journal files");
+}
+
+void Journal::fail(const char* what) {
+    if (!m_failed)
+        qDebug() << "recovery journal:" << what << "in" << m_dir.c_str() << "- edits are not recorded until the next save or load";
+    m_failed = true;
+}
+
+// the records of a generation up to the first one that didn't make it to disk whole, false if
+// there isn't a base at the start of it
+bool Journal::read_generation(const std::string& dir, int generation, std::vector<Record>& records) {
+    records.clear();
+    std::ifstream file(generation_path(dir, "journal", generation), std::ios::binary);
+
+    RecordHeader header;
+    while (file.read((char*) &header, sizeof(header))) {
+        if (header.magic != record_magic || header.size < sizeof(Body) || header.size > sizeof(Body) + 65536)
+            break;
+
+        std::string payload(header.size, '\0');
+        if (!file.read(payload.data(), payload.size()) || checksum(payload.data(), payload.size()) != header.checksum)
+            break;
+
+        Record record;
+        record.type = (Type) header.type;
+        memcpy(&record.body, payload.data(), sizeof(Body));
+        record.path = payload.substr(sizeof(Body));
+        records.push_back(std::move(record));
+    }
+
+    return !records.empty() && is_base(records[0].type);
+}
+
+std::vector<Journal::Session> Journal::find_sessions(const std::string& recovery_dir) {
+    std::vector<Session> sessions;
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(recovery_dir, error), end; !error && it != end; it.increment(error)) {
+        if (!it->is_directory())
+            continue;
+
+        Session session;
+        session.dir = it->path().string();
+        session.lock = std::make_shared<QLockFile>(QString::fromStdString((it->path() / "lock").string()));
+        session.lock->setStaleLockTime(0);
+        if (!session.lock->tryLock(0))
+            continue;
+
+        std::vector<Record> records;
+        for (int generation : get_generations(session.dir)) {
+            if (read_generation(session.dir, generation, records))
+                break;
+        }
+
+        for (const Record& record : records) {
+            session.modified = record.body.time;
+            switch (record.type) {
+            case Type::LOAD:
+            case Type::SAVED:
+                session.document = record.path;
+                session.dirty = false;
+                break;
+            case Type::NEW:
+                session.document.clear();
+                session.dirty = false;
+                break;
+            case Type::SNAPSHOT:
+                session.document = record.path;
+                session.dirty = true;
+                break;
+            default:
+                session.dirty = true;
+                break;
+            }
+        }
+
+        sessions.push_back(std::move(session));
+    }
+
+    std::sort(sessions.begin(), sessions.end(), [](const Session& a, const Session& b) {
+        return a.modified > b.modified;
+    });
+    return sessions;
+}
+
+bool Journal::replay(const std::string& dir, AudioBuffer& out, std::string& error) {
+    std::vector<Record> records;
+    int generation = -1;
+    for (int candidate : get_generations(dir)) {
+        if (read_generation(dir, candidate, records)) {
+            generation = candidate;
+            break;
+        }
+    }
+
+    if (generation < 0) {
+        error = "the journal has nothing to recover";
+        return false;
+    }
+
+    std::ifstream frames_file(generation_path(dir, "frames", generation), std::ios::binary);
+
+    // reads the frames a record refers to, false if they aren't what was written
+    auto read_frames = [&](const Body& body, std::vector<float>& frames) {
+        frames.resize((size_t) (body.new_end - body.start) * body.num_channels);
+        frames_file.clear();
+        frames_file.seekg(body.frames_offset);
+        if (!frames_file.read((char*) frames.data(), frames.size() * sizeof(float)))
+            return false;
+        return checksum(frames.data(), frames.size() * sizeof(float)) == body.frames_checksum;
+    };
+
+    int num_channels = 2;
+    int sample_rate = 44100;
+    std::vector<float> samples;
+    std::vector<float> frames;
+
+    for (const Record& record : records) {
+        const Body& body = record.body;
+        int64_t length = samples.size() / num_channels;
+
+        switch (record.type) {
+        case Type::LOAD: {
+            int64_t size, modified;
+            if (!get_file_identity(record.path, size, modified) || size != body.file_size || modified != body.file_modified) {
+                error = record.path + " has changed since the edits were made";
+                return false;
+            }
+
+            AudioBuffer file;
+            if (ProjectFile::is_project_path(record.path)) {
+                ProjectState state;
+                std::shared_ptr<ProjectFile> project;
+                if (!ProjectFile::open(record.path, state, project, error)) {
+                    error = "could not read " + record.path + ", " + error;
+                    return false;
+                }
+                state.edits.render(file);
+            } else if (!file.load_from_file(QString::fromStdString(record.path))) {
+                error = "could not read " + record.path;
+                return false;
+            }
+            num_channels = file.get_num_channels();
+            sample_rate = file.get_sample_rate();
+            samples = file.get_samples();
+            break;
+        }
+        case Type::NEW:
+            num_channels = body.num_channels;
+            sample_rate = body.sample_rate;
+            samples.clear();
+            break;
+        case Type::SNAPSHOT:
+            if (!read_frames(body, samples)) {
+                error = "the journal is damaged";
+                return false;
+            }
+            num_channels = body.num_channels;
+            sample_rate = body.sample_rate;
+            break;
+        case Type::SPLICE: {
+            // what the edit took out follows from the lengths before and after it
+            int64_t start = body.start;
+            int64_t inserted = body.new_end - body.start;
+            int64_t removed = std::max(length, start) - (body.num_frames - inserted);
+            if (body.num_channels != num_channels || removed < 0 || start + removed > std::max(length, start) || !read_frames(body, frames)) {
+                error = "the journal is damaged";
+                return false;
+            }
+
+            // a paste past the end fills the gap with silence
+            if (start > length)
+                samples.resize((size_t) start * num_channels, 0.0f);
+
+            auto where = samples.begin() + start * num_channels;
+            if (removed == inserted) {
+                std::copy(frames.begin(), frames.end(), where);
+            } else {
+                where = samples.erase(where, where + removed * num_channels);
+                samples.insert(where, frames.begin(), frames.end());
+            }
+            break;
+        }
+        case Type::TRIM:
+            if (body.start < 0 || body.num_frames < 0 || body.start + body.num_frames > length) {
+                error = "the journal is damaged";
+                return false;
+            }
+            samples.erase(samples.begin() + (body.start + body.num_frames) * num_channels, samples.end());
+            samples.erase(samples.begin(), samples.begin() + body.start * num_channels);
+            break;
+        case Type::RESAMPLE: {
+            AudioBuffer buffer;
+            buffer.init(num_channels, sample_rate, std::move(samples));
+            if (!convert_sample_rate(buffer, body.sample_rate, (RateConverter) body.converter, (Resampler::Quality) body.quality)) {
+                error = "could not convert the sample rate again";
+                return false;
+            }
+            sample_rate = body.sample_rate;
+            samples = buffer.get_samples();
+            break;
+        }
+        case Type::SAVED:
+            break;
+        }
+    }
+
+    out.init(num_channels, sample_rate, std::move(samples));
+    return true;
+}
+
+void Journal::remove_session(const std::string& dir) {
+    std::error_code error;
+    std::filesystem::remove_all(dir, error);
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "rate_convert.h"
+#include <QLockFile>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+
+class AudioBuffer;
+class EditList;
+
+// crash recovery, every edit is appended to a journal in a session directory of its own so what
+// was done since the last save can be replayed onto the audio it started from if the app dies
+// edits only queue the frames they changed, a thread writes them out and syncs in batches, frames
+// are synced before the records that refer to them, so a record that made it to disk is complete
+// loading, a new document or a save over the file the journal starts from begins a new generation
+// with a base of its own, the previous one is deleted once that base is on disk
+class Journal {
+public:
+    // what a session left behind
+    struct Session {
+        std::string dir;
+        std::string document; // the file the edits belong to, empty for a new document
+        int64_t modified = 0; // seconds since the epoch, of the last record
+        bool dirty = false; // there are edits after the last save
+        std::shared_ptr<QLockFile> lock; // held so another instance can't recover it at the same time
+    };
+
+    Journal() {}
+    ~Journal();
+
+    // creates a session under recovery_dir and starts the writer, nothing gets recorded if it couldn't
+    bool start(const std::string& recovery_dir);
+
+    // stops the writer and deletes the session, on a clean exit
+    void discard();
+
+    const std::string& get_session_dir() const { return m_dir; }
+    const std::string& get_base_path() const { return m_base_path; }
+
+    // bases, the audio a new generation starts from
+    void record_load(const std::string& path);
+    void record_new(int num_channels, int sample_rate);
+    void record_snapshot(const AudioBuffer& buffer, const std::string& document);
+    void record_snapshot(std::shared_ptr<const EditList> edits, const std::string& document);
+
+    // the edit left frames [start, new_end) new and everything before and after them as it was,
+    // the buffer or list is what it looks like afterwards
+    void record_splice(const AudioBuffer& buffer, int64_t start, int64_t new_end);
+    void record_splice(std::shared_ptr<const EditList> edits, int64_t start, int64_t new_end);
+
+    // an undo from before to after, only the frames between what both have in common are written
+    void record_restore(const AudioBuffer& before, const AudioBuffer& after);
+    void record_restore(const EditList& before, std::shared_ptr<const EditList> after);
+
+    // only num_frames from start on are left
+    void record_trim(int64_t start, int64_t num_frames);
+    void record_resample(int sample_rate, RateConverter converter, Resampler::Quality quality);
+
+    // everything so far is in the file at path
+    void record_saved(const std::string& path);
+
+    // sessions under recovery_dir whose instance didn't exit cleanly, newest first
+    // the ones still in use by a running instance are left out
+    static std::vector<Session> find_sessions(const std::string& recovery_dir);
+
+    // rebuilds the audio of a session, it ends at the first record that didn't make it to disk whole
+    // false with the reason in error if there is no base, or the file it starts from has changed since
+    static bool replay(const std::string& dir, AudioBuffer& out, std::string& error);
+
+    static void remove_session(const std::string& dir);
+
+private:
+    enum class Type : uint32_t {
+        LOAD = 1,
+        NEW,
+        SNAPSHOT,
+        SPLICE,
+        TRIM,
+        RESAMPLE,
+        SAVED,
+    };
+
+    // the fixed part of every record, a path follows it for the ones that have one
+    struct Body {
+        int64_t time = 0;
+        int64_t start = 0;
+        int64_t new_end = 0;
+        int64_t num_frames = 0; // of the audio after the edit, the trimmed length for TRIM
+        int64_t frames_offset = 0; // where [start, new_end) went in the frames file
+        uint64_t frames_checksum = 0;
+        int64_t file_size = 0;
+        int64_t file_modified = 0;
+        int32_t num_channels = 0;
+        int32_t sample_rate = 0;
+        int32_t converter = 0;
+        int32_t quality = 0;
+    };
+
+    struct Record {
+        Type type;
+        Body body;
+        std::string path;
+    };
+
+    struct Task {
+        Type type;
+        Body body;
+        std::string path;
+        std::vector<float> frames; // [start, new_end), or read from edits or buffer when one is set
+        std::shared_ptr<const EditList> edits;
+        std::shared_ptr<const AudioBuffer> buffer; // shares the frames of a snapshot or a long splice, see AudioBuffer
+    };
+
+    static bool is_base(Type type) { return type == Type::LOAD || type == Type::NEW || type == Type::SNAPSHOT; }
+    static bool read_generation(const std::string& dir, int generation, std::vector<Record>& records);
+
+    void stop();
+    void push(Task&& task);
+    void writer_thread();
+    void write_tasks(std::deque<Task>& tasks);
+    bool write_frames(Task& task);
+    void sync(std::string& records);
+    void begin_generation();
+    void fail(const char* what);
+
+    std::string m_dir;
+    std::string m_base_path; // the file the current generation starts from, if it does
+    std::string m_document; // where the edits get saved to, snapshots remember it
+    std::unique_ptr<QLockFile> m_lock;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Task> m_tasks;
+    bool m_stop = false;
+    std::thread m_thread;
+
+    // writer thread only
+    FILE* m_log = nullptr;
+    FILE* m_frames = nullptr;
+    int64_t m_frames_size = 0;
+    bool m_frames_dirty = false;
+    int m_generation = 0;
+    bool m_failed = false;
+};
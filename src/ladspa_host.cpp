@@ -0,0 +1,52 @@
+#include "ladspa_host.h"
+
+#if defined(HAVE_LADSPA)
+
+#include "plugin_host.h"
+#include "effects/ladspa_effect.h"
+#include <dlfcn.h>
+#include <stdlib.h>
+
+// the plugins in a library are told apart by their index in it
+static std::vector<std::pair<std::string, std::string>> scan_library(const std::string& path) {
+    std::vector<std::pair<std::string, std::string>> plugins;
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+        return plugins;
+
+    auto get_descriptor = (LADSPA_Descriptor_Function) dlsym(handle, "ladspa_descriptor");
+    for (unsigned long i = 0; get_descriptor; i++) {
+        const LADSPA_Descriptor* descriptor = get_descriptor(i);
+        if (!descriptor)
+            break;
+        if (LadspaPlugin::is_usable(descriptor))
+            plugins.push_back({std::to_string(i), get_plugin_cache_name(descriptor->Name ? descriptor->Name : descriptor->Label)});
+    }
+
+    dlclose(handle);
+    return plugins;
+}
+
+int register_ladspa_plugins(const std::string& cache_path) {
+    PluginFormat format;
+    format.path_variable = "LADSPA_PATH";
+    format.default_dirs = {"/usr/lib/ladspa", "/usr/local/lib/ladspa", "/usr/lib64/ladspa", "/usr/lib/x86_64-linux-gnu/ladspa"};
+    format.home_dir = ".ladspa";
+    format.extension = ".so";
+    format.bundles = false;
+    format.cache_header = "audioeditor ladspa cache 2";
+    format.submenu = "LADSPA";
+    format.scan = scan_library;
+    format.create = [](const std::string& path, const std::string& id, const std::string& name, int sample_rate) -> std::unique_ptr<Effect> {
+        return std::make_unique<LadspaEffect>(LadspaPlugin::load(path, strtoul(id.c_str(), nullptr, 10)), name, sample_rate);
+    };
+    return register_plugins(format, cache_path);
+}
+
+#else
+
+int register_ladspa_plugins(const std::string&) {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+// finds the ladspa plugins in $LADSPA_PATH or the usual directories and registers them as effects
+// what every library holds is cached in cache_path by its path, size and modification time, so
+// only new or changed libraries get loaded at startup
+// returns the number of plugins registered, always 0 when built without the ladspa sdk header
+int register_ladspa_plugins(const std::string& cache_path);
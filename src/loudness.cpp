@@ -0,0 +1,309 @@
+#include "loudness.h"
+
+#include "audio_buffer.h"
+#include "parallel.h"
+#include "simd.h"
+#include <algorithm>
+
+void KWeighting::init(double sample_rate) {
+    // pre-filter, matches the 48khz table in bs.1770 to within float precision
+    {
+        const double f0 = 1681.974450955533;
+        const double gain_db = 3.999843853973347;
+        const double q = 0.7071752369554196;
+
+        double k = tan(M_PI * f0 / sample_rate);
+        double vh = pow(10.0, gain_db / 20.0);
+        double vb = pow(vh, 0.4996667741545416);
+        double a0 = 1.0 + k / q + k * k;
+
+        shelf.b0 = (float) ((vh + vb * k / q + k * k) / a0);
+        shelf.b1 = (float) (2.0 * (k * k - vh) / a0);
+        shelf.b2 = (float) ((vh - vb * k / q + k * k) / a0);
+        shelf.a1 = (float) (2.0 * (k * k - 1.0) / a0);
+        shelf.a2 = (float) ((1.0 - k / q + k * k) / a0);
+    }
+
+    // rlb weighting
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+
+        double k = tan(M_PI * f0 / sample_rate);
+        double a0 = 1.0 + k / q + k * k;
+
+        high_pass.b0 = 1.0f;
+        high_pass.b1 = -2.0f;
+        high_pass.b2 = 1.0f;
+        high_pass.a1 = (float) (2.0 * (k * k - 1.0) / a0);
+        high_pass.a2 = (float) ((1.0 - k / q + k * k) / a0);
+    }
+}
+
+TruePeakDetector::TruePeakDetector() {
+    // blackman windowed sinc, phase 0 passes the samples through unchanged
+    const int half = num_taps / 2;
+    m_kernel.resize(oversampling * num_taps);
+
+    for (int p = 0; p < oversampling; p++) {
+        float* row = &m_kernel[p * num_taps];
+        double frac = p / (double) oversampling;
+        double sum = 0;
+
+        for (int j = 0; j < num_taps; j++) {
+            // row[j] weighs the sample j places after the oldest one in the window
+            double x = (j - half) + 1 - frac;
+            double w = 0.42 + 0.5 * cos(M_PI * x / half) + 0.08 * cos(2 * M_PI * x / half);
+            double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            row[j] = (float) (sinc * std::max(0.0, w));
+            sum += row[j];
+        }
+
+        for (int j = 0; j < num_taps; j++)
+            row[j] = (float) (row[j] / sum);
+    }
+
+    for (float tap : m_kernel)
+        m_kernel_splat.insert(m_kernel_splat.end(), 4, tap);
+
+    reset();
+}
+
+void TruePeakDetector::init(int max_block) {
+    m_history.reserve(max_block + num_taps - 1);
+    reset();
+}
+
+void TruePeakDetector::reset() {
+    m_history.assign(num_taps - 1, 0.0f);
+}
+
+float TruePeakDetector::process(const float* samples, int num_frames, int stride, float* frame_peaks) {
+    size_t offset = m_history.size();
+    m_history.resize(offset + num_frames);
+    for (int i = 0; i < num_frames; i++)
+        m_history[offset + i] = samples[i * stride];
+
+    // phase 0 is the samples themselves, at most a few frames early
+    float peak = abs_max(&m_history[offset], num_frames);
+
+    // the interpolated points of window i lie between these two samples
+    const float* aligned = &m_history[frame_delay];
+
+    int i = 0;
+#if defined(__SSE__)
+    // four consecutive output frames per register, one phase at a time
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    __m128 max = _mm_setzero_ps();
+    for (; i + 4 <= num_frames; i += 4) {
+        const float* window = &m_history[i];
+        __m128 frame_max = _mm_andnot_ps(sign_mask, _mm_loadu_ps(aligned - 1 + i));
+        for (int p = 1; p < oversampling; p++) {
+            const float* taps = &m_kernel_splat[p * num_taps * 4];
+            __m128 acc0 = _mm_mul_ps(_mm_loadu_ps(window), _mm_loadu_ps(taps));
+            __m128 acc1 = _mm_mul_ps(_mm_loadu_ps(window + 1), _mm_loadu_ps(taps + 4));
+            for (int j = 2; j < num_taps; j += 2) {
+                acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(window + j), _mm_loadu_ps(taps + j * 4)));
+                acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(window + j + 1), _mm_loadu_ps(taps + j * 4 + 4)));
+            }
+            frame_max = _mm_max_ps(frame_max, _mm_andnot_ps(sign_mask, _mm_add_ps(acc0, acc1)));
+        }
+        max = _mm_max_ps(max, frame_max);
+        if (frame_peaks)
+            _mm_storeu_ps(frame_peaks + i, frame_max);
+    }
+    peak = fmaxf(peak, horizontal_max(max));
+#endif
+    for (; i < num_frames; i++) {
+        float frame_max = fabsf(aligned[i - 1]);
+        for (int p = 1; p < oversampling; p++)
+            frame_max = fmaxf(frame_max, fabsf(dot(&m_history[i], &m_kernel[p * num_taps], num_taps)));
+        peak = fmaxf(peak, frame_max);
+        if (frame_peaks)
+            frame_peaks[i] = frame_max;
+    }
+
+    m_history.erase(m_history.begin(), m_history.end() - (num_taps - 1));
+    return peak;
+}
+
+static const double absolute_gate = -70.0; // lufs
+static const double relative_gate = -10.0; // lu below the ungated loudness
+static const int steps_per_block = 4;      // 400ms blocks overlapping by 75%
+static const int64_t min_chunk_steps = 50;
+
+// k-weights num_channels interleaved channels at once and returns their energy, the filters of
+// different channels don't depend on each other so their latencies overlap
+template <int num_channels>
+static double weigh_frames(const KWeighting& k, KWeightingState* states, const float* frames, int num_frames, int stride) {
+    float s1[num_channels], s2[num_channels], h1[num_channels], h2[num_channels];
+    double energy[num_channels];
+    for (int c = 0; c < num_channels; c++) {
+        s1[c] = states[c].shelf.z1;
+        s2[c] = states[c].shelf.z2;
+        h1[c] = states[c].high_pass.z1;
+        h2[c] = states[c].high_pass.z2;
+        energy[c] = 0;
+    }
+
+    const Biquad& s = k.shelf;
+    const Biquad& h = k.high_pass;
+    for (int i = 0; i < num_frames; i++) {
+        for (int c = 0; c < num_channels; c++) {
+            float x = frames[i * stride + c];
+            float y = s.b0 * x + s1[c];
+            s1[c] = s.b1 * x - s.a1 * y + s2[c];
+            s2[c] = s.b2 * x - s.a2 * y;
+
+            float z = h.b0 * y + h1[c];
+            h1[c] = h.b1 * y - h.a1 * z + h2[c];
+            h2[c] = h.b2 * y - h.a2 * z;
+            energy[c] += z * z;
+        }
+    }
+
+    double sum = 0;
+    for (int c = 0; c < num_channels; c++) {
+        states[c].shelf.z1 = s1[c];
+        states[c].shelf.z2 = s2[c];
+        states[c].high_pass.z1 = h1[c];
+        states[c].high_pass.z2 = h2[c];
+        sum += energy[c];
+    }
+    return sum;
+}
+
+// gating steps are 100ms long, kept on an exact frame grid for odd rates too
+static int64_t get_step_start(int64_t step, int sample_rate) {
+    return step * sample_rate / 10;
+}
+
+LoudnessStats analyze_loudness(const AudioBuffer& buffer, int64_t start, int64_t end) {
+    LoudnessStats stats;
+
+    start = std::max((int64_t) 0, start);
+    end = std::min(buffer.get_num_frames(), end);
+    if (start >= end)
+        return stats;
+
+    int num_channels = buffer.get_num_channels();
+    int sample_rate = buffer.get_sample_rate();
+    const float* samples = buffer.get_samples().data() + start * num_channels;
+    int64_t num_frames = end - start;
+
+    // the last step may be cut short, it still counts for the peaks
+    int64_t num_steps = 0;
+    while (get_step_start(num_steps, sample_rate) < num_frames)
+        num_steps++;
+
+    // the k-weighting decays below float precision well within half a second at any rate,
+    // so a chunk that filters that much of the audio before it starts lines up with a single pass
+    const int64_t warm_up_frames = sample_rate / 2;
+
+    KWeighting k;
+    k.init(sample_rate);
+
+    int64_t num_chunks = std::max((int64_t) 1, std::min((int64_t) get_num_worker_threads() * 4, num_steps / min_chunk_steps));
+    int64_t steps_per_chunk = (num_steps + num_chunks - 1) / num_chunks;
+
+    std::vector<double> energy(num_steps); // sum of squares over the step, all channels
+    std::vector<float> true_peaks(num_chunks, 0.0f);
+
+    parallel_for(num_chunks, [&](int64_t chunk) {
+        int64_t first_step = chunk * steps_per_chunk;
+        int64_t last_step = std::min(num_steps, first_step + steps_per_chunk);
+        if (first_step >= last_step)
+            return;
+
+        int64_t chunk_start = get_step_start(first_step, sample_rate);
+        int64_t warm_up_start = std::max((int64_t) 0, chunk_start - warm_up_frames);
+
+        std::vector<KWeightingState> weighting(num_channels);
+        std::vector<TruePeakDetector> detectors(num_channels);
+
+        // runs the filters over [from, to), returns the k-weighted energy of all channels
+        auto process = [&](int64_t from, int64_t to, bool measure) {
+            const float* frames = samples + from * num_channels;
+            int n = (int) (to - from);
+
+            for (int c = 0; c < num_channels; c++) {
+                if (measure) {
+                    true_peaks[chunk] = std::max(true_peaks[chunk], detectors[c].process(frames + c, n, num_channels));
+                } else {
+                    // only the last few frames before the chunk matter to the true peak detector
+                    int tail = std::min(n, TruePeakDetector::num_taps - 1);
+                    detectors[c].process(frames + (n - tail) * num_channels + c, tail, num_channels);
+                }
+            }
+
+            if (num_channels == 2)
+                return weigh_frames<2>(k, weighting.data(), frames, n, 2);
+
+            double sum = 0;
+            for (int c = 0; c < num_channels; c++)
+                sum += weigh_frames<1>(k, &weighting[c], frames + c, n, num_channels);
+            return sum;
+        };
+
+        if (warm_up_start < chunk_start)
+            process(warm_up_start, chunk_start, false);
+
+        for (int64_t step = first_step; step < last_step; step++) {
+            int64_t from = get_step_start(step, sample_rate);
+            int64_t to = std::min(num_frames, get_step_start(step + 1, sample_rate));
+            energy[step] = process(from, to, true);
+        }
+    });
+
+    for (int64_t chunk = 0; chunk < num_chunks; chunk++) {
+        stats.true_peak = std::max(stats.true_peak, true_peaks[chunk]);
+    }
+
+    // mean square of every complete 400ms block that gets past the absolute gate
+    std::vector<double> blocks;
+    for (int64_t step = 0; step + steps_per_block <= num_steps; step++) {
+        int64_t block_end = get_step_start(step + steps_per_block, sample_rate);
+        if (block_end > num_frames)
+            break;
+
+        double sum = 0;
+        for (int i = 0; i < steps_per_block; i++)
+            sum += energy[step + i];
+
+        double mean_square = sum / (block_end - get_step_start(step, sample_rate));
+        if (mean_square_to_lufs(mean_square) > absolute_gate)
+            blocks.push_back(mean_square);
+    }
+
+    if (blocks.empty())
+        return stats;
+
+    double sum = 0;
+    for (double block : blocks)
+        sum += block;
+    double threshold = mean_square_to_lufs(sum / blocks.size()) + relative_gate;
+
+    sum = 0;
+    int64_t num_gated = 0;
+    for (double block : blocks) {
+        if (mean_square_to_lufs(block) > threshold) {
+            sum += block;
+            num_gated++;
+        }
+    }
+
+    if (num_gated > 0)
+        stats.integrated = mean_square_to_lufs(sum / num_gated);
+    return stats;
+}
+
+double get_loudness_gain(const LoudnessStats& stats, double target_lufs, double ceiling_dbtp) {
+    if (!std::isfinite(stats.integrated))
+        return 0;
+
+    double gain = target_lufs - stats.integrated;
+    double true_peak = linear_to_db(stats.true_peak);
+    if (std::isfinite(true_peak))
+        gain = std::min(gain, ceiling_dbtp - true_peak);
+    return gain;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "biquad.h"
+#include <vector>
+#include <stdint.h>
+#include <math.h>
+
+class AudioBuffer;
+
+// itu-r bs.1770 building blocks, used by the live meters and the offline analysis
+
+// k-weighting, a high shelf modelling the head followed by the rlb high pass
+struct KWeighting {
+    Biquad shelf, high_pass;
+
+    // the standard only lists 48khz coefficients, these are derived for any rate
+    void init(double sample_rate);
+};
+
+struct KWeightingState {
+    BiquadState shelf, high_pass;
+
+    void reset() {
+        shelf.reset();
+        high_pass.reset();
+    }
+
+    // one channel, in place
+    void process(const KWeighting& k, float* samples, int num_frames) {
+        shelf.process(k.shelf, samples, num_frames);
+        high_pass.process(k.high_pass, samples, num_frames);
+    }
+};
+
+// mean square of k-weighted audio, summed over channels, to loudness
+inline double mean_square_to_lufs(double mean_square) {
+    return mean_square > 0 ? -0.691 + 10.0 * log10(mean_square) : -INFINITY;
+}
+
+inline double linear_to_db(double value) {
+    return value > 0 ? 20.0 * log10(value) : -INFINITY;
+}
+
+// peak of the signal reconstructed at 4x the sample rate (bs.1770 annex 2),
+// catches the overs between samples that a sample peak meter misses
+class TruePeakDetector {
+public:
+    static const int oversampling = 4;
+    static const int num_taps = 12; // per phase
+
+    TruePeakDetector();
+
+    // makes room for blocks of up to max_block frames, so process() doesn't allocate on the
+    // audio thread, longer blocks still work but grow the history
+    void init(int max_block);
+    void reset();
+
+    // frame_peaks[i] is the largest absolute value from sample i - frame_delay up to the next one
+    static const int frame_delay = num_taps / 2;
+
+    // one channel, every stride'th sample, returns the largest absolute interpolated value and
+    // optionally the peak per frame
+    float process(const float* samples, int num_frames, int stride = 1, float* frame_peaks = nullptr);
+
+private:
+    std::vector<float> m_kernel; // one row of num_taps per phase, oldest sample first
+    std::vector<float> m_kernel_splat; // every tap repeated four times, to load into a register
+    std::vector<float> m_history;
+};
+
+struct LoudnessStats {
+    double integrated = -INFINITY; // lufs, gated as in bs.1770-4 / ebu r128
+    float true_peak = 0;           // linear, largest over all channels
+};
+
+// measures a region of the buffer in parallel chunks, the 100ms gating steps never straddle
+// a chunk so merging them gives the same blocks a single pass would
+LoudnessStats analyze_loudness(const AudioBuffer& buffer, int64_t start, int64_t end);
+
+// gain in db that brings the region to target_lufs without its true peak going over ceiling_dbtp
+double get_loudness_gain(const LoudnessStats& stats, double target_lufs, double ceiling_dbtp);
@@ -0,0 +1,51 @@
+#include "lv2_host.h"
+
+#if defined(HAVE_LV2)
+
+#include "plugin_host.h"
+#include "effects/lv2_effect.h"
+
+// the plugins in a bundle are told apart by their uri
+static std::vector<std::pair<std::string, std::string>> scan_bundle(const std::string& path) {
+    std::vector<std::pair<std::string, std::string>> found;
+    LilvWorld* world = Lv2World::load_bundle(path);
+    const LilvPlugins* plugins = lilv_world_get_all_plugins(world);
+    LILV_FOREACH(plugins, it, plugins) {
+        const LilvPlugin* plugin = lilv_plugins_get(plugins, it);
+        if (!Lv2World::is_usable(world, plugin))
+            continue;
+
+        std::string uri = lilv_node_as_uri(lilv_plugin_get_uri(plugin));
+        LilvNode* label = lilv_plugin_get_name(plugin);
+        std::string name = label ? lilv_node_as_string(label) : uri;
+        lilv_node_free(label);
+        found.push_back({uri, get_plugin_cache_name(name)});
+    }
+
+    lilv_world_free(world);
+    return found;
+}
+
+int register_lv2_plugins(const std::string& cache_path) {
+    PluginFormat format;
+    format.path_variable = "LV2_PATH";
+    format.default_dirs = {"/usr/lib/lv2", "/usr/local/lib/lv2", "/usr/lib64/lv2", "/usr/lib/x86_64-linux-gnu/lv2"};
+    format.home_dir = ".lv2";
+    format.extension = ".lv2";
+    format.bundles = true;
+    format.cache_header = "audioeditor lv2 cache 1";
+    format.submenu = "LV2";
+    format.scan = scan_bundle;
+    format.create = [](const std::string&, const std::string& id, const std::string& name, int sample_rate) -> std::unique_ptr<Effect> {
+        return std::make_unique<Lv2Effect>(Lv2Plugin::load(id), name, sample_rate);
+    };
+    return register_plugins(format, cache_path);
+}
+
+#else
+
+int register_lv2_plugins(const std::string&) {
+    return 0;
+}
+
+#endif
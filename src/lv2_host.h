@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+// finds the lv2 bundles in $LV2_PATH or the usual directories and registers their plugins as effects
+// what every bundle holds is cached in cache_path by its path and the size and latest modification
+// time of its files, so only new or changed bundles get read at startup, the rest of lv2 is only
+// loaded once one of its effects is used
+// returns the number of plugins registered, always 0 when built without lilv
+int register_lv2_plugins(const std::string& cache_path);
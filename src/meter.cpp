@@ -0,0 +1,139 @@
+#include "meter.h"
+
+#include "simd.h"
+#include <QtGlobal>
+#include <chrono>
+#include <algorithm>
+
+Meter::~Meter() {
+    stop();
+}
+
+void Meter::start(int num_channels, double sample_rate) {
+    Q_ASSERT(num_channels >= 1 && num_channels <= max_channels);
+
+    // a stream that finished on its own leaves the thread running
+    stop();
+
+    m_num_channels = num_channels;
+    m_k_weighting.init(sample_rate);
+    m_block_size = std::max(1, (int) (sample_rate * block_duration));
+    m_block_frames = 0;
+    m_block_weighted = 0;
+
+    for (int c = 0; c < max_channels; c++) {
+        m_k_state[c].reset();
+        m_true_peak_detector[c].init(m_block_size);
+        m_block_squares[c] = 0;
+        m_squares_history[c].assign(short_term_blocks, 0.0);
+        m_planar[c].resize(m_block_size);
+    }
+    m_weighted_history.assign(short_term_blocks, 0.0);
+    m_history_pos = 0;
+    m_history_count = 0;
+
+    // a quarter second of slack
+    m_ring.init((size_t) (sample_rate * 0.25) * num_channels);
+    m_read_buf.resize((size_t) m_block_size * num_channels);
+    m_num_dropped = 0;
+    publish_silence();
+
+    m_running = true;
+    m_thread = std::thread(&Meter::analysis_thread, this);
+}
+
+// the stream has to be stopped before calling this
+void Meter::stop() {
+    if (!m_running)
+        return;
+
+    m_running = false;
+    m_thread.join();
+    publish_silence();
+}
+
+void Meter::push(const float* samples, int64_t num_frames) {
+    size_t count = num_frames * m_num_channels;
+    if (m_ring.write_available() < count) {
+        m_num_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    m_ring.write(samples, count);
+}
+
+void Meter::publish_silence() {
+    for (int c = 0; c < max_channels; c++) {
+        m_peak[c] = 0;
+        m_true_peak[c] = 0;
+        m_rms[c] = 0;
+    }
+    m_momentary = -INFINITY;
+    m_short_term = -INFINITY;
+}
+
+void Meter::analysis_thread() {
+    while (m_running) {
+        // never read across a block boundary, finish_block() runs between reads
+        size_t wanted = (size_t) (m_block_size - m_block_frames) * m_num_channels;
+        size_t num_read = m_ring.read(m_read_buf.data(), wanted);
+        if (num_read == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+
+        analyze(m_read_buf.data(), (int) (num_read / m_num_channels));
+    }
+}
+
+void Meter::analyze(const float* samples, int num_frames) {
+    for (int c = 0; c < m_num_channels; c++) {
+        float* planar = m_planar[c].data();
+        for (int i = 0; i < num_frames; i++)
+            planar[i] = samples[i * m_num_channels + c];
+
+        update_max(m_peak[c], abs_max(planar, num_frames));
+        update_max(m_true_peak[c], m_true_peak_detector[c].process(planar, num_frames));
+        m_block_squares[c] += sum_squares(planar, num_frames);
+
+        // bs.1770 channel weights are 1 for left, right and mono
+        m_k_state[c].process(m_k_weighting, planar, num_frames);
+        m_block_weighted += sum_squares(planar, num_frames);
+    }
+
+    m_block_frames += num_frames;
+    if (m_block_frames == m_block_size)
+        finish_block();
+}
+
+void Meter::finish_block() {
+    for (int c = 0; c < m_num_channels; c++) {
+        m_squares_history[c][m_history_pos] = m_block_squares[c] / m_block_size;
+        m_block_squares[c] = 0;
+    }
+    m_weighted_history[m_history_pos] = m_block_weighted / m_block_size;
+    m_block_weighted = 0;
+    m_block_frames = 0;
+
+    m_history_pos = (m_history_pos + 1) % short_term_blocks;
+    m_history_count = std::min(m_history_count + 1, (int) short_term_blocks);
+
+    // mean over the most recent num blocks
+    auto window_mean = [&](const std::vector<double>& history, int num) {
+        double sum = 0;
+        for (int i = 1; i <= num; i++)
+            sum += history[(m_history_pos - i + short_term_blocks) % short_term_blocks];
+        return sum / num;
+    };
+
+    for (int c = 0; c < m_num_channels; c++) {
+        int num = std::min(m_history_count, (int) rms_blocks);
+        m_rms[c].store((float) sqrt(window_mean(m_squares_history[c], num)), std::memory_order_relaxed);
+    }
+
+    // loudness is only defined once the whole window is filled
+    m_momentary.store(m_history_count >= momentary_blocks ? mean_square_to_lufs(window_mean(m_weighted_history, momentary_blocks)) : -INFINITY,
+                      std::memory_order_relaxed);
+    m_short_term.store(m_history_count >= short_term_blocks ? mean_square_to_lufs(window_mean(m_weighted_history, short_term_blocks)) : -INFINITY,
+                       std::memory_order_relaxed);
+}
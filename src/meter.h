@@ -0,0 +1,89 @@
+#pragma once
+
+#include "ring_buffer.h"
+#include "loudness.h"
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <stdint.h>
+
+// live levels of whatever is playing or being recorded
+// the audio callback only copies its blocks into a ring, a thread of its own does the analysis
+// and publishes readings through atomics for the meter widget to pick up at display rate
+class Meter {
+public:
+    static const int max_channels = 2;
+
+    // analysis granularity, the windows below are whole numbers of these
+    static constexpr double block_duration = 0.01;
+    static const int rms_blocks = 30; // 300ms
+    static const int momentary_blocks = 40; // 400ms
+    static const int short_term_blocks = 300; // 3s
+
+    Meter() {}
+    ~Meter();
+
+    // the stream must not be running yet
+    void start(int num_channels, double sample_rate);
+    void stop();
+
+    // audio thread, interleaved, drops the block if the analysis thread has fallen behind
+    void push(const float* samples, int64_t num_frames);
+
+    int get_num_channels() const { return m_num_channels; }
+
+    // linear, the highest value since the previous call
+    float take_peak(int channel) { return m_peak[channel].exchange(0, std::memory_order_relaxed); }
+    float take_true_peak(int channel) { return m_true_peak[channel].exchange(0, std::memory_order_relaxed); }
+
+    // linear, over the last 300ms
+    float get_rms(int channel) const { return m_rms[channel].load(std::memory_order_relaxed); }
+
+    // lufs, -inf until there is enough audio
+    double get_momentary() const { return m_momentary.load(std::memory_order_relaxed); }
+    double get_short_term() const { return m_short_term.load(std::memory_order_relaxed); }
+
+    uint64_t get_num_dropped() const { return m_num_dropped.load(std::memory_order_relaxed); }
+
+private:
+    void analysis_thread();
+    void analyze(const float* samples, int num_frames);
+    void finish_block();
+    void publish_silence();
+
+    static void update_max(std::atomic<float>& value, float x) {
+        float current = value.load(std::memory_order_relaxed);
+        while (x > current && !value.compare_exchange_weak(current, x, std::memory_order_relaxed)) {}
+    }
+
+private:
+    int m_num_channels = 0;
+    RingBuffer<float> m_ring;
+    std::thread m_thread;
+    std::atomic<bool> m_running = false;
+    std::atomic<uint64_t> m_num_dropped = 0;
+
+    // analysis thread
+    KWeighting m_k_weighting;
+    KWeightingState m_k_state[max_channels];
+    TruePeakDetector m_true_peak_detector[max_channels];
+    std::vector<float> m_read_buf;
+    std::vector<float> m_planar[max_channels];
+    int m_block_size = 0; // frames
+    int m_block_frames = 0; // analyzed so far in the current block
+    double m_block_squares[max_channels] = {}; // unweighted
+    double m_block_weighted = 0; // k-weighted, summed over channels
+
+    // per block mean squares, circular, short_term_blocks long
+    std::vector<double> m_squares_history[max_channels];
+    std::vector<double> m_weighted_history;
+    int m_history_pos = 0;
+    int m_history_count = 0;
+
+    // published
+    std::atomic<float> m_peak[max_channels] = {};
+    std::atomic<float> m_true_peak[max_channels] = {};
+    std::atomic<float> m_rms[max_channels] = {};
+    std::atomic<double> m_momentary = -INFINITY;
+    std::atomic<double> m_short_term = -INFINITY;
+};
@@ -0,0 +1,315 @@
+#include "mixer.h"
+
+#include "audio_buffer.h"
+#include "parallel.h"
+#include "simd.h"
+#include <QtGlobal>
+#include <thread>
+#include <algorithm>
+#include <map>
+
+static const int64_t frames_per_task = 1 << 16;
+
+int64_t Track::get_start() const {
+    if (clips.empty())
+        return 0;
+
+    int64_t start = clips[0].position;
+    for (const Clip& clip : clips)
+        start = std::min(start, clip.position);
+    return start;
+}
+
+int64_t Track::get_end() const {
+    int64_t end = 0;
+    for (const Clip& clip : clips)
+        end = std::max(end, clip.position + clip.length);
+    return end;
+}
+
+int64_t MixerState::get_end() const {
+    int64_t end = 0;
+    for (const Track& track : tracks)
+        end = std::max(end, track.get_end());
+    return end;
+}
+
+void MixerState::get_gains(const Track& track, int num_channels, float& left, float& right) const {
+    bool any_solo = main.solo;
+    for (const Track& t : tracks)
+        any_solo |= t.solo;
+
+    if (track.mute || (any_solo && !track.solo)) {
+        left = right = 0;
+        return;
+    }
+
+    if (num_channels == 1) {
+        left = right = track.gain;
+        return;
+    }
+
+    left = track.gain * std::min(1.0f, 1.0f - track.pan);
+    right = track.gain * std::min(1.0f, 1.0f + track.pan);
+}
+
+// adds num_frames of source starting at source_pos onto out, mono sources go to both sides
+static void add_source(float* out, int num_channels, const AudioBuffer& source, int64_t source_pos, int num_frames, float left, float right) {
+    int source_channels = source.get_num_channels();
+    const float* in = source.get_samples().data() + source_pos * source_channels;
+
+    if (source_channels == num_channels && num_channels == 2) {
+        multiply_add_stereo(out, in, num_frames, left, right);
+    } else if (source_channels == num_channels) {
+        multiply_add(out, in, num_frames, left);
+    } else if (num_channels == 2) {
+        multiply_add_mono_to_stereo(out, in, num_frames, left, right);
+    } else {
+        for (int i = 0; i < num_frames; i++)
+            out[i] += (in[i * 2] + in[i * 2 + 1]) * 0.5f * left;
+    }
+}
+
+void mix_track(const Track& track, int64_t pos, int64_t num_frames, float* out, int num_channels, float left, float right) {
+    int64_t end = pos + num_frames;
+
+    if (track.frozen) {
+        int64_t first = std::max(pos, track.frozen_start);
+        int64_t last = std::min(end, track.frozen_start + track.frozen->get_num_frames());
+        if (first < last)
+            add_source(out + (first - pos) * num_channels, num_channels, *track.frozen, first - track.frozen_start, (int) (last - first), left, right);
+        return;
+    }
+
+    for (const Clip& clip : track.clips) {
+        int64_t first = std::max(pos, clip.position);
+        int64_t last = std::min(end, clip.position + clip.length);
+        if (first >= last)
+            continue;
+
+        add_source(out + (first - pos) * num_channels, num_channels, *clip.source, clip.source_start + first - clip.position,
+                   (int) (last - first), left * clip.gain, right * clip.gain);
+    }
+}
+
+std::shared_ptr<const AudioBuffer> freeze_track(const Track& track, int64_t& out_start) {
+    if (track.clips.empty())
+        return nullptr;
+
+    int num_channels = 1;
+    for (const Clip& clip : track.clips)
+        num_channels = std::max(num_channels, clip.source->get_num_channels());
+
+    Track unfrozen = track;
+    unfrozen.frozen = nullptr;
+
+    int64_t start = track.get_start();
+    int64_t num_frames = track.get_end() - start;
+    std::vector<float> samples(num_frames * num_channels, 0.0f);
+
+    parallel_for((num_frames + frames_per_task - 1) / frames_per_task, [&](int64_t task) {
+        int64_t first = task * frames_per_task;
+        int64_t last = std::min(num_frames, first + frames_per_task);
+        mix_track(unfrozen, start + first, last - first, samples.data() + first * num_channels, num_channels, 1, 1);
+    });
+
+    auto frozen = std::make_shared<AudioBuffer>();
+    frozen->init(num_channels, track.clips[0].source->get_sample_rate(), std::move(samples));
+    out_start = start;
+    return frozen;
+}
+
+bool convert_track_rates(MixerState& state, int new_rate, RateConverter converter, Resampler::Quality quality) {
+    int64_t old_rate = state.sample_rate;
+    if (old_rate <= 0 || old_rate == new_rate) {
+        state.sample_rate = new_rate;
+        return true;
+    }
+
+    auto scale = [&](int64_t frame) {
+        return frame * new_rate / old_rate;
+    };
+
+    // clips cut from the same source keep sharing it
+    std::map<const AudioBuffer*, std::shared_ptr<const AudioBuffer>> converted;
+    for (Track& track : state.tracks) {
+        bool was_frozen = track.frozen != nullptr;
+        track.frozen = nullptr;
+
+        for (Clip& clip : track.clips) {
+            std::shared_ptr<const AudioBuffer>& source = converted[clip.source.get()];
+            if (!source) {
+                auto buffer = std::make_shared<AudioBuffer>(*clip.source);
+                if (!convert_sample_rate(*buffer, new_rate, converter, quality))
+                    return false;
+                source = std::move(buffer);
+            }
+
+            clip.source = source;
+            clip.source_start = std::min(scale(clip.source_start), source->get_num_frames());
+            clip.position = scale(clip.position);
+            clip.length = std::min(scale(clip.length), source->get_num_frames() - clip.source_start);
+        }
+
+        if (was_frozen)
+            track.frozen = freeze_track(track, track.frozen_start);
+    }
+
+    state.sample_rate = new_rate;
+    return true;
+}
+
+void bounce_mix(const AudioBuffer& main, const MixerState& state, AudioBuffer& out) {
+    int num_channels = main.get_num_channels();
+    int64_t main_frames = main.get_num_frames();
+    int64_t num_frames = std::max(main_frames, state.sample_rate == main.get_sample_rate() ? state.get_end() : 0);
+    std::vector<float> samples(num_frames * num_channels, 0.0f);
+
+    float main_left, main_right;
+    state.get_gains(state.main, num_channels, main_left, main_right);
+
+    parallel_for((num_frames + frames_per_task - 1) / frames_per_task, [&](int64_t task) {
+        int64_t first = task * frames_per_task;
+        int64_t last = std::min(num_frames, first + frames_per_task);
+        float* dest = samples.data() + first * num_channels;
+
+        // the edited audio first, then every track on top of it
+        int64_t main_last = std::min(last, main_frames);
+        if (first < main_last)
+            add_source(dest, num_channels, main, first, (int) (main_last - first), main_left, main_right);
+
+        if (state.sample_rate != main.get_sample_rate())
+            return;
+
+        for (const Track& track : state.tracks) {
+            float left, right;
+            state.get_gains(track, num_channels, left, right);
+            if (left != 0 || right != 0)
+                mix_track(track, first, last - first, dest, num_channels, left, right);
+        }
+    });
+
+    out.init(num_channels, main.get_sample_rate(), std::move(samples));
+}
+
+Mixer::Mixer() {
+    m_owned = std::make_shared<MixerState>();
+    m_state = m_owned.get();
+}
+
+void Mixer::set_state(std::shared_ptr<const MixerState> state) {
+    Q_ASSERT(state);
+    std::shared_ptr<const MixerState> previous = std::move(m_owned);
+    m_owned = std::move(state);
+    m_state = m_owned.get();
+
+    // both sides use seq_cst, so a callback starting after this point sees the new state
+    while (m_processing)
+        std::this_thread::yield();
+}
+
+int64_t Mixer::get_end() const {
+    return m_owned->get_end();
+}
+
+void Mixer::prepare(int num_channels, int sample_rate) {
+    m_num_channels = num_channels;
+    m_sample_rate = sample_rate;
+
+    const MixerState& state = *m_owned;
+    int num_tracks = std::min((int) state.tracks.size(), max_tracks);
+    m_gains[0].id = state.main.id;
+    state.get_gains(state.main, num_channels, m_gains[0].left, m_gains[0].right);
+    for (int t = 0; t < num_tracks; t++) {
+        m_gains[t + 1].id = state.tracks[t].id;
+        state.get_gains(state.tracks[t], num_channels, m_gains[t + 1].left, m_gains[t + 1].right);
+    }
+    m_num_gains = num_tracks + 1;
+}
+
+// gains the strip had in the last block, strips that weren't there yet fade in from silence
+void Mixer::find_gains(const StripGains* old, int num_old, int hint, uint32_t id, float& left, float& right) const {
+    if (hint < num_old && old[hint].id == id) {
+        left = old[hint].left;
+        right = old[hint].right;
+        return;
+    }
+
+    for (int i = 0; i < num_old; i++) {
+        if (old[i].id == id) {
+            left = old[i].left;
+            right = old[i].right;
+            return;
+        }
+    }
+
+    left = right = 0;
+}
+
+// x[i] *= a ramp from the old gains to the new ones over the block, per side
+static void multiply_ramp_sides(float* x, int num_channels, int num_frames, float old_left, float old_right, float left, float right) {
+    for (int i = 0; i < num_frames; i++) {
+        float t = (i + 1) / (float) num_frames;
+        x[i * num_channels] *= old_left + (left - old_left) * t;
+        if (num_channels == 2)
+            x[i * 2 + 1] *= old_right + (right - old_right) * t;
+    }
+}
+
+static void add_ramp_sides(float* out, const float* x, int num_channels, int num_frames, float old_left, float old_right, float left, float right) {
+    for (int i = 0; i < num_frames; i++) {
+        float t = (i + 1) / (float) num_frames;
+        out[i * num_channels] += x[i * num_channels] * (old_left + (left - old_left) * t);
+        if (num_channels == 2)
+            out[i * 2 + 1] += x[i * 2 + 1] * (old_right + (right - old_right) * t);
+    }
+}
+
+void Mixer::process(float* samples, int num_channels, int64_t num_frames, int64_t frame_pos) {
+    Q_ASSERT(num_channels <= 2);
+    m_processing = true;
+
+    const MixerState* state = m_state;
+    if (state->sample_rate != m_sample_rate || num_channels != m_num_channels) {
+        m_processing = false;
+        return;
+    }
+
+    int num_tracks = std::min((int) state->tracks.size(), max_tracks);
+    for (int64_t offset = 0; offset < num_frames; offset += block_size) {
+        int count = (int) std::min((int64_t) block_size, num_frames - offset);
+        float* out = samples + offset * num_channels;
+        int64_t pos = frame_pos + offset;
+        float left, right, old_left, old_right;
+
+        // the edited audio is already in out, its strip scales it in place
+        state->get_gains(state->main, num_channels, left, right);
+        find_gains(m_gains, m_num_gains, 0, state->main.id, old_left, old_right);
+        m_next_gains[0] = {state->main.id, left, right};
+        if (left != 1 || right != 1 || old_left != 1 || old_right != 1)
+            multiply_ramp_sides(out, num_channels, count, old_left, old_right, left, right);
+
+        for (int t = 0; t < num_tracks; t++) {
+            const Track& track = state->tracks[t];
+            state->get_gains(track, num_channels, left, right);
+            find_gains(m_gains, m_num_gains, t + 1, track.id, old_left, old_right);
+            m_next_gains[t + 1] = {track.id, left, right};
+
+            if (left == old_left && right == old_right) {
+                if (left != 0 || right != 0)
+                    mix_track(track, pos, count, out, num_channels, left, right);
+                continue;
+            }
+
+            // a gain that changed is rendered at unity and added along the ramp
+            std::fill(m_scratch, m_scratch + count * num_channels, 0.0f);
+            mix_track(track, pos, count, m_scratch, num_channels, 1, 1);
+            add_ramp_sides(out, m_scratch, num_channels, count, old_left, old_right, left, right);
+        }
+
+        std::copy(m_next_gains, m_next_gains + num_tracks + 1, m_gains);
+        m_num_gains = num_tracks + 1;
+    }
+
+    m_processing = false;
+}
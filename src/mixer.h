@@ -0,0 +1,105 @@
+#pragma once
+
+#include "rate_convert.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <stdint.h>
+
+class AudioBuffer;
+
+// a stretch of a source placed on a track, the source is at the mix's sample rate
+struct Clip {
+    std::shared_ptr<const AudioBuffer> source;
+    int64_t source_start = 0;
+    int64_t length = 0;
+    int64_t position = 0; // first frame on the timeline
+    float gain = 1;
+};
+
+struct Track {
+    uint32_t id = 0;
+    std::string name;
+    std::vector<Clip> clips;
+    float gain = 1;
+    float pan = 0; // -1 is hard left, 1 hard right
+    bool mute = false;
+    bool solo = false;
+
+    // the clips mixed down once, played instead of them, gain and pan still apply on top
+    std::shared_ptr<const AudioBuffer> frozen;
+    int64_t frozen_start = 0;
+
+    int64_t get_start() const;
+    int64_t get_end() const;
+};
+
+// everything the mixer plays, never changed once it has been handed to the mixer
+struct MixerState {
+    int sample_rate = 0;
+    Track main; // the strip of the edited buffer, it has no clips
+    std::vector<Track> tracks;
+    uint32_t next_id = 1;
+
+    int64_t get_end() const;
+
+    // gains for the left and right channel of a strip, zero when muted or soloed away
+    // the pan is a balance, so mono and stereo sources come out the same and freezing is exact
+    void get_gains(const Track& track, int num_channels, float& left, float& right) const;
+};
+
+// adds frames [pos, pos + num_frames) of a track onto out
+void mix_track(const Track& track, int64_t pos, int64_t num_frames, float* out, int num_channels, float left, float right);
+
+// renders the clips of a track into one buffer at their widest channel count, in parallel chunks,
+// null if the track has no clips
+std::shared_ptr<const AudioBuffer> freeze_track(const Track& track, int64_t& out_start);
+
+// converts every clip source and position to new_rate, frozen tracks are frozen again
+// returns false if a source couldn't be converted, the state is half done then and should be dropped
+bool convert_track_rates(MixerState& state, int new_rate, RateConverter converter, Resampler::Quality quality);
+
+// mixes the edited buffer and every track into out, chunks of the timeline on the worker threads
+void bounce_mix(const AudioBuffer& main, const MixerState& state, AudioBuffer& out);
+
+// plays the tracks along with the edited buffer, the gui publishes a new state for every change
+// and the audio thread only ever reads the one it finds when a callback starts
+class Mixer {
+public:
+    static constexpr int max_tracks = 64;
+    static constexpr int block_size = 256;
+
+    Mixer();
+
+    // once this returns the audio thread no longer touches the previous state
+    void set_state(std::shared_ptr<const MixerState> state);
+    std::shared_ptr<const MixerState> get_state() const { return m_owned; }
+    int64_t get_end() const;
+
+    // only call this while no stream is running, the strips start out at their gains
+    void prepare(int num_channels, int sample_rate);
+
+    // audio thread, interleaved in place, scales the edited audio by the main strip and adds the tracks
+    void process(float* samples, int num_channels, int64_t num_frames, int64_t frame_pos);
+
+private:
+    struct StripGains {
+        uint32_t id;
+        float left, right;
+    };
+
+    void find_gains(const StripGains* old, int num_old, int hint, uint32_t id, float& left, float& right) const;
+
+    std::shared_ptr<const MixerState> m_owned;
+    std::atomic<const MixerState*> m_state = nullptr;
+    std::atomic<bool> m_processing = false;
+
+    // audio thread, gain changes ramp over one block so they don't click
+    int m_num_channels = 0;
+    int m_sample_rate = 0;
+    StripGains m_gains[max_tracks + 1];
+    StripGains m_next_gains[max_tracks + 1];
+    int m_num_gains = 0;
+    float m_scratch[block_size * 2];
+};
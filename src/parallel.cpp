@@ -0,0 +1,42 @@
+#include "parallel.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+int get_num_worker_threads() {
+    return std::max(1, (int) std::thread::hardware_concurrency());
+}
+
+void parallel_for(int64_t num_tasks, const std::function<void(int64_t)>& fn) {
+    if (num_tasks <= 0)
+        return;
+
+    int num_threads = (int) std::min((int64_t) get_num_worker_threads(), num_tasks);
+    if (num_threads == 1) {
+        for (int64_t i = 0; i < num_tasks; i++)
+            fn(i);
+        return;
+    }
+
+    // tasks are handed out dynamically since they rarely take the same time
+    std::atomic<int64_t> next_task = 0;
+    auto worker = [&]() {
+        for (;;) {
+            int64_t task = next_task.fetch_add(1);
+            if (task >= num_tasks)
+                break;
+            fn(task);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; i++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (auto& thread : threads)
+        thread.join();
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <functional>
+#include <stdint.h>
+
+int get_num_worker_threads();
+
+// runs fn(0) .. fn(num_tasks - 1) spread over the worker threads and waits for all of them
+void parallel_for(int64_t num_tasks, const std::function<void(int64_t)>& fn);
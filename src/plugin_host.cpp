@@ -0,0 +1,165 @@
+#include "plugin_host.h"
+
+#include "effect_registry.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+
+// what the cache remembers about a library or bundle, one without usable plugins is kept too so
+// it isn't scanned again on every start
+struct PluginFile {
+    int64_t size = -1; // of its files together for a bundle
+    int64_t modified = -1; // the latest of its files for a bundle
+    std::vector<std::pair<std::string, std::string>> plugins; // id, name
+};
+
+static std::vector<std::string> get_plugin_dirs(const PluginFormat& format) {
+    std::vector<std::string> dirs;
+    if (const char* path = getenv(format.path_variable)) {
+        std::stringstream stream(path);
+        std::string dir;
+        while (std::getline(stream, dir, ':')) {
+            if (!dir.empty())
+                dirs.push_back(dir);
+        }
+        return dirs;
+    }
+
+    dirs = format.default_dirs;
+    if (const char* home = getenv("HOME"))
+        dirs.push_back(std::string(home) + "/" + format.home_dir);
+    return dirs;
+}
+
+// one line per plugin: path, size, modification time, id and name separated by tabs,
+// an empty id stands for a library or bundle without usable plugins
+static std::map<std::string, PluginFile> read_cache(const std::string& cache_path, const char* header) {
+    std::map<std::string, PluginFile> files;
+    std::ifstream file(cache_path);
+    std::string line;
+    if (!std::getline(file, line) || line != header)
+        return files;
+
+    while (std::getline(file, line)) {
+        std::stringstream stream(line);
+        std::string path, size, modified, id, name;
+        if (!std::getline(stream, path, '\t') || !std::getline(stream, size, '\t') ||
+            !std::getline(stream, modified, '\t') || !std::getline(stream, id, '\t'))
+            continue;
+        std::getline(stream, name);
+
+        PluginFile& plugin_file = files[path];
+        plugin_file.size = strtoll(size.c_str(), nullptr, 10);
+        plugin_file.modified = strtoll(modified.c_str(), nullptr, 10);
+        if (!id.empty())
+            plugin_file.plugins.push_back({id, name});
+    }
+
+    return files;
+}
+
+static void write_cache(const std::string& cache_path, const char* header, const std::map<std::string, PluginFile>& files) {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path(), error);
+
+    std::ofstream file(cache_path, std::ios::trunc);
+    if (!file)
+        return;
+
+    file << header << "\n";
+    for (const auto& [path, plugin_file] : files) {
+        std::string prefix = path + "\t" + std::to_string(plugin_file.size) + "\t" + std::to_string(plugin_file.modified) + "\t";
+        if (plugin_file.plugins.empty())
+            file << prefix << "\t\n";
+        for (const auto& [id, name] : plugin_file.plugins)
+            file << prefix << id << "\t" << name << "\n";
+    }
+}
+
+// a bundle is a directory of turtle files and libraries, editing any of them changes the plugins
+static bool get_identity(const std::filesystem::directory_entry& entry, bool bundle, int64_t& size, int64_t& modified) {
+    std::error_code error;
+    if (!bundle) {
+        std::error_code time_error;
+        size = (int64_t) entry.file_size(error);
+        modified = (int64_t) entry.last_write_time(time_error).time_since_epoch().count();
+        return !error && !time_error;
+    }
+
+    if (!entry.is_directory(error))
+        return false;
+
+    size = 0;
+    modified = 0;
+    for (std::filesystem::directory_iterator it(entry.path(), error), end; !error && it != end; it.increment(error)) {
+        std::error_code size_error, time_error;
+        size += it->is_regular_file() ? (int64_t) it->file_size(size_error) : 0;
+        modified = std::max(modified, (int64_t) it->last_write_time(time_error).time_since_epoch().count());
+        if (size_error || time_error)
+            return false;
+    }
+    return !error;
+}
+
+int register_plugins(const PluginFormat& format, const std::string& cache_path) {
+    std::map<std::string, PluginFile> cached = read_cache(cache_path, format.cache_header);
+    std::map<std::string, PluginFile> files;
+    bool changed = false;
+
+    for (const std::string& dir : get_plugin_dirs(format)) {
+        // directories that don't exist are skipped like empty ones
+        std::error_code error;
+        for (std::filesystem::directory_iterator it(dir, error), end; !error && it != end; it.increment(error)) {
+            const std::filesystem::directory_entry& entry = *it;
+            if (entry.path().extension() != format.extension)
+                continue;
+
+            std::string path = entry.path().string();
+            if (files.count(path))
+                continue;
+
+            PluginFile plugin_file;
+            if (!get_identity(entry, format.bundles, plugin_file.size, plugin_file.modified))
+                continue;
+
+            auto known = cached.find(path);
+            if (known != cached.end() && known->second.size == plugin_file.size && known->second.modified == plugin_file.modified) {
+                plugin_file = known->second;
+            } else {
+                plugin_file.plugins = format.scan(path);
+                changed = true;
+            }
+            files[path] = std::move(plugin_file);
+        }
+    }
+
+    // libraries and bundles that went away drop out of the cache as well
+    if (changed || files.size() != cached.size())
+        write_cache(cache_path, format.cache_header, files);
+
+    std::vector<EffectInfo> infos;
+    for (const auto& [path, plugin_file] : files) {
+        for (const auto& [id, name] : plugin_file.plugins) {
+            infos.push_back({QString::fromStdString(name), false, [create = format.create, path = path, id = id, name = name](int sample_rate) {
+                return create(path, id, name, sample_rate);
+            }, format.submenu});
+        }
+    }
+
+    std::sort(infos.begin(), infos.end(), [](const EffectInfo& a, const EffectInfo& b) {
+        return a.name.compare(b.name, Qt::CaseInsensitive) < 0;
+    });
+    for (const EffectInfo& info : infos)
+        register_effect(info);
+
+    return (int) infos.size();
+}
+
+std::string get_plugin_cache_name(std::string name) {
+    std::replace_if(name.begin(), name.end(), [](char c) { return c == '\t' || c == '\n'; }, ' ');
+    return name;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "effect.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// what the ladspa and lv2 hosts tell the discovery apart by, everything else about finding plugins,
+// caching what's in them and registering them as effects is the same for both
+struct PluginFormat {
+    const char* path_variable; // directories separated by colons, replaces the default ones
+    std::vector<std::string> default_dirs;
+    const char* home_dir; // added to the default ones
+    const char* extension;
+    bool bundles; // plugins come in directories instead of single libraries
+    const char* cache_header; // bumped whenever the cache lines change
+    const char* submenu;
+
+    // ids are whatever tells the plugins in one library or bundle apart, without tabs or newlines
+    std::function<std::vector<std::pair<std::string, std::string>>(const std::string& path)> scan; // id, name
+    std::function<std::unique_ptr<Effect>(const std::string& path, const std::string& id, const std::string& name, int sample_rate)> create;
+};
+
+// finds the libraries or bundles of a format and registers their plugins as effects
+// what every one holds is cached in cache_path by its path, size and modification time, so only
+// new or changed ones get scanned at startup
+// returns the number of plugins registered
+int register_plugins(const PluginFormat& format, const std::string& cache_path);
+
+// tabs and newlines would break the cache lines
+std::string get_plugin_cache_name(std::string name);
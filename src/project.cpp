@@ -0,0 +1,589 @@
+#include "project.h"
+
+#include "file_io.h"
+#include <QFile>
+#include <QtGlobal>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <set>
+#include <string.h>
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// everything is stored in the byte order of the machine, little endian on all the app runs on
+static const char project_magic[8] = {'A', 'E', 'P', 'R', 'O', 'J', '1', '\0'};
+static const uint32_t project_version = 1;
+static const int64_t page_size = 4096;
+static const int64_t chunk_frames = 1 << 18;
+
+// the file gets written anew once the space nothing refers to is more than what's used, and this much
+static const int64_t compact_min_garbage = (int64_t) 64 << 20;
+
+// the first page, the rest of it is left empty
+struct ProjectHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t page_size;
+    uint64_t uid;
+    uint64_t index_offset;
+    uint64_t index_size;
+    uint64_t index_checksum;
+};
+
+// fnv-1a
+static uint64_t checksum(const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*) data;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool get_file_identity(const std::string& path, int64_t& size, int64_t& modified) {
+    std::error_code size_error, time_error;
+    size = (int64_t) std::filesystem::file_size(path, size_error);
+    modified = (int64_t) std::filesystem::last_write_time(path, time_error).time_since_epoch().count();
+    return !size_error && !time_error;
+}
+
+static int64_t align_to_page(int64_t pos) {
+    return (pos + page_size - 1) / page_size * page_size;
+}
+
+// a chunk of a project, read straight from where the file is mapped
+class ProjectChunk : public EditSource {
+public:
+    ProjectChunk(std::shared_ptr<QFile> file, const float* samples, int num_channels, int64_t num_frames, uint64_t uid, uint64_t id)
+        : m_file(std::move(file)), m_samples(samples), m_num_channels(num_channels), m_num_frames(num_frames), m_uid(uid), m_id(id) {}
+
+    int64_t get_num_frames() const override { return m_num_frames; }
+    uint64_t get_uid() const { return m_uid; }
+    uint64_t get_id() const { return m_id; }
+
+    bool read(int64_t start, int64_t num_frames, float* out, bool render) const override {
+        int64_t available = std::max((int64_t) 0, std::min(num_frames, m_num_frames - start));
+        if (available > 0)
+            memcpy(out, m_samples + start * m_num_channels, available * m_num_channels * sizeof(float));
+        std::fill(out + available * m_num_channels, out + num_frames * m_num_channels, 0.0f);
+        return true;
+    }
+
+    // pages are only read in once touched, which shouldn't be up to the audio thread
+    void prefetch(int64_t start, int64_t end) const override {
+#if !defined(_WIN32)
+        start = std::max((int64_t) 0, start);
+        end = std::min(m_num_frames, end);
+        if (start >= end)
+            return;
+
+        static const uintptr_t system_page_size = (uintptr_t) sysconf(_SC_PAGESIZE);
+        uintptr_t first = (uintptr_t) (m_samples + start * m_num_channels) & ~(system_page_size - 1);
+        uintptr_t last = (uintptr_t) (m_samples + end * m_num_channels);
+        posix_madvise((void*) first, last - first, POSIX_MADV_WILLNEED);
+#endif
+    }
+
+private:
+    std::shared_ptr<QFile> m_file; // stays mapped while a chunk reads from it
+    const float* m_samples;
+    int m_num_channels;
+    int64_t m_num_frames;
+    uint64_t m_uid;
+    uint64_t m_id;
+};
+
+class IndexWriter {
+public:
+    template <typename T>
+    void write(T value) {
+        m_data.append((const char*) &value, sizeof(T));
+    }
+
+    void write_bytes(const void* data, size_t size) {
+        m_data.append((const char*) data, size);
+    }
+
+    const std::string& get_data() const { return m_data; }
+
+private:
+    std::string m_data;
+};
+
+// once something is missing every read fails, counts are checked against what is left so a
+// damaged index can't ask for more than the file holds
+class IndexReader {
+public:
+    IndexReader(const uchar* data, int64_t size) : m_data(data), m_size(size) {}
+
+    template <typename T>
+    T read() {
+        T value{};
+        read_bytes(&value, sizeof(T));
+        return value;
+    }
+
+    bool read_bytes(void* out, int64_t size) {
+        if (m_failed || size > m_size - m_pos) {
+            m_failed = true;
+            return false;
+        }
+        memcpy(out, m_data + m_pos, size);
+        m_pos += size;
+        return true;
+    }
+
+    uint64_t read_count(int64_t item_size) {
+        uint64_t count = read<uint64_t>();
+        if (count > (uint64_t) ((m_size - m_pos) / item_size))
+            m_failed = true;
+        return m_failed ? 0 : count;
+    }
+
+    bool failed() const { return m_failed; }
+
+private:
+    const uchar* m_data;
+    int64_t m_size;
+    int64_t m_pos = 0;
+    bool m_failed = false;
+};
+
+bool ProjectFile::is_project_path(const std::string& path) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".aeproj";
+}
+
+bool ProjectFile::open(const std::string& path, ProjectState& state, std::shared_ptr<ProjectFile>& project, std::string& error) {
+    auto file = std::make_shared<QFile>(QString::fromStdString(path));
+    if (!file->open(QIODevice::ReadOnly)) {
+        error = "could not open the file";
+        return false;
+    }
+
+    int64_t file_size = file->size();
+    ProjectHeader header;
+    if (file_size < page_size || file->read((char*) &header, sizeof(header)) != sizeof(header) || memcmp(header.magic, project_magic, sizeof(project_magic)) != 0) {
+        error = "it isn't a project file";
+        return false;
+    }
+    if (header.version != project_version || header.page_size != page_size) {
+        error = "it was saved by a newer version";
+        return false;
+    }
+    if (header.index_offset > (uint64_t) file_size || header.index_size > (uint64_t) file_size - header.index_offset) {
+        error = "the file is damaged";
+        return false;
+    }
+
+    const uchar* data = file->map(0, file_size);
+    if (!data) {
+        error = "could not map the file";
+        return false;
+    }
+
+    const uchar* index = data + header.index_offset;
+    if (checksum(index, header.index_size) != header.index_checksum) {
+        error = "the file is damaged";
+        return false;
+    }
+
+    auto result = std::shared_ptr<ProjectFile>(new ProjectFile());
+    result->m_path = path;
+    result->m_uid = header.uid;
+    get_file_identity(path, result->m_file_size, result->m_file_modified);
+
+    IndexReader reader(index, header.index_size);
+    int num_channels = reader.read<int32_t>();
+    int sample_rate = reader.read<int32_t>();
+    bool ok = num_channels >= 1 && num_channels <= 2 && sample_rate > 0;
+    result->m_num_channels = num_channels;
+    result->m_next_id = reader.read<uint64_t>();
+
+    uint64_t num_chunks = reader.read_count(24);
+    for (uint64_t i = 0; ok && i < num_chunks; i++) {
+        uint64_t id = reader.read<uint64_t>();
+        Chunk chunk;
+        chunk.offset = reader.read<int64_t>();
+        chunk.num_frames = reader.read<int64_t>();
+        ok = chunk.offset >= page_size && chunk.offset % page_size == 0 && chunk.num_frames > 0 && chunk.num_frames <= chunk_frames &&
+             chunk.offset <= file_size - chunk.num_frames * num_channels * (int64_t) sizeof(float) && id < result->m_next_id;
+        if (!ok)
+            break;
+
+        const float* samples = (const float*) (data + chunk.offset);
+        result->m_chunks[id] = chunk;
+        result->m_sources[id] = std::make_shared<ProjectChunk>(file, samples, num_channels, chunk.num_frames, header.uid, id);
+    }
+
+    // the document first, then the undo history
+    std::vector<EditList> lists;
+    uint64_t num_lists = ok ? reader.read_count(8) : 0;
+    for (uint64_t i = 0; ok && i < num_lists; i++) {
+        std::vector<EditList::Piece> pieces;
+        uint64_t num_pieces = reader.read_count(24);
+        for (uint64_t p = 0; ok && p < num_pieces; p++) {
+            uint64_t id = reader.read<uint64_t>();
+            int64_t start = reader.read<int64_t>();
+            int64_t length = reader.read<int64_t>();
+            auto it = result->m_sources.find(id);
+            ok = it != result->m_sources.end() && start >= 0 && length > 0 && length <= it->second->get_num_frames() - start;
+            if (ok)
+                pieces.push_back({it->second, start, length});
+        }
+        lists.push_back(EditList(num_channels, sample_rate, std::move(pieces)));
+    }
+    ok = ok && !lists.empty();
+
+    int selection_state = reader.read<int32_t>();
+    double selection_start = reader.read<double>();
+    double selection_end = reader.read<double>();
+
+    std::shared_ptr<BeatGrid> beats;
+    if (reader.read<int32_t>()) {
+        beats = std::make_shared<BeatGrid>();
+        beats->tempo = reader.read<double>();
+        beats->sample_rate = reader.read<int32_t>();
+        beats->beats.resize(reader.read_count(8));
+        reader.read_bytes(beats->beats.data(), beats->beats.size() * sizeof(int64_t));
+    }
+
+    std::vector<WaveformVisual::Level> levels(ok ? reader.read_count(12) : 0);
+    for (WaveformVisual::Level& level : levels) {
+        level.bucket_size = reader.read<int32_t>();
+        uint64_t num_buckets = reader.read_count(num_channels * sizeof(WaveformVisual::Bucket));
+        for (int channel = 0; channel < num_channels; channel++) {
+            level.buckets[channel].resize(num_buckets);
+            reader.read_bytes(level.buckets[channel].data(), num_buckets * sizeof(WaveformVisual::Bucket));
+        }
+    }
+
+    if (!ok || reader.failed()) {
+        error = "the file is damaged";
+        return false;
+    }
+
+    state.edits = std::move(lists[0]);
+    state.history.assign(std::make_move_iterator(lists.begin() + 1), std::make_move_iterator(lists.end()));
+    state.selection_state = selection_state;
+    state.selection_start = selection_start;
+    state.selection_end = selection_end;
+    state.beats = std::move(beats);
+    state.levels = std::move(levels);
+    project = std::move(result);
+    return true;
+}
+
+bool ProjectFile::save(const std::string& path, ProjectState& state, std::shared_ptr<ProjectFile>& project, std::string& error) {
+    int num_channels = state.edits.get_num_channels();
+    int sample_rate = state.edits.get_sample_rate();
+    int64_t frame_bytes = num_channels * (int64_t) sizeof(float);
+
+    std::vector<EditList*> lists = {&state.edits};
+    for (EditList& list : state.history)
+        lists.push_back(&list);
+
+    for (EditList* list : lists) {
+        for (const EditList::Piece& piece : list->get_pieces()) {
+            if (!piece.source) {
+                error = "a layout can't be saved";
+                return false;
+            }
+        }
+    }
+
+    // appending needs the file to be as it was left, and to not be mostly unused space
+    ProjectFile* previous = project.get();
+    if (previous && (previous->m_path != path || previous->m_num_channels != num_channels || !previous->is_current()))
+        previous = nullptr;
+
+    std::set<uint64_t> kept;
+    int64_t kept_bytes = page_size;
+    if (previous) {
+        for (EditList* list : lists) {
+            for (const EditList::Piece& piece : list->get_pieces()) {
+                if (previous->owns(piece.source.get()))
+                    kept.insert(static_cast<const ProjectChunk*>(piece.source.get())->get_id());
+            }
+        }
+        for (uint64_t id : kept)
+            kept_bytes += previous->m_chunks[id].num_frames * frame_bytes;
+
+        int64_t garbage = previous->m_file_size - kept_bytes;
+        if (garbage > kept_bytes && garbage > compact_min_garbage) {
+            previous = nullptr;
+            kept.clear();
+        }
+    }
+
+    // what goes into new chunks, the ranges each source is read from are merged so the frames the
+    // document and its history share are only written once
+    struct Written {
+        int64_t source_start;
+        int64_t num_frames;
+        uint64_t id;
+    };
+    struct Needed {
+        std::shared_ptr<const EditSource> source;
+        std::vector<std::pair<int64_t, int64_t>> ranges;
+        std::vector<Written> written; // by source_start
+    };
+    std::map<const EditSource*, Needed> needed;
+    for (EditList* list : lists) {
+        for (const EditList::Piece& piece : list->get_pieces()) {
+            if (previous && previous->owns(piece.source.get()))
+                continue;
+            Needed& entry = needed[piece.source.get()];
+            entry.source = piece.source;
+            entry.ranges.push_back({piece.source_start, piece.source_start + piece.length});
+        }
+    }
+
+    auto result = std::shared_ptr<ProjectFile>(new ProjectFile());
+    result->m_path = path;
+    result->m_num_channels = num_channels;
+    if (previous) {
+        result->m_uid = previous->m_uid;
+        result->m_next_id = previous->m_next_id;
+        for (uint64_t id : kept) {
+            result->m_chunks[id] = previous->m_chunks[id];
+            result->m_sources[id] = previous->m_sources[id];
+        }
+    } else {
+        std::mt19937_64 random(std::random_device{}() ^ (uint64_t) std::chrono::steady_clock::now().time_since_epoch().count());
+        result->m_uid = random();
+    }
+
+    // a new file is written next to the old one and only replaces it once it's complete
+    std::string write_path = previous ? path : path + ".tmp";
+    FILE* file = fopen(write_path.c_str(), previous ? "r+b" : "wb");
+    if (!file) {
+        error = "could not open the file for writing";
+        return false;
+    }
+
+    auto fail = [&](const char* what) {
+        fclose(file);
+        std::error_code remove_error;
+        if (!previous)
+            std::filesystem::remove(write_path, remove_error);
+        error = what;
+        return false;
+    };
+
+    static const char zeros[page_size] = {};
+    int64_t pos = previous ? previous->m_file_size : 0;
+    if (previous ? fseek(file, 0, SEEK_END) != 0 : fwrite(zeros, 1, page_size, file) != (size_t) page_size)
+        return fail("could not write the file");
+    if (!previous)
+        pos = page_size;
+
+    int64_t first_new_offset = -1;
+    std::vector<float> block;
+    for (auto& [key, entry] : needed) {
+        std::sort(entry.ranges.begin(), entry.ranges.end());
+
+        std::vector<std::pair<int64_t, int64_t>> merged;
+        for (const auto& range : entry.ranges) {
+            if (!merged.empty() && range.first <= merged.back().second)
+                merged.back().second = std::max(merged.back().second, range.second);
+            else
+                merged.push_back(range);
+        }
+
+        for (const auto& [range_start, range_end] : merged) {
+            for (int64_t start = range_start; start < range_end; start += chunk_frames) {
+                int64_t num_frames = std::min(chunk_frames, range_end - start);
+                block.resize(num_frames * num_channels);
+                entry.source->prefetch(start, start + num_frames);
+                entry.source->read(start, num_frames, block.data(), true);
+
+                int64_t offset = align_to_page(pos);
+                if (fwrite(zeros, 1, offset - pos, file) != (size_t) (offset - pos) ||
+                    fwrite(block.data(), sizeof(float), block.size(), file) != block.size())
+                    return fail("could not write the file");
+                pos = offset + num_frames * frame_bytes;
+                if (first_new_offset < 0)
+                    first_new_offset = offset;
+
+                uint64_t id = result->m_next_id++;
+                result->m_chunks[id] = {offset, num_frames};
+                entry.written.push_back({start, num_frames, id});
+            }
+        }
+    }
+
+    // the lists as pieces of chunks, the ones that weren't in the file yet split where their
+    // frames went into different chunks
+    std::vector<std::vector<std::pair<uint64_t, EditList::Piece>>> saved_lists;
+    for (EditList* list : lists) {
+        std::vector<std::pair<uint64_t, EditList::Piece>> pieces;
+        for (const EditList::Piece& piece : list->get_pieces()) {
+            if (previous && previous->owns(piece.source.get())) {
+                pieces.push_back({static_cast<const ProjectChunk*>(piece.source.get())->get_id(), piece});
+                continue;
+            }
+
+            const std::vector<Written>& written = needed[piece.source.get()].written;
+            int64_t start = piece.source_start;
+            int64_t end = piece.source_start + piece.length;
+            while (start < end) {
+                auto it = std::upper_bound(written.begin(), written.end(), start, [](int64_t pos, const Written& chunk) {
+                    return pos < chunk.source_start;
+                }) - 1;
+                int64_t length = std::min(end, it->source_start + it->num_frames) - start;
+                pieces.push_back({it->id, {nullptr, start - it->source_start, length}});
+                start += length;
+            }
+        }
+        saved_lists.push_back(std::move(pieces));
+    }
+
+    IndexWriter index;
+    index.write<int32_t>(num_channels);
+    index.write<int32_t>(sample_rate);
+    index.write<uint64_t>(result->m_next_id);
+
+    index.write<uint64_t>(result->m_chunks.size());
+    for (const auto& [id, chunk] : result->m_chunks) {
+        index.write<uint64_t>(id);
+        index.write<int64_t>(chunk.offset);
+        index.write<int64_t>(chunk.num_frames);
+    }
+
+    index.write<uint64_t>(saved_lists.size());
+    for (const auto& pieces : saved_lists) {
+        index.write<uint64_t>(pieces.size());
+        for (const auto& [id, piece] : pieces) {
+            index.write<uint64_t>(id);
+            index.write<int64_t>(piece.source_start);
+            index.write<int64_t>(piece.length);
+        }
+    }
+
+    index.write<int32_t>(state.selection_state);
+    index.write<double>(state.selection_start);
+    index.write<double>(state.selection_end);
+
+    index.write<int32_t>(state.beats ? 1 : 0);
+    if (state.beats) {
+        index.write<double>(state.beats->tempo);
+        index.write<int32_t>(state.beats->sample_rate);
+        index.write<uint64_t>(state.beats->beats.size());
+        index.write_bytes(state.beats->beats.data(), state.beats->beats.size() * sizeof(int64_t));
+    }
+
+    index.write<uint64_t>(state.levels.size());
+    for (const WaveformVisual::Level& level : state.levels) {
+        index.write<int32_t>(level.bucket_size);
+        index.write<uint64_t>(level.buckets[0].size());
+        for (int channel = 0; channel < num_channels; channel++)
+            index.write_bytes(level.buckets[channel].data(), level.buckets[channel].size() * sizeof(WaveformVisual::Bucket));
+    }
+
+    const std::string& index_data = index.get_data();
+    if (fwrite(index_data.data(), 1, index_data.size(), file) != index_data.size() || !sync_file(file))
+        return fail("could not write the file");
+
+    // everything the header points at is on the disk by now
+    ProjectHeader header = {};
+    memcpy(header.magic, project_magic, sizeof(project_magic));
+    header.version = project_version;
+    header.page_size = page_size;
+    header.uid = result->m_uid;
+    header.index_offset = pos;
+    header.index_size = index_data.size();
+    header.index_checksum = checksum(index_data.data(), index_data.size());
+    if (fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1 || !sync_file(file))
+        return fail("could not write the file");
+    fclose(file);
+
+    if (!previous) {
+        std::error_code rename_error;
+        std::filesystem::rename(write_path, path, rename_error);
+        if (rename_error) {
+            std::filesystem::remove(write_path, rename_error);
+            error = "could not replace the file";
+            return false;
+        }
+    }
+    get_file_identity(path, result->m_file_size, result->m_file_modified);
+
+    // the new chunks are read from a mapping of their own, the old ones keep theirs
+    if (first_new_offset >= 0) {
+        auto mapped = std::make_shared<QFile>(QString::fromStdString(path));
+        const uchar* data = mapped->open(QIODevice::ReadOnly) ? mapped->map(first_new_offset, pos - first_new_offset) : nullptr;
+        if (!data) {
+            error = "the project was saved but could not be mapped";
+            return false;
+        }
+
+        for (const auto& [key, entry] : needed) {
+            for (const Written& written : entry.written) {
+                const float* samples = (const float*) (data + (result->m_chunks[written.id].offset - first_new_offset));
+                result->m_sources[written.id] = std::make_shared<ProjectChunk>(mapped, samples, num_channels, written.num_frames, result->m_uid, written.id);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < lists.size(); i++) {
+        std::vector<EditList::Piece> pieces;
+        for (auto& [id, piece] : saved_lists[i])
+            pieces.push_back({result->m_sources[id], piece.source_start, piece.length});
+        *lists[i] = EditList(num_channels, sample_rate, std::move(pieces));
+    }
+
+    project = std::move(result);
+    return true;
+}
+
+EditList ProjectFile::get_layout(const EditList& edits) const {
+    std::vector<EditList::Piece> pieces;
+    for (const EditList::Piece& piece : edits.get_pieces()) {
+        if (owns(piece.source.get()))
+            pieces.push_back(piece);
+        else
+            pieces.push_back({nullptr, 0, piece.length});
+    }
+    return EditList(edits.get_num_channels(), edits.get_sample_rate(), std::move(pieces));
+}
+
+EditList ProjectFile::fill_layout(const EditList& layout, const EditList& edits) {
+    if (layout.get_num_frames() != edits.get_num_frames() || layout.get_num_channels() != edits.get_num_channels())
+        return edits;
+
+    std::vector<EditList::Piece> pieces;
+    int64_t pos = 0;
+    for (const EditList::Piece& piece : layout.get_pieces()) {
+        if (piece.source) {
+            pieces.push_back(piece);
+        } else {
+            EditList filled = edits.slice(pos, pos + piece.length);
+            pieces.insert(pieces.end(), filled.get_pieces().begin(), filled.get_pieces().end());
+        }
+        pos += piece.length;
+    }
+    return EditList(edits.get_num_channels(), edits.get_sample_rate(), std::move(pieces));
+}
+
+// nothing else wrote to it since it was opened or saved
+bool ProjectFile::is_current() const {
+    int64_t size, modified;
+    if (!get_file_identity(m_path, size, modified) || size != m_file_size || modified != m_file_modified)
+        return false;
+
+    QFile file(QString::fromStdString(m_path));
+    ProjectHeader header;
+    return file.open(QIODevice::ReadOnly) && file.read((char*) &header, sizeof(header)) == sizeof(header) && header.uid == m_uid;
+}
+
+bool ProjectFile::owns(const EditSource* source) const {
+    auto chunk = dynamic_cast<const ProjectChunk*>(source);
+    return chunk && chunk->get_uid() == m_uid && m_chunks.count(chunk->get_id());
+}
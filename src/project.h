@@ -0,0 +1,74 @@
+#pragma once
+
+#include "edit_list.h"
+#include "beat_tracker.h"
+#include "waveform_cache.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class ProjectChunk;
+
+// what a project keeps of a document besides the format, the lists only have pieces of sources
+// that can be read, see ProjectFile::fill_layout for the buffer's frames
+struct ProjectState {
+    EditList edits; // the document as it is now
+    std::vector<EditList> history; // the undo history, oldest first
+    int selection_state = 0; // an AudioWidget::SelectionState
+    double selection_start = 0; // seconds
+    double selection_end = 0;
+    std::shared_ptr<const BeatGrid> beats; // null if there is none
+    std::vector<WaveformVisual::Level> levels; // left empty if they weren't saved
+};
+
+// the native format, the frames are raw interleaved floats in chunks at page aligned offsets so
+// they can be mapped and read in place, an index after them says which chunks make up the
+// document and every step of its undo history, and the header on the first page says where the
+// index is
+// saving over the project that is open appends only the chunks that aren't in it yet and a new
+// index, the header is written last, so a save that didn't finish leaves the old index in charge
+// once the space nothing refers to anymore outgrows what's still used the file gets written anew
+class ProjectFile {
+public:
+    static bool is_project_path(const std::string& path);
+
+    // maps the file, the lists in state read from the mapping, nothing is read up front
+    static bool open(const std::string& path, ProjectState& state, std::shared_ptr<ProjectFile>& project, std::string& error);
+
+    // writes state to path, only what isn't in it yet if project is the one open at path and
+    // nothing else has touched it since, on success the lists in state read from the saved file
+    // and project is replaced with it
+    static bool save(const std::string& path, ProjectState& state, std::shared_ptr<ProjectFile>& project, std::string& error);
+
+    const std::string& get_path() const { return m_path; }
+
+    // the list with every piece that doesn't read from this file turned into a piece without
+    // a source, to keep track of which frames of the buffer are still in the file
+    EditList get_layout(const EditList& edits) const;
+
+    // the pieces without a source in layout filled in with the same frames of edits, the rest
+    // is kept, a layout that doesn't fit edits gets all of edits
+    static EditList fill_layout(const EditList& layout, const EditList& edits);
+
+private:
+    struct Chunk {
+        int64_t offset; // bytes
+        int64_t num_frames;
+    };
+
+    ProjectFile() {}
+
+    bool is_current() const;
+    bool owns(const EditSource* source) const;
+
+    std::string m_path;
+    uint64_t m_uid = 0; // new with every file that gets written from scratch
+    int m_num_channels = 0;
+    int64_t m_file_size = 0; // as it was left, a file that isn't won't be appended to
+    int64_t m_file_modified = 0;
+    std::map<uint64_t, Chunk> m_chunks; // by id
+    std::map<uint64_t, std::shared_ptr<const ProjectChunk>> m_sources; // by id, read from the mapping
+    uint64_t m_next_id = 0;
+};
@@ -0,0 +1,158 @@
+#include "rate_convert.h"
+
+#include "audio_buffer.h"
+#include "parallel.h"
+#include "ffmpeg_wrapper.h"
+#include <QtGlobal>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+static const int64_t min_chunk_frames = 1 << 16;
+
+// splits the output into chunks that are rendered independently, every chunk starts its
+// resampler at the exact phase the output frame has in the continuous stream and pushes enough
+// preceding input to fill the filter, so the seams are identical to a single pass
+static bool convert_sinc(const AudioBuffer& buffer, int new_rate, Resampler::Quality quality, int64_t out_frames, std::vector<float>& out) {
+    int num_channels = buffer.get_num_channels();
+    int64_t in_rate = buffer.get_sample_rate();
+    int64_t in_frames = buffer.get_num_frames();
+    const float* in = buffer.get_samples().data();
+
+    int64_t num_chunks = std::max((int64_t) 1, std::min((int64_t) get_num_worker_threads() * 4, out_frames / min_chunk_frames));
+    int64_t chunk_frames = (out_frames + num_chunks - 1) / num_chunks;
+
+    parallel_for(num_chunks, [&](int64_t chunk) {
+        int64_t out_start = chunk * chunk_frames;
+        int64_t out_end = std::min(out_frames, out_start + chunk_frames);
+        if (out_start >= out_end)
+            return;
+
+        Resampler resampler;
+        resampler.init(num_channels, (double) in_rate, (double) new_rate, quality);
+
+        // input position of the first output frame, kept exact in integers
+        int64_t scaled = out_start * in_rate;
+        int64_t in_pos = scaled / new_rate;
+        double frac = (scaled % new_rate) / (double) new_rate;
+
+        int lookbehind = resampler.get_lookbehind();
+        resampler.reset(lookbehind + frac);
+        in_pos -= lookbehind;
+
+        std::vector<float> block;
+        int64_t produced = out_start;
+        while (produced < out_end) {
+            int64_t wanted = std::min(out_end - produced, (int64_t) Resampler::max_block);
+            int64_t needed = std::max(resampler.get_input_needed(wanted), (int64_t) 1);
+
+            // zeros before the start and past the end, like the stream would see
+            block.assign(needed * num_channels, 0.0f);
+            int64_t copy_start = std::max(in_pos, (int64_t) 0);
+            int64_t copy_end = std::min(in_pos + needed, in_frames);
+            if (copy_start < copy_end)
+                std::copy(in + copy_start * num_channels, in + copy_end * num_channels, block.begin() + (copy_start - in_pos) * num_channels);
+
+            resampler.push(block.data(), needed);
+            in_pos += needed;
+            produced += resampler.pull(&out[produced * num_channels], wanted);
+        }
+    });
+
+    return true;
+}
+
+// swresample can't start mid-stream at a given phase, so channels run in parallel instead
+static bool convert_soxr(const AudioBuffer& buffer, int new_rate, Resampler::Quality quality, int64_t out_frames, std::vector<float>& out) {
+    int num_channels = buffer.get_num_channels();
+    int in_rate = buffer.get_sample_rate();
+    int64_t in_frames = buffer.get_num_frames();
+    const float* in = buffer.get_samples().data();
+
+    int precision;
+    switch (quality) {
+    case Resampler::Quality::LOW:    precision = 16; break;
+    case Resampler::Quality::MEDIUM: precision = 20; break;
+    case Resampler::Quality::HIGH:   precision = 24; break;
+    default:                         precision = 28; break;
+    }
+
+    std::atomic<bool> ok = true;
+    parallel_for(num_channels, [&](int64_t c) {
+        AVChannelLayout mono = AV_CHANNEL_LAYOUT_MONO;
+        SwrContext* swr = NULL;
+        swr_alloc_set_opts2(&swr, &mono, AV_SAMPLE_FMT_FLT, new_rate, &mono, AV_SAMPLE_FMT_FLT, in_rate, 0, NULL);
+        if (!swr) {
+            ok = false;
+            return;
+        }
+
+        av_opt_set_int(swr, "resampler", SWR_ENGINE_SOXR, 0);
+        av_opt_set_int(swr, "precision", precision, 0);
+        if (swr_init(swr) < 0) {
+            swr_free(&swr);
+            ok = false;
+            return;
+        }
+
+        std::vector<float> planar(in_frames);
+        for (int64_t i = 0; i < in_frames; i++)
+            planar[i] = in[i * num_channels + c];
+
+        // a little room for rounding, trimmed below
+        std::vector<float> result(out_frames + 64, 0.0f);
+        const int64_t max_call = 1 << 20;
+        int64_t done_in = 0, done_out = 0;
+        while (ok) {
+            int64_t num_in = std::min(max_call, in_frames - done_in);
+            const uint8_t* src[1] = {(const uint8_t*) (planar.data() + done_in)};
+            uint8_t* dst[1] = {(uint8_t*) (result.data() + done_out)};
+            int space = (int) std::min((int64_t) INT32_MAX, (int64_t) result.size() - done_out);
+
+            // no input left flushes what's still in the filter
+            int num_out = swr_convert(swr, dst, space, num_in > 0 ? src : NULL, (int) num_in);
+            if (num_out < 0) {
+                ok = false;
+                break;
+            }
+
+            done_in += num_in;
+            done_out += num_out;
+            if (num_in == 0 && num_out == 0)
+                break;
+            if (done_out >= (int64_t) result.size())
+                break;
+        }
+
+        swr_free(&swr);
+
+        for (int64_t i = 0; i < out_frames; i++)
+            out[i * num_channels + c] = result[i];
+    });
+
+    return ok;
+}
+
+bool convert_sample_rate(AudioBuffer& buffer, int new_rate, RateConverter converter, Resampler::Quality quality) {
+    Q_ASSERT(new_rate > 0);
+
+    int old_rate = buffer.get_sample_rate();
+    if (new_rate == old_rate)
+        return true;
+
+    int num_channels = buffer.get_num_channels();
+    int64_t out_frames = (buffer.get_num_frames() * new_rate + old_rate - 1) / old_rate;
+    std::vector<float> out(out_frames * num_channels);
+
+    bool ok;
+    if (converter == RateConverter::SOXR)
+        ok = convert_soxr(buffer, new_rate, quality, out_frames, out);
+    else
+        ok = convert_sinc(buffer, new_rate, quality, out_frames, out);
+
+    if (!ok)
+        return false;
+
+    buffer.init(num_channels, new_rate, std::move(out));
+    return true;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "resampler.h"
+
+class AudioBuffer;
+
+enum class RateConverter {
+    SINC, // our own polyphase kernel, the quality picks its length
+    SOXR, // swresample's sox engine, needs ffmpeg built with libsoxr
+};
+
+// converts the whole buffer to new_rate, keeping its duration
+// returns false and leaves the buffer alone if the conversion can't be done
+bool convert_sample_rate(AudioBuffer& buffer, int new_rate, RateConverter converter, Resampler::Quality quality);
@@ -0,0 +1,176 @@
+#include "recorder.h"
+
+#include "audio_buffer.h"
+#include <QtGlobal>
+#include <chrono>
+#include <algorithm>
+
+Recorder::~Recorder() {
+    stop();
+    if (m_file)
+        fclose(m_file);
+}
+
+bool Recorder::start(int input_channels, int num_channels, int sample_rate) {
+    Q_ASSERT(!m_running);
+    Q_ASSERT(input_channels >= 1 && input_channels <= 2);
+    Q_ASSERT(num_channels >= 1 && num_channels <= 2);
+
+    if (m_file)
+        fclose(m_file);
+
+    // deleted automatically when closed
+    m_file = tmpfile();
+    if (!m_file)
+        return false;
+
+    m_input_channels = input_channels;
+    m_num_channels = num_channels;
+    m_num_frames = 0;
+    m_num_overflows = 0;
+    m_write_failed = false;
+
+    // two seconds of slack before the writer thread has to catch up
+    m_ring.init((size_t) sample_rate * input_channels * 2);
+    m_read_buf.resize(8192 * input_channels);
+    m_write_buf.resize(8192 * num_channels);
+
+    {
+        std::lock_guard<std::mutex> lock(m_peak_mutex);
+        for (int c = 0; c < 2; c++) {
+            m_peaks[c].clear();
+            m_current_peak[c] = {2, -2};
+        }
+        m_current_peak_frames = 0;
+    }
+
+    m_running = true;
+    m_thread = std::thread(&Recorder::writer_thread, this);
+    return true;
+}
+
+// the input stream has to be stopped before calling this
+void Recorder::stop() {
+    if (!m_running)
+        return;
+
+    m_running = false;
+    m_thread.join();
+    fflush(m_file);
+}
+
+bool Recorder::splice_into(AudioBuffer& buffer, int64_t where) {
+    Q_ASSERT(!m_running);
+    Q_ASSERT(buffer.get_num_channels() == m_num_channels);
+
+    int64_t num_frames = m_num_frames;
+    if (!m_file || num_frames == 0)
+        return false;
+
+    // read the take straight into its final place in the buffer
+    float* dest = buffer.insert_frames(where, num_frames);
+    rewind(m_file);
+    size_t num_samples = (size_t) num_frames * m_num_channels;
+    size_t num_read = fread(dest, sizeof(float), num_samples, m_file);
+
+    fclose(m_file);
+    m_file = nullptr;
+    return num_read == num_samples;
+}
+
+void Recorder::push(const float* samples, int64_t num_frames) {
+    size_t count = num_frames * m_input_channels;
+
+    // never write partial frames, drop the whole block instead
+    if (m_ring.write_available() < count) {
+        m_num_overflows++;
+        return;
+    }
+
+    m_ring.write(samples, count);
+}
+
+bool Recorder::sample_peaks(int channel, int64_t start_frame, int64_t end_frame, float& min, float& max) const {
+    std::lock_guard<std::mutex> lock(m_peak_mutex);
+    const auto& peaks = m_peaks[std::min(channel, m_num_channels - 1)];
+
+    int64_t bucket_start = std::max((int64_t) 0, start_frame / peak_bucket_size);
+    int64_t bucket_end = std::min((int64_t) peaks.size() - 1, end_frame / peak_bucket_size);
+    if (bucket_start > bucket_end)
+        return false;
+
+    min = peaks[bucket_start].min;
+    max = peaks[bucket_start].max;
+    for (int64_t i = bucket_start + 1; i <= bucket_end; i++) {
+        min = std::min(min, peaks[i].min);
+        max = std::max(max, peaks[i].max);
+    }
+    return true;
+}
+
+void Recorder::writer_thread() {
+    size_t read_size = m_read_buf.size();
+
+    for (;;) {
+        // sample the flag before reading so that nothing pushed before stop() is lost
+        bool running = m_running;
+
+        size_t num_read = m_ring.read(m_read_buf.data(), read_size);
+        if (num_read == 0) {
+            if (!running)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+
+        write_frames(m_read_buf.data(), num_read / m_input_channels);
+    }
+}
+
+void Recorder::write_frames(const float* samples, int64_t num_frames) {
+    // a full disk doesn't get any emptier, the rest of the take is dropped
+    if (m_write_failed)
+        return;
+
+    const float* out = samples;
+
+    // match the channel count of the buffer we'll be spliced into
+    if (m_input_channels == 1 && m_num_channels == 2) {
+        for (int64_t i = 0; i < num_frames; i++) {
+            m_write_buf[i * 2 + 0] = samples[i];
+            m_write_buf[i * 2 + 1] = samples[i];
+        }
+        out = m_write_buf.data();
+    } else if (m_input_channels == 2 && m_num_channels == 1) {
+        for (int64_t i = 0; i < num_frames; i++)
+            m_write_buf[i] = (samples[i * 2] + samples[i * 2 + 1]) * 0.5f;
+        out = m_write_buf.data();
+    }
+
+    // flushed right away so a failure shows up here, and only whole blocks are counted, a partial
+    // one past m_num_frames is never read back
+    size_t num_samples = (size_t) num_frames * m_num_channels;
+    if (fwrite(out, sizeof(float), num_samples, m_file) != num_samples || fflush(m_file) != 0) {
+        m_write_failed = true;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_peak_mutex);
+    for (int64_t i = 0; i < num_frames; i++) {
+        for (int c = 0; c < m_num_channels; c++) {
+            float sample = out[i * m_num_channels + c];
+            m_current_peak[c].min = std::min(m_current_peak[c].min, sample);
+            m_current_peak[c].max = std::max(m_current_peak[c].max, sample);
+        }
+
+        if (++m_current_peak_frames == peak_bucket_size) {
+            for (int c = 0; c < m_num_channels; c++) {
+                m_peaks[c].push_back(m_current_peak[c]);
+                m_current_peak[c] = {2, -2};
+            }
+            m_current_peak_frames = 0;
+        }
+    }
+
+    m_num_frames += num_frames;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ring_buffer.h"
+#include "waveform_cache.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+
+class AudioBuffer;
+
+// takes audio from the input callback through a lock-free ring and spools it to a
+// scratch file from a writer thread, so long takes never live on the heap
+class Recorder {
+public:
+    Recorder() {}
+    ~Recorder();
+
+    bool start(int input_channels, int num_channels, int sample_rate);
+    void stop();
+    bool splice_into(AudioBuffer& buffer, int64_t where);
+
+    // audio thread only
+    void push(const float* samples, int64_t num_frames);
+
+    int64_t get_num_frames() const { return m_num_frames; }
+    int64_t get_num_overflows() const { return m_num_overflows; }
+
+    // the scratch file couldn't be written to, the take ends where it happened
+    bool has_write_failed() const { return m_write_failed; }
+    bool sample_peaks(int channel, int64_t start_frame, int64_t end_frame, float& min, float& max) const;
+
+    // frames per live waveform bucket
+    static const int peak_bucket_size = 1024;
+
+private:
+    void writer_thread();
+    void write_frames(const float* samples, int64_t num_frames);
+
+private:
+    RingBuffer<float> m_ring;
+    FILE* m_file = nullptr;
+    std::thread m_thread;
+    std::atomic<bool> m_running = false;
+    std::atomic<int64_t> m_num_frames = 0; // frames spooled to disk
+    std::atomic<int64_t> m_num_overflows = 0;
+    std::atomic<bool> m_write_failed = false;
+    int m_input_channels = 0;
+    int m_num_channels = 0;
+    std::vector<float> m_read_buf;
+    std::vector<float> m_write_buf;
+
+    mutable std::mutex m_peak_mutex;
+    std::vector<WaveformVisual::Bucket> m_peaks[2];
+    WaveformVisual::Bucket m_current_peak[2];
+    int m_current_peak_frames = 0;
+};
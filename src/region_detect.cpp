@@ -0,0 +1,112 @@
+#include "region_detect.h"
+
+#include "energy_index.h"
+#include <algorithm>
+#include <math.h>
+
+static const double smoothing = 0.05; // seconds of rms window for the silence gate
+static const double onset_short = 0.01;
+static const double onset_long = 0.1;
+
+static double db_to_mean_square(double db) {
+    return pow(10.0, db / 10.0);
+}
+
+std::vector<DetectedRegion> find_sound_regions(const EnergyIndex& index, const SilenceParams& params) {
+    std::vector<DetectedRegion> regions;
+    int64_t num_hops = index.get_num_hops();
+    if (num_hops == 0)
+        return regions;
+
+    double threshold = db_to_mean_square(params.threshold_db);
+    int64_t half_window = std::max((int64_t) 1, index.seconds_to_hops(smoothing) / 2);
+    int64_t min_silence = std::max((int64_t) 1, index.seconds_to_hops(params.min_silence));
+
+    // runs of silent hops long enough to split at, as [start, end) hops
+    std::vector<std::pair<int64_t, int64_t>> silences;
+    int64_t run_start = -1;
+    for (int64_t hop = 0; hop <= num_hops; hop++) {
+        bool silent = hop < num_hops && index.get_mean_square(hop - half_window, hop + half_window + 1) < threshold;
+        if (silent && run_start < 0) {
+            run_start = hop;
+        } else if (!silent && run_start >= 0) {
+            // silence at the very start or end always trims, no matter how short
+            if (hop - run_start >= min_silence || run_start == 0 || hop == num_hops)
+                silences.push_back({run_start, hop});
+            run_start = -1;
+        }
+    }
+
+    // the sound is whatever lies between the silences
+    int64_t padding = index.seconds_to_hops(params.padding);
+    int64_t min_region = index.seconds_to_hops(params.min_region);
+    int64_t sound_start = 0;
+    for (size_t i = 0; i <= silences.size(); i++) {
+        int64_t sound_end = i < silences.size() ? silences[i].first : num_hops;
+        if (sound_end > sound_start && sound_end - sound_start >= min_region) {
+            // padding never reaches past the middle of a silence
+            int64_t start = sound_start;
+            if (i > 0)
+                start = std::max(sound_start - padding, (silences[i - 1].first + silences[i - 1].second + 1) / 2);
+            int64_t end = sound_end;
+            if (i < silences.size())
+                end = std::min(sound_end + padding, (silences[i].first + silences[i].second) / 2);
+
+            regions.push_back({index.get_hop_frame(start), std::min(index.get_num_frames(), index.get_hop_frame(end))});
+        }
+        if (i < silences.size())
+            sound_start = silences[i].second;
+    }
+
+    return regions;
+}
+
+std::vector<int64_t> find_onsets(const EnergyIndex& index, const OnsetParams& params) {
+    std::vector<int64_t> onsets;
+    int64_t num_hops = index.get_num_hops();
+
+    double threshold = db_to_mean_square(params.threshold_db);
+    double rise = db_to_mean_square(params.sensitivity_db);
+    int64_t short_hops = std::max((int64_t) 1, index.seconds_to_hops(onset_short));
+    int64_t long_hops = std::max(short_hops + 1, index.seconds_to_hops(onset_long));
+    int64_t min_spacing = std::max((int64_t) 1, index.seconds_to_hops(params.min_spacing));
+
+    // ratio of the level just after a hop to the level before it, the strongest one
+    // within the spacing wins
+    int64_t best_hop = -1;
+    double best_ratio = 0;
+    for (int64_t hop = 1; hop < num_hops; hop++) {
+        double after = index.get_mean_square(hop, hop + short_hops);
+        double before = index.get_mean_square(hop - long_hops, hop);
+        double ratio = after / std::max(before, threshold * 0.01);
+
+        if (best_hop >= 0 && hop - best_hop >= min_spacing) {
+            onsets.push_back(index.get_hop_frame(best_hop));
+            best_hop = -1;
+        }
+
+        if (after < threshold || ratio < rise)
+            continue;
+
+        if (best_hop < 0 || ratio > best_ratio) {
+            if (!onsets.empty() && index.get_hop_frame(hop) - onsets.back() < index.get_hop_frame(min_spacing))
+                continue;
+            best_hop = hop;
+            best_ratio = ratio;
+        }
+    }
+
+    if (best_hop >= 0)
+        onsets.push_back(index.get_hop_frame(best_hop));
+    return onsets;
+}
+
+std::vector<DetectedRegion> split_at_onsets(const std::vector<int64_t>& onsets, int64_t num_frames) {
+    std::vector<DetectedRegion> regions;
+    for (size_t i = 0; i < onsets.size(); i++) {
+        int64_t end = i + 1 < onsets.size() ? onsets[i + 1] : num_frames;
+        if (end > onsets[i])
+            regions.push_back({onsets[i], end});
+    }
+    return regions;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+class EnergyIndex;
+
+struct DetectedRegion {
+    int64_t start, end; // frames
+};
+
+struct SilenceParams {
+    double threshold_db = -50; // rms below this counts as silence
+    double min_silence = 1.0;  // seconds, shorter gaps don't split
+    double min_region = 0.5;   // seconds, shorter bits of sound are dropped
+    double padding = 0.1;      // seconds of the silence kept on either side of a region
+};
+
+struct OnsetParams {
+    double threshold_db = -50;  // quieter onsets are ignored
+    double sensitivity_db = 9;  // rise over the preceding audio that makes an onset
+    double min_spacing = 0.5;   // seconds between onsets
+};
+
+// the sounding parts between silences, all of these only read the energy index so they take
+// milliseconds even for hours of audio
+std::vector<DetectedRegion> find_sound_regions(const EnergyIndex& index, const SilenceParams& params);
+
+// frames where the level jumps up
+std::vector<int64_t> find_onsets(const EnergyIndex& index, const OnsetParams& params);
+
+// one region from each onset to the next, the last one to the end
+std::vector<DetectedRegion> split_at_onsets(const std::vector<int64_t>& onsets, int64_t num_frames);
@@ -0,0 +1,172 @@
+#include "resampler.h"
+
+#include "simd.h"
+#include <QtGlobal>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// zeroth order modified bessel function of the first kind
+static double bessel_i0(double x) {
+    double sum = 1, term = 1;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+void Resampler::init(int num_channels, double in_rate, double out_rate, Quality quality) {
+    Q_ASSERT(num_channels >= 1 && num_channels <= 2);
+    Q_ASSERT(in_rate > 0 && out_rate > 0);
+
+    m_num_channels = num_channels;
+    m_in_rate = in_rate;
+    m_out_rate = out_rate;
+    m_step = in_rate / out_rate;
+
+    build_kernel(quality);
+
+    m_capacity = (int64_t) ceil(max_block * m_step) + m_num_taps * 2 + 16;
+    for (int c = 0; c < 2; c++)
+        m_history[c].assign(c < num_channels ? m_capacity : 0, 0.0f);
+
+    reset();
+}
+
+void Resampler::reset(double phase) {
+    // prime with zeros so the first output frame is centered on the first input frame
+    for (int c = 0; c < m_num_channels; c++)
+        std::fill(m_history[c].begin(), m_history[c].end(), 0.0f);
+
+    m_history_len = m_half_width - 1;
+    m_pos = m_half_width - 1 + phase;
+}
+
+void Resampler::build_kernel(Quality quality) {
+    int base_width;
+    double cutoff, beta;
+
+    switch (quality) {
+    case Quality::LOW:
+        base_width = 8; cutoff = 0.85; beta = 5; m_num_phases = 128;
+        break;
+    case Quality::MEDIUM:
+        base_width = 16; cutoff = 0.91; beta = 7; m_num_phases = 256;
+        break;
+    case Quality::HIGH:
+        base_width = 32; cutoff = 0.95; beta = 9; m_num_phases = 512;
+        break;
+    case Quality::BEST:
+    default:
+        base_width = 64; cutoff = 0.97; beta = 11; m_num_phases = 1024;
+        break;
+    }
+
+    // when downsampling the kernel is stretched so it still cuts off below the output nyquist
+    double scale = std::min(1.0, m_out_rate / m_in_rate);
+    m_half_width = (int) ceil(base_width / scale);
+    m_half_width += m_half_width % 2; // keeps the tap count a multiple of 4
+    m_num_taps = m_half_width * 2;
+
+    double fc = cutoff * scale;
+    double i0_beta = bessel_i0(beta);
+
+    m_kernel.resize((size_t) (m_num_phases + 1) * m_num_taps);
+    for (int p = 0; p <= m_num_phases; p++) {
+        float* row = &m_kernel[(size_t) p * m_num_taps];
+        double frac = p / (double) m_num_phases;
+        double sum = 0;
+
+        for (int k = 0; k < m_num_taps; k++) {
+            double x = (k - m_half_width + 1) - frac;
+            double r = x / m_half_width;
+            double h = 0;
+            if (fabs(r) < 1.0) {
+                double window = bessel_i0(beta * sqrt(1.0 - r * r)) / i0_beta;
+                double y = M_PI * fc * x;
+                double sinc = fabs(y) < 1e-9 ? 1.0 : sin(y) / y;
+                h = fc * sinc * window;
+            }
+            row[k] = (float) h;
+            sum += h;
+        }
+
+        // unity gain at dc for every phase
+        for (int k = 0; k < m_num_taps; k++)
+            row[k] = (float) (row[k] / sum);
+    }
+}
+
+int64_t Resampler::get_input_needed(int64_t out_frames) const {
+    if (out_frames <= 0)
+        return 0;
+
+    double last_pos = m_pos + (out_frames - 1) * m_step;
+    int64_t needed = (int64_t) last_pos + m_half_width + 1 - m_history_len;
+    return std::max((int64_t) 0, needed);
+}
+
+void Resampler::push(const float* in, int64_t num_frames) {
+    if (m_history_len + num_frames > m_capacity)
+        compact();
+
+    Q_ASSERT(m_history_len + num_frames <= m_capacity);
+
+    for (int c = 0; c < m_num_channels; c++) {
+        float* dest = &m_history[c][m_history_len];
+        for (int64_t i = 0; i < num_frames; i++)
+            dest[i] = in[i * m_num_channels + c];
+    }
+
+    m_history_len += num_frames;
+}
+
+int64_t Resampler::pull(float* out, int64_t num_frames) {
+    int64_t produced = 0;
+
+    while (produced < num_frames) {
+        int64_t center = (int64_t) m_pos;
+        int64_t first = center - m_half_width + 1;
+        if (first + m_num_taps > m_history_len)
+            break;
+
+        double phase = (m_pos - center) * m_num_phases;
+        int p = std::min((int) phase, m_num_phases - 1);
+        float alpha = (float) (phase - p);
+        const float* k0 = &m_kernel[(size_t) p * m_num_taps];
+        const float* k1 = k0 + m_num_taps;
+
+        for (int c = 0; c < m_num_channels; c++) {
+            const float* x = &m_history[c][first];
+            float a = dot(x, k0, m_num_taps);
+            float b = dot(x, k1, m_num_taps);
+            out[produced * m_num_channels + c] = a + (b - a) * alpha;
+        }
+
+        produced++;
+        m_pos += m_step;
+    }
+
+    return produced;
+}
+
+double Resampler::get_delay() const {
+    return m_history_len - m_pos;
+}
+
+// drops history that no future output frame can reach
+void Resampler::compact() {
+    int64_t start = (int64_t) m_pos - m_half_width + 1;
+    if (start <= 0)
+        return;
+
+    start = std::min(start, m_history_len);
+    for (int c = 0; c < m_num_channels; c++)
+        memmove(m_history[c].data(), m_history[c].data() + start, (m_history_len - start) * sizeof(float));
+
+    m_history_len -= start;
+    m_pos -= start;
+}
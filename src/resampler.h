@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+// streaming polyphase windowed-sinc resampler
+// kernel phases are tabulated and linearly interpolated, so any ratio works
+// (including ones that change on the fly, which varispeed relies on)
+class Resampler {
+public:
+    enum class Quality {
+        LOW,
+        MEDIUM,
+        HIGH,
+        BEST,
+    };
+
+    // largest number of frames that may be pulled at once
+    static const int max_block = 1024;
+
+    Resampler() {}
+
+    void init(int num_channels, double in_rate, double out_rate, Quality quality);
+
+    // phase moves the first output frame that many frames past the first pushed input frame,
+    // the first get_lookbehind() pushed frames then only serve as filter history
+    void reset(double phase = 0);
+
+    // interleaved in/out
+    int64_t get_input_needed(int64_t out_frames) const;
+    void push(const float* in, int64_t num_frames);
+    int64_t pull(float* out, int64_t num_frames);
+
+    // how far the output lags behind the last pushed input, in input frames
+    double get_delay() const;
+    int get_lookbehind() const { return m_half_width - 1; }
+    int get_num_channels() const { return m_num_channels; }
+    double get_ratio() const { return m_out_rate / m_in_rate; }
+    bool is_initialized() const { return m_num_channels > 0; }
+
+private:
+    void build_kernel(Quality quality);
+    void compact();
+
+private:
+    int m_num_channels = 0;
+    double m_in_rate = 0, m_out_rate = 0;
+    double m_step = 1; // input frames per output frame
+
+    // coefficient table, (num_phases + 1) rows of m_num_taps
+    std::vector<float> m_kernel;
+    int m_num_phases = 0;
+    int m_half_width = 0;
+    int m_num_taps = 0;
+
+    // planar history, m_pos is relative to its first frame
+    std::vector<float> m_history[2];
+    int64_t m_history_len = 0;
+    int64_t m_capacity = 0;
+    double m_pos = 0;
+};
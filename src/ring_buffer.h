@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+
+// single producer, single consumer lock-free ring buffer
+// safe to write from the audio thread as long as init() isn't called concurrently
+template <typename T>
+class RingBuffer {
+public:
+    RingBuffer() {}
+
+    // rounds capacity up to a power of two
+    void init(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity)
+            size *= 2;
+
+        m_data.assign(size, T());
+        m_mask = size - 1;
+        m_write_pos = 0;
+        m_read_pos = 0;
+    }
+
+    size_t get_capacity() const { return m_data.size(); }
+
+    size_t read_available() const {
+        return m_write_pos.load(std::memory_order_acquire) - m_read_pos.load(std::memory_order_relaxed);
+    }
+
+    size_t write_available() const {
+        return m_data.size() - (m_write_pos.load(std::memory_order_relaxed) - m_read_pos.load(std::memory_order_acquire));
+    }
+
+    // producer side, returns the number of elements written
+    size_t write(const T* data, size_t count) {
+        size_t write_pos = m_write_pos.load(std::memory_order_relaxed);
+        count = std::min(count, write_available());
+
+        for (size_t i = 0; i < count; i++)
+            m_data[(write_pos + i) & m_mask] = data[i];
+
+        m_write_pos.store(write_pos + count, std::memory_order_release);
+        return count;
+    }
+
+    // consumer side, returns the number of elements read
+    size_t read(T* data, size_t count) {
+        size_t read_pos = m_read_pos.load(std::memory_order_relaxed);
+        count = std::min(count, read_available());
+
+        for (size_t i = 0; i < count; i++)
+            data[i] = m_data[(read_pos + i) & m_mask];
+
+        m_read_pos.store(read_pos + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    std::vector<T> m_data;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_write_pos = 0;
+    alignas(64) std::atomic<size_t> m_read_pos = 0;
+};
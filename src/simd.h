@@ -0,0 +1,245 @@
+#pragma once
+
+#include <math.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// small vectorized kernels shared by the dsp code, with scalar fallbacks
+
+#if defined(__SSE__)
+static inline float horizontal_sum(__m128 v) {
+    float sums[4];
+    _mm_storeu_ps(sums, v);
+    return sums[0] + sums[1] + sums[2] + sums[3];
+}
+
+static inline float horizontal_max(__m128 v) {
+    float maxes[4];
+    _mm_storeu_ps(maxes, v);
+    return fmaxf(fmaxf(maxes[0], maxes[1]), fmaxf(maxes[2], maxes[3]));
+}
+#endif
+
+// n has to be a multiple of 4
+static inline float dot(const float* a, const float* b, int n) {
+#if defined(__SSE__)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    for (; i < n; i += 4)
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+
+    return horizontal_sum(_mm_add_ps(acc0, acc1));
+#else
+    float sum = 0;
+    for (int i = 0; i < n; i++)
+        sum += a[i] * b[i];
+    return sum;
+#endif
+}
+
+// largest absolute value
+static inline float abs_max(const float* x, int n) {
+    int i = 0;
+    float result = 0;
+#if defined(__SSE__)
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+        acc = _mm_max_ps(acc, _mm_andnot_ps(sign_mask, _mm_loadu_ps(x + i)));
+    result = horizontal_max(acc);
+#endif
+    for (; i < n; i++)
+        result = fmaxf(result, fabsf(x[i]));
+    return result;
+}
+
+// sum of squares, accumulated in double precision across calls by the caller
+static inline double sum_squares(const float* x, int n) {
+    int i = 0;
+    double result = 0;
+#if defined(__SSE__)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(x + i);
+        acc = _mm_add_ps(acc, _mm_mul_ps(v, v));
+    }
+    result = horizontal_sum(acc);
+#endif
+    for (; i < n; i++)
+        result += (double) x[i] * x[i];
+    return result;
+}
+
+// x[i] *= gains[i]
+static inline void multiply(float* x, const float* gains, int n) {
+    int i = 0;
+#if defined(__SSE__)
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(gains + i)));
+#endif
+    for (; i < n; i++)
+        x[i] *= gains[i];
+}
+
+// x[i] *= gain + step * (i + 1), a linear ramp that ends on gain + step * n
+static inline void multiply_ramp(float* x, int n, float gain, float step) {
+    int i = 0;
+#if defined(__SSE__)
+    __m128 g = _mm_add_ps(_mm_set1_ps(gain), _mm_mul_ps(_mm_set1_ps(step), _mm_set_ps(4, 3, 2, 1)));
+    const __m128 g_step = _mm_set1_ps(step * 4);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), g));
+        g = _mm_add_ps(g, g_step);
+    }
+#endif
+    for (; i < n; i++)
+        x[i] *= gain + step * (i + 1);
+}
+
+// acc[i] += x[i] * gain
+static inline void multiply_add(float* acc, const float* x, int n, float gain) {
+    int i = 0;
+#if defined(__SSE__)
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(x + i), g)));
+#endif
+    for (; i < n; i++)
+        acc[i] += x[i] * gain;
+}
+
+// the same over interleaved stereo frames, with a gain per side
+static inline void multiply_add_stereo(float* acc, const float* x, int num_frames, float left, float right) {
+    int i = 0;
+    int n = num_frames * 2;
+#if defined(__SSE__)
+    const __m128 g = _mm_set_ps(right, left, right, left);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(x + i), g)));
+#endif
+    for (; i < n; i += 2) {
+        acc[i] += x[i] * left;
+        acc[i + 1] += x[i + 1] * right;
+    }
+}
+
+// a mono x added to both sides of interleaved stereo frames
+static inline void multiply_add_mono_to_stereo(float* acc, const float* x, int num_frames, float left, float right) {
+    int i = 0;
+#if defined(__SSE__)
+    const __m128 g = _mm_set_ps(right, left, right, left);
+    for (; i + 4 <= num_frames; i += 4) {
+        __m128 v = _mm_loadu_ps(x + i);
+        __m128 low = _mm_mul_ps(_mm_unpacklo_ps(v, v), g);
+        __m128 high = _mm_mul_ps(_mm_unpackhi_ps(v, v), g);
+        _mm_storeu_ps(acc + i * 2, _mm_add_ps(_mm_loadu_ps(acc + i * 2), low));
+        _mm_storeu_ps(acc + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(acc + i * 2 + 4), high));
+    }
+#endif
+    for (; i < num_frames; i++) {
+        acc[i * 2] += x[i] * left;
+        acc[i * 2 + 1] += x[i] * right;
+    }
+}
+
+// acc[i] += a[i] * b[i] over n complex values stored as interleaved re/im pairs
+static inline void complex_multiply_add(float* acc, const float* a, const float* b, int n) {
+    int i = 0;
+#if defined(__SSE__)
+    const __m128 sign = _mm_set_ps(0.0f, -0.0f, 0.0f, -0.0f);
+    for (; i + 2 <= n; i += 2) {
+        __m128 va = _mm_loadu_ps(a + i * 2);
+        __m128 vb = _mm_loadu_ps(b + i * 2);
+        __m128 b_re = _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128 b_im = _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128 a_swapped = _mm_shuffle_ps(va, va, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 product = _mm_add_ps(_mm_mul_ps(va, b_re), _mm_xor_ps(_mm_mul_ps(a_swapped, b_im), sign));
+        _mm_storeu_ps(acc + i * 2, _mm_add_ps(_mm_loadu_ps(acc + i * 2), product));
+    }
+#endif
+    for (; i < n; i++) {
+        float re = a[i * 2] * b[i * 2] - a[i * 2 + 1] * b[i * 2 + 1];
+        float im = a[i * 2] * b[i * 2 + 1] + a[i * 2 + 1] * b[i * 2];
+        acc[i * 2] += re;
+        acc[i * 2 + 1] += im;
+    }
+}
+
+// x[i] = log2(x[i]) for normal x[i] > 0, to about 1e-4, good enough for levels in db
+static inline void fast_log2(float* x, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i exponent_mask = _mm_set1_epi32(0x7f800000);
+    const __m128i mantissa_bits = _mm_set1_epi32(0x007fffff);
+    const __m128i one_bits = _mm_set1_epi32(0x3f800000);
+    for (; i + 4 <= n; i += 4) {
+        __m128i bits = _mm_castps_si128(_mm_loadu_ps(x + i));
+        __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(_mm_and_si128(bits, exponent_mask), 23), _mm_set1_epi32(127)));
+        __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantissa_bits), one_bits));
+
+        // log2 of the mantissa in [1, 2) from the series of atanh((m - 1) / (m + 1))
+        __m128 t = _mm_div_ps(_mm_sub_ps(m, _mm_set1_ps(1.0f)), _mm_add_ps(m, _mm_set1_ps(1.0f)));
+        __m128 t2 = _mm_mul_ps(t, t);
+        __m128 p = _mm_set1_ps(1.0f / 7.0f);
+        p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(1.0f / 5.0f));
+        p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(1.0f / 3.0f));
+        p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(1.0f));
+        p = _mm_mul_ps(_mm_mul_ps(p, t), _mm_set1_ps(2.8853901f));
+        _mm_storeu_ps(x + i, _mm_add_ps(exponent, p));
+    }
+#endif
+    for (; i < n; i++)
+        x[i] = log2f(x[i]);
+}
+
+// x[i] = 2^x[i] for x[i] in about [-126, 126], to about 1e-4 relative
+static inline void fast_exp2(float* x, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(x + i), _mm_set1_ps(-126.0f)), _mm_set1_ps(126.0f));
+
+        // floor, then 2^fraction in [0, 1) as a polynomial
+        __m128i whole = _mm_cvttps_epi32(v);
+        __m128 floored = _mm_cvtepi32_ps(whole);
+        __m128 adjust = _mm_cmpgt_ps(floored, v);
+        floored = _mm_sub_ps(floored, _mm_and_ps(adjust, _mm_set1_ps(1.0f)));
+        whole = _mm_cvtps_epi32(floored);
+        __m128 f = _mm_sub_ps(v, floored);
+
+        __m128 p = _mm_set1_ps(0.013697664f);
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.051690040f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.241491560f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.693107110f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+
+        __m128i scale = _mm_slli_epi32(_mm_add_epi32(whole, _mm_set1_epi32(127)), 23);
+        _mm_storeu_ps(x + i, _mm_mul_ps(p, _mm_castsi128_ps(scale)));
+    }
+#endif
+    for (; i < n; i++)
+        x[i] = exp2f(x[i]);
+}
+
+// keeps every x[i] within [-limit, limit]
+static inline void clamp_abs(float* x, int n, float limit) {
+    int i = 0;
+#if defined(__SSE__)
+    const __m128 high = _mm_set1_ps(limit);
+    const __m128 low = _mm_set1_ps(-limit);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(x + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(x + i), low), high));
+#endif
+    for (; i < n; i++)
+        x[i] = fminf(fmaxf(x[i], -limit), limit);
+}
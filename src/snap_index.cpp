@@ -0,0 +1,254 @@
+#include "snap_index.h"
+
+#include "audio_buffer.h"
+#include "parallel.h"
+#include "simd.h"
+#include <algorithm>
+#include <math.h>
+
+static const int64_t cells_per_task = 4096;
+static const int64_t hops_per_task = 4096;
+
+static const double transient_threshold = 1e-5; // mean square, -50 db
+static const double transient_rise = 7.94;      // 9 db over the level before it
+static const double transient_window = 0.05;    // seconds of level the rise is measured against
+static const double transient_spacing = 0.05;   // seconds
+
+// the channels summed, so a crossing is where the whole frame goes through zero
+static float mix(const float* samples, int num_channels, int64_t frame) {
+    float sum = 0;
+    for (int c = 0; c < num_channels; c++)
+        sum += samples[frame * num_channels + c];
+    return sum;
+}
+
+SnapIndex::~SnapIndex() {
+    cancel_builds();
+    for (auto& build : m_builds)
+        build->thread.join();
+}
+
+void SnapIndex::build(const AudioBuffer& buffer, const std::atomic<bool>* cancel) {
+    m_valid = false;
+    m_sample_rate = buffer.get_sample_rate();
+    m_crossings.clear();
+    m_transients.clear();
+
+    scan_crossings(buffer, 0, buffer.get_num_frames(), m_crossings);
+    if (cancel && *cancel)
+        return;
+    scan_transients(buffer, 0, buffer.get_num_frames(), -1, m_transients);
+    m_valid = !cancel || !*cancel;
+}
+
+void SnapIndex::start_build(const AudioBuffer& buffer) {
+    if (m_valid || (!m_builds.empty() && !m_builds.back()->cancel))
+        return;
+    join_finished();
+
+    auto audio = std::make_shared<const AudioBuffer>(buffer);
+    m_builds.push_back(std::make_unique<Build>());
+    Build* build = m_builds.back().get();
+    build->thread = std::thread([build, audio = std::move(audio)]() mutable {
+        SnapIndex index;
+        index.build(*audio, &build->cancel);
+
+        // the next edit would have to copy the frames while they're shared
+        audio.reset();
+
+        build->sample_rate = index.m_sample_rate;
+        build->crossings = std::move(index.m_crossings);
+        build->transients = std::move(index.m_transients);
+        build->done = true;
+    });
+}
+
+bool SnapIndex::poll_built() {
+    if (m_builds.empty() || m_builds.back()->cancel || !m_builds.back()->done)
+        return false;
+
+    Build& build = *m_builds.back();
+    m_sample_rate = build.sample_rate;
+    m_crossings = std::move(build.crossings);
+    m_transients = std::move(build.transients);
+    m_valid = true;
+    join_finished();
+    return true;
+}
+
+void SnapIndex::invalidate() {
+    m_valid = false;
+    cancel_builds();
+}
+
+void SnapIndex::cancel_builds() {
+    for (auto& build : m_builds)
+        build->cancel = true;
+}
+
+void SnapIndex::join_finished() {
+    for (size_t i = 0; i < m_builds.size();) {
+        if (m_builds[i]->done) {
+            m_builds[i]->thread.join();
+            m_builds.erase(m_builds.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+void SnapIndex::update(const AudioBuffer& buffer, int64_t start, int64_t old_end, int64_t new_end) {
+    if (!m_valid) {
+        cancel_builds();
+        return;
+    }
+
+    // a new rate moves every position, it gets built again
+    if (buffer.get_sample_rate() != m_sample_rate) {
+        invalidate();
+        return;
+    }
+
+    int64_t num_frames = buffer.get_num_frames();
+    int64_t shift = new_end - old_end;
+
+    // drops what lay in the rescanned stretch, moves the rest along and returns where the new
+    // positions go, the stretch reaches far enough around the edit for every scan to settle
+    auto splice = [&](std::vector<int64_t>& positions, int64_t scan_start, int64_t scan_end) {
+        auto first = std::lower_bound(positions.begin(), positions.end(), scan_start);
+        auto last = std::lower_bound(first, positions.end(), scan_end - shift);
+        size_t index = first - positions.begin();
+
+        positions.erase(first, last);
+        for (size_t i = index; i < positions.size(); i++)
+            positions[i] += shift;
+        return index;
+    };
+
+    {
+        int64_t scan_start = std::max((int64_t) 0, start - crossing_cell);
+        int64_t scan_end = std::min(num_frames, new_end + crossing_cell);
+        size_t index = splice(m_crossings, scan_start, scan_end);
+
+        std::vector<int64_t> found;
+        scan_crossings(buffer, scan_start, scan_end, found);
+        m_crossings.insert(m_crossings.begin() + index, found.begin(), found.end());
+    }
+
+    {
+        int64_t margin = get_transient_margin();
+        int64_t scan_start = std::max((int64_t) 0, start - margin);
+        int64_t scan_end = std::min(num_frames, new_end + margin);
+        size_t index = splice(m_transients, scan_start, scan_end);
+
+        std::vector<int64_t> found;
+        scan_transients(buffer, scan_start, scan_end, index > 0 ? m_transients[index - 1] : -1, found);
+        m_transients.insert(m_transients.begin() + index, found.begin(), found.end());
+
+        // the ones after the stretch keep their spacing to the new ones
+        if (!found.empty()) {
+            int64_t spacing = (int64_t) (transient_spacing * m_sample_rate);
+            auto next = m_transients.begin() + index + found.size();
+            auto keep = next;
+            while (keep != m_transients.end() && *keep - found.back() < spacing)
+                keep++;
+            m_transients.erase(next, keep);
+        }
+    }
+}
+
+int64_t SnapIndex::find_nearest(Kind kind, int64_t frame, int64_t max_distance) const {
+    const std::vector<int64_t>& positions = get_positions(kind);
+    auto it = std::lower_bound(positions.begin(), positions.end(), frame);
+
+    int64_t best = -1;
+    int64_t best_distance = max_distance;
+    if (it != positions.end() && *it - frame <= best_distance) {
+        best = *it;
+        best_distance = *it - frame;
+    }
+    if (it != positions.begin() && frame - *(it - 1) <= best_distance)
+        best = *(it - 1);
+
+    return best;
+}
+
+// one crossing per cell, on whichever of the two frames around it is closer to zero
+void SnapIndex::scan_crossings(const AudioBuffer& buffer, int64_t start, int64_t end, std::vector<int64_t>& out) const {
+    int num_channels = buffer.get_num_channels();
+    const float* samples = buffer.get_samples().data();
+
+    int64_t num_cells = (end - start + crossing_cell - 1) / crossing_cell;
+    int64_t num_tasks = (num_cells + cells_per_task - 1) / cells_per_task;
+    std::vector<std::vector<int64_t>> found(num_tasks);
+
+    parallel_for(num_tasks, [&](int64_t task) {
+        int64_t task_start = start + task * cells_per_task * crossing_cell;
+        int64_t task_end = std::min(end, task_start + cells_per_task * crossing_cell);
+
+        for (int64_t cell = task_start; cell < task_end; cell += crossing_cell) {
+            int64_t cell_end = std::min(task_end, cell + crossing_cell);
+            int64_t i = std::max(cell, (int64_t) 1);
+            float previous = mix(samples, num_channels, i - 1);
+
+            for (; i < cell_end; i++) {
+                float current = mix(samples, num_channels, i);
+                if ((previous < 0) != (current < 0)) {
+                    bool before = fabsf(previous) < fabsf(current) && i - 1 >= start;
+                    found[task].push_back(before ? i - 1 : i);
+                    break;
+                }
+                previous = current;
+            }
+        }
+    });
+
+    for (const std::vector<int64_t>& positions : found)
+        out.insert(out.end(), positions.begin(), positions.end());
+}
+
+int64_t SnapIndex::get_transient_margin() const {
+    int64_t window = std::max((int64_t) 1, (int64_t) (transient_window * m_sample_rate / transient_hop));
+    return (window + 1) * transient_hop + (int64_t) (transient_spacing * m_sample_rate);
+}
+
+// the start of every hop whose level jumps well above the level before it, none closer than the
+// spacing to the one before, starting with previous
+void SnapIndex::scan_transients(const AudioBuffer& buffer, int64_t start, int64_t end, int64_t previous, std::vector<int64_t>& out) const {
+    int num_channels = buffer.get_num_channels();
+    int64_t num_frames = buffer.get_num_frames();
+    const float* samples = buffer.get_samples().data();
+
+    int64_t window = std::max((int64_t) 1, (int64_t) (transient_window * m_sample_rate / transient_hop));
+    int64_t spacing = (int64_t) (transient_spacing * m_sample_rate);
+
+    // the hops of the window before start give the first ones something to compare against
+    int64_t origin = start - window * transient_hop;
+    int64_t num_hops = window + (end - start + transient_hop - 1) / transient_hop;
+    std::vector<float> levels(num_hops);
+
+    parallel_for((num_hops + hops_per_task - 1) / hops_per_task, [&](int64_t task) {
+        int64_t first = task * hops_per_task;
+        int64_t last = std::min(num_hops, first + hops_per_task);
+        for (int64_t hop = first; hop < last; hop++) {
+            int64_t hop_start = std::max((int64_t) 0, origin + hop * transient_hop);
+            int64_t hop_end = std::min(num_frames, origin + (hop + 1) * transient_hop);
+            int count = (int) (hop_end - hop_start);
+            levels[hop] = count > 0 ? (float) (sum_squares(samples + hop_start * num_channels, count * num_channels) / (count * num_channels)) : 0.0f;
+        }
+    });
+
+    double sum = 0;
+    for (int64_t hop = 0; hop < window; hop++)
+        sum += levels[hop];
+
+    for (int64_t hop = window; hop < num_hops; hop++) {
+        int64_t frame = origin + hop * transient_hop;
+        double before = std::max(sum / window, transient_threshold * 0.01);
+        if (levels[hop] >= transient_threshold && levels[hop] >= before * transient_rise && (previous < 0 || frame - previous >= spacing)) {
+            out.push_back(frame);
+            previous = frame;
+        }
+        sum += levels[hop] - levels[hop - window];
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <stdint.h>
+
+class AudioBuffer;
+
+// zero crossings and transients of the buffer as sorted frame positions, patched edit by edit so
+// selection edges can snap to them while dragging without going back to the samples
+// everything but the build on its own thread belongs to the gui thread
+class SnapIndex {
+public:
+    SnapIndex() {}
+    ~SnapIndex();
+
+    enum class Kind {
+        ZERO_CROSSING,
+        TRANSIENT,
+    };
+
+    // crossings closer together than this are thinned to one, finer than any snap distance
+    static const int crossing_cell = 32;
+    static const int transient_hop = 128;
+
+    // parallel, stops early and leaves the index invalid if cancel gets set
+    void build(const AudioBuffer& buffer, const std::atomic<bool>* cancel = nullptr);
+
+    // builds the index on a thread of its own from a copy of the buffer that shares its frames,
+    // unless it's valid or already being built, poll_built() takes it over once it's done
+    void start_build(const AudioBuffer& buffer);
+
+    // true once a build finished and the index is valid again, the timer that draws the playhead
+    // asks, nothing needs drawing for it
+    bool poll_built();
+
+    // also drops a build that's still running, it doesn't wait for it
+    void invalidate();
+    bool is_valid() const { return m_valid; }
+
+    // the edit replaced frames [start, old_end) with [start, new_end), the positions past it are
+    // moved along and only the stretch around it is scanned again, a build that's still running
+    // is of the old audio and gets dropped
+    void update(const AudioBuffer& buffer, int64_t start, int64_t old_end, int64_t new_end);
+
+    // closest position of the kind, or -1 if there is none within max_distance frames
+    int64_t find_nearest(Kind kind, int64_t frame, int64_t max_distance) const;
+
+    const std::vector<int64_t>& get_positions(Kind kind) const {
+        return kind == Kind::ZERO_CROSSING ? m_crossings : m_transients;
+    }
+
+private:
+    void scan_crossings(const AudioBuffer& buffer, int64_t start, int64_t end, std::vector<int64_t>& out) const;
+    void scan_transients(const AudioBuffer& buffer, int64_t start, int64_t end, int64_t previous, std::vector<int64_t>& out) const;
+    int64_t get_transient_margin() const;
+
+    // a dropped one runs until it notices, the next start joins it once it's done
+    struct Build {
+        std::thread thread;
+        std::atomic<bool> cancel = false;
+        std::atomic<bool> done = false;
+        int sample_rate = 0;
+        std::vector<int64_t> crossings, transients;
+    };
+
+    void cancel_builds();
+    void join_finished();
+
+private:
+    bool m_valid = false;
+    int m_sample_rate = 0;
+    std::vector<int64_t> m_crossings;
+    std::vector<int64_t> m_transients;
+    std::vector<std::unique_ptr<Build>> m_builds; // only the last one can be running uncancelled
+};
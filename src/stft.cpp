@@ -0,0 +1,75 @@
+#include "stft.h"
+
+#include <QtGlobal>
+#include <math.h>
+#include <algorithm>
+
+std::vector<float> make_hann_window(int size) {
+    std::vector<float> window(size);
+    for (int i = 0; i < size; i++)
+        window[i] = (float) (0.5 - 0.5 * cos(2.0 * M_PI * i / size));
+    return window;
+}
+
+static int64_t wrap(int64_t pos, int64_t size) {
+    int64_t index = pos % size;
+    return index < 0 ? index + size : index;
+}
+
+bool StftProcessor::init(int fft_size, int hop) {
+    Q_ASSERT(fft_size % hop == 0 && fft_size / hop >= 4);
+
+    if (!m_fft.init(fft_size))
+        return false;
+
+    m_hop = hop;
+    m_window = make_hann_window(fft_size);
+    m_input.resize(fft_size);
+    m_output.resize(fft_size * 2);
+    m_frame.resize(fft_size);
+    m_bins.resize(fft_size / 2 + 1);
+
+    // hann applied twice overlaps to 3/8 of the number of frames per window
+    m_scale = (float) (hop / (fft_size * 0.375));
+
+    reset();
+    return true;
+}
+
+void StftProcessor::reset() {
+    std::fill(m_input.begin(), m_input.end(), 0.0f);
+    std::fill(m_output.begin(), m_output.end(), 0.0f);
+}
+
+void StftProcessor::process(float* samples, int num_frames, int64_t frame_pos, const FrameFn& on_frame) {
+    int64_t fft_size = m_input.size();
+    int64_t output_size = m_output.size();
+
+    for (int i = 0; i < num_frames; i++) {
+        int64_t pos = frame_pos + i;
+        m_input[wrap(pos, fft_size)] = samples[i];
+
+        // every frame that covers this position has been added by now
+        float& out = m_output[wrap(pos - fft_size, output_size)];
+        samples[i] = out;
+        out = 0;
+
+        if (wrap(pos + 1, m_hop) == 0)
+            run_frame(pos + 1 - fft_size, on_frame);
+    }
+}
+
+void StftProcessor::run_frame(int64_t start, const FrameFn& on_frame) {
+    int64_t fft_size = m_input.size();
+    int64_t output_size = m_output.size();
+
+    for (int64_t j = 0; j < fft_size; j++)
+        m_frame[j] = m_input[wrap(start + j, fft_size)] * m_window[j];
+
+    m_fft.forward(m_frame.data(), m_bins.data());
+    on_frame(m_bins.data());
+    m_fft.inverse(m_bins.data(), m_frame.data());
+
+    for (int64_t j = 0; j < fft_size; j++)
+        m_output[wrap(start + j, output_size)] += m_frame[j] * m_window[j] * m_scale;
+}
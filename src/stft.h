@@ -0,0 +1,43 @@
+#pragma once
+
+#include "fft.h"
+#include <vector>
+#include <complex>
+#include <functional>
+#include <stdint.h>
+
+// periodic hann window, overlaps to a constant at a hop of a quarter or half its length
+std::vector<float> make_hann_window(int size);
+
+// streaming short-time fourier transform of one channel with windowed overlap-add resynthesis
+// frames start on multiples of the hop in absolute frame positions rather than wherever the
+// stream began, so a stream started anywhere agrees with one started earlier after fft_size frames
+class StftProcessor {
+public:
+    using FrameFn = std::function<void(std::complex<float>* bins)>;
+
+    // allocates, hop has to divide fft_size into at least 4
+    bool init(int fft_size, int hop);
+    void reset();
+
+    int get_fft_size() const { return m_fft.get_size(); }
+    int get_hop() const { return m_hop; }
+    int get_num_bins() const { return (int) m_bins.size(); }
+    int get_latency() const { return get_fft_size(); }
+
+    // in place, the output lags by get_latency(), on_frame can change the bins of every frame
+    void process(float* samples, int num_frames, int64_t frame_pos, const FrameFn& on_frame);
+
+private:
+    void run_frame(int64_t start, const FrameFn& on_frame);
+
+private:
+    RealFFT m_fft;
+    int m_hop = 0;
+    float m_scale = 1;
+    std::vector<float> m_window;
+    std::vector<float> m_input;  // the last fft_size frames, by position modulo fft_size
+    std::vector<float> m_output; // overlap-add sums, by position modulo twice the fft size
+    std::vector<float> m_frame;
+    std::vector<std::complex<float>> m_bins;
+};
@@ -0,0 +1,365 @@
+#include "time_stretch.h"
+
+#include "audio_buffer.h"
+#include "fft.h"
+#include "stft.h"
+#include "parallel.h"
+#include "resampler.h"
+#include "simd.h"
+#include <QtGlobal>
+#include <math.h>
+#include <algorithm>
+#include <complex>
+#include <memory>
+#include <vector>
+
+// planar copy of the region with zeros either side, so frames can read a little past its ends
+struct StretchInput {
+    std::vector<float> channels[2];
+    int num_channels;
+    int64_t num_frames;
+    int64_t padding;
+
+    const float* get(int c) const { return channels[c].data() + padding; }
+};
+
+static void load_input(const AudioBuffer& buffer, int64_t start, int64_t end, int64_t padding, StretchInput& input) {
+    input.num_channels = buffer.get_num_channels();
+    input.num_frames = end - start;
+    input.padding = padding;
+
+    const float* samples = buffer.get_samples().data() + start * input.num_channels;
+    for (int c = 0; c < input.num_channels; c++) {
+        input.channels[c].assign(input.num_frames + padding * 2, 0.0f);
+        for (int64_t i = 0; i < input.num_frames; i++)
+            input.channels[c][padding + i] = samples[i * input.num_channels + c];
+    }
+}
+
+static float wrap_phase(float phase) {
+    return phase - (float) (2 * M_PI) * roundf(phase / (float) (2 * M_PI));
+}
+
+// about 46ms, long enough to resolve the harmonics of low notes
+static int get_vocoder_fft_size(int sample_rate) {
+    int size = 256;
+    while (size < sample_rate / 22)
+        size *= 2;
+    return size;
+}
+
+// frames are analysed and resynthesized in parallel a block at a time, in between the phases
+// are propagated from frame to frame, which is the only sequential part and cheap
+// identity phase locking (laroche and dolson): peaks advance by their measured frequency and
+// the bins around each peak keep their analysed phase relative to it, which avoids the phasey
+// smearing of a plain vocoder
+static void stretch_phase_vocoder(const StretchInput& input, double stretch, int sample_rate, int64_t out_frames, std::vector<float>* out) {
+    const int block_frames = 128;
+
+    int fft_size = get_vocoder_fft_size(sample_rate);
+    int half = fft_size / 2;
+    int hop = fft_size / 4;
+    int num_bins = fft_size / 2 + 1;
+    int num_channels = input.num_channels;
+    double analysis_hop = hop / stretch;
+    float scale = (float) (hop / (fft_size * 0.375));
+    std::vector<float> window = make_hann_window(fft_size);
+
+    // output frame m is centered on m * hop, the first and last just reach into the output
+    int64_t first = -(half / hop) + 1;
+    int64_t end = (out_frames + half + hop - 1) / hop;
+    auto get_center = [&](int64_t m) { return (int64_t) llround(m * analysis_hop); };
+
+    int64_t num_groups = get_num_worker_threads() * 2;
+    std::unique_ptr<RealFFT[]> ffts(new RealFFT[num_groups]);
+    for (int64_t g = 0; g < num_groups; g++)
+        ffts[g].init(fft_size);
+
+    size_t block_bins = (size_t) num_channels * block_frames * num_bins;
+    std::vector<float> magnitude(block_bins), phase(block_bins), frequency(block_bins);
+    std::vector<float> synthesis((size_t) num_channels * block_frames * fft_size);
+    std::vector<float> last_phase(num_channels * num_bins), synthesis_phase(num_channels * num_bins);
+
+    // runs fn(channel, frame in block, fft) for every frame of the block spread over the groups
+    auto for_each_frame = [&](int count, const std::function<void(int, int, RealFFT&)>& fn) {
+        int64_t num_items = (int64_t) num_channels * count;
+        int64_t per_group = (num_items + num_groups - 1) / num_groups;
+        parallel_for(num_groups, [&](int64_t g) {
+            int64_t last = std::min(num_items, (g + 1) * per_group);
+            for (int64_t item = g * per_group; item < last; item++)
+                fn((int) (item / count), (int) (item % count), ffts[g]);
+        });
+    };
+
+    for (int64_t block_start = first; block_start < end; block_start += block_frames) {
+        int count = (int) std::min((int64_t) block_frames, end - block_start);
+
+        for_each_frame(count, [&](int c, int f, RealFFT& fft) {
+            thread_local std::vector<float> frame;
+            thread_local std::vector<std::complex<float>> bins;
+            frame.resize(fft_size);
+            bins.resize(num_bins);
+
+            int64_t from = get_center(block_start + f) - half;
+            const float* in = input.get(c);
+            for (int i = 0; i < fft_size; i++) {
+                int64_t pos = from + i;
+                frame[i] = pos >= 0 && pos < input.num_frames ? in[pos] * window[i] : 0.0f;
+            }
+            fft.forward(frame.data(), bins.data());
+
+            size_t offset = ((size_t) c * block_frames + f) * num_bins;
+            for (int k = 0; k < num_bins; k++) {
+                magnitude[offset + k] = std::abs(bins[k]);
+                phase[offset + k] = std::arg(bins[k]);
+            }
+        });
+
+        // phases in place of the analysed ones from here on
+        parallel_for(num_channels, [&](int64_t c) {
+            std::vector<int> peaks;
+            std::vector<float> peak_phase;
+            float* last = &last_phase[c * num_bins];
+            float* synth = &synthesis_phase[c * num_bins];
+
+            for (int f = 0; f < count; f++) {
+                int64_t m = block_start + f;
+                size_t offset = ((size_t) c * block_frames + f) * num_bins;
+                const float* mag = &magnitude[offset];
+                float* ph = &phase[offset];
+                float* freq = &frequency[offset];
+
+                if (m == first) {
+                    std::copy(ph, ph + num_bins, last);
+                    std::copy(ph, ph + num_bins, synth);
+                    continue;
+                }
+
+                // instantaneous frequency in radians per frame from the advance over the analysis hop
+                int64_t actual_hop = std::max((int64_t) 1, get_center(m) - get_center(m - 1));
+                for (int k = 0; k < num_bins; k++) {
+                    float omega = (float) (2 * M_PI * k / fft_size);
+                    float deviation = wrap_phase(ph[k] - last[k] - omega * actual_hop);
+                    freq[k] = omega + deviation / actual_hop;
+                    last[k] = ph[k];
+                }
+
+                peaks.clear();
+                for (int k = 0; k < num_bins; k++) {
+                    float v = mag[k];
+                    if ((k < 1 || v > mag[k - 1]) && (k < 2 || v > mag[k - 2]) &&
+                        (k + 1 >= num_bins || v >= mag[k + 1]) && (k + 2 >= num_bins || v >= mag[k + 2]))
+                        peaks.push_back(k);
+                }
+
+                if (peaks.empty()) {
+                    for (int k = 0; k < num_bins; k++) {
+                        synth[k] = wrap_phase(synth[k] + hop * freq[k]);
+                        ph[k] = synth[k];
+                    }
+                    continue;
+                }
+
+                peak_phase.resize(peaks.size());
+                for (size_t p = 0; p < peaks.size(); p++)
+                    peak_phase[p] = wrap_phase(synth[peaks[p]] + hop * freq[peaks[p]]);
+
+                // each bin follows the nearest peak, the boundary half way between two peaks
+                size_t p = 0;
+                for (int k = 0; k < num_bins; k++) {
+                    while (p + 1 < peaks.size() && k > (peaks[p] + peaks[p + 1]) / 2)
+                        p++;
+                    synth[k] = wrap_phase(peak_phase[p] + ph[k] - ph[peaks[p]]);
+                }
+                std::copy(synth, synth + num_bins, ph);
+            }
+        });
+
+        for_each_frame(count, [&](int c, int f, RealFFT& fft) {
+            thread_local std::vector<std::complex<float>> bins;
+            bins.resize(num_bins);
+
+            size_t offset = ((size_t) c * block_frames + f) * num_bins;
+            for (int k = 0; k < num_bins; k++)
+                bins[k] = std::polar(magnitude[offset + k], phase[offset + k]);
+
+            float* frame = &synthesis[((size_t) c * block_frames + f) * fft_size];
+            fft.inverse(bins.data(), frame);
+            for (int i = 0; i < fft_size; i++)
+                frame[i] *= window[i] * scale;
+        });
+
+        for (int c = 0; c < num_channels; c++) {
+            for (int f = 0; f < count; f++) {
+                const float* frame = &synthesis[((size_t) c * block_frames + f) * fft_size];
+                int64_t from = (block_start + f) * hop - half;
+                int i = (int) std::max((int64_t) 0, -from);
+                int to = (int) std::min((int64_t) fft_size, out_frames - from);
+                for (; i < to; i++)
+                    out[c][from + i] += frame[i];
+            }
+        }
+    }
+}
+
+// waveform similarity overlap-add (verhelst and roelands), every output frame is cut from near
+// its nominal input position where it best continues the previous one, searched on a mono mix
+// so both channels are cut at the same place
+// the searches run in parallel chunks, each starting a few frames early so its path has settled
+// onto the one a single pass would take by the time its own frames begin
+static void stretch_wsola(const StretchInput& input, double stretch, int sample_rate, int64_t out_frames, std::vector<float>* out) {
+    const int64_t chunk_frames = 64;
+    const int64_t settle_frames = 8;
+
+    int frame_size = std::max(64, sample_rate / 25 / 8 * 8); // 40ms
+    int half = frame_size / 2;
+    int hop = half;
+    int tolerance = hop / 2;
+    int num_channels = input.num_channels;
+    double analysis_hop = hop / stretch;
+    std::vector<float> window = make_hann_window(frame_size);
+
+    Q_ASSERT(input.padding >= frame_size + tolerance + hop);
+
+    std::vector<float> mix(input.channels[0].size(), 0.0f);
+    for (int c = 0; c < num_channels; c++) {
+        for (size_t i = 0; i < mix.size(); i++)
+            mix[i] += input.channels[c][i] / num_channels;
+    }
+    const float* mono = mix.data() + input.padding;
+
+    int64_t num_out = (out_frames + half + hop - 1) / hop;
+    std::vector<int64_t> positions(num_out);
+    auto get_nominal = [&](int64_t m) { return std::min(input.num_frames, (int64_t) llround(m * analysis_hop)); };
+
+    parallel_for((num_out + chunk_frames - 1) / chunk_frames, [&](int64_t chunk) {
+        int64_t begin = chunk * chunk_frames;
+        int64_t last = std::min(num_out, begin + chunk_frames);
+        int64_t m = std::max((int64_t) 0, begin - settle_frames);
+
+        int64_t previous = get_nominal(m);
+        if (m >= begin)
+            positions[m] = previous;
+
+        for (m++; m < last; m++) {
+            int64_t nominal = get_nominal(m);
+            const float* target = mono + previous + hop - half;
+
+            auto score = [&](int64_t delta) { return dot(mono + nominal + delta - half, target, frame_size); };
+
+            // coarse steps, then the neighbours of the best one
+            int64_t best = 0;
+            float best_score = -INFINITY;
+            for (int64_t delta = -tolerance; delta <= tolerance; delta += 4) {
+                float s = score(delta);
+                if (s > best_score) {
+                    best_score = s;
+                    best = delta;
+                }
+            }
+            int64_t coarse = best;
+            for (int64_t delta = std::max((int64_t) -tolerance, coarse - 3); delta <= std::min((int64_t) tolerance, coarse + 3); delta++) {
+                float s = score(delta);
+                if (s > best_score) {
+                    best_score = s;
+                    best = delta;
+                }
+            }
+
+            previous = nominal + best;
+            if (m >= begin)
+                positions[m] = previous;
+        }
+    });
+
+    // hann at half overlap sums to one, no normalization needed
+    parallel_for(num_channels, [&](int64_t c) {
+        const float* in = input.get((int) c);
+        for (int64_t m = 0; m < num_out; m++) {
+            int64_t from = m * hop - half;
+            const float* src = in + positions[m] - half;
+            int i = (int) std::max((int64_t) 0, -from);
+            int to = (int) std::min((int64_t) frame_size, out_frames - from);
+            for (; i < to; i++)
+                out[c][from + i] += src[i] * window[i];
+        }
+    });
+}
+
+// planar in to interleaved out, squeezing in_frames into out_frames with the sinc resampler
+static void resample_into(const std::vector<float>* in, int num_channels, int64_t in_frames, int64_t out_frames, float* out) {
+    Resampler resampler;
+    resampler.init(num_channels, (double) in_frames, (double) out_frames, Resampler::Quality::HIGH);
+
+    int lookbehind = resampler.get_lookbehind();
+    resampler.reset(lookbehind);
+    int64_t in_pos = -lookbehind;
+
+    std::vector<float> block;
+    int64_t produced = 0;
+    while (produced < out_frames) {
+        int64_t wanted = std::min(out_frames - produced, (int64_t) Resampler::max_block);
+        int64_t needed = std::max(resampler.get_input_needed(wanted), (int64_t) 1);
+
+        block.assign(needed * num_channels, 0.0f);
+        for (int64_t i = std::max(in_pos, (int64_t) 0); i < std::min(in_pos + needed, in_frames); i++) {
+            for (int c = 0; c < num_channels; c++)
+                block[(i - in_pos) * num_channels + c] = in[c][i];
+        }
+
+        resampler.push(block.data(), needed);
+        in_pos += needed;
+        produced += resampler.pull(out + produced * num_channels, wanted);
+    }
+}
+
+bool time_stretch(const AudioBuffer& source, int64_t start, int64_t end, const StretchOptions& options, AudioBuffer& out) {
+    start = std::max((int64_t) 0, start);
+    end = std::min(source.get_num_frames(), end);
+    if (start >= end || options.speed < 0.1 || options.speed > 10 || fabs(options.pitch_semitones) > 48)
+        return false;
+
+    int num_channels = source.get_num_channels();
+    int sample_rate = source.get_sample_rate();
+    int64_t in_frames = end - start;
+    int64_t out_frames = std::max((int64_t) 1, (int64_t) llround(in_frames / options.speed));
+
+    // shifting up stretches further and resamples the result back down to length
+    double pitch = pow(2.0, options.pitch_semitones / 12.0);
+    bool shift = fabs(options.pitch_semitones) > 1e-6;
+    int64_t stretched_frames = shift ? std::max((int64_t) 1, (int64_t) llround(out_frames * pitch)) : out_frames;
+    double stretch = stretched_frames / (double) in_frames;
+
+    StretchInput input;
+    int64_t padding = sample_rate / 10;
+    load_input(source, start, end, padding, input);
+
+    std::vector<float> stretched[2];
+    for (int c = 0; c < num_channels; c++)
+        stretched[c].assign(stretched_frames, 0.0f);
+
+    if (options.mode == StretchMode::WSOLA)
+        stretch_wsola(input, stretch, sample_rate, stretched_frames, stretched);
+    else
+        stretch_phase_vocoder(input, stretch, sample_rate, stretched_frames, stretched);
+
+    // the region lands between copies of what was around it
+    const float* samples = source.get_samples().data();
+    int64_t total_frames = source.get_num_frames() - in_frames + out_frames;
+    std::vector<float> result(total_frames * num_channels);
+    std::copy(samples, samples + start * num_channels, result.begin());
+    std::copy(samples + end * num_channels, samples + source.get_num_frames() * num_channels, result.begin() + (start + out_frames) * num_channels);
+
+    float* region = result.data() + start * num_channels;
+    if (shift) {
+        resample_into(stretched, num_channels, stretched_frames, out_frames, region);
+    } else {
+        for (int64_t i = 0; i < out_frames; i++) {
+            for (int c = 0; c < num_channels; c++)
+                region[i * num_channels + c] = stretched[c][i];
+        }
+    }
+
+    out.init(num_channels, sample_rate, std::move(result));
+    return true;
+}
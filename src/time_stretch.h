@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+class AudioBuffer;
+
+enum class StretchMode {
+    PHASE_VOCODER, // phase locked, for music and other tonal material
+    WSOLA,         // waveform similarity overlap-add, keeps speech crisp
+};
+
+struct StretchOptions {
+    StretchMode mode = StretchMode::PHASE_VOCODER;
+    double speed = 1.0;        // above 1 plays faster and shortens the region
+    double pitch_semitones = 0;
+};
+
+// builds out as a copy of source with [start, end) stretched and pitch shifted, frames are
+// analysed and resynthesized in parallel, pitch shifting stretches and then resamples back
+// returns false if the region is empty or the options are out of range
+bool time_stretch(const AudioBuffer& source, int64_t start, int64_t end, const StretchOptions& options, AudioBuffer& out);
@@ -0,0 +1,185 @@
+#include "varispeed.h"
+
+#include <QtGlobal>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// wsola similarity search only looks at every nth frame
+static const int search_decimation = 4;
+
+void Varispeed::init(int num_channels, int sample_rate) {
+    Q_ASSERT(num_channels >= 1 && num_channels <= 2);
+    m_num_channels = num_channels;
+
+    // ~30ms grains work well for speech and most music
+    m_window_size = (int) (sample_rate * 0.03);
+    m_window_size += m_window_size % 2;
+    m_hop = m_window_size / 2;
+    m_search_radius = m_window_size / 4;
+
+    // periodic hann, overlapping by half sums to one
+    m_window.resize(m_window_size);
+    for (int i = 0; i < m_window_size; i++)
+        m_window[i] = (float) (0.5 - 0.5 * cos(2.0 * M_PI * i / m_window_size));
+
+    m_accum.assign(m_window_size * num_channels, 0.0f);
+    m_ready.assign(m_hop * num_channels, 0.0f);
+    m_continuation.assign(m_hop / search_decimation + 1, 0.0f);
+
+    reset(0, 1);
+}
+
+void Varispeed::reset(double pos, double step) {
+    m_pos = pos;
+    m_step = step;
+    std::fill(m_accum.begin(), m_accum.end(), 0.0f);
+    m_ready_pos = 0;
+    m_ready_count = 0;
+    m_prev_segment = -1;
+    m_finished = false;
+}
+
+int Varispeed::render(const float* samples, int64_t total_frames, float* out, int num_frames, double step, Mode mode, const Range& range) {
+    m_samples = samples;
+    m_total_frames = total_frames;
+
+    double start_step = m_step;
+    int produced = 0;
+
+    if (mode == Mode::RESAMPLE) {
+        for (; produced < num_frames; produced++) {
+            if (m_finished)
+                break;
+
+            read_frame(m_pos, out + produced * m_num_channels);
+            advance(start_step + (step - start_step) * (produced + 1) / num_frames, range);
+        }
+    } else {
+        while (produced < num_frames) {
+            if (m_ready_count == 0) {
+                if (m_finished)
+                    break;
+                synthesize_hop(start_step + (step - start_step) * produced / num_frames, range);
+            }
+
+            int count = std::min(m_ready_count, num_frames - produced);
+            memcpy(out + produced * m_num_channels, &m_ready[m_ready_pos * m_num_channels], count * m_num_channels * sizeof(float));
+            m_ready_pos += count;
+            m_ready_count -= count;
+            produced += count;
+        }
+    }
+
+    m_step = step;
+    return produced;
+}
+
+// moves the position by step, returns false once it runs off a STOP range
+bool Varispeed::advance(double step, const Range& range) {
+    m_pos += step;
+
+    switch (range.edge) {
+    case Edge::WRAP: {
+        double length = (double) (range.end - range.start);
+        if (length <= 0) {
+            m_finished = true;
+            return false;
+        }
+        if (m_pos >= range.end || m_pos < range.start)
+            m_pos = range.start + fmod(fmod(m_pos - range.start, length) + length, length);
+        return true;
+    }
+    case Edge::CLAMP:
+        m_pos = std::max((double) range.start, std::min((double) range.end, m_pos));
+        return true;
+    case Edge::STOP:
+    default:
+        if (m_pos >= range.end || m_pos < range.start) {
+            m_finished = true;
+            return false;
+        }
+        return true;
+    }
+}
+
+// 4 point cubic hermite, silence outside the buffer
+void Varispeed::read_frame(double pos, float* out) const {
+    int64_t i = (int64_t) floor(pos);
+    float t = (float) (pos - i);
+
+    for (int c = 0; c < m_num_channels; c++) {
+        float y[4];
+        for (int k = 0; k < 4; k++) {
+            int64_t f = i - 1 + k;
+            y[k] = (f >= 0 && f < m_total_frames) ? m_samples[f * m_num_channels + c] : 0.0f;
+        }
+
+        float c1 = 0.5f * (y[2] - y[0]);
+        float c2 = y[0] - 2.5f * y[1] + 2.0f * y[2] - 0.5f * y[3];
+        float c3 = 0.5f * (y[3] - y[0]) + 1.5f * (y[1] - y[2]);
+        out[c] = ((c3 * t + c2) * t + c1) * t + y[1];
+    }
+}
+
+float Varispeed::read_mono(int64_t pos) const {
+    if (pos < 0 || pos >= m_total_frames)
+        return 0;
+
+    const float* frame = m_samples + pos * m_num_channels;
+    return m_num_channels == 2 ? (frame[0] + frame[1]) * 0.5f : frame[0];
+}
+
+// picks the segment near the nominal position that lines up best with the natural
+// continuation of the previous segment
+int64_t Varispeed::find_best_offset(int64_t nominal, int64_t continuation) {
+    int num_points = (int) m_continuation.size();
+    for (int j = 0; j < num_points; j++)
+        m_continuation[j] = read_mono(continuation + j * search_decimation);
+
+    int64_t best = nominal;
+    double best_score = -1e30;
+
+    for (int offset = -m_search_radius; offset <= m_search_radius; offset += 2) {
+        int64_t candidate = nominal + offset;
+        double xy = 0, xx = 0;
+        for (int j = 0; j < num_points; j++) {
+            float x = read_mono(candidate + j * search_decimation);
+            xy += x * m_continuation[j];
+            xx += x * x;
+        }
+
+        double score = xy / sqrt(xx + 1e-9);
+        if (score > best_score) {
+            best_score = score;
+            best = candidate;
+        }
+    }
+
+    return best;
+}
+
+void Varispeed::synthesize_hop(double step, const Range& range) {
+    int64_t nominal = (int64_t) floor(m_pos);
+    int64_t segment = m_prev_segment < 0 ? nominal : find_best_offset(nominal, m_prev_segment + m_hop);
+
+    for (int i = 0; i < m_window_size; i++) {
+        int64_t f = segment + i;
+        if (f < 0 || f >= m_total_frames)
+            continue;
+
+        for (int c = 0; c < m_num_channels; c++)
+            m_accum[i * m_num_channels + c] += m_window[i] * m_samples[f * m_num_channels + c];
+    }
+
+    // the first hop has received all of its overlaps now
+    int hop_samples = m_hop * m_num_channels;
+    memcpy(m_ready.data(), m_accum.data(), hop_samples * sizeof(float));
+    memmove(m_accum.data(), m_accum.data() + hop_samples, (m_accum.size() - hop_samples) * sizeof(float));
+    std::fill(m_accum.end() - hop_samples, m_accum.end(), 0.0f);
+    m_ready_pos = 0;
+    m_ready_count = m_hop;
+
+    m_prev_segment = segment;
+    advance(step * m_hop, range);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+// reads the buffer at an arbitrary, continuously changing rate (negative plays backwards)
+// either like tape, with cubic interpolation, or with wsola so the pitch stays the same
+class Varispeed {
+public:
+    enum class Mode {
+        RESAMPLE,
+        KEEP_PITCH,
+    };
+
+    // what happens when the position leaves the range
+    enum class Edge {
+        STOP,
+        WRAP,
+        CLAMP,
+    };
+
+    struct Range {
+        int64_t start, end;
+        Edge edge;
+    };
+
+    Varispeed() {}
+
+    void init(int num_channels, int sample_rate);
+    void reset(double pos, double step);
+
+    // renders num_frames of interleaved output, the step (source frames per output frame) glides
+    // from the previous call's value to the new one over the block
+    // returns the number of frames produced before running off the range
+    int render(const float* samples, int64_t total_frames, float* out, int num_frames, double step, Mode mode, const Range& range);
+
+    double get_pos() const { return m_pos; }
+    double get_step() const { return m_step; }
+
+private:
+    bool advance(double step, const Range& range);
+    void read_frame(double pos, float* out) const;
+    float read_mono(int64_t pos) const;
+    int64_t find_best_offset(int64_t nominal, int64_t continuation);
+    void synthesize_hop(double step, const Range& range);
+
+private:
+    int m_num_channels = 0;
+    double m_pos = 0;
+    double m_step = 1;
+
+    // source the current render call reads from
+    const float* m_samples = nullptr;
+    int64_t m_total_frames = 0;
+
+    // wsola
+    int m_window_size = 0;
+    int m_hop = 0;
+    int m_search_radius = 0;
+    std::vector<float> m_window;
+    std::vector<float> m_accum; // overlap-add area, interleaved, one window long
+    std::vector<float> m_ready; // finished output frames not handed out yet
+    std::vector<float> m_continuation; // decimated mono, for the similarity search
+    int m_ready_pos = 0, m_ready_count = 0;
+    int64_t m_prev_segment = -1;
+    bool m_finished = false;
+};
@@ -1,48 +1,275 @@
 #include "waveform_cache.h"
 
 #include "app.h"
+#include "parallel.h"
 #include <math.h>
 #include <algorithm>
 
-void WaveformVisual::render(int64_t start_frame, int64_t end_frame) {
-    int64_t total_frames = the_app.buffer.get_num_frames();
+// every level divides the next one, so coarse buckets are built from the finer ones
+static const int bucket_sizes[] = {
+    128, 8192,
+};
+
+static const int64_t buckets_per_task = 2048;
+
+// the render thread does one step per request, well within what an effect keeps cached, so the
+// step is still there when poll_rendered reads it
+static const int64_t render_step_frames = 1 << 20;
+
+WaveformVisual::~WaveformVisual() {
+    {
+        std::lock_guard<std::mutex> lock(render_mutex);
+        render_quit = true;
+    }
+    render_cond.notify_one();
+    if (render_worker.joinable())
+        render_worker.join();
+}
+
+void WaveformVisual::render() {
+    int64_t total_frames = get_edited_frames();
     num_channels = the_app.buffer.get_num_channels();
-    const int bucket_sizes[] = {
-        128, 8192,
-    };
 
     Q_ASSERT(num_levels <= sizeof(bucket_sizes) / sizeof(bucket_sizes[0]));
 
+    levels.clear();
     for (int i = 0; i < num_levels; i++) {
-        int bucket_size = bucket_sizes[i];
         Level level;
-        level.bucket_size = bucket_size;
+        level.bucket_size = bucket_sizes[i];
 
-        for (int channel = 0; channel < num_channels; channel++) {
-            // rounded up
-            int64_t num_buckets = (total_frames + bucket_size - 1) / bucket_size;
+        // rounded up
+        int64_t num_buckets = (total_frames + level.bucket_size - 1) / level.bucket_size;
+        for (int channel = 0; channel < num_channels; channel++)
+            level.buckets[channel].resize(num_buckets);
+
+        levels.push_back(std::move(level));
+        if (i == 0)
+            unrendered.assign(num_buckets, 0);
+        sample_buckets(i, 0, num_buckets);
+    }
+    request_unrendered();
+}
+
+void WaveformVisual::update(int64_t start, int64_t old_end, int64_t new_end) {
+    // a different channel count or a fresh buffer changes everything
+    if (levels.empty() || num_channels != the_app.buffer.get_num_channels()) {
+        render();
+        return;
+    }
+
+    int64_t total_frames = get_edited_frames();
+    int64_t shift = new_end - old_end;
+
+    for (int i = 0; i < num_levels; i++) {
+        Level& level = levels[i];
+        int64_t bucket_size = level.bucket_size;
+        int64_t old_num_buckets = (int64_t) level.buckets[0].size();
+        int64_t num_buckets = (total_frames + bucket_size - 1) / bucket_size;
+
+        int64_t first_dirty = std::min(start / bucket_size, num_buckets);
+        int64_t last_dirty = num_buckets;
+
+        if (shift % bucket_size == 0) {
+            // the buckets past the edit hold the same frames, just somewhere else
+            int64_t first_clean = std::min((old_end + bucket_size - 1) / bucket_size, old_num_buckets);
+            int64_t bucket_shift = shift / bucket_size;
+            last_dirty = std::max(first_dirty, std::min(num_buckets, first_clean + bucket_shift));
+
+            auto move_along = [&](auto& buckets) {
+                if (bucket_shift > 0) {
+                    buckets.resize(num_buckets);
+                    std::copy_backward(buckets.begin() + first_clean, buckets.begin() + old_num_buckets, buckets.begin() + num_buckets);
+                } else if (bucket_shift < 0) {
+                    std::copy(buckets.begin() + first_clean, buckets.begin() + old_num_buckets, buckets.begin() + first_clean + bucket_shift);
+                    buckets.resize(num_buckets);
+                }
+            };
+            for (int channel = 0; channel < num_channels; channel++)
+                move_along(level.buckets[channel]);
+            if (i == 0)
+                move_along(unrendered);
+        } else {
+            for (int channel = 0; channel < num_channels; channel++)
+                level.buckets[channel].resize(num_buckets);
+            if (i == 0)
+                unrendered.resize(num_buckets);
+        }
+
+        sample_buckets(i, first_dirty, last_dirty);
+    }
+    request_unrendered();
+}
+
+bool WaveformVisual::set_levels(std::vector<Level> new_levels) {
+    int64_t total_frames = get_edited_frames();
+    int new_num_channels = the_app.buffer.get_num_channels();
+    if ((int) new_levels.size() != num_levels)
+        return false;
+
+    for (int i = 0; i < num_levels; i++) {
+        const Level& level = new_levels[i];
+        if (level.bucket_size != bucket_sizes[i])
+            return false;
+
+        int64_t num_buckets = (total_frames + level.bucket_size - 1) / level.bucket_size;
+        for (int channel = 0; channel < 2; channel++) {
+            int64_t expected = channel < new_num_channels ? num_buckets : 0;
+            if ((int64_t) level.buckets[channel].size() != expected)
+                return false;
+        }
+    }
+
+    levels = std::move(new_levels);
+    num_channels = new_num_channels;
+    unrendered.assign(levels[0].buckets[0].size(), 0);
+    return true;
+}
+
+bool WaveformVisual::has_unrendered() const {
+    int64_t first, last;
+    return find_unrendered(first, last);
+}
 
-            int64_t start_bucket = start_frame / bucket_size;
-            int64_t end_bucket = end_frame == -1 ? num_buckets : end_frame / bucket_size;
+void WaveformVisual::render_missing(int64_t start, int64_t end) {
+    if (start >= end)
+        return;
 
-            if (end_bucket >= level.buckets[channel].size())
-                level.buckets[channel].resize(end_bucket);
+    {
+        std::lock_guard<std::mutex> lock(render_mutex);
+        if (render_edits) {
+            start = std::min(start, render_start);
+            end = std::max(end, render_end);
+        }
+        render_edits = std::make_unique<EditList>(the_app.edits);
+        render_start = start;
+        render_end = end;
+    }
+    render_cond.notify_one();
+
+    if (!render_worker.joinable())
+        render_worker = std::thread(&WaveformVisual::render_thread, this);
+}
+
+bool WaveformVisual::poll_rendered() {
+    if (!rendered.exchange(false))
+        return false;
 
-            for (int b = start_bucket; b < end_bucket; b++) {
-                int64_t bucket_start_frame = b * bucket_size;
-                int64_t bucket_end_frame = bucket_start_frame + bucket_size;
+    int64_t start, end;
+    {
+        std::lock_guard<std::mutex> lock(render_mutex);
+        start = rendered_start;
+        end = rendered_end;
+    }
+
+    // only the step that was rendered, the rest of a long range could be dropped again by now
+    int64_t first, last;
+    if (find_unrendered(first, last)) {
+        first = std::max(first, start / levels[0].bucket_size);
+        last = std::min(last, (end + levels[0].bucket_size - 1) / levels[0].bucket_size);
+        for (int i = 0; i < num_levels && first < last; i++) {
+            int64_t ratio = levels[i].bucket_size / levels[0].bucket_size;
+            sample_buckets(i, first / ratio, (last + ratio - 1) / ratio);
+        }
+    }
 
+    // whatever is still missing, the next step or frames an edit since the request brought in,
+    // gets asked for again
+    request_unrendered();
+    return true;
+}
+
+// level 0 buckets [first, last) span every one that was sampled before it was rendered
+bool WaveformVisual::find_unrendered(int64_t& first, int64_t& last) const {
+    auto it = std::find(unrendered.begin(), unrendered.end(), 1);
+    if (it == unrendered.end())
+        return false;
+
+    first = it - unrendered.begin();
+    last = unrendered.rend() - std::find(unrendered.rbegin(), unrendered.rend(), 1);
+    return true;
+}
+
+void WaveformVisual::request_unrendered() {
+    int64_t first, last;
+    if (find_unrendered(first, last))
+        render_missing(first * levels[0].bucket_size, last * levels[0].bucket_size);
+}
+
+void WaveformVisual::render_thread() {
+    for (;;) {
+        std::unique_ptr<EditList> edits;
+        int64_t start, end;
+        {
+            std::unique_lock<std::mutex> lock(render_mutex);
+            render_cond.wait(lock, [&]() { return render_quit || render_edits; });
+            if (render_quit)
+                return;
+            edits = std::move(render_edits);
+            start = render_start;
+            end = render_end;
+        }
+
+        // what's left of the range is asked for again once the buckets of this step are sampled
+        end = std::min(end, start + render_step_frames);
+        edits->prefetch(start, end);
+
+        {
+            std::lock_guard<std::mutex> lock(render_mutex);
+            rendered_start = start;
+            rendered_end = end;
+        }
+        rendered = true;
+    }
+}
+
+void WaveformVisual::sample_buckets(int level_i, int64_t first, int64_t last) {
+    if (first >= last)
+        return;
+
+    Level& level = levels[level_i];
+    const AudioBuffer& buffer = the_app.buffer;
+    const EditList& edits = the_app.edits;
+    bool non_destructive = the_app.non_destructive;
+
+    parallel_for((last - first + buckets_per_task - 1) / buckets_per_task, [&](int64_t task) {
+        int64_t task_first = first + task * buckets_per_task;
+        int64_t task_last = std::min(last, task_first + buckets_per_task);
+
+        for (int channel = 0; channel < num_channels; channel++) {
+            for (int64_t b = task_first; b < task_last; b++) {
                 float min, max;
-                the_app.buffer.sample_amplitude(channel, bucket_start_frame, bucket_end_frame, max, min);
+                if (level_i == 0) {
+                    int64_t bucket_start_frame = b * level.bucket_size;
+                    bool complete = true;
+                    if (non_destructive)
+                        complete = edits.sample_amplitude(channel, bucket_start_frame, bucket_start_frame + level.bucket_size, max, min, false);
+                    else
+                        buffer.sample_amplitude(channel, bucket_start_frame, bucket_start_frame + level.bucket_size, max, min);
+
+                    // every channel reads the same frames
+                    if (channel == 0 || !complete)
+                        unrendered[b] = !complete;
+                } else {
+                    const Level& finer = levels[level_i - 1];
+                    int64_t ratio = level.bucket_size / finer.bucket_size;
+                    int64_t finer_first = b * ratio;
+                    int64_t finer_last = std::min(finer_first + ratio, (int64_t) finer.buckets[channel].size());
+
+                    min = 2;
+                    max = -2;
+                    for (int64_t f = finer_first; f < finer_last; f++) {
+                        min = fmin(min, finer.buckets[channel][f].min);
+                        max = fmax(max, finer.buckets[channel][f].max);
+                    }
+                }
+
                 level.buckets[channel][b] = Bucket{
                     .min = min,
                     .max = max,
                 };
             }
         }
-
-        levels.push_back(std::move(level));
-    }
+    });
 }
 
 // find coarsest zoom level for which:
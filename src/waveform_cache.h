@@ -1,7 +1,13 @@
 #pragma once
 
+#include "edit_list.h"
 #include <vector>
+#include <condition_variable>
 #include <cstdint>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 class WaveformVisual {
 public:
@@ -15,8 +21,17 @@ public:
     };
 
     WaveformVisual() {}
+    ~WaveformVisual();
+
+    // drops every level and samples them again from the buffer, or the edit list
+    // effects in the edit list aren't rendered for it, what they haven't rendered yet reads as
+    // silence until the render thread is done with it, see poll_rendered
+    void render();
+
+    // the edit replaced frames [start, old_end) with [start, new_end), only the buckets it touched
+    // are sampled again, the ones after it are moved along if the edit kept them on the grid
+    void update(int64_t start, int64_t old_end, int64_t new_end);
 
-    void render(int64_t start_frame = 0, int64_t end_frame = -1);
     int find_best_level(double frames_per_pixel) const;
     void sample(int64_t frame_start, int64_t frame_end, int level_i, int channel, float& min, float& max) const;
 
@@ -26,8 +41,41 @@ public:
         return levels[level];
     }
 
+    // for a project to keep them, set_levels returns false without touching anything if they
+    // don't fit the buffer, or the edit list, as it is now
+    const std::vector<Level>& get_levels() const { return levels; }
+    bool set_levels(std::vector<Level> new_levels);
+
+    // some buckets show silence where an effect hasn't rendered its frames yet
+    bool has_unrendered() const;
+
+    // gui thread, frames [start, end) of the edit list as it is now get rendered on the render
+    // thread, for anything else that reads it with render off, a newer request takes over
+    void render_missing(int64_t start, int64_t end);
+
+    // gui thread, once the render thread is done with a step of the request the buckets in it are
+    // sampled again and the next step is asked for, true if they were and the waveform needs drawing
+    bool poll_rendered();
+
+private:
+    void sample_buckets(int level_i, int64_t first, int64_t last);
+    bool find_unrendered(int64_t& first, int64_t& last) const;
+    void request_unrendered();
+    void render_thread();
+
 private:
     std::vector<Level> levels;
     const int num_levels = 2; // TODO: allow user to adjust?
     int num_channels = 0;
+    std::vector<uint8_t> unrendered; // by level 0 bucket, sampled before its frames were rendered
+
+    // the next request for the render thread, a newer one replaces it
+    std::mutex render_mutex;
+    std::condition_variable render_cond;
+    std::unique_ptr<EditList> render_edits; // null if there's nothing to do
+    int64_t render_start = 0, render_end = 0;
+    int64_t rendered_start = 0, rendered_end = 0; // the frames of the last step it did
+    bool render_quit = false;
+    std::thread render_worker;
+    std::atomic<bool> rendered = false; // set by the render thread, cleared by poll_rendered
 };